@@ -99,5 +99,6 @@ struct opl3_chip {
 void OPL3_Reset(opl3_chip *chip, Bit32u samplerate);
 Bit32u OPL3_WriteAddr(opl3_chip *chip, Bit32u port, Bit8u val);
 void OPL3_WriteReg(opl3_chip *chip, Bit16u reg, Bit8u v);
+void OPL3_GenerateBlock(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples);
 void OPL3_GenerateStream(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples);
 #endif
@@ -199,6 +199,8 @@ void mem_remap_top_256k();
 void mem_remap_top_384k();
 
 void mem_flush_write_page(uint32_t addr, uint32_t virt);
+void addwritelookup_ptr(uint32_t virt, uint8_t *p);
+void mem_flush_write_ptr_range(uint8_t *p, uint32_t size);
 
 void mem_add_bios();
 
@@ -17,5 +17,14 @@ void writedma2(uint8_t temp);
 
 int dma_channel_read(int channel);
 int dma_channel_write(int channel, uint16_t val);
+/*Block transfers return the number of transfers made, with DMA_OVER or'd in at terminal count, or
+  DMA_NODATA if the channel refused the first transfer. Callers must check for DMA_NODATA and mask off
+  DMA_OVER before using the count (sound_sb_dsp.c and fdc.c do)*/
+int dma_channel_read_block(int channel, uint16_t *buf, int len);
+int dma_channel_write_block(int channel, uint16_t *buf, int len);
+int dma_channel_write_space(int channel);
+
+void dma_add_sync_handler(void (*sync)(void *p), void *p);
+void dma_remove_sync_handler(void (*sync)(void *p), void *p);
 
 #endif /* _DMA_H_ */
@@ -34,6 +34,12 @@ class SIDFP {
         static float kinked_dac(const int x, const float nonlinearity, const int bits);
         bool sse_enabled() { return can_use_sse; }
 
+        // Select the resampling FIR kernel. Returns false, leaving the kernel
+        // unchanged, if the host can't run the one asked for.
+        bool set_convolve_kernel(convolve_kernel kernel);
+        convolve_kernel get_convolve_kernel() { return convolve_kernel_type; }
+        static const char *convolve_kernel_name(convolve_kernel kernel);
+
         void set_chip_model(chip_model model);
         FilterFP &get_filter() { return filter; }
         void enable_filter(bool enable);
@@ -120,6 +126,9 @@ class SIDFP {
         float *fir;
 
         bool can_use_sse;
+
+        convolve_kernel convolve_kernel_type;
+        float (*convolve_fn)(const float *a, const float *b, int n);
 };
 
 #endif // not __SID_H__
@@ -62,6 +62,10 @@ enum chip_model { MOS6581FP = 1, MOS8580FP };
 
 enum sampling_method { SAMPLE_INTERPOLATE = 1, SAMPLE_RESAMPLE_INTERPOLATE };
 
+// Resampling FIR convolution kernels. SIDFP picks the best one the host
+// supports; CONVOLVE_AUTO asks for that choice again.
+enum convolve_kernel { CONVOLVE_AUTO = 0, CONVOLVE_C, CONVOLVE_SSE, CONVOLVE_AVX2 };
+
 extern "C" {
 #ifndef __VERSION_CC__
 extern const char *resid_version_string;
@@ -79,6 +83,14 @@ const char *resid_version_string = VERSION;
 #define RESID_USE_SSE 0
 #endif
 
+// AVX2 code is compiled per function with a target attribute and only run
+// once the CPU has been checked, so it doesn't depend on the build target.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define RESID_USE_AVX2 1
+#else
+#define RESID_USE_AVX2 0
+#endif
+
 #define HAVE_LOGF
 #define HAVE_EXPF
 #define HAVE_LOGF_PROTOTYPE
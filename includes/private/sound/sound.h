@@ -3,6 +3,7 @@
 #include "timer.h"
 
 void sound_add_handler(void (*get_buffer)(int32_t *buffer, int len, void *p), void *p);
+void sound_add_status_info(char *s, int max_len);
 
 extern int sound_card_current;
 
@@ -19,23 +20,30 @@ void sound_set_cd_volume(unsigned int vol_l, unsigned int vol_r);
 #define CD_BUFLEN (CD_FREQ / 10)
 
 extern int sound_pos_global;
+int sound_pos_at(uint64_t ts);
 void sound_speed_changed();
 
 void sound_init();
 void sound_init_builtin();
 void sound_reset();
 
-void initalmain(int argc, char *argv[]);
-void inital();
-
-void givealbuffer(int32_t *buf);
-void givealbuffer_cd(int16_t *buf);
-
 extern int sound_buf_len;
 void sound_update_buf_length();
 
 extern int sound_gain;
 
+/*Synth cores can run on a separate audio thread. Register writes are logged along with the sample
+  position they were made at, and replayed in order on the audio thread, which renders up to each
+  write before applying it. render() is called with the position to render up to within the current
+  buffer*/
+typedef struct sound_synth_t sound_synth_t;
+
+extern int sound_synth_thread;
+
+sound_synth_t *sound_synth_add(void (*write)(uint32_t addr, uint8_t val, void *p), void (*render)(int end, void *p), void *p);
+void sound_synth_write(sound_synth_t *synth, uint32_t addr, uint8_t val);
+void sound_synth_stop();
+
 extern int sound_buf_len_al;
 #define MAXSOUNDBUFLEN (48000 / 10)
 
@@ -0,0 +1,18 @@
+#ifndef _SOUND_CAPTURE_H_
+#define _SOUND_CAPTURE_H_
+
+/*Capture of the mixed 48 kHz stream, and optionally of each sound handler's output, to 16-bit stereo
+  WAV files. Samples are gathered into blocks on the emulation thread and written out by a separate
+  thread, so file I/O doesn't stall emulation. Each capture gets its own sequence number, so capture.wav
+  is written as capture_0001.wav, with the per-handler files named after the device*/
+extern int sound_capture;
+extern int sound_capture_devices;
+extern int sound_capture_unthrottled;
+extern char sound_capture_file[512];
+
+void sound_capture_mix(int32_t *buf, int len);
+void sound_capture_device(int dev, const char *name, int32_t *buf, int len);
+void sound_capture_close();
+void sound_capture_add_status_info(char *s, int max_len);
+
+#endif /* _SOUND_CAPTURE_H_ */
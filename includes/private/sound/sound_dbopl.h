@@ -6,6 +6,8 @@ extern "C" {
 void opl_init(void (*timer_callback)(void *param, int timer, int64_t period), void *timer_param, int nr, int is_opl3,
               int opl_emu);
 void opl_write(int nr, uint16_t addr, uint8_t val);
+void opl_write_chip(int nr, uint16_t addr, uint8_t val);
+void opl_write_timers(int nr, uint16_t addr, uint8_t val);
 uint8_t opl_read(int nr, uint16_t addr);
 void opl_timer_over(int nr, int timer);
 void opl2_update(int nr, int16_t *buffer, int samples);
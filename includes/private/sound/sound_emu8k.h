@@ -106,8 +106,8 @@ typedef struct emu8k_chorus_eng_t {
 
 } emu8k_chorus_eng_t;
 
-/*  32 * 242. 32 comes from the "right" room resso case.*/
-#define MAX_REFL_SIZE 7744
+/*  34 * 242. The last reflection can be up to 33 steps long and the tail one step longer than that.*/
+#define MAX_REFL_SIZE 8228
 
 /* Reverb parameters description, extracted from AST sources.
  Mix level
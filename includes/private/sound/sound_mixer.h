@@ -0,0 +1,10 @@
+#ifndef _SOUND_MIXER_H_
+#define _SOUND_MIXER_H_
+
+/*Mixing kernels for interleaved stereo int32 buffers. len is in samples, ie twice the frame count*/
+void sound_mix_add(int32_t *dst, const int32_t *src, int len);
+void sound_mix_add_gain(int32_t *dst, const int32_t *src, int len, float gain_l, float gain_r);
+void sound_mix_scale(int32_t *buf, int len, float gain);
+void sound_mix_clamp16(int16_t *dst, const int32_t *src, int len);
+
+#endif /* _SOUND_MIXER_H_ */
@@ -11,6 +11,8 @@ typedef struct opl_t {
 
         int16_t buffer[MAXSOUNDBUFLEN * 2];
         int pos;
+
+        sound_synth_t *synth; /*Non-NULL if the chip core runs on the audio thread*/
 } opl_t;
 
 uint8_t opl2_read(uint16_t a, void *priv);
@@ -0,0 +1,34 @@
+#ifndef _SOUND_OUT_H_
+#define _SOUND_OUT_H_
+
+/*Host audio output. Mixed buffers go into a ring buffer, and the backend pulls from it through a
+  resampler whose rate follows the ring fill level, so the ring stays near sound_latency milliseconds
+  however the emulation speed varies. Backends that are not paced by a real audio device take the
+  stream unchanged. The output gain (sound_gain) is applied here, before any backend*/
+typedef struct sound_backend_t {
+        const char *name;
+        int realtime;
+
+        int (*init)();
+        void (*close)();
+
+        /*Number of 48 kHz stereo frames the backend can take now. Realtime backends are written
+          sound_buf_len_al frames at a time*/
+        int (*get_space)();
+        void (*write)(int16_t *buf, int frames);
+        void (*write_cd)(int16_t *buf, int frames);
+} sound_backend_t;
+
+extern sound_backend_t sound_backend_openal;
+
+extern char sound_backend_name[64];
+extern char sound_output_file[512];
+extern int sound_latency;
+
+void sound_out_init();
+void sound_out_close();
+void sound_out_write(int32_t *buf, int len);
+void sound_out_write_cd(int16_t *buf);
+void sound_out_add_status_info(char *s, int max_len);
+
+#endif /* _SOUND_OUT_H_ */
@@ -3,7 +3,7 @@
 #ifdef __cplusplus
 extern "C" {
 #endif
-void *sid_init();
+void *sid_init(int resample);
 void sid_close(void *p);
 void sid_reset(void *p);
 uint8_t sid_read(uint16_t addr, void *p);
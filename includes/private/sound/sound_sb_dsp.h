@@ -12,6 +12,9 @@
          (dsp)->sb_subtype == SB_SUBTYPE_CLONE_AZT1605_0X0C) // check for future AZT cards here
 #define AZTECH_EEPROM_SIZE 16
 
+/*Most output samples generated between timer callbacks*/
+#define SB_DSP_BLOCK_LEN 128
+
 typedef struct sb_dsp_t {
         int sb_type;
         int sb_subtype; // which clone
@@ -64,6 +67,21 @@ typedef struct sb_dsp_t {
 
         pc_timer_t output_timer, input_timer;
 
+        /*Output is generated lazily. out_ts is the time of the next output sample; samples up to the
+          current time are run when the DSP is written or the buffer is collected, and output_timer only
+          fires for samples that can raise an IRQ. PCM DMA for a run of samples is prefetched into dma_buf*/
+        int out_running;
+        uint64_t out_ts;
+        uint16_t dma_buf[SB_DSP_BLOCK_LEN * 2];
+        int dma_buf_pos, dma_buf_len, dma_buf_active;
+
+        /*Input runs the same way, with in_ts and input_timer. DMA writes for a run of samples are gathered
+          in dma_in_buf*/
+        int in_running;
+        uint64_t in_ts;
+        uint16_t dma_in_buf[SB_DSP_BLOCK_LEN * 2];
+        int dma_in_len, dma_in_active;
+
         uint64_t sblatcho, sblatchi;
 
         uint16_t sb_addr;
@@ -1,5 +1,7 @@
 #ifndef _VID_CGA_H_
 #define _VID_CGA_H_
+#include "vid_text_cache.h"
+
 typedef struct cga_t {
         mem_mapping_t mapping;
 
@@ -33,6 +35,8 @@ typedef struct cga_t {
         int revision;
         int composite;
         int snow_enabled;
+
+        text_cache_t text_cache;
 } cga_t;
 
 void cga_init(cga_t *cga);
@@ -1,5 +1,8 @@
 #ifndef _VID_EGA_H_
 #define _VID_EGA_H_
+
+#include "vid_text_cache.h"
+
 typedef struct ega_t {
         mem_mapping_t mapping;
 
@@ -63,6 +66,9 @@ typedef struct ega_t {
         int vrammask;
         uint32_t vram_limit;
 
+        int text_changed;
+        text_cache_t text_cache;
+
         int video_res_x, video_res_y, video_bpp;
         int frames;
 } ega_t;
@@ -1,6 +1,8 @@
 #ifndef _VID_MDA_H_
 #define _VID_MDA_H_
 
+#include "vid_text_cache.h"
+
 typedef struct mda_t {
         mem_mapping_t mapping;
 
@@ -22,6 +24,8 @@ typedef struct mda_t {
         int vsynctime, vadj;
 
         uint8_t *vram;
+
+        text_cache_t text_cache;
 } mda_t;
 
 void mda_init(mda_t *mda);
@@ -1,5 +1,21 @@
 #ifndef _VID_SVGA_H_
 #define _VID_SVGA_H_
+
+#include "vid_text_cache.h"
+
+#define SVGA_MAX_LAYER_LINES 2048
+
+/*A displayed line with the hardware cursor and/or a deferred overlay on it*/
+typedef struct svga_layer_line_t {
+        int displine;
+        int hwcursor, hwcursor_oddeven;
+        int overlay, overlay_oddeven;
+
+        /*Span of the buffer32 line saved before compositing, and its position in layer_save*/
+        int x, w;
+        int save_offset;
+} svga_layer_line_t;
+
 typedef struct svga_t {
         mem_mapping_t mapping;
 
@@ -50,6 +66,11 @@ typedef struct svga_t {
 
         int set_reset_disabled;
 
+        /*Planar write state, recomputed by svga_recalc_write_state() when the GDC
+          registers change. Each uint32_t holds one byte per plane*/
+        uint32_t write_bitmask, write_sr_enable, write_sr_value;
+        int write_rotate, write_op;
+
         uint8_t egapal[16];
         uint32_t pallook[512];
         PALETTE vgapal;
@@ -92,6 +113,8 @@ typedef struct svga_t {
         uint32_t write_bank, read_bank;
 
         int fullchange;
+        int text_changed; /*Text (plane 0/1) VRAM written, text lines must be checked against text_cache*/
+        text_cache_t text_cache;
 
         int video_res_x, video_res_y, video_bpp;
         int video_res_override; /*If clear then SVGA code will set above variables, if
@@ -114,6 +137,23 @@ typedef struct svga_t {
         int hwcursor_oddeven;
         int overlay_oddeven;
 
+        /*The hardware cursor is not drawn while lines are rendered. Displayed lines it covers are
+          recorded, and the cursor is composited onto buffer32 just before the frame is blitted.
+          The pixels under it are saved and put back once the blit has finished with the buffer,
+          so buffer32 only holds the rendered VRAM image and lines do not need to be re-rendered
+          when the cursor moves.
+
+          If overlay_deferred is set then overlay_draw is treated the same way. A card may only set
+          this if overlay_draw depends on nothing but overlay_latch, overlay_oddeven and its own
+          registers, and not on buffer32 retaining what it drew on previous frames*/
+        int overlay_deferred;
+        svga_layer_line_t *layer_lines;
+        int nr_layer_lines;
+        int layers_saved;
+        uint32_t *layer_save;
+        int layer_save_size;
+        int layer_restored_first, layer_restored_last;
+
         void (*render)(struct svga_t *svga);
         void (*recalctimings_ex)(struct svga_t *svga);
 
@@ -158,6 +198,13 @@ typedef struct svga_t {
 
         int remap_required;
         uint32_t (*remap_func)(struct svga_t *svga, uint32_t in_addr);
+
+        /*If set, LFB writes through this mapping put the VRAM page they hit straight into the CPU
+          write TLB, so later writes to that page run at RAM speed. The pages are taken back out at
+          the end of each frame, so the first write to a page in every frame still goes through the
+          handler and marks changedvram*/
+        mem_mapping_t *lfb_direct_mapping;
+        int lfb_direct_mapped;
 } svga_t;
 
 extern int svga_init(svga_t *svga, void *p, int memsize, void (*recalctimings_ex)(struct svga_t *svga),
@@ -184,6 +231,8 @@ void svga_add_status_info(char *s, int max_len, void *p);
 
 extern uint8_t svga_rotate[8][256];
 
+void svga_recalc_write_state(svga_t *svga);
+
 void svga_out(uint16_t addr, uint8_t val, void *p);
 uint8_t svga_in(uint16_t addr, void *p);
 
@@ -196,4 +245,7 @@ void svga_set_ramdac_type(svga_t *svga, int type);
 
 void svga_doblit(int y1, int y2, int wx, int wy, svga_t *svga);
 
+void svga_lfb_map_direct(svga_t *svga, uint32_t addr, uint32_t vram_addr);
+void svga_lfb_flush_direct(svga_t *svga);
+
 #endif /* _VID_SVGA_H_ */
@@ -0,0 +1,46 @@
+#ifndef _VID_TEXT_CACHE_H_
+#define _VID_TEXT_CACHE_H_
+
+#include <stddef.h>
+
+/*Text mode line cache.
+
+  Remembers, for each display line, a key describing what the text renderer last drew there :
+  the character/attribute pairs plus whatever else affects the output (scanline within the
+  row, cursor position, blink phase etc). If the key for a line has not changed then the
+  line in buffer32 is still correct and does not need to be rasterised again.
+
+  Keys are built by the caller, and must be complete - anything that can change the pixels
+  on the line must either be in the key or invalidate the cache.*/
+
+#define TEXT_CACHE_MAX_CELLS 256
+
+typedef struct text_cache_key_t {
+        int params[8];
+        uint8_t cells[TEXT_CACHE_MAX_CELLS * 2];
+} text_cache_key_t;
+
+#define TEXT_CACHE_KEY_LEN(nr_cells) (offsetof(text_cache_key_t, cells) + (nr_cells)*2)
+
+typedef struct text_cache_t {
+        int lines;
+        int *key_len;
+        text_cache_key_t *keys;
+} text_cache_t;
+
+void text_cache_init(text_cache_t *cache, int lines);
+void text_cache_close(text_cache_t *cache);
+void text_cache_invalidate(text_cache_t *cache);
+
+/*Returns 1 if line was last drawn with this key. Otherwise stores the key and returns 0, and
+  the caller must draw the line*/
+int text_cache_check(text_cache_t *cache, int line, text_cache_key_t *key, int len);
+/*Store key for a line that is being drawn unconditionally*/
+void text_cache_store(text_cache_t *cache, int line, text_cache_key_t *key, int len);
+/*Line has been drawn by something other than the text renderer*/
+static inline void text_cache_invalidate_line(text_cache_t *cache, int line) {
+        if (line < cache->lines)
+                cache->key_len[line] = 0;
+}
+
+#endif /* _VID_TEXT_CACHE_H_ */
@@ -0,0 +1,931 @@
+/*Registers :
+
+  alphaMode
+  fbzMode & 0x1f3fff
+  fbzColorPath
+*/
+
+/*AArch64 pixel pipeline recompiler.
+
+  This mirrors the x86-64 generator, but only covers the most common pipeline
+  configurations. Fog, alpha blending, tiled framebuffers and the trexInit1 TMU
+  config override are not handled natively; voodoo_get_block() returns NULL for
+  these and voodoo_half_triangle() falls back to the C pixel loop. Texture fetch
+  is done by calling back into voodoo_tmu_fetch()/voodoo_tmu_fetch_and_blend().
+
+  Colour combine is done on packed ARGB words expanded into 16-bit NEON lanes,
+  ordered [b, g, r, a] to match the layout of color0/color1 and the iterated
+  ib/ig/ir/ia block in voodoo_state_t.
+
+  Register usage :
+  X19 = state
+  X20 = params
+  X21 = voodoo
+  W22 = real_y
+  W23 = x
+  W24 = new_depth
+  X16/X17 = scratch for call target/addressing
+  W0-W15, V0-V3 = scratch*/
+
+#ifndef _VID_VOODOO_CODEGEN_ARM64_H_
+#define _VID_VOODOO_CODEGEN_ARM64_H_
+
+#include <stdlib.h>
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(__APPLE__)
+#include <pthread.h>
+#endif
+#if defined(_WIN32)
+#define BITMAP windows_BITMAP
+#include <windows.h>
+#undef BITMAP
+#endif
+
+/*Compiled pipelines are held in a set-associative cache shared by all render
+  threads of a card, as in the x86-64 recompiler. Generated code lives in a
+  separate executable mapping, so that cache bookkeeping never has to write to
+  W^X protected memory.*/
+#define BLOCK_NUM 128
+#define BLOCK_WAYS 8
+#define BLOCK_SETS (BLOCK_NUM / BLOCK_WAYS)
+#define BLOCK_SIZE 8192
+
+#define LOD_MASK (LOD_TMIRROR_S | LOD_TMIRROR_T)
+
+typedef struct voodoo_arm64_data_t {
+        uint8_t *code_block;
+        int valid;
+        /*0 if this pipeline state is not supported by the recompiler*/
+        int native;
+        uint32_t last_used;
+        int xdir;
+        uint32_t alphaMode;
+        uint32_t fbzMode;
+        uint32_t fogMode;
+        uint32_t fbzColorPath;
+        uint32_t textureMode[2];
+        uint32_t tLOD[2];
+        uint32_t trexInit1;
+        int is_tiled;
+} voodoo_arm64_data_t;
+
+typedef struct voodoo_codegen_cache_t {
+        voodoo_arm64_data_t blocks[BLOCK_NUM];
+        uint8_t *code;
+
+        mutex_t *lock;
+        /*Bumped with an atomic add, as render threads hit pinned blocks without holding lock*/
+        uint32_t use_stamp;
+        /*Block currently executed by each render thread, or -1*/
+        volatile int in_use[VOODOO_MAX_RENDER_THREADS];
+} voodoo_codegen_cache_t;
+
+#define addlong(val)                                                                                                             \
+        do {                                                                                                                     \
+                *(uint32_t *)&code_block[block_pos] = val;                                                                       \
+                block_pos += 4;                                                                                                  \
+                if (block_pos >= BLOCK_SIZE)                                                                                     \
+                        fatal("Over!\n");                                                                                        \
+        } while (0)
+
+/*Condition codes*/
+enum {
+        COND_EQ = 0x0,
+        COND_NE = 0x1,
+        COND_HS = 0x2,
+        COND_LO = 0x3,
+        COND_HI = 0x8,
+        COND_LS = 0x9,
+        COND_GE = 0xa,
+        COND_LT = 0xb,
+        COND_GT = 0xc,
+        COND_AL = 0xe
+};
+
+#define REG_WZR 31
+#define REG_SP 31
+
+#define REG_STATE 19
+#define REG_PARAMS 20
+#define REG_VOODOO 21
+#define REG_REAL_Y 22
+#define REG_X 23
+#define REG_DEPTH 24
+
+/*Load/store, unsigned scaled 12-bit offset*/
+#define OPCODE_LDR_W 0xb9400000
+#define OPCODE_STR_W 0xb9000000
+#define OPCODE_LDR_X 0xf9400000
+#define OPCODE_STR_X 0xf9000000
+#define OPCODE_LDRH 0x79400000
+#define OPCODE_LDR_Q 0x3dc00000
+#define OPCODE_STR_Q 0x3d800000
+
+/*Load/store, register offset*/
+#define OPCODE_LDRH_SXTW 0x7860d800 /*LDRH Wt, [Xn, Wm, SXTW #1]*/
+#define OPCODE_STRH_SXTW 0x7820d800 /*STRH Wt, [Xn, Wm, SXTW #1]*/
+#define OPCODE_LDRB_REG 0x38606800  /*LDRB Wt, [Xn, Xm]*/
+
+#define OPCODE_STP_X_PRE 0xa9800000
+#define OPCODE_STP_X 0xa9000000
+#define OPCODE_LDP_X 0xa9400000
+#define OPCODE_LDP_X_POST 0xa8c00000
+
+/*Data processing, immediate*/
+#define OPCODE_ADD_IMM_W 0x11000000
+#define OPCODE_ADD_IMM_X 0x91000000
+#define OPCODE_SUB_IMM_W 0x51000000
+#define OPCODE_SUBS_IMM_W 0x71000000
+#define OPCODE_MOVZ_W 0x52800000
+#define OPCODE_MOVK_W 0x72800000
+#define OPCODE_MOVZ_X 0xd2800000
+#define OPCODE_MOVK_X 0xf2800000
+#define OPCODE_UBFM_W 0x53000000
+#define OPCODE_UBFM_X 0xd3400000
+#define OPCODE_SBFM_W 0x13000000
+#define OPCODE_BFM_W 0x33000000
+
+/*Data processing, register*/
+#define OPCODE_ADD_W 0x0b000000
+#define OPCODE_ADD_X 0x8b000000
+#define OPCODE_SUB_W 0x4b000000
+#define OPCODE_SUB_X 0xcb000000
+#define OPCODE_SUBS_W 0x6b000000
+#define OPCODE_AND_W 0x0a000000
+#define OPCODE_ORR_W 0x2a000000
+#define OPCODE_ORR_X 0xaa000000
+#define OPCODE_ORN_W 0x2a200000
+#define OPCODE_EOR_W 0x4a000000
+#define OPCODE_LSRV_W 0x1ac02400
+#define OPCODE_CLZ_W 0x5ac01000
+#define OPCODE_CSEL_W 0x1a800000
+#define OPCODE_MUL_W 0x1b007c00
+
+/*Branches*/
+#define OPCODE_B 0x14000000
+#define OPCODE_BCOND 0x54000000
+#define OPCODE_CBZ_W 0x34000000
+#define OPCODE_CBNZ_W 0x35000000
+#define OPCODE_BLR 0xd63f0000
+#define OPCODE_RET 0xd65f03c0
+
+/*NEON*/
+#define OPCODE_FMOV_S_W 0x1e270000
+#define OPCODE_FMOV_W_S 0x1e260000
+#define OPCODE_UXTL_8H 0x2f08a400
+#define OPCODE_SQXTUN_8B 0x2e212800
+#define OPCODE_SQXTUN_4H 0x2e612800
+#define OPCODE_UQXTN_8B 0x2e214800
+#define OPCODE_XTN_4H 0x0e612800
+#define OPCODE_SMULL_4S 0x0e60c000
+#define OPCODE_ADD_V4H 0x0e608400
+#define OPCODE_SUB_V4H 0x2e608400
+#define OPCODE_ADD_V4S 0x4ea08400
+#define OPCODE_SUB_V4S 0x6ea08400
+#define OPCODE_ADD_V2D 0x4ee08400
+#define OPCODE_SUB_V2D 0x6ee08400
+#define OPCODE_SSHR_4S 0x4f000400
+#define OPCODE_MOVI_8H_1 0x4f008420
+
+#define Rd(x) (x)
+#define Rt(x) (x)
+#define Rn(x) ((x) << 5)
+#define Rt2(x) ((x) << 10)
+#define Rm(x) ((x) << 16)
+
+static inline uint32_t arm64_ldst(uint32_t opcode, int rt, int rn, int offset, int size) {
+        if ((offset & (size - 1)) || offset < 0 || (offset / size) > 4095)
+                fatal("arm64_ldst: bad offset %i\n", offset);
+        return opcode | ((offset / size) << 10) | Rn(rn) | Rt(rt);
+}
+
+static inline uint32_t arm64_add_imm(uint32_t opcode, int rd, int rn, int imm) {
+        if (imm < 0 || imm > 4095)
+                fatal("arm64_add_imm: bad immediate %i\n", imm);
+        return opcode | (imm << 10) | Rn(rn) | Rd(rd);
+}
+
+static inline uint32_t arm64_alu(uint32_t opcode, int rd, int rn, int rm, int lsl) {
+        return opcode | Rm(rm) | (lsl << 10) | Rn(rn) | Rd(rd);
+}
+
+static inline uint32_t arm64_bfm(uint32_t opcode, int rd, int rn, int immr, int imms) {
+        return opcode | (immr << 16) | (imms << 10) | Rn(rn) | Rd(rd);
+}
+
+#define LSR_W(rd, rn, shift) arm64_bfm(OPCODE_UBFM_W, rd, rn, shift, 31)
+#define LSL_W(rd, rn, shift) arm64_bfm(OPCODE_UBFM_W, rd, rn, (32 - (shift)) & 31, 31 - (shift))
+#define ASR_W(rd, rn, shift) arm64_bfm(OPCODE_SBFM_W, rd, rn, shift, 31)
+#define UBFX_W(rd, rn, lsb, width) arm64_bfm(OPCODE_UBFM_W, rd, rn, lsb, (lsb) + (width)-1)
+#define UBFX_X(rd, rn, lsb, width) arm64_bfm(OPCODE_UBFM_X, rd, rn, lsb, (lsb) + (width)-1)
+#define SXTH_W(rd, rn) arm64_bfm(OPCODE_SBFM_W, rd, rn, 0, 15)
+#define BFI_W(rd, rn, lsb, width) arm64_bfm(OPCODE_BFM_W, rd, rn, (32 - (lsb)) & 31, (width)-1)
+#define MOV_W(rd, rm) arm64_alu(OPCODE_ORR_W, rd, REG_WZR, rm, 0)
+#define MOV_X(rd, rm) arm64_alu(OPCODE_ORR_X, rd, REG_WZR, rm, 0)
+#define CMP_W(rn, rm) arm64_alu(OPCODE_SUBS_W, REG_WZR, rn, rm, 0)
+#define CMP_IMM_W(rn, imm) arm64_add_imm(OPCODE_SUBS_IMM_W, REG_WZR, rn, imm)
+#define CSEL_W(rd, rn, rm, cond) (OPCODE_CSEL_W | Rm(rm) | ((cond) << 12) | Rn(rn) | Rd(rd))
+#define NEON_OP(opcode, rd, rn, rm) ((opcode) | Rm(rm) | Rn(rn) | Rd(rd))
+#define NEON_OP2(opcode, rd, rn) ((opcode) | Rn(rn) | Rd(rd))
+
+/*Emit a load of a 32-bit immediate into a W register*/
+static inline int codegen_mov_imm_w(uint8_t *code_block, int block_pos, int rd, uint32_t imm) {
+        addlong(OPCODE_MOVZ_W | ((imm & 0xffff) << 5) | Rd(rd));
+        if (imm >> 16)
+                addlong(OPCODE_MOVK_W | (1 << 21) | ((imm >> 16) << 5) | Rd(rd));
+        return block_pos;
+}
+
+/*Emit a load of a pointer into an X register*/
+static inline int codegen_mov_imm_x(uint8_t *code_block, int block_pos, int rd, uintptr_t imm) {
+        uint64_t val = (uint64_t)imm;
+        int c;
+
+        addlong(OPCODE_MOVZ_X | ((val & 0xffff) << 5) | Rd(rd));
+        for (c = 1; c < 4; c++) {
+                if ((val >> (c * 16)) & 0xffff)
+                        addlong(OPCODE_MOVK_X | (c << 21) | (((val >> (c * 16)) & 0xffff) << 5) | Rd(rd));
+        }
+        return block_pos;
+}
+
+/*Emit a 128-bit load/store at an arbitrary offset from a base register*/
+static inline int codegen_ldst_q(uint8_t *code_block, int block_pos, uint32_t opcode, int rt, int rn, int offset) {
+        if (offset & 15) {
+                addlong(arm64_add_imm(OPCODE_ADD_IMM_X, 17, rn, offset)); /*ADD X17, Xn, #offset*/
+                addlong(arm64_ldst(opcode, rt, 17, 0, 16));
+        } else
+                addlong(arm64_ldst(opcode, rt, rn, offset, 16));
+        return block_pos;
+}
+
+/*Emit an increment of a 32-bit counter in voodoo_t*/
+static inline int codegen_inc_counter(uint8_t *code_block, int block_pos, voodoo_t *voodoo, uint32_t *counter) {
+        intptr_t offset = (uintptr_t)counter - (uintptr_t)voodoo;
+
+        if (offset >= 0 && offset / 4 <= 4095) {
+                addlong(arm64_ldst(OPCODE_LDR_W, 10, REG_VOODOO, offset, 4)); /*LDR W10, [X21, #counter]*/
+                addlong(arm64_add_imm(OPCODE_ADD_IMM_W, 10, 10, 1));         /*ADD W10, W10, #1*/
+                addlong(arm64_ldst(OPCODE_STR_W, 10, REG_VOODOO, offset, 4)); /*STR W10, [X21, #counter]*/
+        } else {
+                block_pos = codegen_mov_imm_x(code_block, block_pos, 9, (uintptr_t)counter); /*MOV X9, counter*/
+                addlong(arm64_ldst(OPCODE_LDR_W, 10, 9, 0, 4)); /*LDR W10, [X9]*/
+                addlong(arm64_add_imm(OPCODE_ADD_IMM_W, 10, 10, 1)); /*ADD W10, W10, #1*/
+                addlong(arm64_ldst(OPCODE_STR_W, 10, 9, 0, 4)); /*STR W10, [X9]*/
+        }
+        return block_pos;
+}
+
+#define MAX_SKIP_FIXUPS 8
+
+/*Emit a compare-and-skip for a depth or alpha test. op is a DEPTHOP_* or AFUNC_*
+  value; both enumerations share the same encoding. Flags must already hold the
+  result of CMP value, reference. On failure the counter is incremented and the
+  pixel is skipped.*/
+static inline int codegen_test(uint8_t *code_block, int block_pos, voodoo_t *voodoo, int op, uint32_t *fail_counter,
+                               int *skip_fixups, int *nr_skip_fixups) {
+        static const int pass_cond[8] = {COND_AL, COND_LO, COND_EQ, COND_LS, COND_HI, COND_NE, COND_HS, COND_AL};
+        int pass_pos = -1;
+
+        if (op != DEPTHOP_NEVER) {
+                pass_pos = block_pos;
+                addlong(OPCODE_BCOND | pass_cond[op]); /*B.cond pass*/
+        }
+        block_pos = codegen_inc_counter(code_block, block_pos, voodoo, fail_counter);
+        if (*nr_skip_fixups == MAX_SKIP_FIXUPS)
+                fatal("codegen_test: too many skips\n");
+        skip_fixups[(*nr_skip_fixups)++] = block_pos;
+        addlong(OPCODE_B); /*B skip*/
+        if (pass_pos != -1)
+                *(uint32_t *)&code_block[pass_pos] |= (((block_pos - pass_pos) >> 2) & 0x7ffff) << 5;
+        return block_pos;
+}
+
+/*Called from generated code to sample the TMUs. Returns the texel as a packed ARGB word*/
+static uint32_t voodoo_arm64_texture_fetch(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int x) {
+        if ((params->textureMode[0] & TEXTUREMODE_LOCAL_MASK) == TEXTUREMODE_LOCAL || !voodoo->dual_tmus) {
+                /*TMU0 only sampling local colour or only one TMU, only sample TMU0*/
+                voodoo_tmu_fetch(voodoo, params, state, 0, x);
+        } else if ((params->textureMode[0] & TEXTUREMODE_MASK) == TEXTUREMODE_PASSTHROUGH) {
+                /*TMU0 in pass-through mode, only sample TMU1*/
+                voodoo_tmu_fetch(voodoo, params, state, 1, x);
+
+                state->tex_r[0] = state->tex_r[1];
+                state->tex_g[0] = state->tex_g[1];
+                state->tex_b[0] = state->tex_b[1];
+                state->tex_a[0] = state->tex_a[1];
+        } else {
+                voodoo_tmu_fetch_and_blend(voodoo, params, state, x);
+        }
+
+        return (state->tex_a[0] << 24) | (state->tex_r[0] << 16) | (state->tex_g[0] << 8) | state->tex_b[0];
+}
+
+/*Returns non-zero if voodoo_generate() can compile this pipeline state*/
+static inline int voodoo_codegen_supported(voodoo_t *voodoo, voodoo_params_t *params) {
+        if (params->fogMode & FOG_ENABLE)
+                return 0;
+        if (params->alphaMode & (1 << 4))
+                return 0;
+        if (params->col_tiled || params->aux_tiled)
+                return 0;
+        if (voodoo->trexInit1[0] & (1 << 18))
+                return 0;
+        if (cca_localselect > CCA_LOCALSELECT_ITER_Z || a_sel == A_SEL_LFB)
+                return 0;
+        if (cc_mselect > CC_MSELECT_TEXRGB || cca_mselect > CCA_MSELECT_TEX || cc_add == 3)
+                return 0;
+        return 1;
+}
+
+/*Emit a replicated byte (b * 0x01010101) into rd*/
+#define REPLICATE_W(rd, rn)                                                                                                      \
+        do {                                                                                                                     \
+                addlong(arm64_alu(OPCODE_ORR_W, rd, rn, rn, 8));  /*ORR Wd, Wn, Wn, LSL #8*/                                \
+                addlong(arm64_alu(OPCODE_ORR_W, rd, rd, rd, 16)); /*ORR Wd, Wd, Wd, LSL #16*/                               \
+        } while (0)
+
+static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state,
+                                   int depthop) {
+        int block_pos = 0;
+        int loop_jump_pos;
+        int skip_fixups[MAX_SKIP_FIXUPS];
+        int nr_skip_fixups = 0;
+        int depth_jump_pos = 0, depth_jump_pos2 = 0;
+        int texture_enabled = params->fbzColorPath & FBZCP_TEXTURE_ENABLED;
+        int uses_tex = (_rgb_sel == CC_LOCALSELECT_TEX) || (a_sel == A_SEL_TEX) || cc_localselect_override ||
+                       (cc_mselect == CC_MSELECT_TEX) || (cc_mselect == CC_MSELECT_TEXRGB) || (cca_mselect == CCA_MSELECT_TEX);
+        uint32_t mask;
+        int c;
+
+        addlong(OPCODE_STP_X_PRE | ((-64 / 8) & 0x7f) << 15 | Rt2(30) | Rn(REG_SP) | Rt(29)); /*STP X29, X30, [SP, #-64]!*/
+        addlong(arm64_add_imm(OPCODE_ADD_IMM_X, 29, REG_SP, 0));                           /*MOV X29, SP*/
+        addlong(OPCODE_STP_X | (2 << 15) | Rt2(20) | Rn(REG_SP) | Rt(19));                  /*STP X19, X20, [SP, #16]*/
+        addlong(OPCODE_STP_X | (4 << 15) | Rt2(22) | Rn(REG_SP) | Rt(21));                  /*STP X21, X22, [SP, #32]*/
+        addlong(OPCODE_STP_X | (6 << 15) | Rt2(24) | Rn(REG_SP) | Rt(23));                  /*STP X23, X24, [SP, #48]*/
+
+        addlong(MOV_X(REG_STATE, 0));  /*MOV X19, X0 (voodoo_state)*/
+        addlong(MOV_X(REG_PARAMS, 1)); /*MOV X20, X1 (voodoo_params)*/
+        addlong(MOV_W(REG_X, 2));      /*MOV W23, W2 (x)*/
+        addlong(MOV_W(REG_REAL_Y, 3)); /*MOV W22, W3 (real_y)*/
+        block_pos = codegen_mov_imm_x(code_block, block_pos, REG_VOODOO, (uintptr_t)voodoo); /*MOV X21, voodoo*/
+
+        loop_jump_pos = block_pos;
+
+        /*Depth*/
+        if (params->fbzMode & FBZ_W_BUFFER) {
+                addlong(arm64_ldst(OPCODE_LDR_X, 9, REG_STATE, offsetof(voodoo_state_t, w), 8)); /*LDR X9, state->w*/
+                addlong(UBFX_X(10, 9, 32, 16));                                                    /*UBFX X10, X9, #32, #16*/
+                addlong(OPCODE_MOVZ_W | Rd(REG_DEPTH));                                            /*MOV W24, #0*/
+                depth_jump_pos = block_pos;
+                addlong(OPCODE_CBNZ_W | Rt(10)); /*CBNZ W10, got_depth*/
+                addlong(LSR_W(10, 9, 16));       /*LSR W10, W9, #16*/
+                addlong(OPCODE_MOVZ_W | (0xf001 << 5) | Rd(REG_DEPTH)); /*MOV W24, #0xf001*/
+                depth_jump_pos2 = block_pos;
+                addlong(OPCODE_CBZ_W | Rt(10));                           /*CBZ W10, got_depth*/
+                addlong(OPCODE_CLZ_W | Rn(9) | Rd(10));                   /*CLZ W10, W9 - W10 = exp*/
+                addlong(OPCODE_MOVZ_W | (19 << 5) | Rd(11));              /*MOV W11, #19*/
+                addlong(arm64_alu(OPCODE_SUB_W, 11, 11, 10, 0));          /*SUB W11, W11, W10*/
+                addlong(arm64_alu(OPCODE_ORN_W, 12, REG_WZR, 9, 0));      /*MVN W12, W9*/
+                addlong(NEON_OP(OPCODE_LSRV_W, 12, 12, 11));              /*LSR W12, W12, W11*/
+                addlong(UBFX_W(12, 12, 0, 12));                           /*AND W12, W12, #0xfff - W12 = mant*/
+                addlong(LSL_W(10, 10, 12));                               /*LSL W10, W10, #12*/
+                addlong(arm64_alu(OPCODE_ADD_W, REG_DEPTH, 10, 12, 0));   /*ADD W24, W10, W12*/
+                addlong(arm64_add_imm(OPCODE_ADD_IMM_W, REG_DEPTH, REG_DEPTH, 1)); /*ADD W24, W24, #1*/
+                addlong(OPCODE_MOVZ_W | (0xffff << 5) | Rd(11));          /*MOV W11, #0xffff*/
+                addlong(CMP_W(REG_DEPTH, 11));                            /*CMP W24, W11*/
+                addlong(CSEL_W(REG_DEPTH, 11, REG_DEPTH, COND_HI));       /*CSEL W24, W11, W24, HI*/
+
+                *(uint32_t *)&code_block[depth_jump_pos] |= (((block_pos - depth_jump_pos) >> 2) & 0x7ffff) << 5;
+                *(uint32_t *)&code_block[depth_jump_pos2] |= (((block_pos - depth_jump_pos2) >> 2) & 0x7ffff) << 5;
+        } else {
+                addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_STATE, offsetof(voodoo_state_t, z), 4)); /*LDR W9, state->z*/
+                addlong(ASR_W(REG_DEPTH, 9, 12));                                                  /*ASR W24, W9, #12*/
+        }
+        if (!(params->fbzMode & FBZ_W_BUFFER) || (params->fbzMode & FBZ_DEPTH_BIAS)) {
+                if (params->fbzMode & FBZ_DEPTH_BIAS) {
+                        addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_PARAMS, offsetof(voodoo_params_t, zaColor), 4)); /*LDR W9, params->zaColor*/
+                        addlong(SXTH_W(9, 9));                                            /*SXTH W9, W9*/
+                        addlong(arm64_alu(OPCODE_ADD_W, REG_DEPTH, REG_DEPTH, 9, 0)); /*ADD W24, W24, W9*/
+                }
+                /*CLAMP16*/
+                addlong(CMP_IMM_W(REG_DEPTH, 0));                            /*CMP W24, #0*/
+                addlong(CSEL_W(REG_DEPTH, REG_WZR, REG_DEPTH, COND_LT));     /*CSEL W24, WZR, W24, LT*/
+                addlong(OPCODE_MOVZ_W | (0xffff << 5) | Rd(11));             /*MOV W11, #0xffff*/
+                addlong(CMP_W(REG_DEPTH, 11));                               /*CMP W24, W11*/
+                addlong(CSEL_W(REG_DEPTH, 11, REG_DEPTH, COND_GT));          /*CSEL W24, W11, W24, GT*/
+        }
+
+        if ((params->fbzMode & FBZ_DEPTH_ENABLE) && depthop != DEPTHOP_ALWAYS) {
+                if (depthop != DEPTHOP_NEVER) {
+                        addlong(arm64_ldst(OPCODE_LDR_X, 9, REG_STATE, offsetof(voodoo_state_t, aux_mem), 8)); /*LDR X9, state->aux_mem*/
+                        addlong(NEON_OP(OPCODE_LDRH_SXTW, 10, 9, REG_X)); /*LDRH W10, [X9, W23, SXTW #1]*/
+                        if (params->fbzMode & FBZ_DEPTH_SOURCE) {
+                                addlong(arm64_ldst(OPCODE_LDRH, 11, REG_PARAMS, offsetof(voodoo_params_t, zaColor), 2)); /*LDRH W11, params->zaColor*/
+                                addlong(CMP_W(11, 10)); /*CMP W11, W10*/
+                        } else
+                                addlong(CMP_W(REG_DEPTH, 10)); /*CMP W24, W10*/
+                }
+                block_pos = codegen_test(code_block, block_pos, voodoo, depthop, &voodoo->fbiZFuncFail, skip_fixups,
+                                         &nr_skip_fixups);
+        }
+
+        /*Texture - W13 = texel*/
+        if (texture_enabled) {
+                addlong(MOV_X(0, REG_VOODOO)); /*MOV X0, X21*/
+                addlong(MOV_X(1, REG_PARAMS)); /*MOV X1, X20*/
+                addlong(MOV_X(2, REG_STATE));  /*MOV X2, X19*/
+                addlong(MOV_W(3, REG_X));      /*MOV W3, W23*/
+                block_pos = codegen_mov_imm_x(code_block, block_pos, 16, (uintptr_t)voodoo_arm64_texture_fetch);
+                addlong(OPCODE_BLR | Rn(16)); /*BLR X16*/
+                addlong(MOV_W(13, 0));        /*MOV W13, W0*/
+
+                if (params->fbzMode & FBZ_CHROMAKEY) {
+                        addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_PARAMS, offsetof(voodoo_params_t, chromaKey), 4)); /*LDR W9, params->chromaKey*/
+                        addlong(UBFX_W(10, 13, 0, 24)); /*AND W10, W13, #0xffffff*/
+                        addlong(CMP_W(10, 9));          /*CMP W10, W9*/
+                        block_pos = codegen_test(code_block, block_pos, voodoo, DEPTHOP_NOTEQUAL, &voodoo->fbiChromaFail,
+                                                 skip_fixups, &nr_skip_fixups);
+                }
+        } else if (uses_tex) {
+                /*Texturing disabled, use whatever texel was last fetched*/
+                addlong(arm64_ldst(OPCODE_LDR_W, 13, REG_STATE, offsetof(voodoo_state_t, tex_b[0]), 4)); /*LDR W13, state->tex_b[0]*/
+                addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_STATE, offsetof(voodoo_state_t, tex_g[0]), 4)); /*LDR W9, state->tex_g[0]*/
+                addlong(BFI_W(13, 9, 8, 8)); /*BFI W13, W9, #8, #8*/
+                addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_STATE, offsetof(voodoo_state_t, tex_r[0]), 4)); /*LDR W9, state->tex_r[0]*/
+                addlong(BFI_W(13, 9, 16, 8)); /*BFI W13, W9, #16, #8*/
+                addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_STATE, offsetof(voodoo_state_t, tex_a[0]), 4)); /*LDR W9, state->tex_a[0]*/
+                addlong(BFI_W(13, 9, 24, 8)); /*BFI W13, W9, #24, #8*/
+        }
+
+        /*W14 = CLAMP(iterated BGRA >> 12)*/
+        block_pos = codegen_ldst_q(code_block, block_pos, OPCODE_LDR_Q, 0, REG_STATE, offsetof(voodoo_state_t, ib)); /*LDR Q0, state->ib*/
+        addlong(OPCODE_SSHR_4S | ((64 - 12) << 16) | Rn(0) | Rd(0)); /*SSHR V0.4S, V0.4S, #12*/
+        addlong(NEON_OP2(OPCODE_SQXTUN_4H, 0, 0));                  /*SQXTUN V0.4H, V0.4S*/
+        addlong(NEON_OP2(OPCODE_UQXTN_8B, 0, 0));                   /*UQXTN V0.8B, V0.8H*/
+        addlong(NEON_OP2(OPCODE_FMOV_W_S, 14, 0));                  /*FMOV W14, S0*/
+
+        /*W1 = color0, W2 = color1*/
+        addlong(arm64_ldst(OPCODE_LDR_W, 1, REG_PARAMS, offsetof(voodoo_params_t, color0), 4)); /*LDR W1, params->color0*/
+        addlong(arm64_ldst(OPCODE_LDR_W, 2, REG_PARAMS, offsetof(voodoo_params_t, color1), 4)); /*LDR W2, params->color1*/
+
+        /*W5 = alocal*/
+        switch (cca_localselect) {
+        case CCA_LOCALSELECT_ITER_A:
+                addlong(LSR_W(5, 14, 24)); /*LSR W5, W14, #24*/
+                break;
+        case CCA_LOCALSELECT_COLOR0:
+                addlong(LSR_W(5, 1, 24)); /*LSR W5, W1, #24*/
+                break;
+        case CCA_LOCALSELECT_ITER_Z:
+                addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_STATE, offsetof(voodoo_state_t, z), 4)); /*LDR W9, state->z*/
+                addlong(ASR_W(5, 9, 20));                            /*ASR W5, W9, #20*/
+                addlong(CMP_IMM_W(5, 0));                            /*CMP W5, #0*/
+                addlong(CSEL_W(5, REG_WZR, 5, COND_LT));             /*CSEL W5, WZR, W5, LT*/
+                addlong(OPCODE_MOVZ_W | (0xff << 5) | Rd(9));        /*MOV W9, #0xff*/
+                addlong(CMP_W(5, 9));                                /*CMP W5, W9*/
+                addlong(CSEL_W(5, 9, 5, COND_GT));                   /*CSEL W5, W9, W5, GT*/
+                break;
+        }
+
+        /*W6 = aother*/
+        switch (a_sel) {
+        case A_SEL_ITER_A:
+                addlong(LSR_W(6, 14, 24)); /*LSR W6, W14, #24*/
+                break;
+        case A_SEL_TEX:
+                addlong(LSR_W(6, 13, 24)); /*LSR W6, W13, #24*/
+                break;
+        case A_SEL_COLOR1:
+                addlong(LSR_W(6, 2, 24)); /*LSR W6, W2, #24*/
+                break;
+        }
+
+        /*W3 = clocal RGB, alocal*/
+        if (cc_localselect_override) {
+                addlong(CMP_IMM_W(13, 0));           /*CMP W13, #0 - tex_a & 0x80*/
+                addlong(CSEL_W(3, 1, 14, COND_LT)); /*CSEL W3, W1, W14, LT*/
+        } else if (cc_localselect)
+                addlong(MOV_W(3, 1)); /*MOV W3, W1*/
+        else
+                addlong(MOV_W(3, 14)); /*MOV W3, W14*/
+        addlong(BFI_W(3, 5, 24, 8)); /*BFI W3, W5, #24, #8*/
+
+        /*W4 = cother RGB, aother*/
+        switch (_rgb_sel) {
+        case CC_LOCALSELECT_ITER_RGB:
+                addlong(MOV_W(4, 14)); /*MOV W4, W14*/
+                break;
+        case CC_LOCALSELECT_TEX:
+                addlong(MOV_W(4, 13)); /*MOV W4, W13*/
+                break;
+        case CC_LOCALSELECT_COLOR1:
+                addlong(MOV_W(4, 2)); /*MOV W4, W2*/
+                break;
+        case CC_LOCALSELECT_LFB:
+                addlong(OPCODE_MOVZ_W | Rd(4)); /*MOV W4, #0*/
+                break;
+        }
+        addlong(BFI_W(4, 6, 24, 8)); /*BFI W4, W6, #24, #8*/
+
+        /*V0 = src = cother - clocal*/
+        mask = (cc_zero_other ? 0 : 0x00ffffff) | (cca_zero_other ? 0 : 0xff000000);
+        if (mask != 0xffffffff) {
+                block_pos = codegen_mov_imm_w(code_block, block_pos, 9, mask);
+                addlong(arm64_alu(OPCODE_AND_W, 4, 4, 9, 0)); /*AND W4, W4, W9*/
+        }
+        addlong(NEON_OP2(OPCODE_FMOV_S_W, 0, 4)); /*FMOV S0, W4*/
+        addlong(NEON_OP2(OPCODE_UXTL_8H, 0, 0));  /*UXTL V0.8H, V0.8B*/
+        mask = (cc_sub_clocal ? 0x00ffffff : 0) | (cca_sub_clocal ? 0xff000000 : 0);
+        if (mask) {
+                if (mask != 0xffffffff) {
+                        block_pos = codegen_mov_imm_w(code_block, block_pos, 9, mask);
+                        addlong(arm64_alu(OPCODE_AND_W, 8, 3, 9, 0)); /*AND W8, W3, W9*/
+                } else
+                        addlong(MOV_W(8, 3)); /*MOV W8, W3*/
+                addlong(NEON_OP2(OPCODE_FMOV_S_W, 1, 8));      /*FMOV S1, W8*/
+                addlong(NEON_OP2(OPCODE_UXTL_8H, 1, 1));       /*UXTL V1.8H, V1.8B*/
+                addlong(NEON_OP(OPCODE_SUB_V4H, 0, 0, 1));     /*SUB V0.4H, V0.4H, V1.4H*/
+        }
+
+        /*W10 = msel*/
+        switch (cc_mselect) {
+        case CC_MSELECT_ZERO:
+                addlong(OPCODE_MOVZ_W | Rd(10)); /*MOV W10, #0*/
+                break;
+        case CC_MSELECT_CLOCAL:
+                addlong(MOV_W(10, 3)); /*MOV W10, W3*/
+                break;
+        case CC_MSELECT_AOTHER:
+                REPLICATE_W(10, 6);
+                break;
+        case CC_MSELECT_ALOCAL:
+                REPLICATE_W(10, 5);
+                break;
+        case CC_MSELECT_TEX:
+                addlong(LSR_W(9, 13, 24)); /*LSR W9, W13, #24*/
+                REPLICATE_W(10, 9);
+                break;
+        case CC_MSELECT_TEXRGB:
+                addlong(MOV_W(10, 13)); /*MOV W10, W13*/
+                break;
+        }
+        switch (cca_mselect) {
+        case CCA_MSELECT_ZERO:
+                addlong(BFI_W(10, REG_WZR, 24, 8)); /*BFI W10, WZR, #24, #8*/
+                break;
+        case CCA_MSELECT_ALOCAL:
+        case CCA_MSELECT_ALOCAL2:
+                addlong(BFI_W(10, 5, 24, 8)); /*BFI W10, W5, #24, #8*/
+                break;
+        case CCA_MSELECT_AOTHER:
+                addlong(BFI_W(10, 6, 24, 8)); /*BFI W10, W6, #24, #8*/
+                break;
+        case CCA_MSELECT_TEX:
+                addlong(LSR_W(9, 13, 24));    /*LSR W9, W13, #24*/
+                addlong(BFI_W(10, 9, 24, 8)); /*BFI W10, W9, #24, #8*/
+                break;
+        }
+        mask = (cc_reverse_blend ? 0 : 0x00ffffff) | (cca_reverse_blend ? 0 : 0xff000000);
+        if (mask) {
+                block_pos = codegen_mov_imm_w(code_block, block_pos, 9, mask);
+                addlong(arm64_alu(OPCODE_EOR_W, 10, 10, 9, 0)); /*EOR W10, W10, W9*/
+        }
+
+        /*V0 = (src * (msel + 1)) >> 8*/
+        addlong(NEON_OP2(OPCODE_FMOV_S_W, 1, 10));                   /*FMOV S1, W10*/
+        addlong(NEON_OP2(OPCODE_UXTL_8H, 1, 1));                    /*UXTL V1.8H, V1.8B*/
+        addlong(OPCODE_MOVI_8H_1 | Rd(2));                          /*MOVI V2.8H, #1*/
+        addlong(NEON_OP(OPCODE_ADD_V4H, 1, 1, 2));                  /*ADD V1.4H, V1.4H, V2.4H*/
+        addlong(NEON_OP(OPCODE_SMULL_4S, 3, 0, 1));                 /*SMULL V3.4S, V0.4H, V1.4H*/
+        addlong(OPCODE_SSHR_4S | ((64 - 8) << 16) | Rn(3) | Rd(3)); /*SSHR V3.4S, V3.4S, #8*/
+        addlong(NEON_OP2(OPCODE_XTN_4H, 0, 3));                     /*XTN V0.4H, V3.4S*/
+
+        /*Add clocal/alocal*/
+        if (cc_add || cca_add) {
+                switch (cc_add) {
+                case 0:
+                        addlong(OPCODE_MOVZ_W | Rd(11)); /*MOV W11, #0*/
+                        break;
+                case CC_ADD_CLOCAL:
+                        addlong(MOV_W(11, 3)); /*MOV W11, W3*/
+                        break;
+                case CC_ADD_ALOCAL:
+                        REPLICATE_W(11, 5);
+                        break;
+                }
+                addlong(BFI_W(11, cca_add ? 5 : REG_WZR, 24, 8)); /*BFI W11, W5/WZR, #24, #8*/
+                addlong(NEON_OP2(OPCODE_FMOV_S_W, 1, 11));        /*FMOV S1, W11*/
+                addlong(NEON_OP2(OPCODE_UXTL_8H, 1, 1));          /*UXTL V1.8H, V1.8B*/
+                addlong(NEON_OP(OPCODE_ADD_V4H, 0, 0, 1));        /*ADD V0.4H, V0.4H, V1.4H*/
+        }
+
+        /*W0 = CLAMP(result)*/
+        addlong(NEON_OP2(OPCODE_SQXTUN_8B, 0, 0)); /*SQXTUN V0.8B, V0.8H*/
+        addlong(NEON_OP2(OPCODE_FMOV_W_S, 0, 0));  /*FMOV W0, S0*/
+
+        mask = (cc_invert_output ? 0x00ffffff : 0) | (cca_invert_output ? 0xff000000 : 0);
+        if (mask) {
+                block_pos = codegen_mov_imm_w(code_block, block_pos, 9, mask);
+                addlong(arm64_alu(OPCODE_EOR_W, 0, 0, 9, 0)); /*EOR W0, W0, W9*/
+        }
+
+        if ((params->alphaMode & 1) && alpha_func != AFUNC_ALWAYS) {
+                if (alpha_func != AFUNC_NEVER) {
+                        addlong(LSR_W(9, 0, 24));        /*LSR W9, W0, #24*/
+                        addlong(CMP_IMM_W(9, a_ref));    /*CMP W9, #a_ref*/
+                }
+                block_pos = codegen_test(code_block, block_pos, voodoo, alpha_func, &voodoo->fbiAFuncFail, skip_fixups,
+                                         &nr_skip_fixups);
+        }
+
+        /*W9 = R, W10 = G, W11 = B*/
+        addlong(UBFX_W(9, 0, 16, 8));  /*UBFX W9, W0, #16, #8*/
+        addlong(UBFX_W(10, 0, 8, 8));  /*UBFX W10, W0, #8, #8*/
+        addlong(UBFX_W(11, 0, 0, 8));  /*UBFX W11, W0, #0, #8*/
+
+        if (params->fbzMode & FBZ_DITHER) {
+                int shift = (params->fbzMode & FBZ_DITHER_2x2) ? 2 : 4;
+
+                if (params->fbzMode & FBZ_DITHER_2x2) {
+                        block_pos = codegen_mov_imm_x(code_block, block_pos, 12, (uintptr_t)dither_rb2x2);
+                        block_pos = codegen_mov_imm_x(code_block, block_pos, 15, (uintptr_t)dither_g2x2);
+                        addlong(UBFX_W(1, REG_REAL_Y, 0, 1)); /*AND W1, W22, #1*/
+                        addlong(UBFX_W(2, REG_X, 0, 1));      /*AND W2, W23, #1*/
+                        addlong(arm64_alu(OPCODE_ADD_W, 1, 2, 1, 1)); /*ADD W1, W2, W1, LSL #1*/
+                } else {
+                        block_pos = codegen_mov_imm_x(code_block, block_pos, 12, (uintptr_t)dither_rb);
+                        block_pos = codegen_mov_imm_x(code_block, block_pos, 15, (uintptr_t)dither_g);
+                        addlong(UBFX_W(1, REG_REAL_Y, 0, 2)); /*AND W1, W22, #3*/
+                        addlong(UBFX_W(2, REG_X, 0, 2));      /*AND W2, W23, #3*/
+                        addlong(arm64_alu(OPCODE_ADD_W, 1, 2, 1, 2)); /*ADD W1, W2, W1, LSL #2*/
+                }
+                addlong(arm64_alu(OPCODE_ADD_W, 9, 1, 9, shift));   /*ADD W9, W1, W9, LSL #shift*/
+                addlong(arm64_alu(OPCODE_ADD_W, 10, 1, 10, shift)); /*ADD W10, W1, W10, LSL #shift*/
+                addlong(arm64_alu(OPCODE_ADD_W, 11, 1, 11, shift)); /*ADD W11, W1, W11, LSL #shift*/
+                addlong(NEON_OP(OPCODE_LDRB_REG, 9, 12, 9));        /*LDRB W9, [X12, X9]*/
+                addlong(NEON_OP(OPCODE_LDRB_REG, 10, 15, 10));      /*LDRB W10, [X15, X10]*/
+                addlong(NEON_OP(OPCODE_LDRB_REG, 11, 12, 11));      /*LDRB W11, [X12, X11]*/
+        } else {
+                addlong(LSR_W(9, 9, 3));   /*LSR W9, W9, #3*/
+                addlong(LSR_W(10, 10, 2)); /*LSR W10, W10, #2*/
+                addlong(LSR_W(11, 11, 3)); /*LSR W11, W11, #3*/
+        }
+
+        if (params->fbzMode & FBZ_RGB_WMASK) {
+                addlong(arm64_alu(OPCODE_ORR_W, 11, 11, 10, 5));  /*ORR W11, W11, W10, LSL #5*/
+                addlong(arm64_alu(OPCODE_ORR_W, 11, 11, 9, 11));  /*ORR W11, W11, W9, LSL #11*/
+                addlong(arm64_ldst(OPCODE_LDR_X, 12, REG_STATE, offsetof(voodoo_state_t, fb_mem), 8)); /*LDR X12, state->fb_mem*/
+                addlong(NEON_OP(OPCODE_STRH_SXTW, 11, 12, REG_X)); /*STRH W11, [X12, W23, SXTW #1]*/
+        }
+        if ((params->fbzMode & (FBZ_DEPTH_WMASK | FBZ_DEPTH_ENABLE)) == (FBZ_DEPTH_WMASK | FBZ_DEPTH_ENABLE)) {
+                addlong(arm64_ldst(OPCODE_LDR_X, 12, REG_STATE, offsetof(voodoo_state_t, aux_mem), 8)); /*LDR X12, state->aux_mem*/
+                addlong(NEON_OP(OPCODE_STRH_SXTW, REG_DEPTH, 12, REG_X)); /*STRH W24, [X12, W23, SXTW #1]*/
+        }
+
+        block_pos = codegen_inc_counter(code_block, block_pos, voodoo, &voodoo->fbiPixelsOut);
+
+        /*skip:*/
+        for (c = 0; c < nr_skip_fixups; c++)
+                *(uint32_t *)&code_block[skip_fixups[c]] |= ((block_pos - skip_fixups[c]) >> 2) & 0x3ffffff;
+
+        /*Step iterators*/
+        block_pos = codegen_ldst_q(code_block, block_pos, OPCODE_LDR_Q, 0, REG_STATE, offsetof(voodoo_state_t, ib)); /*LDR Q0, state->ib*/
+        block_pos = codegen_ldst_q(code_block, block_pos, OPCODE_LDR_Q, 1, REG_PARAMS, offsetof(voodoo_params_t, dBdX)); /*LDR Q1, params->dBdX*/
+        addlong(NEON_OP((state->xdir > 0) ? OPCODE_ADD_V4S : OPCODE_SUB_V4S, 0, 0, 1)); /*ADD/SUB V0.4S, V0.4S, V1.4S*/
+        block_pos = codegen_ldst_q(code_block, block_pos, OPCODE_STR_Q, 0, REG_STATE, offsetof(voodoo_state_t, ib)); /*STR Q0, state->ib*/
+
+        addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_STATE, offsetof(voodoo_state_t, z), 4));     /*LDR W9, state->z*/
+        addlong(arm64_ldst(OPCODE_LDR_W, 10, REG_PARAMS, offsetof(voodoo_params_t, dZdX), 4)); /*LDR W10, params->dZdX*/
+        addlong(arm64_alu((state->xdir > 0) ? OPCODE_ADD_W : OPCODE_SUB_W, 9, 9, 10, 0));    /*ADD/SUB W9, W9, W10*/
+        addlong(arm64_ldst(OPCODE_STR_W, 9, REG_STATE, offsetof(voodoo_state_t, z), 4));     /*STR W9, state->z*/
+
+        for (c = 0; c < (voodoo->dual_tmus ? 2 : 1); c++) {
+                int s_offset = c ? offsetof(voodoo_state_t, tmu1_s) : offsetof(voodoo_state_t, tmu0_s);
+                int w_offset = c ? offsetof(voodoo_state_t, tmu1_w) : offsetof(voodoo_state_t, tmu0_w);
+
+                block_pos = codegen_ldst_q(code_block, block_pos, OPCODE_LDR_Q, 0, REG_STATE, s_offset); /*LDR Q0, state->tmu_s/t*/
+                block_pos = codegen_ldst_q(code_block, block_pos, OPCODE_LDR_Q, 1, REG_PARAMS,
+                                           offsetof(voodoo_params_t, tmu[c].dSdX)); /*LDR Q1, params->tmu[c].dSdX/dTdX*/
+                addlong(NEON_OP((state->xdir > 0) ? OPCODE_ADD_V2D : OPCODE_SUB_V2D, 0, 0, 1)); /*ADD/SUB V0.2D, V0.2D, V1.2D*/
+                block_pos = codegen_ldst_q(code_block, block_pos, OPCODE_STR_Q, 0, REG_STATE, s_offset); /*STR Q0, state->tmu_s/t*/
+
+                addlong(arm64_ldst(OPCODE_LDR_X, 9, REG_STATE, w_offset, 8)); /*LDR X9, state->tmu_w*/
+                addlong(arm64_ldst(OPCODE_LDR_X, 10, REG_PARAMS, offsetof(voodoo_params_t, tmu[c].dWdX), 8)); /*LDR X10, params->tmu[c].dWdX*/
+                addlong(arm64_alu((state->xdir > 0) ? OPCODE_ADD_X : OPCODE_SUB_X, 9, 9, 10, 0)); /*ADD/SUB X9, X9, X10*/
+                addlong(arm64_ldst(OPCODE_STR_X, 9, REG_STATE, w_offset, 8)); /*STR X9, state->tmu_w*/
+        }
+
+        addlong(arm64_ldst(OPCODE_LDR_X, 9, REG_STATE, offsetof(voodoo_state_t, w), 8));       /*LDR X9, state->w*/
+        addlong(arm64_ldst(OPCODE_LDR_X, 10, REG_PARAMS, offsetof(voodoo_params_t, dWdX), 8)); /*LDR X10, params->dWdX*/
+        addlong(arm64_alu((state->xdir > 0) ? OPCODE_ADD_X : OPCODE_SUB_X, 9, 9, 10, 0));      /*ADD/SUB X9, X9, X10*/
+        addlong(arm64_ldst(OPCODE_STR_X, 9, REG_STATE, offsetof(voodoo_state_t, w), 8));       /*STR X9, state->w*/
+
+        addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_STATE, offsetof(voodoo_state_t, pixel_count), 4)); /*LDR W9, state->pixel_count*/
+        addlong(arm64_add_imm(OPCODE_ADD_IMM_W, 9, 9, 1));                                         /*ADD W9, W9, #1*/
+        addlong(arm64_ldst(OPCODE_STR_W, 9, REG_STATE, offsetof(voodoo_state_t, pixel_count), 4)); /*STR W9, state->pixel_count*/
+
+        if (texture_enabled) {
+                int texels = ((params->textureMode[0] & TEXTUREMODE_MASK) == TEXTUREMODE_PASSTHROUGH ||
+                              (params->textureMode[0] & TEXTUREMODE_LOCAL_MASK) == TEXTUREMODE_LOCAL)
+                                     ? 1
+                                     : 2;
+
+                addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_STATE, offsetof(voodoo_state_t, texel_count), 4)); /*LDR W9, state->texel_count*/
+                addlong(arm64_add_imm(OPCODE_ADD_IMM_W, 9, 9, texels)); /*ADD W9, W9, #texels*/
+                addlong(arm64_ldst(OPCODE_STR_W, 9, REG_STATE, offsetof(voodoo_state_t, texel_count), 4)); /*STR W9, state->texel_count*/
+        }
+
+        addlong(arm64_ldst(OPCODE_LDR_W, 9, REG_STATE, offsetof(voodoo_state_t, x2), 4)); /*LDR W9, state->x2*/
+        addlong(MOV_W(10, REG_X)); /*MOV W10, W23*/
+        if (state->xdir > 0)
+                addlong(arm64_add_imm(OPCODE_ADD_IMM_W, REG_X, REG_X, 1)); /*ADD W23, W23, #1*/
+        else
+                addlong(arm64_add_imm(OPCODE_SUB_IMM_W, REG_X, REG_X, 1)); /*SUB W23, W23, #1*/
+        addlong(arm64_ldst(OPCODE_STR_W, REG_X, REG_STATE, offsetof(voodoo_state_t, x), 4)); /*STR W23, state->x*/
+        addlong(CMP_W(10, 9)); /*CMP W10, W9*/
+        addlong(OPCODE_BCOND | ((((loop_jump_pos - block_pos) >> 2) & 0x7ffff) << 5) | COND_NE); /*B.NE loop_jump_pos*/
+
+        addlong(OPCODE_LDP_X | (6 << 15) | Rt2(24) | Rn(REG_SP) | Rt(23));                   /*LDP X23, X24, [SP, #48]*/
+        addlong(OPCODE_LDP_X | (4 << 15) | Rt2(22) | Rn(REG_SP) | Rt(21));                   /*LDP X21, X22, [SP, #32]*/
+        addlong(OPCODE_LDP_X | (2 << 15) | Rt2(20) | Rn(REG_SP) | Rt(19));                   /*LDP X19, X20, [SP, #16]*/
+        addlong(OPCODE_LDP_X_POST | ((64 / 8) << 15) | Rt2(30) | Rn(REG_SP) | Rt(29));       /*LDP X29, X30, [SP], #64*/
+        addlong(OPCODE_RET); /*RET*/
+}
+int voodoo_recomp = 0;
+int voodoo_recomp_hits = 0;
+
+static inline int voodoo_block_matches(voodoo_arm64_data_t *data, voodoo_t *voodoo, voodoo_params_t *params,
+                                       voodoo_state_t *state) {
+        return data->valid && state->xdir == data->xdir && params->alphaMode == data->alphaMode &&
+               params->fbzMode == data->fbzMode && params->fogMode == data->fogMode &&
+               params->fbzColorPath == data->fbzColorPath && (voodoo->trexInit1[0] & (1 << 18)) == data->trexInit1 &&
+               params->textureMode[0] == data->textureMode[0] && params->textureMode[1] == data->textureMode[1] &&
+               (params->tLOD[0] & LOD_MASK) == data->tLOD[0] && (params->tLOD[1] & LOD_MASK) == data->tLOD[1] &&
+               ((params->col_tiled || params->aux_tiled) ? 1 : 0) == data->is_tiled;
+}
+
+static inline int voodoo_block_hash(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state) {
+        uint32_t hash = params->fbzMode;
+
+        hash = (hash * 0x9e3779b1) ^ params->alphaMode;
+        hash = (hash * 0x9e3779b1) ^ params->fbzColorPath;
+        hash = (hash * 0x9e3779b1) ^ params->fogMode;
+        hash = (hash * 0x9e3779b1) ^ params->textureMode[0];
+        hash = (hash * 0x9e3779b1) ^ params->textureMode[1];
+        hash = (hash * 0x9e3779b1) ^ ((params->tLOD[0] & LOD_MASK) | ((params->tLOD[1] & LOD_MASK) >> 1));
+        hash = (hash * 0x9e3779b1) ^ (state->xdir & 3) ^ ((params->col_tiled || params->aux_tiled) ? 4 : 0) ^
+               ((voodoo->trexInit1[0] >> 15) & 8);
+        hash ^= hash >> 16;
+
+        return hash & (BLOCK_SETS - 1);
+}
+
+static inline void *voodoo_block_code(voodoo_arm64_data_t *data) { return data->native ? data->code_block : NULL; }
+
+/*Mark a block as just used. Called both with and without the cache lock held, so the stamp and the hit
+  counter are updated atomically*/
+static inline void voodoo_block_touch(voodoo_codegen_cache_t *cache, voodoo_arm64_data_t *data) {
+        __atomic_store_n(&data->last_used, __atomic_fetch_add(&cache->use_stamp, 1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even) {
+        voodoo_codegen_cache_t *cache = voodoo->codegen_data;
+        voodoo_arm64_data_t *data;
+        voodoo_arm64_data_t *set;
+        int victim = -1;
+        int c;
+
+        /*Fast path - same pipeline as this thread's previous half-triangle. The block
+          is pinned by this thread, so it can be checked without taking the lock*/
+        if (cache->in_use[odd_even] != -1) {
+                data = &cache->blocks[cache->in_use[odd_even]];
+
+                if (voodoo_block_matches(data, voodoo, params, state)) {
+                        voodoo_block_touch(cache, data);
+                        __atomic_fetch_add(&voodoo_recomp_hits, 1, __ATOMIC_RELAXED);
+                        return voodoo_block_code(data);
+                }
+        }
+
+        thread_lock_mutex(cache->lock);
+
+        set = &cache->blocks[voodoo_block_hash(voodoo, params, state) * BLOCK_WAYS];
+        for (c = 0; c < BLOCK_WAYS; c++) {
+                data = &set[c];
+
+                if (voodoo_block_matches(data, voodoo, params, state)) {
+                        voodoo_block_touch(cache, data);
+                        cache->in_use[odd_even] = data - cache->blocks;
+                        thread_unlock_mutex(cache->lock);
+                        __atomic_fetch_add(&voodoo_recomp_hits, 1, __ATOMIC_RELAXED);
+                        return voodoo_block_code(data);
+                }
+        }
+
+        /*Miss - replace the least recently used block in this set that no other
+          render thread is executing*/
+        for (c = 0; c < BLOCK_WAYS; c++) {
+                int index = (set - cache->blocks) + c;
+                int d;
+
+                for (d = 0; d < VOODOO_MAX_RENDER_THREADS; d++) {
+                        if (d != odd_even && cache->in_use[d] == index)
+                                break;
+                }
+                if (d != VOODOO_MAX_RENDER_THREADS)
+                        continue;
+
+                if (!set[c].valid) {
+                        victim = c;
+                        break;
+                }
+                if (victim == -1 || (int32_t)(__atomic_load_n(&set[c].last_used, __ATOMIC_RELAXED) -
+                                              __atomic_load_n(&set[victim].last_used, __ATOMIC_RELAXED)) < 0)
+                        victim = c;
+        }
+        if (victim == -1)
+                fatal("voodoo_get_block: no free block\n");
+
+        voodoo_recomp++;
+        data = &set[victim];
+        data->valid = 0;
+        cache->in_use[odd_even] = data - cache->blocks;
+
+        /*Unsupported states are cached too, so the C fallback is chosen without
+          retrying the compile on every half-triangle*/
+        data->native = voodoo_codegen_supported(voodoo, params);
+        if (data->native) {
+#if defined(__APPLE__)
+                pthread_jit_write_protect_np(0);
+#endif
+                voodoo_generate(data->code_block, voodoo, params, state, depth_op);
+#if defined(__APPLE__)
+                pthread_jit_write_protect_np(1);
+#endif
+#if defined(_WIN32)
+                FlushInstructionCache(GetCurrentProcess(), data->code_block, BLOCK_SIZE);
+#else
+                __builtin___clear_cache((char *)data->code_block, (char *)data->code_block + BLOCK_SIZE);
+#endif
+        }
+
+        data->xdir = state->xdir;
+        data->alphaMode = params->alphaMode;
+        data->fbzMode = params->fbzMode;
+        data->fogMode = params->fogMode;
+        data->fbzColorPath = params->fbzColorPath;
+        data->trexInit1 = voodoo->trexInit1[0] & (1 << 18);
+        data->textureMode[0] = params->textureMode[0];
+        data->textureMode[1] = params->textureMode[1];
+        data->tLOD[0] = params->tLOD[0] & LOD_MASK;
+        data->tLOD[1] = params->tLOD[1] & LOD_MASK;
+        data->is_tiled = (params->col_tiled || params->aux_tiled) ? 1 : 0;
+        voodoo_block_touch(cache, data);
+        data->valid = 1;
+
+        thread_unlock_mutex(cache->lock);
+
+        return voodoo_block_code(data);
+}
+
+void voodoo_codegen_init(voodoo_t *voodoo) {
+        voodoo_codegen_cache_t *cache;
+        int c;
+
+        cache = malloc(sizeof(voodoo_codegen_cache_t));
+        memset(cache, 0, sizeof(voodoo_codegen_cache_t));
+#if defined(_WIN32)
+        cache->code = VirtualAlloc(NULL, BLOCK_NUM * BLOCK_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+#elif defined(__APPLE__)
+        cache->code = mmap(0, BLOCK_NUM * BLOCK_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANON | MAP_PRIVATE | MAP_JIT, -1, 0);
+#else
+        cache->code = mmap(0, BLOCK_NUM * BLOCK_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANON | MAP_PRIVATE, -1, 0);
+#endif
+        for (c = 0; c < BLOCK_NUM; c++) {
+                cache->blocks[c].code_block = &cache->code[c * BLOCK_SIZE];
+                cache->blocks[c].valid = 0;
+        }
+        for (c = 0; c < VOODOO_MAX_RENDER_THREADS; c++)
+                cache->in_use[c] = -1;
+        cache->use_stamp = 0;
+        cache->lock = thread_create_mutex();
+        voodoo->codegen_data = cache;
+}
+
+void voodoo_codegen_close(voodoo_t *voodoo) {
+        voodoo_codegen_cache_t *cache = voodoo->codegen_data;
+
+        thread_destroy_mutex(cache->lock);
+#if defined(_WIN32)
+        VirtualFree(cache->code, 0, MEM_RELEASE);
+#else
+        munmap(cache->code, BLOCK_NUM * BLOCK_SIZE);
+#endif
+        free(cache);
+}
+
+#endif /* _VID_VOODOO_CODEGEN_ARM64_H_ */
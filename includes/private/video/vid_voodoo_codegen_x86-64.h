@@ -20,14 +20,21 @@
 
 #include <xmmintrin.h>
 
-#define BLOCK_NUM 8
-#define BLOCK_MASK (BLOCK_NUM - 1)
+/*Compiled pipelines are held in a set-associative cache shared by all render
+  threads of a card. Blocks are looked up by hashing the full pipeline state, and
+  replaced least-recently-used within a set. A block that a render thread is
+  currently executing is pinned in in_use[] and is never chosen for replacement.*/
+#define BLOCK_NUM 128
+#define BLOCK_WAYS 8
+#define BLOCK_SETS (BLOCK_NUM / BLOCK_WAYS)
 #define BLOCK_SIZE 8192
 
 #define LOD_MASK (LOD_TMIRROR_S | LOD_TMIRROR_T)
 
 typedef struct voodoo_x86_data_t {
         uint8_t code_block[BLOCK_SIZE];
+        int valid;
+        uint32_t last_used;
         int xdir;
         uint32_t alphaMode;
         uint32_t fbzMode;
@@ -39,10 +46,15 @@ typedef struct voodoo_x86_data_t {
         int is_tiled;
 } voodoo_x86_data_t;
 
-// static voodoo_x86_data_t voodoo_x86_data[2][BLOCK_NUM];
+typedef struct voodoo_codegen_cache_t {
+        voodoo_x86_data_t blocks[BLOCK_NUM];
 
-static int last_block[4] = {0, 0};
-static int next_block_to_write[4] = {0, 0};
+        mutex_t *lock;
+        /*Bumped with an atomic add, as render threads hit pinned blocks without holding lock*/
+        uint32_t use_stamp;
+        /*Block currently executed by each render thread, or -1*/
+        volatile int in_use[VOODOO_MAX_RENDER_THREADS];
+} voodoo_codegen_cache_t;
 
 #define addbyte(val)                                                                                                             \
         do {                                                                                                                     \
@@ -80,7 +92,6 @@ static __m128i xmm_ff_w; // = 0x00ff00ff00ff00ffull;
 static __m128i xmm_ff_b; // = 0x00000000ffffffffull;
 
 static __m128i alookup[257], aminuslookup[256];
-static __m128i minus_254; // = 0xff02ff02ff02ff02ull;
 static __m128i bilinear_lookup[256 * 2];
 static __m128i xmm_00_ff_w[2];
 static uint32_t i_00_ff_w[2] = {0, 0xff};
@@ -92,9 +103,9 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                 addbyte(0x8b);
                 addbyte(0x9f);
                 addlong(tmu ? offsetof(voodoo_state_t, tmu1_s) : offsetof(voodoo_state_t, tmu0_s));
-                addbyte(0x48); /*MOV RAX, (1 << 48)*/
-                addbyte(0xb8);
-                addquad(1ULL << 48);
+                /*The C code does an unsigned divide, so a W of zero or below gives zero*/
+                addbyte(0x31); /*XOR EAX, EAX*/
+                addbyte(0xc0);
                 addbyte(0x48); /*XOR RDX, RDX*/
                 addbyte(0x31);
                 addbyte(0xd2);
@@ -107,12 +118,23 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                 addbyte(0xbf);
                 addlong(tmu ? offsetof(voodoo_state_t, tmu1_w) : offsetof(voodoo_state_t, tmu0_w));
                 addbyte(0);
-                addbyte(0x74); /*JZ +*/
-                addbyte(7);
+                addbyte(0x7e); /*JLE +*/
+                addbyte(10 + 7);
+                addbyte(0x48); /*MOV RAX, (1 << 48)*/
+                addbyte(0xb8);
+                addquad(1ULL << 48);
                 addbyte(0x48); /*IDIV state->tmu_w*/
                 addbyte(0xf7);
                 addbyte(0xbf);
                 addlong(tmu ? offsetof(voodoo_state_t, tmu1_w) : offsetof(voodoo_state_t, tmu0_w));
+                addbyte(0x48); /*ADD RBX, 1 << 13*/
+                addbyte(0x81);
+                addbyte(0xc3);
+                addlong(1 << 13);
+                addbyte(0x48); /*ADD RCX, 1 << 13*/
+                addbyte(0x81);
+                addbyte(0xc1);
+                addlong(1 << 13);
                 addbyte(0x48); /*SAR RBX, 14*/
                 addbyte(0xc1);
                 addbyte(0xfb);
@@ -129,6 +151,14 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                 addbyte(0x0f);
                 addbyte(0xaf);
                 addbyte(0xc8);
+                addbyte(0x48); /*ADD RBX, 1 << 29*/
+                addbyte(0x81);
+                addbyte(0xc3);
+                addlong(1 << 29);
+                addbyte(0x48); /*ADD RCX, 1 << 29*/
+                addbyte(0x81);
+                addbyte(0xc1);
+                addlong(1 << 29);
                 addbyte(0x48); /*SAR RBX, 30*/
                 addbyte(0xc1);
                 addbyte(0xfb);
@@ -137,10 +167,18 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                 addbyte(0xc1);
                 addbyte(0xf9);
                 addbyte(30);
-                addbyte(0x48); /*BSR EDX, RAX*/
+                /*fastlog(0) is 0x80000000, which 0x800000 gives once 19 is taken off and it is shifted up*/
+                addbyte(0x41); /*MOV R8D, 0x800000*/
+                addbyte(0xb8);
+                addlong(0x800000);
+                addbyte(0x48); /*BSR RDX, RAX*/
                 addbyte(0x0f);
                 addbyte(0xbd);
                 addbyte(0xd0);
+                addbyte(0x41); /*CMOVZ EDX, R8D*/
+                addbyte(0x0f);
+                addbyte(0x44);
+                addbyte(0xd0);
                 addbyte(0x48); /*SHL RAX, 8*/
                 addbyte(0xc1);
                 addbyte(0xe0);
@@ -174,26 +212,6 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                 addbyte(0x03); /*ADD EAX, state->lod*/
                 addbyte(0x87);
                 addlong(offsetof(voodoo_state_t, tmu[tmu].lod));
-                addbyte(0x3b); /*CMP EAX, state->lod_min*/
-                addbyte(0x87);
-                addlong(offsetof(voodoo_state_t, lod_min[tmu]));
-                addbyte(0x0f); /*CMOVL EAX, state->lod_min*/
-                addbyte(0x4c);
-                addbyte(0x87);
-                addlong(offsetof(voodoo_state_t, lod_min[tmu]));
-                addbyte(0x3b); /*CMP EAX, state->lod_max*/
-                addbyte(0x87);
-                addlong(offsetof(voodoo_state_t, lod_max[tmu]));
-                addbyte(0x0f); /*CMOVNL EAX, state->lod_max*/
-                addbyte(0x4d);
-                addbyte(0x87);
-                addlong(offsetof(voodoo_state_t, lod_max[tmu]));
-                addbyte(0xc1); /*SHR EAX, 8*/
-                addbyte(0xe8);
-                addbyte(8);
-                addbyte(0x89); /*MOV state->lod, EAX*/
-                addbyte(0x87);
-                addlong(offsetof(voodoo_state_t, lod));
         } else {
                 addbyte(0x48); /*MOV RAX, state->tmu0_s*/
                 addbyte(0x8b);
@@ -207,29 +225,51 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                 addbyte(0xc1);
                 addbyte(0xe8);
                 addbyte(28);
-                addbyte(0x8b); /*MOV EBX, state->lod_min*/
-                addbyte(0x9f);
-                addlong(offsetof(voodoo_state_t, lod_min[tmu]));
                 addbyte(0x48); /*SHR RCX, 28*/
                 addbyte(0xc1);
                 addbyte(0xe9);
                 addbyte(28);
-                addbyte(0x48); /*MOV state->tex_s, RAX*/
-                addbyte(0x89);
+                addbyte(0x89); /*MOV state->tex_s, EAX*/
                 addbyte(0x87);
                 addlong(offsetof(voodoo_state_t, tex_s));
-                addbyte(0xc1); /*SHR EBX, 8*/
-                addbyte(0xeb);
-                addbyte(8);
-                addbyte(0x48); /*MOV state->tex_t, RCX*/
-                addbyte(0x89);
+                addbyte(0x89); /*MOV state->tex_t, ECX*/
                 addbyte(0x8f);
                 addlong(offsetof(voodoo_state_t, tex_t));
-                addbyte(0x89); /*MOV state->lod, EBX*/
-                addbyte(0x9f);
-                addlong(offsetof(voodoo_state_t, lod));
+                addbyte(0x8b); /*MOV EAX, state->tmu[tmu].lod*/
+                addbyte(0x87);
+                addlong(offsetof(voodoo_state_t, tmu[tmu].lod));
         }
 
+        /*Clamp as the C code does, with lod_min taking priority if it is above lod_max*/
+        addbyte(0x89); /*MOV EDX, EAX*/
+        addbyte(0xc2);
+        addbyte(0x3b); /*CMP EAX, state->lod_max*/
+        addbyte(0x87);
+        addlong(offsetof(voodoo_state_t, lod_max[tmu]));
+        addbyte(0x0f); /*CMOVG EAX, state->lod_max*/
+        addbyte(0x4f);
+        addbyte(0x87);
+        addlong(offsetof(voodoo_state_t, lod_max[tmu]));
+        addbyte(0x3b); /*CMP EDX, state->lod_min*/
+        addbyte(0x97);
+        addlong(offsetof(voodoo_state_t, lod_min[tmu]));
+        addbyte(0x0f); /*CMOVL EAX, state->lod_min*/
+        addbyte(0x4c);
+        addbyte(0x87);
+        addlong(offsetof(voodoo_state_t, lod_min[tmu]));
+        addbyte(0x0f); /*MOVZX EDX, AL*/
+        addbyte(0xb6);
+        addbyte(0xd0);
+        addbyte(0xc1); /*SHR EAX, 8*/
+        addbyte(0xe8);
+        addbyte(8);
+        addbyte(0x89); /*MOV state->lod_frac[tmu], EDX*/
+        addbyte(0x97);
+        addlong(offsetof(voodoo_state_t, lod_frac[tmu]));
+        addbyte(0x89); /*MOV state->lod, EAX*/
+        addbyte(0x87);
+        addlong(offsetof(voodoo_state_t, lod));
+
         if (params->fbzColorPath & FBZCP_TEXTURE_ENABLED) {
                 if (voodoo->bilinear_enabled && (params->textureMode[tmu] & 6)) {
                         addbyte(0xb2); /*MOV DL, 8*/
@@ -237,6 +277,10 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                         addbyte(0x8b); /*MOV ECX, state->lod[RDI]*/
                         addbyte(0x8f);
                         addlong(offsetof(voodoo_state_t, lod));
+                        addbyte(0x8b); /*MOV ECX, params->tex_lod[RSI+RCX*4]*/
+                        addbyte(0x8c);
+                        addbyte(0x8e);
+                        addlong(offsetof(voodoo_params_t, tex_lod[tmu]));
                         addbyte(0xbd); /*MOV EBP, 1*/
                         addlong(1);
                         addbyte(0x28); /*SUB DL, CL*/
@@ -559,6 +603,10 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                         addbyte(0xac);
                         addbyte(0xcf);
                         addlong(offsetof(voodoo_state_t, tex[tmu]));
+                        addbyte(0x8b); /*MOV ECX, params->tex_lod[RSI+RCX*4]*/
+                        addbyte(0x8c);
+                        addbyte(0x8e);
+                        addlong(offsetof(voodoo_params_t, tex_lod[tmu]));
                         addbyte(0x28); /*SUB DL, CL*/
                         addbyte(0xca);
                         addbyte(0x80); /*ADD CL, 4*/
@@ -587,10 +635,13 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                                 addbyte(0xf7); /*NOT EBX*/
                                 addbyte(0xd3);
                         }
-                        addbyte(0xd3); /*SHR EAX, CL*/
-                        addbyte(0xe8);
-                        addbyte(0xd3); /*SHR EBX, CL*/
-                        addbyte(0xeb);
+                        addbyte(0xd3); /*SAR EAX, CL*/
+                        addbyte(0xf8);
+                        addbyte(0xd3); /*SAR EBX, CL*/
+                        addbyte(0xfb);
+                        addbyte(0x8b); /*MOV ECX, state->lod[RDI]*/
+                        addbyte(0x8f);
+                        addlong(offsetof(voodoo_state_t, lod));
                         if (state->clamp_s[tmu]) {
                                 addbyte(0x85); /*TEST EAX, EAX*/
                                 addbyte(0xc0);
@@ -601,18 +652,18 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                                 addbyte(0x3b); /*CMP EAX, params->tex_w_mask[ESI+ECX*4]*/
                                 addbyte(0x84);
                                 addbyte(0x8e);
-                                addlong(offsetof(voodoo_params_t, tex_w_mask[tmu]) - 0x10);
+                                addlong(offsetof(voodoo_params_t, tex_w_mask[tmu]));
                                 addbyte(0x0f); /*CMOVAE EAX, params->tex_w_mask[ESI+ECX*4]*/
                                 addbyte(0x43);
                                 addbyte(0x84);
                                 addbyte(0x8e);
-                                addlong(offsetof(voodoo_params_t, tex_w_mask[tmu]) - 0x10);
+                                addlong(offsetof(voodoo_params_t, tex_w_mask[tmu]));
 
                         } else {
-                                addbyte(0x23); /*AND EAX, params->tex_w_mask-0x10[ESI+ECX*4]*/
+                                addbyte(0x23); /*AND EAX, params->tex_w_mask[ESI+ECX*4]*/
                                 addbyte(0x84);
                                 addbyte(0x8e);
-                                addlong(offsetof(voodoo_params_t, tex_w_mask[tmu]) - 0x10);
+                                addlong(offsetof(voodoo_params_t, tex_w_mask[tmu]));
                         }
                         if (state->clamp_t[tmu]) {
                                 addbyte(0x85); /*TEST EBX, EBX*/
@@ -624,17 +675,17 @@ static inline int codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, v
                                 addbyte(0x3b); /*CMP EBX, params->tex_h_mask[ESI+ECX*4]*/
                                 addbyte(0x9c);
                                 addbyte(0x8e);
-                                addlong(offsetof(voodoo_params_t, tex_h_mask[tmu]) - 0x10);
+                                addlong(offsetof(voodoo_params_t, tex_h_mask[tmu]));
                                 addbyte(0x0f); /*CMOVAE EBX, params->tex_h_mask[ESI+ECX*4]*/
                                 addbyte(0x43);
                                 addbyte(0x9c);
                                 addbyte(0x8e);
-                                addlong(offsetof(voodoo_params_t, tex_h_mask[tmu]) - 0x10);
+                                addlong(offsetof(voodoo_params_t, tex_h_mask[tmu]));
                         } else {
-                                addbyte(0x23); /*AND EBX, params->tex_h_mask-0x10[ESI+ECX*4]*/
+                                addbyte(0x23); /*AND EBX, params->tex_h_mask[ESI+ECX*4]*/
                                 addbyte(0x9c);
                                 addbyte(0x8e);
-                                addlong(offsetof(voodoo_params_t, tex_h_mask[tmu]) - 0x10);
+                                addlong(offsetof(voodoo_params_t, tex_h_mask[tmu]));
                         }
                         addbyte(0x88); /*MOV CL, DL*/
                         addbyte(0xd1);
@@ -662,13 +713,15 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
         int depth_jump_pos = 0;
         int depth_jump_pos2 = 0;
         int loop_jump_pos = 0;
+        /*The colour path can use a_local and a_other even when alpha test and blend are off*/
+        int alpha_used = (params->alphaMode & ((1 << 0) | (1 << 4))) || cc_mselect == CC_MSELECT_AOTHER ||
+                         cc_mselect == CC_MSELECT_ALOCAL || cc_add == CC_ADD_ALOCAL;
         //        xmm_01_w = (__m128i)0x0001000100010001ull;
         //        xmm_ff_w = (__m128i)0x00ff00ff00ff00ffull;
         //        xmm_ff_b = (__m128i)0x00000000ffffffffull;
         xmm_01_w = _mm_set_epi32(0, 0, 0x00010001, 0x00010001);
         xmm_ff_w = _mm_set_epi32(0, 0, 0x00ff00ff, 0x00ff00ff);
         xmm_ff_b = _mm_set_epi32(0, 0, 0, 0x00ffffff);
-        minus_254 = _mm_set_epi32(0, 0, 0xff02ff02, 0xff02ff02);
         //        *(uint64_t *)&const_1_48 = 0x45b0000000000000ull;
         //        block_pos = 0;
         //        voodoo_get_depth = &code_block[block_pos];
@@ -717,14 +770,6 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
         addbyte(0x0f);
         addbyte(0x6f);
         addbyte(0x07 | (2 << 3));
-        addbyte(0x49); /*MOV R15, minus_254*/
-        addbyte(0xbf);
-        addquad((uint64_t)(uintptr_t)&minus_254);
-        addbyte(0x66); /*MOVDQA XMM11, [R15]*/
-        addbyte(0x45);
-        addbyte(0x0f);
-        addbyte(0x6f);
-        addbyte(0x07 | (3 << 3));
 
 #if WIN64
         addbyte(0x48); /*MOV RDI, RCX (voodoo_state)*/
@@ -885,11 +930,24 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
         }
 
         if (params->fbzMode & FBZ_DEPTH_BIAS) {
-                addbyte(0x03); /*ADD EAX, params->zaColor[ESI]*/
-                addbyte(0x86);
+                addbyte(0x0f); /*MOVSX EBX, params->zaColor[ESI]*/
+                addbyte(0xbf);
+                addbyte(0x9e);
                 addlong(offsetof(voodoo_params_t, zaColor));
-                addbyte(0x25); /*AND EAX, 0xffff*/
+                addbyte(0x31); /*XOR ECX, ECX*/
+                addbyte(0xc9);
+                addbyte(0x01); /*ADD EAX, EBX*/
+                addbyte(0xd8);
+                addbyte(0xbb); /*MOV EBX, 0xffff*/
                 addlong(0xffff);
+                addbyte(0x0f); /*CMOVS EAX, ECX*/
+                addbyte(0x48);
+                addbyte(0xc1);
+                addbyte(0x39); /*CMP EAX, EBX*/
+                addbyte(0xd8);
+                addbyte(0x0f); /*CMOVA EAX, EBX*/
+                addbyte(0x47);
+                addbyte(0xc3);
         }
 
         addbyte(0x89); /*MOV state->new_depth[EDI], EAX*/
@@ -952,7 +1010,9 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 } else
                         fatal("Bad depth_op\n");
         } else if ((params->fbzMode & FBZ_DEPTH_ENABLE) && (depthop == DEPTHOP_NEVER)) {
-                addbyte(0xC3); /*RET*/
+                addbyte(0xe9); /*JMP skip*/
+                z_skip_pos = block_pos;
+                addlong(0);
         }
 
         /*XMM0 = colour*/
@@ -995,7 +1055,7 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 addbyte(0x0f);
                 addbyte(0x6e);
                 addbyte(0xd8);
-                if ((params->textureMode[1] & TEXTUREMODE_TRILINEAR) && tc_sub_clocal_1) {
+                if ((params->textureMode[1] & TEXTUREMODE_TRILINEAR) && (tc_sub_clocal_1 || tca_sub_clocal_1)) {
                         addbyte(0x8b); /*MOV EAX, state->lod*/
                         addbyte(0x87);
                         addlong(offsetof(voodoo_state_t, lod));
@@ -1025,6 +1085,11 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         addbyte(4);
                         /*EBX = tc_reverse_blend, ECX=tca_reverse_blend*/
                 }
+                addbyte(0x66); /*MOVD R8D, XMM3*/
+                addbyte(0x41);
+                addbyte(0x0f);
+                addbyte(0x7e);
+                addbyte(0xd8);
                 addbyte(0x66); /*PUNPCKLBW XMM3, XMM2*/
                 addbyte(0x0f);
                 addbyte(0x60);
@@ -1114,10 +1179,6 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         addbyte(0x0f);
                         addbyte(0xfd);
                         addbyte(0xc0);
-                        addbyte(0xf3); /*MOVQ XMM1, XMM2*/
-                        addbyte(0x0f);
-                        addbyte(0x7e);
-                        addbyte(0xca);
                         addbyte(0xf3); /*MOVQ XMM5, XMM0*/
                         addbyte(0x0f);
                         addbyte(0x7e);
@@ -1134,19 +1195,24 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         addbyte(0x0f);
                         addbyte(0x61);
                         addbyte(0xc5);
-                        addbyte(0x66); /*PSRAD XMM0, 8*/
+                        /*Negate before the shift, so the result rounds towards minus infinity as in the C code*/
+                        addbyte(0x66); /*PXOR XMM1, XMM1*/
+                        addbyte(0x0f);
+                        addbyte(0xef);
+                        addbyte(0xc9);
+                        addbyte(0x66); /*PSUBD XMM1, XMM0*/
+                        addbyte(0x0f);
+                        addbyte(0xfa);
+                        addbyte(0xc8);
+                        addbyte(0x66); /*PSRAD XMM1, 8*/
                         addbyte(0x0f);
                         addbyte(0x72);
-                        addbyte(0xe0);
+                        addbyte(0xe1);
                         addbyte(8);
-                        addbyte(0x66); /*PACKSSDW XMM0, XMM0*/
+                        addbyte(0x66); /*PACKSSDW XMM1, XMM1*/
                         addbyte(0x0f);
                         addbyte(0x6b);
-                        addbyte(0xc0);
-                        addbyte(0x66); /*PSUBW XMM1, XMM0*/
-                        addbyte(0x0f);
-                        addbyte(0xf9);
-                        addbyte(0xc8);
+                        addbyte(0xc9);
                         if (tc_add_clocal_1) {
                                 addbyte(0x66); /*PADDW XMM1, XMM3*/
                                 addbyte(0x0f);
@@ -1163,16 +1229,26 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                                 addbyte(0xfd);
                                 addbyte(0xc8);
                         }
-                        addbyte(0x66); /*PACKUSWB XMM3, XMM1*/
+                        /*The colour combine leaves the texture alpha alone*/
+                        addbyte(0x44); /*MOV EAX, R8D*/
+                        addbyte(0x89);
+                        addbyte(0xc0);
+                        addbyte(0xc1); /*SHR EAX, 24*/
+                        addbyte(0xe8);
+                        addbyte(24);
+                        addbyte(0x66); /*PINSRW XMM1, EAX, 3*/
+                        addbyte(0x0f);
+                        addbyte(0xc4);
+                        addbyte(0xc8);
+                        addbyte(3);
+                        addbyte(0x66); /*PACKUSWB XMM1, XMM1*/
                         addbyte(0x0f);
                         addbyte(0x67);
+                        addbyte(0xc9);
+                        addbyte(0xf3); /*MOVQ XMM3, XMM1*/
+                        addbyte(0x0f);
+                        addbyte(0x7e);
                         addbyte(0xd9);
-                        if (tca_sub_clocal_1) {
-                                addbyte(0x66); /*MOVD EBX, XMM3*/
-                                addbyte(0x0f);
-                                addbyte(0x7e);
-                                addbyte(0xdb);
-                        }
                         addbyte(0x66); /*PUNPCKLBW XMM3, XMM2*/
                         addbyte(0x0f);
                         addbyte(0x60);
@@ -1180,6 +1256,9 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 }
 
                 if (tca_sub_clocal_1) {
+                        addbyte(0x44); /*MOV EBX, R8D*/
+                        addbyte(0x89);
+                        addbyte(0xc3);
                         addbyte(0xc1); /*SHR EBX, 24*/
                         addbyte(0xeb);
                         addbyte(24);
@@ -1229,18 +1308,18 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                                 addbyte(0x44);
                                 addbyte(0x8d);
                                 addbyte(0);
-                        } else if (!tc_reverse_blend_1) {
+                        } else if (!tca_reverse_blend_1) {
                                 addbyte(0x35); /*XOR EAX, 0xff*/
                                 addlong(0xff);
                         }
-                        addbyte(0x8e); /*ADD EAX, 1*/
+                        addbyte(0x83); /*ADD EAX, 1*/
                         addbyte(0xc0);
                         addbyte(1);
                         addbyte(0x0f); /*IMUL EAX, EBX*/
                         addbyte(0xaf);
                         addbyte(0xc3);
-                        addbyte(0xb9); /*MOV ECX, 0xff*/
-                        addlong(0xff);
+                        addbyte(0x31); /*XOR ECX, ECX*/
+                        addbyte(0xc9);
                         addbyte(0xf7); /*NEG EAX*/
                         addbyte(0xd8);
                         addbyte(0xc1); /*SAR EAX, 8*/
@@ -1250,12 +1329,17 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                                 addbyte(0x01); /*ADD EAX, EBX*/
                                 addbyte(0xd8);
                         }
-                        addbyte(0x39); /*CMP ECX, EAX*/
+                        addbyte(0x0f); /*CMOVS EAX, ECX*/
+                        addbyte(0x48);
                         addbyte(0xc1);
-                        addbyte(0x0f); /*CMOVA ECX, EAX*/
-                        addbyte(0x47);
+                        addbyte(0xb9); /*MOV ECX, 0xff*/
+                        addlong(0xff);
+                        addbyte(0x39); /*CMP EAX, ECX*/
                         addbyte(0xc8);
-                        addbyte(0x66); /*PINSRW 3, XMM3, XMM0*/
+                        addbyte(0x0f); /*CMOVG EAX, ECX*/
+                        addbyte(0x4f);
+                        addbyte(0xc1);
+                        addbyte(0x66); /*PINSRW XMM3, EAX, 3*/
                         addbyte(0x0f);
                         addbyte(0xc4);
                         addbyte(0xd8);
@@ -1466,16 +1550,9 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         addbyte(0xff);
                         addbyte(0x66); /*PADDW XMM1, XMM4*/
                         addbyte(0x0f);
-                        addbyte(0xfc);
+                        addbyte(0xfd);
                         addbyte(0xcc);
                 }
-                if (tc_invert_output) {
-                        addbyte(0x66); /*PXOR XMM1, XMM9(xmm_ff_w)*/
-                        addbyte(0x41);
-                        addbyte(0x0f);
-                        addbyte(0xef);
-                        addbyte(0xc9);
-                }
 
                 addbyte(0x66); /*PACKUSWB XMM0, XMM0*/
                 addbyte(0x0f);
@@ -1489,6 +1566,14 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 addbyte(0x0f);
                 addbyte(0x67);
                 addbyte(0xc9);
+                if (tc_invert_output) {
+                        /*Inverted after clamping*/
+                        addbyte(0x66); /*PXOR XMM1, XMM10(xmm_ff_b)*/
+                        addbyte(0x41);
+                        addbyte(0x0f);
+                        addbyte(0xef);
+                        addbyte(0xca);
+                }
 
                 if (tca_zero_other) {
                         addbyte(0x31); /*XOR EAX, EAX*/
@@ -1539,16 +1624,16 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         addbyte(24);
                         break;
                 case TCA_MSELECT_DETAIL:
-                        addbyte(0xbb); /*MOV EBX, params->detail_bias[1]*/
-                        addlong(params->detail_bias[1]);
+                        addbyte(0xbb); /*MOV EBX, params->detail_bias[0]*/
+                        addlong(params->detail_bias[0]);
                         addbyte(0x2b); /*SUB EBX, state->lod*/
                         addbyte(0x9f);
                         addlong(offsetof(voodoo_state_t, lod));
-                        addbyte(0xba); /*MOV EDX, params->detail_max[1]*/
-                        addlong(params->detail_max[1]);
-                        addbyte(0xc1); /*SHL EBX, params->detail_scale[1]*/
+                        addbyte(0xba); /*MOV EDX, params->detail_max[0]*/
+                        addlong(params->detail_max[0]);
+                        addbyte(0xc1); /*SHL EBX, params->detail_scale[0]*/
                         addbyte(0xe3);
-                        addbyte(params->detail_scale[1]);
+                        addbyte(params->detail_scale[0]);
                         addbyte(0x39); /*CMP EBX, EDX*/
                         addbyte(0xd3);
                         addbyte(0x0f); /*CMOVNL EBX, EDX*/
@@ -1626,44 +1711,12 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 addbyte(0xe0);
         }
 
-        if ((params->fbzMode & FBZ_CHROMAKEY)) {
-                switch (_rgb_sel) {
-                case CC_LOCALSELECT_ITER_RGB:
-                        addbyte(0xf3); /*MOVDQU XMM0, ib*/ /* ir, ig and ib must be in same dqword!*/
-                        addbyte(0x0f);
-                        addbyte(0x6f);
-                        addbyte(0x87);
-                        addlong(offsetof(voodoo_state_t, ib));
-                        addbyte(0x66); /*PSRAD XMM0, 12*/
-                        addbyte(0x0f);
-                        addbyte(0x72);
-                        addbyte(0xe0);
-                        addbyte(12);
-                        addbyte(0x66); /*PACKSSDW XMM0, XMM0*/
-                        addbyte(0x0f);
-                        addbyte(0x6b);
-                        addbyte(0xc0);
-                        addbyte(0x66); /*PACKUSWB XMM0, XMM0*/
-                        addbyte(0x0f);
-                        addbyte(0x67);
-                        addbyte(0xc0);
-                        addbyte(0x66); /*MOVD EAX, XMM0*/
-                        addbyte(0x0f);
-                        addbyte(0x7e);
-                        addbyte(0xc0);
-                        break;
-                case CC_LOCALSELECT_COLOR1:
-                        addbyte(0x8b); /*MOV EAX, params->color1[RSI]*/
-                        addbyte(0x86);
-                        addlong(offsetof(voodoo_params_t, color1));
-                        break;
-                case CC_LOCALSELECT_TEX:
-                        addbyte(0x66); /*MOVD EAX, XMM0*/
-                        addbyte(0x0f);
-                        addbyte(0x7e);
-                        addbyte(0xc0);
-                        break;
-                }
+        if ((params->fbzMode & FBZ_CHROMAKEY) && (params->fbzColorPath & FBZCP_TEXTURE_ENABLED)) {
+                /*The chroma key is compared with the texel, as in the C pixel loop*/
+                addbyte(0x66); /*MOVD EAX, XMM0*/
+                addbyte(0x0f);
+                addbyte(0x7e);
+                addbyte(0xc0);
                 addbyte(0x8b); /*MOV EBX, params->chromaKey[ESI]*/
                 addbyte(0x9e);
                 addlong(offsetof(voodoo_params_t, chromaKey));
@@ -1672,22 +1725,46 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 addbyte(0x81); /*AND EBX, 0xffffff*/
                 addbyte(0xe3);
                 addlong(0xffffff);
-                addbyte(0x0f); /*JE skip*/
-                addbyte(0x84);
+                addbyte(0x75); /*JNE +18*/
+                addbyte(18);
+                addbyte(0x48); /*MOV RAX, &voodoo->fbiChromaFail*/
+                addbyte(0xb8);
+                addquad((uintptr_t)&voodoo->fbiChromaFail);
+                addbyte(0x83); /*ADD dword [RAX], 1*/
+                addbyte(0x00);
+                addbyte(1);
+                addbyte(0xe9); /*JMP skip*/
                 chroma_skip_pos = block_pos;
                 addlong(0);
         }
 
         if (voodoo->trexInit1[0] & (1 << 18)) {
-                addbyte(0xb8); /*MOV EAX, tmuConfig*/
-                addlong(voodoo->tmuConfig);
+                /*Texture colour is replaced by 0, 0, tmuConfig, keeping the texture alpha. tmuConfig can
+                  be written at any time, so it is read when drawing rather than compiled in*/
+                addbyte(0x66); /*MOVD EAX, XMM0*/
+                addbyte(0x0f);
+                addbyte(0x7e);
+                addbyte(0xc0);
+                addbyte(0x48); /*MOV RBX, &voodoo->tmuConfig*/
+                addbyte(0xbb);
+                addquad((uintptr_t)&voodoo->tmuConfig);
+                addbyte(0x25); /*AND EAX, 0xff000000*/
+                addlong(0xff000000);
+                addbyte(0x8a); /*MOV AL, [RBX]*/
+                addbyte(0x03);
                 addbyte(0x66); /*MOVD XMM0, EAX*/
                 addbyte(0x0f);
                 addbyte(0x6e);
                 addbyte(0xc0);
+                if (cc_mselect == CC_MSELECT_TEXRGB) {
+                        addbyte(0xf3); /*MOVQ XMM4, XMM0*/
+                        addbyte(0x0f);
+                        addbyte(0x7e);
+                        addbyte(0xe0);
+                }
         }
 
-        if (params->alphaMode & ((1 << 0) | (1 << 4))) {
+        if (alpha_used) {
                 /*EBX = a_other*/
                 switch (a_sel) {
                 case A_SEL_ITER_A:
@@ -1834,7 +1911,6 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 } else {
                         addbyte(0xf6); /*TEST state->tex_a, 0x80*/
                         addbyte(0x87);
-                        addbyte(0x23);
                         addlong(offsetof(voodoo_state_t, tex_a));
                         addbyte(0x80);
                         addbyte(0x74); /*JZ !cc_localselect*/
@@ -1977,8 +2053,8 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         addbyte(0x0f); /*IMUL EDX, EAX*/
                         addbyte(0xaf);
                         addbyte(0xd0);
-                        addbyte(0xc1); /*SHR EDX, 8*/
-                        addbyte(0xea);
+                        addbyte(0xc1); /*SAR EDX, 8*/
+                        addbyte(0xfa);
                         addbyte(8);
                 }
         }
@@ -1989,11 +2065,11 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
         }
 
         if (!(cc_mselect == 0 && cc_reverse_blend == 0) && cc_mselect == CC_MSELECT_AOTHER) {
-                /*Copy a_other to XMM3 before it gets modified*/
-                addbyte(0x66); /*MOVD XMM3, EDX*/
+                /*XMM3 = a_other*/
+                addbyte(0x66); /*MOVD XMM3, EBX*/
                 addbyte(0x0f);
                 addbyte(0x6e);
-                addbyte(0xda);
+                addbyte(0xdb);
                 addbyte(0xf2); /*PSHUFLW XMM3, XMM3, 0*/
                 addbyte(0x0f);
                 addbyte(0x70);
@@ -2131,11 +2207,25 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 addbyte(0xc0);
         }
 
-        if (cc_add == 1) {
+        if (cc_add == CC_ADD_CLOCAL) {
                 addbyte(0x66); /*PADDW XMM0, XMM1*/
                 addbyte(0x0f);
                 addbyte(0xfd);
                 addbyte(0xc1);
+        } else if (cc_add == CC_ADD_ALOCAL) {
+                addbyte(0x66); /*MOVD XMM3, ECX*/
+                addbyte(0x0f);
+                addbyte(0x6e);
+                addbyte(0xd9);
+                addbyte(0xf2); /*PSHUFLW XMM3, XMM3, 0*/
+                addbyte(0x0f);
+                addbyte(0x70);
+                addbyte(0xdb);
+                addbyte(0x00);
+                addbyte(0x66); /*PADDW XMM0, XMM3*/
+                addbyte(0x0f);
+                addbyte(0xfd);
+                addbyte(0xc3);
         }
 
         addbyte(0x66); /*PACKUSWB XMM0, XMM0*/
@@ -2192,13 +2282,6 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                                 addbyte(0xd8);
                         }
 
-                        /*Divide by 2 to prevent overflow on multiply*/
-                        addbyte(0x66); /*PSRAW XMM3, 1*/
-                        addbyte(0x0f);
-                        addbyte(0x71);
-                        addbyte(0xe3);
-                        addbyte(1);
-
                         switch (params->fogMode & (FOG_Z | FOG_ALPHA)) {
                         case 0:
                                 addbyte(0x8b); /*MOV EBX, state->w_depth[EDI]*/
@@ -2242,9 +2325,9 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                                 addbyte(0x8b); /*MOV EAX, state->z[EDI]*/
                                 addbyte(0x87);
                                 addlong(offsetof(voodoo_state_t, z));
-                                addbyte(0xc1); /*SHR EAX, 12*/
+                                addbyte(0xc1); /*SHR EAX, 20*/
                                 addbyte(0xe8);
-                                addbyte(12);
+                                addbyte(20);
                                 addbyte(0x25); /*AND EAX, 0xff*/
                                 addlong(0xff);
                                 //                                fog_a = (z >> 20) & 0xff;
@@ -2273,41 +2356,52 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                                 break;
 
                         case FOG_W:
-                                addbyte(0x8b); /*MOV EAX, state->w[EDI]+4*/
+                                addbyte(0x0f); /*MOVZX EAX, state->w[EDI]+4*/
+                                addbyte(0xb6);
                                 addbyte(0x87);
                                 addlong(offsetof(voodoo_state_t, w) + 4);
-                                addbyte(0x31); /*XOR EBX, EBX*/
-                                addbyte(0xdb);
-                                addbyte(0x09); /*OR EAX, EAX*/
-                                addbyte(0xc0);
-                                addbyte(0x0f); /*CMOVS EAX, EBX*/
-                                addbyte(0x48);
-                                addbyte(0xc3);
-                                addbyte(0xbb); /*MOV EBX, 0xff*/
-                                addlong(0xff);
-                                addbyte(0x3d); /*CMP EAX, 0xff*/
-                                addlong(0xff);
-                                addbyte(0x0f); /*CMOVAE EAX, EBX*/
-                                addbyte(0x43);
-                                addbyte(0xc3);
-                                //                                fog_a = CLAMP(w >> 32);
+                                //                                fog_a = (w >> 32) & 0xff;
                                 break;
                         }
-                        addbyte(0x01); /*ADD EAX, EAX*/
+                        /*The table fog value can exceed 0xff, and the fog difference times fog_a overflows
+                          16 bits, so multiply to 32 bits as the C code does*/
+                        addbyte(0x83); /*ADD EAX, 1*/
                         addbyte(0xc0);
-
-                        addbyte(0x66); /*PMULLW XMM3, alookup+4[EAX*8]*/
-                        addbyte(0x41);
+                        addbyte(1);
+                        addbyte(0x66); /*MOVD XMM4, EAX*/
+                        addbyte(0x0f);
+                        addbyte(0x6e);
+                        addbyte(0xe0);
+                        addbyte(0xf2); /*PSHUFLW XMM4, XMM4, 0*/
+                        addbyte(0x0f);
+                        addbyte(0x70);
+                        addbyte(0xe4);
+                        addbyte(0x00);
+                        addbyte(0xf3); /*MOVQ XMM5, XMM3*/
+                        addbyte(0x0f);
+                        addbyte(0x7e);
+                        addbyte(0xeb);
+                        addbyte(0x66); /*PMULLW XMM3, XMM4*/
                         addbyte(0x0f);
                         addbyte(0xd5);
-                        addbyte(0x5c);
-                        addbyte(0xc2);
-                        addbyte(16);
-                        addbyte(0x66); /*PSRAW XMM3, 7*/
+                        addbyte(0xdc);
+                        addbyte(0x66); /*PMULHW XMM5, XMM4*/
                         addbyte(0x0f);
-                        addbyte(0x71);
+                        addbyte(0xe5);
+                        addbyte(0xec);
+                        addbyte(0x66); /*PUNPCKLWD XMM3, XMM5*/
+                        addbyte(0x0f);
+                        addbyte(0x61);
+                        addbyte(0xdd);
+                        addbyte(0x66); /*PSRAD XMM3, 8*/
+                        addbyte(0x0f);
+                        addbyte(0x72);
                         addbyte(0xe3);
-                        addbyte(7);
+                        addbyte(8);
+                        addbyte(0x66); /*PACKSSDW XMM3, XMM3*/
+                        addbyte(0x0f);
+                        addbyte(0x6b);
+                        addbyte(0xdb);
 
                         if (params->fogMode & FOG_MULT) {
                                 addbyte(0xf3); /*MOV XMM0, XMM3*/
@@ -2374,7 +2468,9 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         break;
                 }
         } else if ((params->alphaMode & 1) && (alpha_func == AFUNC_NEVER)) {
-                addbyte(0xC3); /*RET*/
+                addbyte(0xe9); /*JMP skip*/
+                a_skip_pos = block_pos;
+                addlong(0);
         }
 
         if (params->alphaMode & (1 << 4)) {
@@ -2412,6 +2508,61 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 addbyte(0x0f);
                 addbyte(0x60);
                 addbyte(0xe2);
+                if (dithersub && voodoo->dithersub_enabled) {
+                        uintptr_t rb_table = dither2x2 ? (uintptr_t)dithersub_rb2x2 : (uintptr_t)dithersub_rb;
+                        uintptr_t g_table = dither2x2 ? (uintptr_t)dithersub_g2x2 : (uintptr_t)dithersub_g;
+                        int c;
+
+                        addbyte(0x41); /*MOV EBX, rgb565[EAX*4]*/
+                        addbyte(0x8b);
+                        addbyte(0x1c);
+                        addbyte(0x80);
+                        addbyte(0x8b); /*MOV ECX, state->x[EDI]*/
+                        addbyte(0x8f);
+                        addlong(offsetof(voodoo_state_t, x));
+                        addbyte(0x44); /*MOV EAX, R14D (real_y)*/
+                        addbyte(0x89);
+                        addbyte(0xf0);
+                        addbyte(0x83); /*AND ECX, 3*/
+                        addbyte(0xe1);
+                        addbyte(dither2x2 ? 1 : 3);
+                        addbyte(0x83); /*AND EAX, 3*/
+                        addbyte(0xe0);
+                        addbyte(dither2x2 ? 1 : 3);
+                        addbyte(0x8d); /*LEA ECX, [RCX+RAX*4]*/
+                        addbyte(0x0c);
+                        addbyte(dither2x2 ? 0x41 : 0x81);
+                        addbyte(0x49); /*MOV R8, dithersub_rb*/
+                        addbyte(0xb8);
+                        addquad(rb_table);
+                        /*Replace the unpacked destination B, G and R with the dither subtracted values*/
+                        for (c = 0; c < 3; c++) {
+                                if (c == 2) {
+                                        addbyte(0xc1); /*SHR EBX, 16*/
+                                        addbyte(0xeb);
+                                        addbyte(16);
+                                }
+                                addbyte(0x0f); /*MOVZX EAX, BL / BH*/
+                                addbyte(0xb6);
+                                addbyte((c == 1) ? 0xc7 : 0xc3);
+                                addbyte(0xc1); /*SHL EAX, 4*/
+                                addbyte(0xe0);
+                                addbyte(dither2x2 ? 2 : 4);
+                                addbyte(0x01); /*ADD EAX, ECX*/
+                                addbyte(0xc8);
+                                addbyte(0x41); /*MOVZX EAX, dithersub_rb[R8+RAX]*/
+                                addbyte(0x0f);
+                                addbyte(0xb6);
+                                addbyte(0x84);
+                                addbyte(0x00);
+                                addlong((c == 1) ? (g_table - rb_table) : 0);
+                                addbyte(0x66); /*PINSRW XMM4, EAX, c*/
+                                addbyte(0x0f);
+                                addbyte(0xc4);
+                                addbyte(0xe0);
+                                addbyte(c);
+                        }
+                }
                 addbyte(0xf3); /*MOV XMM6, XMM4*/
                 addbyte(0x0f);
                 addbyte(0x7e);
@@ -2568,35 +2719,12 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         addbyte(0xe4);
                         break;
                 case AFUNC_ASATURATE:
-                        addbyte(0x66); /*PMULLW XMM4, XMM11(minus_254)*/
-                        addbyte(0x41);
-                        addbyte(0x0f);
-                        addbyte(0xd5);
-                        addbyte(0xe3);
-                        addbyte(0xf3); /*MOVQ XMM5, XMM4*/
-                        addbyte(0x0f);
-                        addbyte(0x7e);
-                        addbyte(0xec);
-                        addbyte(0x66); /*PADDW XMM4, alookup[1*8]*/
-                        addbyte(0x41);
-                        addbyte(0x0f);
-                        addbyte(0xfd);
-                        addbyte(0x62);
-                        addbyte(8 * 2);
-                        addbyte(0x66); /*PSRLW XMM5, 8*/
-                        addbyte(0x0f);
-                        addbyte(0x71);
-                        addbyte(0xd5);
-                        addbyte(8);
-                        addbyte(0x66); /*PADDW XMM4, XMM5*/
-                        addbyte(0x0f);
-                        addbyte(0xfd);
-                        addbyte(0xe5);
-                        addbyte(0x66); /*PSRLW XMM4, 8*/
+                        /*There is no destination alpha, so min(src_a, 1 - dest_a) is always zero*/
+                        addbyte(0x66); /*PXOR XMM4, XMM4*/
                         addbyte(0x0f);
-                        addbyte(0x71);
-                        addbyte(0xd4);
-                        addbyte(8);
+                        addbyte(0xef);
+                        addbyte(0xe4);
+                        break;
                 }
 
                 switch (src_afunc) {
@@ -3171,30 +3299,102 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
         addbyte(0xC3); /*RET*/
 }
 int voodoo_recomp = 0;
+int voodoo_recomp_hits = 0;
+
+static inline int voodoo_block_matches(voodoo_x86_data_t *data, voodoo_t *voodoo, voodoo_params_t *params,
+                                       voodoo_state_t *state) {
+        return data->valid && state->xdir == data->xdir && params->alphaMode == data->alphaMode &&
+               params->fbzMode == data->fbzMode && params->fogMode == data->fogMode &&
+               params->fbzColorPath == data->fbzColorPath && (voodoo->trexInit1[0] & (1 << 18)) == data->trexInit1 &&
+               params->textureMode[0] == data->textureMode[0] && params->textureMode[1] == data->textureMode[1] &&
+               (params->tLOD[0] & LOD_MASK) == data->tLOD[0] && (params->tLOD[1] & LOD_MASK) == data->tLOD[1] &&
+               ((params->col_tiled || params->aux_tiled) ? 1 : 0) == data->is_tiled;
+}
+
+static inline int voodoo_block_hash(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state) {
+        uint32_t hash = params->fbzMode;
+
+        hash = (hash * 0x9e3779b1) ^ params->alphaMode;
+        hash = (hash * 0x9e3779b1) ^ params->fbzColorPath;
+        hash = (hash * 0x9e3779b1) ^ params->fogMode;
+        hash = (hash * 0x9e3779b1) ^ params->textureMode[0];
+        hash = (hash * 0x9e3779b1) ^ params->textureMode[1];
+        hash = (hash * 0x9e3779b1) ^ ((params->tLOD[0] & LOD_MASK) | ((params->tLOD[1] & LOD_MASK) >> 1));
+        hash = (hash * 0x9e3779b1) ^ (state->xdir & 3) ^ ((params->col_tiled || params->aux_tiled) ? 4 : 0) ^
+               ((voodoo->trexInit1[0] >> 15) & 8);
+        hash ^= hash >> 16;
+
+        return hash & (BLOCK_SETS - 1);
+}
+
+/*Mark a block as just used. Called both with and without the cache lock held, so the stamp and the hit
+  counter are updated atomically*/
+static inline void voodoo_block_touch(voodoo_codegen_cache_t *cache, voodoo_x86_data_t *data) {
+        __atomic_store_n(&data->last_used, __atomic_fetch_add(&cache->use_stamp, 1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
 static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even) {
-        int c;
-        int b = last_block[odd_even];
-        voodoo_x86_data_t *voodoo_x86_data = voodoo->codegen_data;
+        voodoo_codegen_cache_t *cache = voodoo->codegen_data;
         voodoo_x86_data_t *data;
+        voodoo_x86_data_t *set;
+        int victim = -1;
+        int c;
+
+        /*Fast path - same pipeline as this thread's previous half-triangle. The block
+          is pinned by this thread, so it can be checked without taking the lock*/
+        if (cache->in_use[odd_even] != -1) {
+                data = &cache->blocks[cache->in_use[odd_even]];
+
+                if (voodoo_block_matches(data, voodoo, params, state)) {
+                        voodoo_block_touch(cache, data);
+                        __atomic_fetch_add(&voodoo_recomp_hits, 1, __ATOMIC_RELAXED);
+                        return data->code_block;
+                }
+        }
 
-        for (c = 0; c < 8; c++) {
-                data = &voodoo_x86_data[odd_even + c * 4]; //&voodoo_x86_data[odd_even][b];
+        thread_lock_mutex(cache->lock);
 
-                if (state->xdir == data->xdir && params->alphaMode == data->alphaMode && params->fbzMode == data->fbzMode &&
-                    params->fogMode == data->fogMode && params->fbzColorPath == data->fbzColorPath &&
-                    (voodoo->trexInit1[0] & (1 << 18)) == data->trexInit1 && params->textureMode[0] == data->textureMode[0] &&
-                    params->textureMode[1] == data->textureMode[1] && (params->tLOD[0] & LOD_MASK) == data->tLOD[0] &&
-                    (params->tLOD[1] & LOD_MASK) == data->tLOD[1] &&
-                    ((params->col_tiled || params->aux_tiled) ? 1 : 0) == data->is_tiled) {
-                        last_block[odd_even] = b;
+        set = &cache->blocks[voodoo_block_hash(voodoo, params, state) * BLOCK_WAYS];
+        for (c = 0; c < BLOCK_WAYS; c++) {
+                data = &set[c];
+
+                if (voodoo_block_matches(data, voodoo, params, state)) {
+                        voodoo_block_touch(cache, data);
+                        cache->in_use[odd_even] = data - cache->blocks;
+                        thread_unlock_mutex(cache->lock);
+                        __atomic_fetch_add(&voodoo_recomp_hits, 1, __ATOMIC_RELAXED);
                         return data->code_block;
                 }
+        }
+
+        /*Miss - replace the least recently used block in this set that no other
+          render thread is executing*/
+        for (c = 0; c < BLOCK_WAYS; c++) {
+                int index = (set - cache->blocks) + c;
+                int d;
+
+                for (d = 0; d < VOODOO_MAX_RENDER_THREADS; d++) {
+                        if (d != odd_even && cache->in_use[d] == index)
+                                break;
+                }
+                if (d != VOODOO_MAX_RENDER_THREADS)
+                        continue;
 
-                b = (b + 1) & 7;
+                if (!set[c].valid) {
+                        victim = c;
+                        break;
+                }
+                if (victim == -1 || (int32_t)(__atomic_load_n(&set[c].last_used, __ATOMIC_RELAXED) -
+                                              __atomic_load_n(&set[victim].last_used, __ATOMIC_RELAXED)) < 0)
+                        victim = c;
         }
+        if (victim == -1)
+                fatal("voodoo_get_block: no free block\n");
+
         voodoo_recomp++;
-        data = &voodoo_x86_data[odd_even + next_block_to_write[odd_even] * 4];
-        //        code_block = data->code_block;
+        data = &set[victim];
+        data->valid = 0;
+        cache->in_use[odd_even] = data - cache->blocks;
 
         voodoo_generate(data->code_block, voodoo, params, state, depth_op);
 
@@ -3209,21 +3409,30 @@ static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params,
         data->tLOD[0] = params->tLOD[0] & LOD_MASK;
         data->tLOD[1] = params->tLOD[1] & LOD_MASK;
         data->is_tiled = (params->col_tiled || params->aux_tiled) ? 1 : 0;
+        voodoo_block_touch(cache, data);
+        data->valid = 1;
 
-        next_block_to_write[odd_even] = (next_block_to_write[odd_even] + 1) & 7;
+        thread_unlock_mutex(cache->lock);
 
         return data->code_block;
 }
 
 void voodoo_codegen_init(voodoo_t *voodoo) {
+        voodoo_codegen_cache_t *cache;
         int c;
 
 #if WIN64
-        voodoo->codegen_data = VirtualAlloc(NULL, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+        cache = VirtualAlloc(NULL, sizeof(voodoo_codegen_cache_t), MEM_COMMIT, PAGE_EXECUTE_READWRITE);
 #else
-        voodoo->codegen_data = mmap(0, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4, PROT_READ | PROT_WRITE | PROT_EXEC,
-                                    MAP_ANON | MAP_PRIVATE, 0, 0);
+        cache = mmap(0, sizeof(voodoo_codegen_cache_t), PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANON | MAP_PRIVATE, 0, 0);
 #endif
+        for (c = 0; c < BLOCK_NUM; c++)
+                cache->blocks[c].valid = 0;
+        for (c = 0; c < VOODOO_MAX_RENDER_THREADS; c++)
+                cache->in_use[c] = -1;
+        cache->use_stamp = 0;
+        cache->lock = thread_create_mutex();
+        voodoo->codegen_data = cache;
 
         for (c = 0; c < 256; c++) {
                 int d[4];
@@ -3249,10 +3458,13 @@ void voodoo_codegen_init(voodoo_t *voodoo) {
 }
 
 void voodoo_codegen_close(voodoo_t *voodoo) {
+        voodoo_codegen_cache_t *cache = voodoo->codegen_data;
+
+        thread_destroy_mutex(cache->lock);
 #if WIN64
-        VirtualFree(voodoo->codegen_data, 0, MEM_RELEASE);
+        VirtualFree(cache, 0, MEM_RELEASE);
 #else
-        munmap(voodoo->codegen_data, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4);
+        munmap(cache, sizeof(voodoo_codegen_cache_t));
 #endif
 }
 
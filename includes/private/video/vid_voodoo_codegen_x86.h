@@ -39,8 +39,8 @@ typedef struct voodoo_x86_data_t {
         int is_tiled;
 } voodoo_x86_data_t;
 
-static int last_block[4] = {0, 0};
-static int next_block_to_write[4] = {0, 0};
+static int last_block[VOODOO_MAX_RENDER_THREADS] = {0, 0};
+static int next_block_to_write[VOODOO_MAX_RENDER_THREADS] = {0, 0};
 
 #define addbyte(val)                                                                                                             \
         do {                                                                                                                     \
@@ -81,7 +81,6 @@ static uint32_t zero = 0;
 static double const_1_48 = (double)(1ull << 4);
 
 static __m128i alookup[257], aminuslookup[256];
-static __m128i minus_254; // = 0xff02ff02ff02ff02ull;
 static __m128i bilinear_lookup[256 * 2];
 static __m128i xmm_00_ff_w[2];
 static uint32_t i_00_ff_w[2] = {0, 0xff};
@@ -651,7 +650,6 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
         xmm_01_w = _mm_set_epi32(0, 0, 0x00010001, 0x00010001);
         xmm_ff_w = _mm_set_epi32(0, 0, 0x00ff00ff, 0x00ff00ff);
         xmm_ff_b = _mm_set_epi32(0, 0, 0, 0x00ffffff);
-        minus_254 = _mm_set_epi32(0, 0, 0xff02ff02, 0xff02ff02);
         //        *(uint64_t *)&const_1_48 = 0x45b0000000000000ull;
         //        block_pos = 0;
         //        voodoo_get_depth = &code_block[block_pos];
@@ -1164,7 +1162,7 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                                 addbyte(0x04);
                                 addbyte(0x8d);
                                 addlong((uint32_t)i_00_ff_w);
-                        } else if (!tc_reverse_blend_1) {
+                        } else if (!tca_reverse_blend_1) {
                                 addbyte(0x35); /*XOR EAX, 0xff*/
                                 addlong(0xff);
                         }
@@ -1473,14 +1471,14 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         addbyte(24);
                         break;
                 case TCA_MSELECT_DETAIL:
-                        addbyte(0xbb); /*MOV EBX, params->detail_bias[1]*/
-                        addlong(params->detail_bias[1]);
+                        addbyte(0xbb); /*MOV EBX, params->detail_bias[0]*/
+                        addlong(params->detail_bias[0]);
                         addbyte(0x2b); /*SUB EBX, state->lod*/
                         addbyte(0x9f);
                         addlong(offsetof(voodoo_state_t, lod));
-                        addbyte(0xba); /*MOV EDX, params->detail_max[1]*/
-                        addlong(params->detail_max[1]);
-                        addbyte(0xc1); /*SHL EBX, params->detail_scale[1]*/
+                        addbyte(0xba); /*MOV EDX, params->detail_max[0]*/
+                        addlong(params->detail_max[0]);
+                        addbyte(0xc1); /*SHL EBX, params->detail_scale[0]*/
                         addbyte(0xe3);
                         addbyte(params->detail_scale[1]);
                         addbyte(0x39); /*CMP EBX, EDX*/
@@ -1613,7 +1611,7 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
 
         if (voodoo->trexInit1[0] & (1 << 18)) {
                 addbyte(0xb8); /*MOV EAX, tmuConfig*/
-                addlong(voodoo->tmuConfig);
+                addlong(voodoo->tmuConfig & 0xff);
                 addbyte(0x66); /*MOVD XMM0, EAX*/
                 addbyte(0x0f);
                 addbyte(0x6e);
@@ -2516,34 +2514,12 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                         addbyte(0xe4);
                         break;
                 case AFUNC_ASATURATE:
-                        addbyte(0x66); /*PMULLW XMM4, minus_254*/
-                        addbyte(0x0f);
-                        addbyte(0xd5);
-                        addbyte(0x25);
-                        addlong((uint32_t)&minus_254);
-                        addbyte(0xf3); /*MOVQ XMM5, XMM4*/
-                        addbyte(0x0f);
-                        addbyte(0x7e);
-                        addbyte(0xec);
-                        addbyte(0x66); /*PADDW XMM4, alookup[1*8]*/
-                        addbyte(0x0f);
-                        addbyte(0xfd);
-                        addbyte(0x25);
-                        addlong((uint32_t)alookup + 16);
-                        addbyte(0x66); /*PSRLW XMM5, 8*/
-                        addbyte(0x0f);
-                        addbyte(0x71);
-                        addbyte(0xd5);
-                        addbyte(8);
-                        addbyte(0x66); /*PADDW XMM4, XMM5*/
-                        addbyte(0x0f);
-                        addbyte(0xfd);
-                        addbyte(0xe5);
-                        addbyte(0x66); /*PSRLW XMM4, 8*/
+                        /*There is no destination alpha, so min(src_a, 1 - dest_a) is always zero*/
+                        addbyte(0x66); /*PXOR XMM4, XMM4*/
                         addbyte(0x0f);
-                        addbyte(0x71);
-                        addbyte(0xd4);
-                        addbyte(8);
+                        addbyte(0xef);
+                        addbyte(0xe4);
+                        break;
                 }
 
                 switch (src_afunc) {
@@ -3108,6 +3084,7 @@ static inline void voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo
                 cs = cs;
 }
 int voodoo_recomp = 0;
+int voodoo_recomp_hits = 0;
 
 static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even) {
         int c;
@@ -3116,7 +3093,7 @@ static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params,
         voodoo_x86_data_t *codegen_data = voodoo->codegen_data;
 
         for (c = 0; c < 8; c++) {
-                data = &codegen_data[odd_even + b * 4];
+                data = &codegen_data[odd_even + b * VOODOO_MAX_RENDER_THREADS];
 
                 if (state->xdir == data->xdir && params->alphaMode == data->alphaMode && params->fbzMode == data->fbzMode &&
                     params->fogMode == data->fogMode && params->fbzColorPath == data->fbzColorPath &&
@@ -3125,13 +3102,14 @@ static inline void *voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params,
                     (params->tLOD[1] & LOD_MASK) == data->tLOD[1] &&
                     ((params->col_tiled || params->aux_tiled) ? 1 : 0) == data->is_tiled) {
                         last_block[odd_even] = b;
+                        voodoo_recomp_hits++;
                         return data->code_block;
                 }
 
                 b = (b + 1) & 7;
         }
         voodoo_recomp++;
-        data = &codegen_data[odd_even + next_block_to_write[odd_even] * 4];
+        data = &codegen_data[odd_even + next_block_to_write[odd_even] * VOODOO_MAX_RENDER_THREADS];
         //        code_block = data->code_block;
 
         voodoo_generate(data->code_block, voodoo, params, state, depth_op);
@@ -3163,9 +3141,9 @@ void voodoo_codegen_init(voodoo_t *voodoo) {
 #endif
 
 #if defined WIN32 || defined _WIN32 || defined _WIN32
-        voodoo->codegen_data = VirtualAlloc(NULL, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+        voodoo->codegen_data = VirtualAlloc(NULL, sizeof(voodoo_x86_data_t) * BLOCK_NUM * VOODOO_MAX_RENDER_THREADS, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
 #else
-        voodoo->codegen_data = mmap(0, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4, PROT_READ | PROT_WRITE | PROT_EXEC,
+        voodoo->codegen_data = mmap(0, sizeof(voodoo_x86_data_t) * BLOCK_NUM * VOODOO_MAX_RENDER_THREADS, PROT_READ | PROT_WRITE | PROT_EXEC,
                                     MAP_ANON | MAP_PRIVATE, 0, 0);
 #endif
 
@@ -3196,7 +3174,7 @@ void voodoo_codegen_close(voodoo_t *voodoo) {
 #if defined WIN32 || defined _WIN32 || defined _WIN32
         VirtualFree(voodoo->codegen_data, 0, MEM_RELEASE);
 #else
-        munmap(voodoo->codegen_data, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4);
+        munmap(voodoo->codegen_data, sizeof(voodoo_x86_data_t) * BLOCK_NUM * VOODOO_MAX_RENDER_THREADS);
 #endif
 }
 
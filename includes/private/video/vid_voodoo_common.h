@@ -64,6 +64,16 @@ enum {
 #define PARAM_MASK (PARAM_SIZE - 1)
 #define PARAM_ENTRY_SIZE (1 << 31)
 
+/*Render work is split into screen tiles. A tile is every render_tiles'th band of
+  (1 << VOODOO_TILE_SHIFT) lines. Each tile consumes the triangle queue in order
+  and is rendered by at most one render thread at a time, so per-pixel ordering
+  is preserved while idle threads are free to pick up any tile with work.*/
+#define VOODOO_MAX_RENDER_THREADS 16
+#define VOODOO_MAX_RENDER_TILES (VOODOO_MAX_RENDER_THREADS * 2)
+#define VOODOO_MAX_DISPLAY_THREADS 4
+#define VOODOO_MAX_DISPLAY_LINES 2048
+#define VOODOO_TILE_SHIFT 2
+
 #define PARAM_ENTRIES(x) (voodoo->params_write_idx - voodoo->params_read_idx[x])
 #define PARAM_FULL(x) ((voodoo->params_write_idx - voodoo->params_read_idx[x]) >= PARAM_SIZE)
 #define PARAM_EMPTY(x) (voodoo->params_read_idx[x] == voodoo->params_write_idx)
@@ -148,7 +158,7 @@ typedef struct voodoo_params_t {
 typedef struct texture_t {
         uint32_t base;
         uint32_t tLOD;
-        volatile int refcount, refcount_r[4];
+        volatile int refcount, refcount_r[VOODOO_MAX_RENDER_TILES];
         int is16;
         uint32_t palette_checksum;
         uint32_t addr_start[4], addr_end[4];
@@ -168,6 +178,18 @@ typedef struct clip_t {
         int y_min, y_max;
 } clip_t;
 
+typedef struct voodoo_render_worker_t {
+        struct voodoo_t *voodoo;
+        int index;
+} voodoo_render_worker_t;
+
+/*A displayed line waiting to be converted into buffer32*/
+typedef struct voodoo_display_line_t {
+        struct voodoo_t *draw_voodoo;
+        uint16_t *src;
+        int line;
+} voodoo_display_line_t;
+
 typedef struct voodoo_t {
         mem_mapping_t mapping;
 
@@ -239,21 +261,24 @@ typedef struct voodoo_t {
         int ncc_dirty[2];
 
         thread_t *fifo_thread;
-        thread_t *render_thread[4];
+        thread_t *render_thread[VOODOO_MAX_RENDER_THREADS];
+        voodoo_render_worker_t render_worker[VOODOO_MAX_RENDER_THREADS];
         event_t *wake_fifo_thread;
         event_t *wake_main_thread;
         event_t *fifo_not_full_event;
-        event_t *render_not_full_event[4];
-        event_t *wake_render_thread[4];
+        event_t *render_not_full_event;
+        event_t *wake_render_thread[VOODOO_MAX_RENDER_THREADS];
 
         int voodoo_busy;
-        int render_voodoo_busy[4];
+        volatile int render_voodoo_busy[VOODOO_MAX_RENDER_THREADS];
 
         int render_threads;
-        int odd_even_mask;
+        int render_tiles;
+        mutex_t *render_tile_lock;
+        int render_tile_claimed[VOODOO_MAX_RENDER_TILES];
 
-        int pixel_count[4], texel_count[4], tri_count, frame_count;
-        int pixel_count_old[4], texel_count_old[4];
+        int pixel_count[VOODOO_MAX_RENDER_THREADS], texel_count[VOODOO_MAX_RENDER_THREADS], tri_count, frame_count;
+        int pixel_count_old[VOODOO_MAX_RENDER_THREADS], texel_count_old[VOODOO_MAX_RENDER_THREADS];
         int wr_count, rd_count, tex_count;
 
         int retrace_count;
@@ -278,7 +303,7 @@ typedef struct voodoo_t {
         volatile int cmd_read, cmd_written, cmd_written_fifo;
 
         voodoo_params_t params_buffer[PARAM_SIZE];
-        volatile int params_read_idx[4], params_write_idx;
+        volatile int params_read_idx[VOODOO_MAX_RENDER_TILES], params_write_idx;
 
         uint32_t cmdfifo_base, cmdfifo_end, cmdfifo_size;
         int cmdfifo_rp, cmdfifo_ret_addr;
@@ -403,6 +428,10 @@ typedef struct voodoo_t {
 
                 int line_pix_pos, line_bit_pos;
                 int line_rep_cnt, line_bit_mask_size;
+
+                /*Pixels written by the span fast paths and by PLOT(), reset by status info. Only counted
+                  when built with BANSHEE_BLT_STATS*/
+                int span_pixel_count, plot_pixel_count;
         } banshee_blt;
 
         struct {
@@ -428,6 +457,17 @@ typedef struct voodoo_t {
         uint8_t dirty_line[2048];
         int dirty_line_low, dirty_line_high;
 
+        voodoo_display_line_t display_line[VOODOO_MAX_DISPLAY_LINES];
+        int nr_display_lines;
+        /*Held while the display line queue is added to or converted*/
+        mutex_t *display_mutex;
+
+        int display_threads;
+        thread_t *display_thread[VOODOO_MAX_DISPLAY_THREADS];
+        event_t *wake_display_thread[VOODOO_MAX_DISPLAY_THREADS];
+        event_t *display_done_event[VOODOO_MAX_DISPLAY_THREADS];
+        voodoo_render_worker_t display_worker[VOODOO_MAX_DISPLAY_THREADS];
+
         int fb_write_buffer, fb_draw_buffer;
         int buffer_cutoff;
 
@@ -445,6 +485,7 @@ typedef struct voodoo_t {
         uint8_t thefilterg[256][256];
         uint8_t thefilterb[256][256];
         uint16_t purpleline[256][3];
+        int filter_cap[3]; /*Thresholds the tables were generated with, blue/green/red*/
 
         texture_t texture_cache[2][TEX_CACHE_MAX];
         uint8_t texture_present[2][16384];
@@ -454,11 +495,13 @@ typedef struct voodoo_t {
         int palette_dirty[2];
 
         uint64_t time;
-        int render_time[4];
+        int render_time[VOODOO_MAX_RENDER_THREADS];
 
         int use_recompiler;
         void *codegen_data;
 
+        void *record_data;
+
         struct voodoo_set_t *set;
 
         uint8_t *vram, *changedvram;
@@ -7,4 +7,8 @@ void voodoo_generate_filter_v2(voodoo_t *voodoo);
 void voodoo_threshold_check(voodoo_t *voodoo);
 void voodoo_callback(void *p);
 
+void voodoo_display_init(voodoo_t *voodoo);
+void voodoo_display_close(voodoo_t *voodoo);
+void voodoo_display_flush_front(voodoo_t *voodoo);
+
 #endif /* _VID_VOODOO_DISPLAY_H_ */
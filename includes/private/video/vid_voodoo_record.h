@@ -0,0 +1,36 @@
+#ifndef _VID_VOODOO_RECORD_H_
+#define _VID_VOODOO_RECORD_H_
+
+#define VOODOO_RECORD_MAGIC "PCEMVDR1"
+#define VOODOO_RECORD_VERSION 1
+
+/*Command stream file header. Followed by a sequence of {addr_type, val} pairs,
+  using the same FIFO_* encoding as fifo_entry_t. Streams are replayed by the
+  standalone voodoo-replay tool*/
+typedef struct voodoo_record_header_t {
+        char magic[8];
+        uint32_t version;
+        uint32_t type;
+        uint32_t dual_tmus;
+        uint32_t fb_size;
+        uint32_t texture_size;
+
+        /*Registers written directly by the CPU rather than through the FIFO*/
+        uint32_t fbiInit[8];
+        uint32_t backPorch;
+        uint32_t videoDimensions;
+        uint32_t hSync;
+        uint32_t vSync;
+} voodoo_record_header_t;
+
+void voodoo_record_init(voodoo_t *voodoo);
+void voodoo_record_close(voodoo_t *voodoo);
+void voodoo_record_write(voodoo_t *voodoo, uint32_t addr_type, uint32_t val);
+void voodoo_record_vertex(voodoo_t *voodoo);
+
+static inline void voodoo_record(voodoo_t *voodoo, uint32_t addr_type, uint32_t val) {
+        if (voodoo->record_data)
+                voodoo_record_write(voodoo, addr_type, val);
+}
+
+#endif /* _VID_VOODOO_RECORD_H_ */
@@ -1,9 +1,18 @@
 #ifndef _VID_VOODOO_RENDER_H_
 #define _VID_VOODOO_RENDER_H_
-#if !(defined i386 || defined __i386 || defined __i386__ || defined _X86_) && !(defined __amd64__)
+#if !(defined i386 || defined __i386 || defined __i386__ || defined _X86_) && !(defined __amd64__) &&                          \
+        !(defined __aarch64__ || defined _M_ARM64)
 #define NO_CODEGEN
 #endif
 
+/*The AArch64 recompiler has not been run through voodoo-jit-test on ARM hardware yet, so it is only used
+  when selected in the card configuration*/
+#if defined __aarch64__ || defined _M_ARM64
+#define VOODOO_RECOMPILER_DEFAULT 0
+#else
+#define VOODOO_RECOMPILER_DEFAULT 1
+#endif
+
 #ifndef NO_CODEGEN
 void voodoo_codegen_init(voodoo_t *voodoo);
 void voodoo_codegen_close(voodoo_t *voodoo);
@@ -16,37 +25,37 @@ void voodoo_codegen_close(voodoo_t *voodoo);
                         voodoo->fbiZFuncFail++;                                                                                  \
                         goto skip_pixel;                                                                                         \
                 case DEPTHOP_LESSTHAN:                                                                                           \
-                        if (!(comp_depth < old_depth)) {                                                                         \
+                        if (!((comp_depth) < old_depth)) {                                                                       \
                                 voodoo->fbiZFuncFail++;                                                                          \
                                 goto skip_pixel;                                                                                 \
                         }                                                                                                        \
                         break;                                                                                                   \
                 case DEPTHOP_EQUAL:                                                                                              \
-                        if (!(comp_depth == old_depth)) {                                                                        \
+                        if (!((comp_depth) == old_depth)) {                                                                      \
                                 voodoo->fbiZFuncFail++;                                                                          \
                                 goto skip_pixel;                                                                                 \
                         }                                                                                                        \
                         break;                                                                                                   \
                 case DEPTHOP_LESSTHANEQUAL:                                                                                      \
-                        if (!(comp_depth <= old_depth)) {                                                                        \
+                        if (!((comp_depth) <= old_depth)) {                                                                      \
                                 voodoo->fbiZFuncFail++;                                                                          \
                                 goto skip_pixel;                                                                                 \
                         }                                                                                                        \
                         break;                                                                                                   \
                 case DEPTHOP_GREATERTHAN:                                                                                        \
-                        if (!(comp_depth > old_depth)) {                                                                         \
+                        if (!((comp_depth) > old_depth)) {                                                                       \
                                 voodoo->fbiZFuncFail++;                                                                          \
                                 goto skip_pixel;                                                                                 \
                         }                                                                                                        \
                         break;                                                                                                   \
                 case DEPTHOP_NOTEQUAL:                                                                                           \
-                        if (!(comp_depth != old_depth)) {                                                                        \
+                        if (!((comp_depth) != old_depth)) {                                                                      \
                                 voodoo->fbiZFuncFail++;                                                                          \
                                 goto skip_pixel;                                                                                 \
                         }                                                                                                        \
                         break;                                                                                                   \
                 case DEPTHOP_GREATERTHANEQUAL:                                                                                   \
-                        if (!(comp_depth >= old_depth)) {                                                                        \
+                        if (!((comp_depth) >= old_depth)) {                                                                      \
                                 voodoo->fbiZFuncFail++;                                                                          \
                                 goto skip_pixel;                                                                                 \
                         }                                                                                                        \
@@ -210,7 +219,7 @@ void voodoo_codegen_close(voodoo_t *voodoo);
                         newdest_b = (dest_b * (255 - dest_a)) / 255;                                                             \
                         break;                                                                                                   \
                 case AFUNC_ASATURATE:                                                                                            \
-                        _a = MIN(src_a, 1 - dest_a);                                                                             \
+                        _a = MIN(src_a, 255 - dest_a);                                                                           \
                         newdest_r = (dest_r * _a) / 255;                                                                         \
                         newdest_g = (dest_g * _a) / 255;                                                                         \
                         newdest_b = (dest_b * _a) / 255;                                                                         \
@@ -267,39 +276,39 @@ void voodoo_codegen_close(voodoo_t *voodoo);
                 src_b = CLAMP(src_b);                                                                                            \
         } while (0)
 
-void voodoo_render_thread_1(void *param);
-void voodoo_render_thread_2(void *param);
-void voodoo_render_thread_3(void *param);
-void voodoo_render_thread_4(void *param);
+void voodoo_render_init(voodoo_t *voodoo);
+void voodoo_render_close(voodoo_t *voodoo);
 void voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params);
 
 extern int voodoo_recomp;
+extern int voodoo_recomp_hits;
 extern int tris;
 
 static inline void voodoo_wake_render_thread(voodoo_t *voodoo) {
-        thread_set_event(voodoo->wake_render_thread[0]); /*Wake up render thread if moving from idle*/
-        if (voodoo->render_threads >= 2)
-                thread_set_event(voodoo->wake_render_thread[1]); /*Wake up render thread if moving from idle*/
-        if (voodoo->render_threads == 4) {
-                thread_set_event(voodoo->wake_render_thread[2]); /*Wake up render thread if moving from idle*/
-                thread_set_event(voodoo->wake_render_thread[3]); /*Wake up render thread if moving from idle*/
+        int c;
+
+        for (c = 0; c < voodoo->render_threads; c++)
+                thread_set_event(voodoo->wake_render_thread[c]); /*Wake up render thread if moving from idle*/
+}
+
+static inline int voodoo_render_busy(voodoo_t *voodoo) {
+        int c;
+
+        for (c = 0; c < voodoo->render_tiles; c++) {
+                if (!PARAM_EMPTY(c))
+                        return 1;
+        }
+        for (c = 0; c < voodoo->render_threads; c++) {
+                if (voodoo->render_voodoo_busy[c])
+                        return 1;
         }
+        return 0;
 }
 
 static inline void voodoo_wait_for_render_thread_idle(voodoo_t *voodoo) {
-        while (!PARAM_EMPTY(0) || (voodoo->render_threads >= 2 && !PARAM_EMPTY(1)) ||
-               (voodoo->render_threads == 4 && (!PARAM_EMPTY(2) || !PARAM_EMPTY(3))) || voodoo->render_voodoo_busy[0] ||
-               (voodoo->render_threads >= 2 && voodoo->render_voodoo_busy[1]) ||
-               (voodoo->render_threads == 4 && (voodoo->render_voodoo_busy[2] || voodoo->render_voodoo_busy[3]))) {
+        while (voodoo_render_busy(voodoo)) {
                 voodoo_wake_render_thread(voodoo);
-                if (!PARAM_EMPTY(0) || voodoo->render_voodoo_busy[0])
-                        thread_wait_event(voodoo->render_not_full_event[0], 1);
-                if (voodoo->render_threads >= 2 && (!PARAM_EMPTY(1) || voodoo->render_voodoo_busy[1]))
-                        thread_wait_event(voodoo->render_not_full_event[1], 1);
-                if (voodoo->render_threads == 4 && (!PARAM_EMPTY(2) || voodoo->render_voodoo_busy[2]))
-                        thread_wait_event(voodoo->render_not_full_event[2], 1);
-                if (voodoo->render_threads == 4 && (!PARAM_EMPTY(3) || voodoo->render_voodoo_busy[3]))
-                        thread_wait_event(voodoo->render_not_full_event[3], 1);
+                thread_wait_event(voodoo->render_not_full_event, 1);
         }
 }
 
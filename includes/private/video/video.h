@@ -78,6 +78,39 @@ extern int vid_resize;
 void video_wait_for_blit();
 void video_wait_for_buffer();
 
+/*Video pipeline statistics, accumulated over one second then latched by
+  video_stats_latch() with the other per-second counters. Times are in
+  timer_read() ticks. VRAM access time is measured on one call in
+  VIDEO_STATS_SAMPLE and scaled up.
+
+  video_stats is only written on the emulation thread. The host renderer
+  runs on its own thread, so it counts through video_stats_add_update() and
+  video_stats_add_present(), and the status window takes a copy of the
+  latched figures with video_stats_get(). Those go through a lock*/
+typedef struct video_stats_t {
+        uint64_t render_time;      /*SVGA line rendering in svga_poll()*/
+        uint64_t vram_read_time;   /*svga_read*()*/
+        uint64_t vram_write_time;  /*svga_write*()*/
+        uint64_t blit_wait_time;   /*video_wait_for_blit()*/
+        uint64_t buffer_wait_time; /*video_wait_for_buffer()*/
+        uint64_t update_time;      /*Host renderer texture update*/
+        uint64_t present_time;     /*Host renderer present*/
+
+        int render_lines;
+        int vram_reads, vram_writes;
+        int blits;
+        int presents;
+} video_stats_t;
+
+#define VIDEO_STATS_SAMPLE 64
+
+extern video_stats_t video_stats;
+
+void video_stats_latch();
+void video_stats_get(video_stats_t *stats);
+void video_stats_add_update(uint64_t time);
+void video_stats_add_present(uint64_t time);
+
 typedef enum {
         FONT_MDA,      /* MDA 8x14 */
         FONT_PC200,    /* MDA 8x14 and CGA 8x8, four fonts */
@@ -17,6 +17,10 @@
 #include "dosbox/nukedopl.h"
 
 #define RSM_FRAC    10
+#define OPL3_BLOCK_LEN 256
+
+// OPL3_REFERENCE_PATH builds the core without the envelope-off fast path and
+// block generation, as the per-sample reference for nukedopl-test.
 
 // Channel types
 
@@ -296,6 +300,24 @@ static Bit16s OPL3_EnvelopeCalcSin7(Bit16u phase, Bit16u envelope) {
 	return OPL3_EnvelopeCalcExp(out + (envelope << 3)) ^ neg;
 }
 
+#ifndef OPL3_REFERENCE_PATH
+// A slot whose envelope is off is fully attenuated, so the exp lookup always
+// returns zero and only the sign of the waveform remains.
+static Bit16s OPL3_EnvelopeCalcSign(Bit8u wf, Bit16u phase) {
+	phase &= 0x3ff;
+	switch (wf) {
+	case 0:
+	case 6:
+	case 7:
+		return (phase & 0x200) ? ~0 : 0;
+	case 4:
+		return ((phase & 0x300) == 0x100) ? ~0 : 0;
+	default:
+		return 0;
+	}
+}
+#endif
+
 static const envelope_sinfunc envelope_sin[8] = {
 	OPL3_EnvelopeCalcSin0,
 	OPL3_EnvelopeCalcSin1,
@@ -538,6 +560,12 @@ static void OPL3_SlotWriteE0(opl3_slot *slot, Bit8u data) {
 }
 
 static void OPL3_SlotGeneratePhase(opl3_slot *slot, Bit16u phase) {
+#ifndef OPL3_REFERENCE_PATH
+	if (slot->eg_gen == envelope_gen_num_off) {
+		slot->out = OPL3_EnvelopeCalcSign(slot->reg_wf, phase);
+		return;
+	}
+#endif
 	slot->out = envelope_sin[slot->reg_wf](phase, slot->eg_out);
 }
 
@@ -558,6 +586,22 @@ static void OPL3_SlotCalcFB(opl3_slot *slot) {
 	slot->prout = slot->out;
 }
 
+// Feedback, phase and envelope for one sample. Slots with the envelope off
+// stay off until the next key on, which always happens between samples, and
+// OPL3_SlotGeneratePhase() does not use the envelope level for them, so the
+// envelope step is skipped.
+static void OPL3_SlotCalc(opl3_slot *slot) {
+	OPL3_SlotCalcFB(slot);
+	OPL3_PhaseGenerate(slot);
+#ifndef OPL3_REFERENCE_PATH
+	if (slot->eg_gen != envelope_gen_num_off) {
+		OPL3_EnvelopeCalc(slot);
+	}
+#else
+	OPL3_EnvelopeCalc(slot);
+#endif
+}
+
 //
 // Channel
 //
@@ -905,16 +949,12 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf) {
 	buf[1] = OPL3_ClipSample(chip->mixbuff[1]);
 
 	for (ii = 0; ii < 12; ii++) {
-		OPL3_SlotCalcFB(&chip->slot[ii]);
-		OPL3_PhaseGenerate(&chip->slot[ii]);
-		OPL3_EnvelopeCalc(&chip->slot[ii]);
+		OPL3_SlotCalc(&chip->slot[ii]);
 		OPL3_SlotGenerate(&chip->slot[ii]);
 	}
 
 	for (ii = 12; ii < 15; ii++) {
-		OPL3_SlotCalcFB(&chip->slot[ii]);
-		OPL3_PhaseGenerate(&chip->slot[ii]);
-		OPL3_EnvelopeCalc(&chip->slot[ii]);
+		OPL3_SlotCalc(&chip->slot[ii]);
 	}
 
 	if (chip->rhy & 0x20) {
@@ -935,9 +975,7 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf) {
 	}
 
 	for (ii = 15; ii < 18; ii++) {
-		OPL3_SlotCalcFB(&chip->slot[ii]);
-		OPL3_PhaseGenerate(&chip->slot[ii]);
-		OPL3_EnvelopeCalc(&chip->slot[ii]);
+		OPL3_SlotCalc(&chip->slot[ii]);
 	}
 
 	if (chip->rhy & 0x20) {
@@ -951,9 +989,7 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf) {
 	buf[0] = OPL3_ClipSample(chip->mixbuff[0]);
 
 	for (ii = 18; ii < 33; ii++) {
-		OPL3_SlotCalcFB(&chip->slot[ii]);
-		OPL3_PhaseGenerate(&chip->slot[ii]);
-		OPL3_EnvelopeCalc(&chip->slot[ii]);
+		OPL3_SlotCalc(&chip->slot[ii]);
 		OPL3_SlotGenerate(&chip->slot[ii]);
 	}
 
@@ -967,9 +1003,7 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf) {
 	}
 
 	for (ii = 33; ii < 36; ii++) {
-		OPL3_SlotCalcFB(&chip->slot[ii]);
-		OPL3_PhaseGenerate(&chip->slot[ii]);
-		OPL3_EnvelopeCalc(&chip->slot[ii]);
+		OPL3_SlotCalc(&chip->slot[ii]);
 		OPL3_SlotGenerate(&chip->slot[ii]);
 	}
 
@@ -991,6 +1025,15 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf) {
 	chip->timer++;
 }
 
+void OPL3_GenerateBlock(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples) {
+	Bit32u i;
+
+	for (i = 0; i < numsamples; i++) {
+		OPL3_Generate(chip, sndptr);
+		sndptr += 2;
+	}
+}
+
 void OPL3_GenerateResampled(opl3_chip *chip, Bit16s *buf) {
 	while (chip->samplecnt >= chip->rateratio) {
 		chip->oldsamples[0] = chip->samples[0];
@@ -1129,11 +1172,58 @@ void OPL3_WriteReg(opl3_chip *chip, Bit16u reg, Bit8u v) {
 	}
 }
 
+// Same output as calling OPL3_GenerateResampled() for each sample. Chip
+// samples are generated a block at a time and then interpolated, rather than
+// one at a time as the resampler asks for them.
 void OPL3_GenerateStream(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples) {
+#ifdef OPL3_REFERENCE_PATH
 	Bit32u i;
 
 	for (i = 0; i < numsamples; i++) {
 		OPL3_GenerateResampled(chip, sndptr);
 		sndptr += 2;
 	}
+#else
+	Bit16s native[OPL3_BLOCK_LEN * 2];
+	Bit16s *nptr;
+	Bit32u i, len, count, step;
+	Bit32s samplecnt;
+
+	while (numsamples) {
+		// Find how many output samples the block can cover
+		samplecnt = chip->samplecnt;
+		count = 0;
+		for (len = 0; len < numsamples; len++) {
+			for (step = 0; samplecnt >= chip->rateratio; step++) {
+				samplecnt -= chip->rateratio;
+			}
+			if (count + step > OPL3_BLOCK_LEN) {
+				break;
+			}
+			count += step;
+			samplecnt += 1 << RSM_FRAC;
+		}
+
+		OPL3_GenerateBlock(chip, native, count);
+
+		nptr = native;
+		for (i = 0; i < len; i++) {
+			while (chip->samplecnt >= chip->rateratio) {
+				chip->oldsamples[0] = chip->samples[0];
+				chip->oldsamples[1] = chip->samples[1];
+				chip->samples[0] = nptr[0];
+				chip->samples[1] = nptr[1];
+				nptr += 2;
+				chip->samplecnt -= chip->rateratio;
+			}
+			sndptr[0] = (Bit16s)((chip->oldsamples[0] * (chip->rateratio - chip->samplecnt)
+				+ chip->samples[0] * chip->samplecnt) / chip->rateratio);
+			sndptr[1] = (Bit16s)((chip->oldsamples[1] * (chip->rateratio - chip->samplecnt)
+				+ chip->samples[1] * chip->samplecnt) / chip->rateratio);
+			chip->samplecnt += 1 << RSM_FRAC;
+			sndptr += 2;
+		}
+		numsamples -= len;
+	}
+#endif
 }
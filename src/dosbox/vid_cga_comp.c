@@ -4,6 +4,11 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "ibm.h"
 #include "device.h"
@@ -54,6 +59,17 @@ int tandy_mode_control = 0;
 
 static bool new_cga = 0;
 
+/*Integer decode coefficients, indexed by output phase. The I/Q rotation for each
+  of the four pixel phases is folded in, so that a pixel decodes as
+  y + ca[phase] * a + cb[phase] * b, with a and b the chroma filter outputs*/
+static int comp_ca[3][4], comp_cb[3][4];
+#if defined(__SSE2__)
+/*The same coefficients as 16-bit pairs for _mm_madd_epi16 : luma (c, d), then
+  red/green/blue (a, b) for phases 0-3. Only valid when comp_madd_ok is set*/
+static int16_t comp_madd[4][8];
+static int comp_madd_ok;
+#endif
+
 FILE *df;
 
 void update_cga16_color(uint8_t cgamode) {
@@ -128,6 +144,43 @@ void update_cga16_color(uint8_t cgamode) {
         video_bi = (int)(bi * iq_adjust_i + bq * iq_adjust_q);
         video_bq = (int)(-bi * iq_adjust_q + bq * iq_adjust_i);
         video_sharpness = (int)(sharpness * 256 / 100);
+
+        int coef_i[3] = {(int)video_ri, (int)video_gi, (int)video_bi};
+        int coef_q[3] = {(int)video_rq, (int)video_gq, (int)video_bq};
+        for (x = 0; x < 3; x++) {
+                /*Phase 0 : I = a, Q = b. Phase 1 : I = -b, Q = a. Phase 2 : I = -a, Q = -b. Phase 3 : I = b, Q = -a*/
+                comp_ca[x][0] = coef_i[x];
+                comp_cb[x][0] = coef_q[x];
+                comp_ca[x][1] = coef_q[x];
+                comp_cb[x][1] = -coef_i[x];
+                comp_ca[x][2] = -coef_i[x];
+                comp_cb[x][2] = -coef_q[x];
+                comp_ca[x][3] = -coef_q[x];
+                comp_cb[x][3] = coef_i[x];
+        }
+
+#if defined(__SSE2__)
+        /*The 16-bit kernel is exact as long as every filter output fits in 16 bits. Luma
+          inputs are bounded by 32x the largest table entry, chroma inputs by 8x*/
+        int max_t = 0;
+        for (x = 0; x < 1024; x++) {
+                if (abs(CGA_Composite_Table[x]) > max_t)
+                        max_t = abs(CGA_Composite_Table[x]);
+        }
+        comp_madd_ok = (max_t < 1024) && abs(256 + video_sharpness) < 32768 && abs(256 - video_sharpness) < 32768;
+        for (x = 0; x < 4; x++) {
+                int c;
+
+                comp_madd[0][x * 2] = 256 + video_sharpness;
+                comp_madd[0][x * 2 + 1] = 256 - video_sharpness;
+                for (c = 0; c < 3; c++) {
+                        if (abs(comp_ca[c][x]) >= 32768 || abs(comp_cb[c][x]) >= 32768)
+                                comp_madd_ok = 0;
+                        comp_madd[c + 1][x * 2] = comp_ca[c][x];
+                        comp_madd[c + 1][x * 2 + 1] = comp_cb[c][x];
+                }
+        }
+#endif
 }
 
 static Bit8u byte_clamp(int v) {
@@ -142,30 +195,74 @@ static int temp[SCALER_MAXWIDTH + 10] = {0};
 static int atemp[SCALER_MAXWIDTH + 2] = {0};
 static int btemp[SCALER_MAXWIDTH + 2] = {0};
 
+#if defined(__SSE2__)
+static void composite_decode_sse2(Bit32u *srgb, const int *i, const int *ap, const int *bp, int w) {
+        const __m128i ky = _mm_loadu_si128((const __m128i *)comp_madd[0]);
+        const __m128i kr = _mm_loadu_si128((const __m128i *)comp_madd[1]);
+        const __m128i kg = _mm_loadu_si128((const __m128i *)comp_madd[2]);
+        const __m128i kb = _mm_loadu_si128((const __m128i *)comp_madd[3]);
+        int x;
+
+        for (x = 0; x < w; x += 4) {
+                __m128i p = _mm_loadu_si128((const __m128i *)&i[x]);
+                __m128i p_l = _mm_loadu_si128((const __m128i *)&i[x - 1]);
+                __m128i p_r = _mm_loadu_si128((const __m128i *)&i[x + 1]);
+                __m128i a = _mm_loadu_si128((const __m128i *)&ap[x]);
+                __m128i b = _mm_loadu_si128((const __m128i *)&bp[x]);
+                __m128i c = _mm_add_epi32(p, p);
+                __m128i d = _mm_add_epi32(p_l, p_r);
+                __m128i cd = _mm_unpacklo_epi16(_mm_packs_epi32(c, c), _mm_packs_epi32(d, d));
+                __m128i ab = _mm_unpacklo_epi16(_mm_packs_epi32(a, a), _mm_packs_epi32(b, b));
+                __m128i y = _mm_madd_epi16(cd, ky);
+                __m128i rr = _mm_srai_epi32(_mm_add_epi32(y, _mm_madd_epi16(ab, kr)), 13);
+                __m128i gg = _mm_srai_epi32(_mm_add_epi32(y, _mm_madd_epi16(ab, kg)), 13);
+                __m128i bb = _mm_srai_epi32(_mm_add_epi32(y, _mm_madd_epi16(ab, kb)), 13);
+                /*Saturating packs clamp to 0-255, giving B0-3 G0-3 R0-3 0000*/
+                __m128i px = _mm_packus_epi16(_mm_packs_epi32(bb, gg), _mm_packs_epi32(rr, _mm_setzero_si128()));
+
+                /*Transpose to B G R 0 per pixel*/
+                px = _mm_unpacklo_epi8(px, _mm_srli_si128(px, 8));
+                px = _mm_unpacklo_epi8(px, _mm_srli_si128(px, 8));
+                _mm_storeu_si128((__m128i *)&srgb[x], px);
+        }
+}
+#elif defined(__ARM_NEON)
+static void composite_decode_neon(Bit32u *srgb, const int *i, const int *ap, const int *bp, int w) {
+        const int32x4_t ca_r = vld1q_s32(comp_ca[0]), cb_r = vld1q_s32(comp_cb[0]);
+        const int32x4_t ca_g = vld1q_s32(comp_ca[1]), cb_g = vld1q_s32(comp_cb[1]);
+        const int32x4_t ca_b = vld1q_s32(comp_ca[2]), cb_b = vld1q_s32(comp_cb[2]);
+        const int32x4_t zero = vdupq_n_s32(0);
+        const int32x4_t max = vdupq_n_s32(255);
+        int x;
+
+        for (x = 0; x < w; x += 4) {
+                int32x4_t p = vld1q_s32(&i[x]);
+                int32x4_t a = vld1q_s32(&ap[x]);
+                int32x4_t b = vld1q_s32(&bp[x]);
+                int32x4_t c = vaddq_s32(p, p);
+                int32x4_t d = vaddq_s32(vld1q_s32(&i[x - 1]), vld1q_s32(&i[x + 1]));
+                int32x4_t y = vmlaq_n_s32(vshlq_n_s32(vaddq_s32(c, d), 8), vsubq_s32(c, d), video_sharpness);
+                int32x4_t rr = vshrq_n_s32(vmlaq_s32(vmlaq_s32(y, a, ca_r), b, cb_r), 13);
+                int32x4_t gg = vshrq_n_s32(vmlaq_s32(vmlaq_s32(y, a, ca_g), b, cb_g), 13);
+                int32x4_t bb = vshrq_n_s32(vmlaq_s32(vmlaq_s32(y, a, ca_b), b, cb_b), 13);
+                uint32x4_t px;
+
+                rr = vmaxq_s32(vminq_s32(rr, max), zero);
+                gg = vmaxq_s32(vminq_s32(gg, max), zero);
+                bb = vmaxq_s32(vminq_s32(bb, max), zero);
+                px = vorrq_u32(vshlq_n_u32(vreinterpretq_u32_s32(rr), 16), vshlq_n_u32(vreinterpretq_u32_s32(gg), 8));
+                px = vorrq_u32(px, vreinterpretq_u32_s32(bb));
+                vst1q_u32(&srgb[x], px);
+        }
+}
+#endif
+
 Bit8u *Composite_Process(uint8_t cgamode, Bit8u border, Bit32u blocks /*, bool doublewidth*/, Bit8u *TempLine) {
         int x;
         Bit32u x2;
 
         int w = blocks * 4;
 
-#define COMPOSITE_CONVERT(I, Q)                                                                                                  \
-        do {                                                                                                                     \
-                i[1] = (i[1] << 3) - ap[1];                                                                                      \
-                a = ap[0];                                                                                                       \
-                b = bp[0];                                                                                                       \
-                c = i[0] + i[0];                                                                                                 \
-                d = i[-1] + i[1];                                                                                                \
-                y = ((c + d) << 8) + video_sharpness * (c - d);                                                                  \
-                rr = y + video_ri * (I) + video_rq * (Q);                                                                        \
-                gg = y + video_gi * (I) + video_gq * (Q);                                                                        \
-                bb = y + video_bi * (I) + video_bq * (Q);                                                                        \
-                ++i;                                                                                                             \
-                ++ap;                                                                                                            \
-                ++bp;                                                                                                            \
-                *srgb = (byte_clamp(rr) << 16) | (byte_clamp(gg) << 8) | byte_clamp(bb);                                         \
-                ++srgb;                                                                                                          \
-        } while (0)
-
 #define OUT(v)                                                                                                                   \
         do {                                                                                                                     \
                 *o = (v);                                                                                                        \
@@ -212,18 +309,31 @@ Bit8u *Composite_Process(uint8_t cgamode, Bit8u border, Bit32u blocks /*, bool d
 
                 // Decode
                 i = temp + 5;
-                i[-1] = (i[-1] << 3) - ap[-1];
-                i[0] = (i[0] << 3) - ap[0];
+                for (x = -1; x < w + 1; ++x)
+                        i[x] = (i[x] << 3) - ap[x];
                 Bit32u *srgb = (Bit32u *)TempLine;
-                for (x2 = 0; x2 < blocks; ++x2) {
-                        int y, a, b, c, d, rr, gg, bb;
-                        COMPOSITE_CONVERT(a, b);
-                        COMPOSITE_CONVERT(-b, a);
-                        COMPOSITE_CONVERT(-a, -b);
-                        COMPOSITE_CONVERT(b, -a);
+#if defined(__SSE2__)
+                if (comp_madd_ok) {
+                        composite_decode_sse2(srgb, i, ap, bp, w);
+                        return TempLine;
+                }
+#elif defined(__ARM_NEON)
+                composite_decode_neon(srgb, i, ap, bp, w);
+                return TempLine;
+#endif
+                for (x = 0; x < w; ++x) {
+                        int phase = x & 3;
+                        int c = i[x] + i[x];
+                        int d = i[x - 1] + i[x + 1];
+                        int y = ((c + d) << 8) + video_sharpness * (c - d);
+                        int rr = y + comp_ca[0][phase] * ap[x] + comp_cb[0][phase] * bp[x];
+                        int gg = y + comp_ca[1][phase] * ap[x] + comp_cb[1][phase] * bp[x];
+                        int bb = y + comp_ca[2][phase] * ap[x] + comp_cb[2][phase] * bp[x];
+
+                        *srgb = (byte_clamp(rr) << 16) | (byte_clamp(gg) << 8) | byte_clamp(bb);
+                        ++srgb;
                 }
         }
-#undef COMPOSITE_CONVERT
 #undef OUT
 
         return TempLine;
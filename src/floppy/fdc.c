@@ -72,6 +72,10 @@ typedef struct FDC {
         int fifobufpos;
         uint8_t fifobuf[16];
 
+        /*DMA transfers are made a FIFO threshold at a time, as the real controller does*/
+        uint16_t dma_buf[16];
+        int dma_buf_pos, dma_buf_len, dma_buf_over;
+
         int int_pending;
 
         pc_timer_t timer;
@@ -88,6 +92,17 @@ int discmodified[2];
 int discrate[2];
 
 int discint;
+
+static void fdc_dma_reset() { fdc.dma_buf_pos = fdc.dma_buf_len = fdc.dma_buf_over = 0; }
+
+/*Write out bytes gathered by fdc_data(). A channel that reaches terminal count, or takes nothing at all
+  (masked or misprogrammed, where dma_channel_write() returned DMA_NODATA), ends the command as before*/
+static void fdc_dma_flush() {
+        if (fdc.dma_buf_len && (dma_channel_write_block(2, fdc.dma_buf, fdc.dma_buf_len) & DMA_OVER))
+                fdc.tc = 1;
+        fdc.dma_buf_len = 0;
+}
+
 void fdc_reset() {
         fdc.stat = 0x80;
         fdc.pnum = fdc.ptot = 0;
@@ -95,6 +110,7 @@ void fdc_reset() {
         fdc.lock = 0;
         fdc.head = 0;
         fdc.abort = 0;
+        fdc_dma_reset();
         if (!AT && romset != ROM_XI8088 && romset != ROM_PC5086) {
                 fdc.rate = 2;
                 // fdc_update_rate();
@@ -342,6 +358,7 @@ void fdc_write(uint16_t addr, uint8_t val, void *priv) {
                 if (fdc.pnum == fdc.ptot) {
                         fdc.tc = 0;
                         fdc.data_ready = 0;
+                        fdc_dma_reset();
 
                         fdc.command = val;
                         //                        pclog("Starting FDC command %02X\n",fdc.command);
@@ -1074,8 +1091,9 @@ int fdc_data(uint8_t data) {
                         }
                 }
         } else {
-                if (dma_channel_write(2, data) & DMA_OVER)
-                        fdc.tc = 1;
+                fdc.dma_buf[fdc.dma_buf_len++] = data;
+                if (fdc.dma_buf_len >= (fdc.fifo ? fdc.tfifo : 1))
+                        fdc_dma_flush();
 
                 if (!fdc.fifo) {
                         fdc.data_ready = 1;
@@ -1094,6 +1112,7 @@ int fdc_data(uint8_t data) {
 }
 
 void fdc_finishread() {
+        fdc_dma_flush();
         fdc.inread = 0;
         timer_set_delay_u64(&fdc.timer, 200 * TIMER_USEC);
         //        rpclog("fdc_finishread\n");
@@ -1133,6 +1152,7 @@ void fdc_notfound(int reason) {
 }
 
 void fdc_datacrcerror() {
+        fdc_dma_flush();
         timer_disable(&fdc.timer);
 
         fdc_int();
@@ -1200,7 +1220,16 @@ int fdc_getdata(int last) {
                                 fdc.stat = 0xb0;
                 }
         } else {
-                data = dma_channel_read(2);
+                if (fdc.dma_buf_pos == fdc.dma_buf_len) {
+                        int len = dma_channel_read_block(2, fdc.dma_buf, fdc.fifo ? fdc.tfifo : 1);
+
+                        /*DMA_NODATA has DMA_OVER set, so a channel that gives nothing ends the command, as
+                          it did when each byte was read with dma_channel_read()*/
+                        fdc.dma_buf_over = len & DMA_OVER;
+                        fdc.dma_buf_len = (len == DMA_NODATA) ? 0 : (len & ~DMA_OVER);
+                        fdc.dma_buf_pos = 0;
+                }
+                data = (fdc.dma_buf_pos < fdc.dma_buf_len) ? fdc.dma_buf[fdc.dma_buf_pos++] : 0xff;
 
                 if (!fdc.fifo) {
                         if (!last)
@@ -1212,7 +1241,8 @@ int fdc_getdata(int last) {
                                 fdc.stat = 0x90;
                 }
 
-                if (data & DMA_OVER)
+                /*Terminal count is seen with the last byte before it*/
+                if (fdc.dma_buf_over && fdc.dma_buf_pos == fdc.dma_buf_len)
                         fdc.tc = 1;
         }
 
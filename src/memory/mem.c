@@ -210,6 +210,22 @@ void mem_flush_write_page(uint32_t addr, uint32_t virt) {
         }
 }
 
+/*Remove any write mappings added by addwritelookup_ptr() that point into the given block*/
+void mem_flush_write_ptr_range(uint8_t *p, uint32_t size) {
+        int c;
+
+        for (c = 0; c < 256; c++) {
+                if (writelookup[c] != 0xffffffff && writelookup2[writelookup[c]] != -1) {
+                        uintptr_t host = writelookup2[writelookup[c]] + (uintptr_t)((uint32_t)writelookup[c] << 12);
+
+                        if (host >= (uintptr_t)p && host < (uintptr_t)p + size) {
+                                writelookup2[writelookup[c]] = -1;
+                                writelookup[c] = 0xffffffff;
+                        }
+                }
+        }
+}
+
 #define mmutranslate_read(addr) mmutranslatereal(addr, 0)
 #define mmutranslate_write(addr) mmutranslatereal(addr, 1)
 
@@ -417,6 +433,29 @@ void addwritelookup(uint32_t virt, uint32_t phys) {
         cycles -= 9;
 }
 
+/*Map a logical page straight to a 4kb block of host memory outside of RAM, so writes to it no
+  longer go through the mapping's write handlers. Used for linear framebuffers - the owner must
+  remove the mapping with mem_flush_write_ptr_range() once it needs to see writes again*/
+void addwritelookup_ptr(uint32_t virt, uint8_t *p) {
+        if (virt == 0xffffffff)
+                return;
+
+        if (page_lookup[virt >> 12] || writelookup2[virt >> 12] != -1)
+                return;
+
+        if (writelookup[writelnext] != -1) {
+                page_lookup[writelookup[writelnext]] = NULL;
+                writelookup2[writelookup[writelnext]] = -1;
+        }
+
+        writelookup2[virt >> 12] = (uintptr_t)p - (uintptr_t)(virt & ~0xfff);
+        writelookupp[writelnext] = mmu_perm;
+        writelookup[writelnext++] = virt >> 12;
+        writelnext &= (cachesize - 1);
+
+        cycles -= 9;
+}
+
 uint8_t *getpccache(uint32_t a) {
         uint32_t a2 = a;
 
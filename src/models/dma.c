@@ -36,6 +36,46 @@ static struct {
 
 static void dma_ps2_run(int channel);
 
+/*Devices that consume DMA ahead of time rather than a transfer at a time register here, to be brought up
+  to date before the guest looks at or reprograms the controller*/
+#define DMA_MAX_SYNC 4
+
+static struct {
+        void (*sync)(void *p);
+        void *p;
+} dma_sync_handlers[DMA_MAX_SYNC];
+
+void dma_add_sync_handler(void (*sync)(void *p), void *p) {
+        int c;
+
+        for (c = 0; c < DMA_MAX_SYNC; c++) {
+                if (!dma_sync_handlers[c].sync) {
+                        dma_sync_handlers[c].sync = sync;
+                        dma_sync_handlers[c].p = p;
+                        return;
+                }
+        }
+        fatal("dma_add_sync_handler - no free slots\n");
+}
+
+void dma_remove_sync_handler(void (*sync)(void *p), void *p) {
+        int c;
+
+        for (c = 0; c < DMA_MAX_SYNC; c++) {
+                if (dma_sync_handlers[c].sync == sync && dma_sync_handlers[c].p == p)
+                        dma_sync_handlers[c].sync = NULL;
+        }
+}
+
+static void dma_sync() {
+        int c;
+
+        for (c = 0; c < DMA_MAX_SYNC; c++) {
+                if (dma_sync_handlers[c].sync)
+                        dma_sync_handlers[c].sync(dma_sync_handlers[c].p);
+        }
+}
+
 void dma_reset() {
         int c;
 
@@ -57,6 +97,8 @@ void dma_reset() {
 uint8_t dma_read(uint16_t addr, void *priv) {
         int channel = (addr >> 1) & 3;
         uint8_t temp;
+
+        dma_sync();
         //        printf("Read DMA %04X %04X:%04X %i %02X\n",addr,CS,pc, pic_intpending, pic.pend);
         switch (addr & 0xf) {
         case 0:
@@ -93,6 +135,8 @@ uint8_t dma_read(uint16_t addr, void *priv) {
 
 void dma_write(uint16_t addr, uint8_t val, void *priv) {
         int channel = (addr >> 1) & 3;
+
+        dma_sync();
         //        printf("Write DMA %04X %02X %04X:%04X\n",addr,val,CS,pc);
         dmaregs[addr & 0xf] = val;
         switch (addr & 0xf) {
@@ -165,6 +209,7 @@ static uint8_t dma_ps2_read(uint16_t addr, void *priv) {
         dma_t *dma_c = &dma[dma_ps2.xfr_channel];
         uint8_t temp = 0xff;
 
+        dma_sync();
         switch (addr) {
         case 0x1a:
                 switch (dma_ps2.xfr_command) {
@@ -227,6 +272,7 @@ static void dma_ps2_write(uint16_t addr, uint8_t val, void *priv) {
         dma_t *dma_c = &dma[dma_ps2.xfr_channel];
         uint8_t mode;
 
+        dma_sync();
         //        pclog("Write PS2 DMA %04X %02X %04X:%04X\n",addr,val,CS,cpu_state.pc);
 
         switch (addr) {
@@ -313,6 +359,8 @@ static void dma_ps2_write(uint16_t addr, uint8_t val, void *priv) {
 uint8_t dma16_read(uint16_t addr, void *priv) {
         int channel = ((addr >> 2) & 3) + 4;
         uint8_t temp;
+
+        dma_sync();
         //        printf("Read DMA %04X %04X:%04X\n",addr,cs>>4,pc);
         addr >>= 1;
         switch (addr & 0xf) {
@@ -351,6 +399,8 @@ uint8_t dma16_read(uint16_t addr, void *priv) {
 
 void dma16_write(uint16_t addr, uint8_t val, void *priv) {
         int channel = ((addr >> 2) & 3) + 4;
+
+        dma_sync();
         //        printf("Write dma16 %04X %02X %04X:%04X\n",addr,val,CS,pc);
         addr >>= 1;
         dma16regs[addr & 0xf] = val;
@@ -426,6 +476,7 @@ void dma16_write(uint16_t addr, uint8_t val, void *priv) {
 }
 
 void dma_page_write(uint16_t addr, uint8_t val, void *priv) {
+        dma_sync();
         dmapages[addr & 0xf] = val;
         switch (addr & 0xf) {
         case 1:
@@ -495,30 +546,9 @@ void _dma_write(uint32_t addr, uint8_t val) {
         mem_invalidate_range(addr, addr);
 }
 
-int dma_channel_read(int channel) {
-        dma_t *dma_c = &dma[channel];
-        uint16_t temp;
-        int tc = 0;
-
-        if (channel < 4) {
-                if (dma_command & 0x04)
-                        return DMA_NODATA;
-        } else {
-                if (dma16_command & 0x04)
-                        return DMA_NODATA;
-        }
-
-        if (!AT)
-                refreshread();
-
-        if (dma_m & (1 << channel))
-                return DMA_NODATA;
-        if ((dma_c->mode & 0xC) != 8)
-                return DMA_NODATA;
-
+/*Step the channel's address by one transfer*/
+static inline void dma_channel_step(dma_t *dma_c) {
         if (!dma_c->size) {
-                temp = _dma_read(dma_c->ac);
-
                 if (dma_c->mode & 0x20) {
                         if (dma_ps2.is_ps2)
                                 dma_c->ac--;
@@ -531,8 +561,6 @@ int dma_channel_read(int channel) {
                                 dma_c->ac = (dma_c->ac & 0xff0000) | ((dma_c->ac + 1) & 0xffff);
                 }
         } else {
-                temp = _dma_read(dma_c->ac) | (_dma_read(dma_c->ac + 1) << 8);
-
                 if (dma_c->mode & 0x20) {
                         if (dma_ps2.is_ps2)
                                 dma_c->ac -= 2;
@@ -545,12 +573,17 @@ int dma_channel_read(int channel) {
                                 dma_c->ac = (dma_c->ac & 0xfe0000) | ((dma_c->ac + 2) & 0x1ffff);
                 }
         }
+}
+
+/*Count off len transfers. Returns 1 if the channel reached terminal count, in which case it has been
+  reloaded (auto-init) or masked*/
+static inline int dma_channel_count(int channel, int len) {
+        dma_t *dma_c = &dma[channel];
 
         dma_stat_rq |= (1 << channel);
 
-        dma_c->cc--;
+        dma_c->cc -= len;
         if (dma_c->cc < 0) {
-                tc = 1;
                 if (dma_c->mode & 0x10) /*Auto-init*/
                 {
                         dma_c->cc = dma_c->cb;
@@ -558,24 +591,124 @@ int dma_channel_read(int channel) {
                 } else
                         dma_m |= (1 << channel);
                 dma_stat |= (1 << channel);
+                return 1;
         }
+        return 0;
+}
+
+/*Number of transfers, up to len, the channel can make before its address wraps within the 64k block
+  (128k for 16-bit channels) or it reaches terminal count. The address moves linearly over such a run*/
+static inline int dma_channel_run_len(dma_t *dma_c, int len) {
+        int to_tc = (dma_c->cc < 0) ? 1 : dma_c->cc + 1;
+
+        if (len > to_tc)
+                len = to_tc;
+
+        if (!dma_ps2.is_ps2) {
+                uint32_t mask = dma_c->size ? 0x1ffff : 0xffff;
+                uint32_t offset = dma_c->ac & mask;
+                int to_wrap;
+
+                if (dma_c->mode & 0x20)
+                        to_wrap = (offset >> dma_c->size) + 1;
+                else
+                        to_wrap = (mask + 1 - offset + dma_c->size) >> dma_c->size;
+                if (len > to_wrap)
+                        len = to_wrap;
+        }
+
+        return len;
+}
+
+/*Set the address after a run of len transfers*/
+static inline void dma_channel_run_step(dma_t *dma_c, uint32_t addr) {
+        if (dma_ps2.is_ps2)
+                dma_c->ac = addr;
+        else if (!dma_c->size)
+                dma_c->ac = (dma_c->ac & 0xff0000) | (addr & 0xffff);
+        else
+                dma_c->ac = (dma_c->ac & 0xfe0000) | (addr & 0x1ffff);
+}
+
+static inline int dma_channel_disabled(int channel) {
+        if (channel < 4)
+                return dma_command & 0x04;
+        return dma16_command & 0x04;
+}
+
+int dma_channel_read(int channel) {
+        dma_t *dma_c = &dma[channel];
+        uint16_t temp;
+
+        if (dma_channel_disabled(channel))
+                return DMA_NODATA;
+
+        if (!AT)
+                refreshread();
+
+        if (dma_m & (1 << channel))
+                return DMA_NODATA;
+        if ((dma_c->mode & 0xC) != 8)
+                return DMA_NODATA;
+
+        if (!dma_c->size)
+                temp = _dma_read(dma_c->ac);
+        else
+                temp = _dma_read(dma_c->ac) | (_dma_read(dma_c->ac + 1) << 8);
+        dma_channel_step(dma_c);
 
-        if (tc)
+        if (dma_channel_count(channel, 1))
                 return temp | DMA_OVER;
         return temp;
 }
 
-int dma_channel_write(int channel, uint16_t val) {
+/*Read up to len transfers into buf, as repeated dma_channel_read() calls would, stopping where one would
+  return DMA_NODATA (eg the channel masking itself at terminal count in single cycle mode). Memory is read
+  a run at a time, up to the next address wrap or terminal count. Returns the number of transfers read,
+  with DMA_OVER set if terminal count was reached, so len must be less than DMA_OVER. If the channel
+  refuses the first transfer, returns DMA_NODATA as dma_channel_read() would*/
+int dma_channel_read_block(int channel, uint16_t *buf, int len) {
         dma_t *dma_c = &dma[channel];
+        int c = 0, over = 0;
 
-        if (channel < 4) {
-                if (dma_command & 0x04)
-                        return DMA_NODATA;
-        } else {
-                if (dma16_command & 0x04)
-                        return DMA_NODATA;
+        if (dma_channel_disabled(channel))
+                return DMA_NODATA;
+        if ((dma_c->mode & 0xC) != 8 || (dma_m & (1 << channel)))
+                return DMA_NODATA;
+
+        while (c < len && !(dma_m & (1 << channel))) {
+                int run = dma_channel_run_len(dma_c, len - c);
+                int step = (dma_c->mode & 0x20) ? -(1 << dma_c->size) : (1 << dma_c->size);
+                uint32_t addr = dma_c->ac;
+                int d;
+
+                if (!dma_c->size) {
+                        for (d = 0; d < run; d++, addr += step)
+                                buf[c + d] = _dma_read(addr);
+                } else {
+                        for (d = 0; d < run; d++, addr += step)
+                                buf[c + d] = _dma_read(addr) | (_dma_read(addr + 1) << 8);
+                }
+                if (!AT) {
+                        for (d = 0; d < run; d++)
+                                refreshread();
+                }
+                dma_channel_run_step(dma_c, addr);
+
+                c += run;
+                if (dma_channel_count(channel, run))
+                        over = DMA_OVER;
         }
 
+        return c | over;
+}
+
+int dma_channel_write(int channel, uint16_t val) {
+        dma_t *dma_c = &dma[channel];
+
+        if (dma_channel_disabled(channel))
+                return DMA_NODATA;
+
         if (!AT)
                 refreshread();
 
@@ -586,52 +719,82 @@ int dma_channel_write(int channel, uint16_t val) {
 
         if (!dma_c->size) {
                 _dma_write(dma_c->ac, val);
-
-                if (dma_c->mode & 0x20) {
-                        if (dma_ps2.is_ps2)
-                                dma_c->ac--;
-                        else
-                                dma_c->ac = (dma_c->ac & 0xff0000) | ((dma_c->ac - 1) & 0xffff);
-                } else {
-                        if (dma_ps2.is_ps2)
-                                dma_c->ac++;
-                        else
-                                dma_c->ac = (dma_c->ac & 0xff0000) | ((dma_c->ac + 1) & 0xffff);
-                }
         } else {
                 _dma_write(dma_c->ac, val);
                 _dma_write(dma_c->ac + 1, val >> 8);
+        }
+        dma_channel_step(dma_c);
 
-                if (dma_c->mode & 0x20) {
-                        if (dma_ps2.is_ps2)
-                                dma_c->ac -= 2;
-                        else
-                                dma_c->ac = (dma_c->ac & 0xfe0000) | ((dma_c->ac - 2) & 0x1ffff);
+        dma_channel_count(channel, 1);
+
+        if (dma_m & (1 << channel))
+                return DMA_OVER;
+
+        return 0;
+}
+
+/*Write up to len transfers from buf, as repeated dma_channel_write() calls would. Memory is written and
+  invalidated a run at a time. Returns the number of transfers written, with DMA_OVER set if the channel
+  masked itself at terminal count, so len must be less than DMA_OVER. If the channel refuses the first
+  transfer, returns DMA_NODATA as dma_channel_write() would*/
+int dma_channel_write_block(int channel, uint16_t *buf, int len) {
+        dma_t *dma_c = &dma[channel];
+        int c = 0;
+
+        if (dma_channel_disabled(channel))
+                return DMA_NODATA;
+        if ((dma_c->mode & 0xC) != 4 || (dma_m & (1 << channel)))
+                return DMA_NODATA;
+
+        while (c < len && !(dma_m & (1 << channel))) {
+                int run = dma_channel_run_len(dma_c, len - c);
+                int step = (dma_c->mode & 0x20) ? -(1 << dma_c->size) : (1 << dma_c->size);
+                uint32_t addr = dma_c->ac;
+                int d;
+
+                if (!dma_c->size) {
+                        for (d = 0; d < run; d++, addr += step)
+                                mem_writeb_phys(addr, buf[c + d]);
                 } else {
-                        if (dma_ps2.is_ps2)
-                                dma_c->ac += 2;
-                        else
-                                dma_c->ac = (dma_c->ac & 0xfe0000) | ((dma_c->ac + 2) & 0x1ffff);
+                        for (d = 0; d < run; d++, addr += step) {
+                                mem_writeb_phys(addr, buf[c + d]);
+                                mem_writeb_phys(addr + 1, buf[c + d] >> 8);
+                        }
                 }
+                if (step > 0)
+                        mem_invalidate_range(dma_c->ac, addr - step + dma_c->size);
+                else
+                        mem_invalidate_range(addr - step, dma_c->ac + dma_c->size);
+                if (!AT) {
+                        for (d = 0; d < run; d++)
+                                refreshread();
+                }
+                dma_channel_run_step(dma_c, addr);
+
+                c += run;
+                dma_channel_count(channel, run);
         }
 
-        dma_stat_rq |= (1 << channel);
+        if (dma_m & (1 << channel))
+                return c | DMA_OVER;
+        return c;
+}
 
-        dma_c->cc--;
-        if (dma_c->cc < 0) {
-                if (dma_c->mode & 0x10) /*Auto-init*/
-                {
-                        dma_c->cc = dma_c->cb;
-                        dma_c->ac = dma_c->ab;
-                } else
-                        dma_m |= (1 << channel);
-                dma_stat |= (1 << channel);
-        }
+/*Number of transfers dma_channel_write() is sure to accept - what is left of a single cycle transfer, or
+  a full cycle for auto-init, which never runs out. 0 if the channel can't be written*/
+int dma_channel_write_space(int channel) {
+        dma_t *dma_c = &dma[channel];
 
+        if (dma_channel_disabled(channel))
+                return 0;
         if (dma_m & (1 << channel))
-                return DMA_OVER;
+                return 0;
+        if ((dma_c->mode & 0xC) != 4)
+                return 0;
 
-        return 0;
+        if (dma_c->mode & 0x10)
+                return dma_c->cb + 1;
+        return (dma_c->cc < 0) ? 1 : dma_c->cc + 1;
 }
 
 static void dma_ps2_run(int channel) {
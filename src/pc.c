@@ -47,9 +47,11 @@
 #include "scsi_zip.h"
 #include "serial.h"
 #include "sound.h"
+#include "sound_capture.h"
 #include "sound_cms.h"
 #include "sound_dbopl.h"
 #include "sound_opl.h"
+#include "sound_out.h"
 #include "sound_sb.h"
 #include "sound_speaker.h"
 #include "sound_ssi2001.h"
@@ -349,6 +351,7 @@ void resetpc_cad() {
 }
 
 void resetpchard() {
+        sound_synth_stop();
         device_close_all();
         mouse_emu_close();
         viewer_close_all();
@@ -527,6 +530,7 @@ void runpc() {
                 updatestatus = 1;
                 readlnum = writelnum = 0;
                 egareads = egawrites = 0;
+                video_stats_latch();
                 cycles_lost = 0;
                 mmuflush = 0;
                 emu_fps = frames;
@@ -585,6 +589,9 @@ void closepc() {
         closevideo();
         lpt1_device_close();
         mouse_emu_close();
+        sound_synth_stop();
+        sound_capture_close();
+        sound_out_close();
         device_close_all();
         zip_eject();
 }
@@ -632,6 +639,20 @@ void loadconfig(char *fn) {
 
         sound_buf_len = config_get_int(CFG_GLOBAL, NULL, "sound_buf_len", 200);
         sound_gain = config_get_int(CFG_GLOBAL, NULL, "sound_gain", 0);
+        sound_synth_thread = config_get_int(CFG_GLOBAL, NULL, "sound_synth_thread", 0);
+        sound_latency = config_get_int(CFG_GLOBAL, NULL, "sound_latency", 100);
+        p = (char *)config_get_string(CFG_GLOBAL, NULL, "sound_backend", "openal");
+        if (p)
+                strncpy(sound_backend_name, p, sizeof(sound_backend_name) - 1);
+        p = (char *)config_get_string(CFG_GLOBAL, NULL, "sound_output_file", "sound.pcm");
+        if (p)
+                strncpy(sound_output_file, p, sizeof(sound_output_file) - 1);
+        sound_capture = config_get_int(CFG_GLOBAL, NULL, "sound_capture", 0);
+        sound_capture_devices = config_get_int(CFG_GLOBAL, NULL, "sound_capture_devices", 0);
+        sound_capture_unthrottled = config_get_int(CFG_GLOBAL, NULL, "sound_capture_unthrottled", 0);
+        p = (char *)config_get_string(CFG_GLOBAL, NULL, "sound_capture_file", "capture.wav");
+        if (p)
+                strncpy(sound_capture_file, p, sizeof(sound_capture_file) - 1);
 
         GAMEBLASTER = config_get_int(CFG_MACHINE, NULL, "gameblaster", 0);
         GUS = config_get_int(CFG_MACHINE, NULL, "gus", 0);
@@ -855,6 +876,14 @@ void saveconfig(char *fn) {
 
         config_set_int(CFG_GLOBAL, NULL, "sound_buf_len", sound_buf_len);
         config_set_int(CFG_GLOBAL, NULL, "sound_gain", sound_gain);
+        config_set_int(CFG_GLOBAL, NULL, "sound_synth_thread", sound_synth_thread);
+        config_set_int(CFG_GLOBAL, NULL, "sound_latency", sound_latency);
+        config_set_string(CFG_GLOBAL, NULL, "sound_backend", sound_backend_name);
+        config_set_string(CFG_GLOBAL, NULL, "sound_output_file", sound_output_file);
+        config_set_int(CFG_GLOBAL, NULL, "sound_capture", sound_capture);
+        config_set_int(CFG_GLOBAL, NULL, "sound_capture_devices", sound_capture_devices);
+        config_set_int(CFG_GLOBAL, NULL, "sound_capture_unthrottled", sound_capture_unthrottled);
+        config_set_string(CFG_GLOBAL, NULL, "sound_capture_file", sound_capture_file);
 
         config_set_int(CFG_MACHINE, NULL, "gameblaster", GAMEBLASTER);
         config_set_int(CFG_MACHINE, NULL, "gus", GUS);
@@ -0,0 +1,62 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//  Copyright (C) 2004  Dag Lem <resid@nimrod.no>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "resid-fp/sid.h"
+
+#if (RESID_USE_AVX2 == 1)
+
+#include <immintrin.h>
+
+/* Built for AVX2 and FMA whatever the compiler's target, so only call this
+ * once the CPU has been checked for both. Four accumulators hide the FMA
+ * latency; loads are unaligned, which costs nothing on AVX2 hardware. */
+__attribute__((target("avx2,fma"))) float convolve_avx2(const float *a, const float *b, int n) {
+        __m256 out0 = _mm256_setzero_ps();
+        __m256 out1 = _mm256_setzero_ps();
+        __m256 out2 = _mm256_setzero_ps();
+        __m256 out3 = _mm256_setzero_ps();
+
+        for (; n >= 32; n -= 32) {
+                out0 = _mm256_fmadd_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b), out0);
+                out1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + 8), _mm256_loadu_ps(b + 8), out1);
+                out2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + 16), _mm256_loadu_ps(b + 16), out2);
+                out3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + 24), _mm256_loadu_ps(b + 24), out3);
+                a += 32;
+                b += 32;
+        }
+        for (; n >= 8; n -= 8) {
+                out0 = _mm256_fmadd_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b), out0);
+                a += 8;
+                b += 8;
+        }
+
+        out0 = _mm256_add_ps(_mm256_add_ps(out0, out1), _mm256_add_ps(out2, out3));
+
+        __m128 out4 = _mm_add_ps(_mm256_castps256_ps128(out0), _mm256_extractf128_ps(out0, 1));
+        out4 = _mm_add_ps(_mm_movehl_ps(out4, out4), out4);
+        out4 = _mm_add_ss(_mm_shuffle_ps(out4, out4, 1), out4);
+        float out = _mm_cvtss_f32(out4);
+
+        while (n--)
+                out += (*(a++)) * (*(b++));
+
+        return out;
+}
+#endif
@@ -23,8 +23,9 @@
 
 extern float convolve(const float *a, const float *b, int n);
 extern float convolve_sse(const float *a, const float *b, int n);
+extern float convolve_avx2(const float *a, const float *b, int n);
 
-enum host_cpu_feature { HOST_CPU_MMX = 1, HOST_CPU_SSE = 2, HOST_CPU_SSE2 = 4, HOST_CPU_SSE3 = 8 };
+enum host_cpu_feature { HOST_CPU_MMX = 1, HOST_CPU_SSE = 2, HOST_CPU_SSE2 = 4, HOST_CPU_SSE3 = 8, HOST_CPU_AVX2 = 16 };
 
 /* This code is appropriate for 32-bit and 64-bit x86 CPUs. */
 #if defined(__x86_64__) || defined(__i386__) || defined(_MSC_VER)
@@ -126,6 +127,12 @@ static int host_cpu_features(void) {
         }
 
         features = host_cpu_features_by_cpuid();
+#if (RESID_USE_AVX2 == 1)
+        /* The compiler's check also confirms the OS saves the YMM registers */
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                features |= HOST_CPU_AVX2;
+#endif
         return features;
 }
 
@@ -158,6 +165,9 @@ SIDFP::SIDFP() {
 #else
         can_use_sse = false;
 #endif
+        convolve_fn = convolve;
+        convolve_kernel_type = CONVOLVE_C;
+        set_convolve_kernel(CONVOLVE_AUTO);
 
         // Initialize pointers.
         sample = 0;
@@ -175,6 +185,59 @@ SIDFP::SIDFP() {
         input(0);
 }
 
+// ----------------------------------------------------------------------------
+// Select the resampling FIR kernel.
+// ----------------------------------------------------------------------------
+bool SIDFP::set_convolve_kernel(convolve_kernel kernel) {
+        if (kernel == CONVOLVE_AUTO) {
+#if (RESID_USE_AVX2 == 1)
+                if (set_convolve_kernel(CONVOLVE_AVX2))
+                        return true;
+#endif
+                if (set_convolve_kernel(CONVOLVE_SSE))
+                        return true;
+                return set_convolve_kernel(CONVOLVE_C);
+        }
+
+        switch (kernel) {
+        case CONVOLVE_C:
+                convolve_fn = convolve;
+                break;
+#if (RESID_USE_SSE == 1)
+        case CONVOLVE_SSE:
+                if (!can_use_sse)
+                        return false;
+                convolve_fn = convolve_sse;
+                break;
+#endif
+#if (RESID_USE_AVX2 == 1)
+        case CONVOLVE_AVX2:
+                if (!(host_cpu_features() & HOST_CPU_AVX2))
+                        return false;
+                convolve_fn = convolve_avx2;
+                break;
+#endif
+        default:
+                return false;
+        }
+
+        convolve_kernel_type = kernel;
+        return true;
+}
+
+const char *SIDFP::convolve_kernel_name(convolve_kernel kernel) {
+        switch (kernel) {
+        case CONVOLVE_C:
+                return "C";
+        case CONVOLVE_SSE:
+                return "SSE";
+        case CONVOLVE_AVX2:
+                return "AVX2";
+        default:
+                return "auto";
+        }
+}
+
 // ----------------------------------------------------------------------------
 // Destructor.
 // ----------------------------------------------------------------------------
@@ -824,11 +887,7 @@ int SIDFP::clock_resample_interpolate(cycle_count &delta_t, short *buf, int n, i
                 /* find fir_N most recent samples, plus one extra in case the FIR wraps. */
                 float *sample_start = sample + sample_index - fir_N + RINGSIZE - 1;
 
-                float v1 =
-#if (RESID_USE_SSE == 1)
-                        can_use_sse ? convolve_sse(sample_start, fir + fir_offset * fir_N, fir_N) :
-#endif
-                                    convolve(sample_start, fir + fir_offset * fir_N, fir_N);
+                float v1 = convolve_fn(sample_start, fir + fir_offset * fir_N, fir_N);
 
                 // Use next FIR table, wrap around to first FIR table using
                 // previous sample.
@@ -836,11 +895,7 @@ int SIDFP::clock_resample_interpolate(cycle_count &delta_t, short *buf, int n, i
                         fir_offset = 0;
                         ++sample_start;
                 }
-                float v2 =
-#if (RESID_USE_SSE == 1)
-                        can_use_sse ? convolve_sse(sample_start, fir + fir_offset * fir_N, fir_N) :
-#endif
-                                    convolve(sample_start, fir + fir_offset * fir_N, fir_N);
+                float v2 = convolve_fn(sample_start, fir + fir_offset * fir_N, fir_N);
 
                 // Linear interpolation between the sinc tables yields good approximation
                 // for the exact value.
@@ -5,6 +5,7 @@
 
 #include "cdrom-ioctl.h"
 #include "cdrom-image.h"
+#include "config.h"
 #include "ide.h"
 
 #include "filters.h"
@@ -16,11 +17,14 @@
 #include "sound_adlibgold.h"
 #include "sound_audiopci.h"
 #include "sound_azt2316a.h"
+#include "sound_capture.h"
 #include "sound_pas16.h"
 #include "sound_sb.h"
 #include "sound_sb_dsp.h"
 #include "sound_wss.h"
+#include "sound_mixer.h"
 #include "sound_mmb.h"
+#include "sound_out.h"
 
 #include "timer.h"
 #include "thread.h"
@@ -104,12 +108,63 @@ void sound_card_init() {
         sound_card_last = sound_card_current;
 }
 
+/*Each handler renders into its own buffer, which is then mixed in at the handler's volume and pan. These
+  are read from the machine config section of the device that added the handler, as mixer_volume (percent)
+  and mixer_pan (-100 for left to 100 for right). Handlers at full volume and centre pan accumulate straight
+  into the output buffer, unless their output is being captured.
+
+  time is the host time spent in the handler since the last latch. Once a second the emulation thread turns
+  it into load (hundredths of a percent of host time), which is all the status window reads*/
 static struct {
         void (*get_buffer)(int32_t *buffer, int len, void *p);
         void *priv;
+
+        char name[64];
+        int volume, pan;
+        float gain_l, gain_r;
+
+        uint64_t time;
+        int load;
 } sound_handlers[8];
 
 static int sound_handlers_num;
+static int sound_handlers_builtin;
+static uint64_t sound_load_start;
+
+#define SOUND_SYNTH_LOG_SIZE 8192
+#define SOUND_SYNTH_LOG_MASK (SOUND_SYNTH_LOG_SIZE - 1)
+#define SOUND_SYNTH_STEP 64 /*Samples between wakeups of the synth thread*/
+
+typedef struct sound_synth_entry_t {
+        int pos;
+        uint32_t addr;
+        uint8_t val;
+} sound_synth_entry_t;
+
+struct sound_synth_t {
+        void (*write)(uint32_t addr, uint8_t val, void *p);
+        void (*render)(int end, void *p);
+        void *priv;
+
+        /*Single producer (emulation thread), single consumer (synth thread). Each side publishes its index
+          with a release store and reads the other side's with an acquire load, so the entries are visible
+          before the index that covers them*/
+        sound_synth_entry_t log[SOUND_SYNTH_LOG_SIZE];
+        int log_write_idx, log_read_idx;
+};
+
+static sound_synth_t sound_synths[4];
+static int sound_synths_num;
+
+int sound_synth_thread = 0;
+
+static thread_t *sound_synth_thread_h;
+static event_t *sound_synth_event;
+static event_t *sound_synth_done_event;
+/*sound_synth_target is published by the release store of sound_synth_req, and the synth thread's
+  output by the release store of sound_synth_ack*/
+static int sound_synth_target;
+static int sound_synth_req, sound_synth_ack;
 
 static pc_timer_t sound_poll_timer;
 static uint64_t sound_poll_latch;
@@ -190,29 +245,181 @@ static void sound_cd_thread(void *param) {
                                 cd_buffer[c + 1] = cd_buffer_temp[1];
                         }
 
-                        givealbuffer_cd(cd_buffer);
+                        sound_out_write_cd(cd_buffer);
                 }
         }
 }
 
+static void sound_synth_run(sound_synth_t *synth, int target) {
+        int read_idx = synth->log_read_idx;
+
+        while (read_idx != __atomic_load_n(&synth->log_write_idx, __ATOMIC_ACQUIRE)) {
+                sound_synth_entry_t *entry = &synth->log[read_idx];
+
+                if (entry->pos > target)
+                        break;
+
+                synth->render(entry->pos, synth->priv);
+                synth->write(entry->addr, entry->val, synth->priv);
+
+                read_idx = (read_idx + 1) & SOUND_SYNTH_LOG_MASK;
+                __atomic_store_n(&synth->log_read_idx, read_idx, __ATOMIC_RELEASE);
+        }
+
+        synth->render(target, synth->priv);
+}
+
+static void sound_synth_thread_func(void *param) {
+        while (1) {
+                int req, target;
+                int c;
+
+                thread_wait_event(sound_synth_event, -1);
+                thread_reset_event(sound_synth_event);
+
+                req = __atomic_load_n(&sound_synth_req, __ATOMIC_ACQUIRE);
+                target = sound_synth_target;
+
+                for (c = 0; c < sound_synths_num; c++)
+                        sound_synth_run(&sound_synths[c], target);
+
+                __atomic_store_n(&sound_synth_ack, req, __ATOMIC_RELEASE);
+                thread_set_event(sound_synth_done_event);
+        }
+}
+
+/*Let the synth thread catch up to the current position. Everything before sound_pos_global is final, as
+  later writes can only be logged at or after it*/
+static void sound_synth_wake() {
+        sound_synth_target = sound_pos_global;
+        __atomic_store_n(&sound_synth_req, sound_synth_req + 1, __ATOMIC_RELEASE);
+        thread_set_event(sound_synth_event);
+}
+
+static void sound_synth_wait_idle() {
+        while (__atomic_load_n(&sound_synth_ack, __ATOMIC_ACQUIRE) != sound_synth_req) {
+                thread_wait_event(sound_synth_done_event, -1);
+                thread_reset_event(sound_synth_done_event);
+        }
+}
+
+/*Wait until every logged write has been applied, and every synth rendered up to sound_pos_global*/
+static void sound_synth_sync() {
+        sound_synth_wake();
+        sound_synth_wait_idle();
+}
+
+sound_synth_t *sound_synth_add(void (*write)(uint32_t addr, uint8_t val, void *p), void (*render)(int end, void *p), void *p) {
+        sound_synth_t *synth;
+
+        if (!sound_synth_thread || sound_synths_num == (sizeof(sound_synths) / sizeof(sound_synths[0])))
+                return NULL;
+
+        synth = &sound_synths[sound_synths_num];
+        synth->write = write;
+        synth->render = render;
+        synth->priv = p;
+        synth->log_write_idx = synth->log_read_idx = 0;
+        sound_synths_num++;
+
+        return synth;
+}
+
+void sound_synth_write(sound_synth_t *synth, uint32_t addr, uint8_t val) {
+        int write_idx = synth->log_write_idx;
+        sound_synth_entry_t *entry;
+
+        if (((write_idx + 1) & SOUND_SYNTH_LOG_MASK) == __atomic_load_n(&synth->log_read_idx, __ATOMIC_ACQUIRE))
+                sound_synth_sync(); /*Log full*/
+
+        entry = &synth->log[write_idx];
+        entry->pos = sound_pos_global;
+        entry->addr = addr;
+        entry->val = val;
+
+        __atomic_store_n(&synth->log_write_idx, (write_idx + 1) & SOUND_SYNTH_LOG_MASK, __ATOMIC_RELEASE);
+}
+
+/*Called before devices are closed, so the synth thread can no longer touch them*/
+void sound_synth_stop() {
+        sound_synth_wait_idle();
+        sound_synths_num = 0;
+}
+
 static int32_t *outbuffer;
+static int32_t *devbuffer;
 
 void sound_init() {
-        initalmain(0, NULL);
-        inital();
+        sound_out_init();
 
         outbuffer = malloc(MAXSOUNDBUFLEN * 2 * sizeof(int32_t));
+        devbuffer = malloc(MAXSOUNDBUFLEN * 2 * sizeof(int32_t));
 
         sound_cd_event = thread_create_event();
         sound_cd_thread_h = thread_create(sound_cd_thread, NULL);
+
+        sound_synth_event = thread_create_event();
+        sound_synth_done_event = thread_create_event();
+        sound_synth_thread_h = thread_create(sound_synth_thread_func, NULL);
 }
 
 void sound_add_handler(void (*get_buffer)(int32_t *buffer, int len, void *p), void *p) {
+        int volume, pan;
+
         sound_handlers[sound_handlers_num].get_buffer = get_buffer;
         sound_handlers[sound_handlers_num].priv = p;
+
+        /*Handlers added outside of a device (eg the PC speaker) are numbered instead*/
+        if (current_device_name)
+                strncpy(sound_handlers[sound_handlers_num].name, current_device_name, 63);
+        else
+                sprintf(sound_handlers[sound_handlers_num].name, "Built-in sound %i", sound_handlers_builtin++);
+        sound_handlers[sound_handlers_num].name[63] = 0;
+
+        volume = config_get_int(CFG_MACHINE, sound_handlers[sound_handlers_num].name, "mixer_volume", 100);
+        pan = config_get_int(CFG_MACHINE, sound_handlers[sound_handlers_num].name, "mixer_pan", 0);
+        if (volume < 0)
+                volume = 0;
+        if (pan < -100)
+                pan = -100;
+        else if (pan > 100)
+                pan = 100;
+        sound_handlers[sound_handlers_num].volume = volume;
+        sound_handlers[sound_handlers_num].pan = pan;
+        sound_handlers[sound_handlers_num].gain_l = (volume / 100.0f) * ((pan > 0) ? (100 - pan) / 100.0f : 1.0f);
+        sound_handlers[sound_handlers_num].gain_r = (volume / 100.0f) * ((pan < 0) ? (100 + pan) / 100.0f : 1.0f);
+        sound_handlers[sound_handlers_num].time = 0;
+        sound_handlers[sound_handlers_num].load = 0;
+
         sound_handlers_num++;
 }
 
+void sound_add_status_info(char *s, int max_len) {
+        char temps[256];
+        int c;
+
+        for (c = 0; c < sound_handlers_num; c++) {
+                snprintf(temps, sizeof(temps), "Mixer %i : %s - volume %i%%, pan %i, %.2f%% CPU\n", c,
+                         sound_handlers[c].name, sound_handlers[c].volume, sound_handlers[c].pan,
+                         sound_handlers[c].load / 100.0);
+                strncat(s, temps, max_len - strlen(s) - 1);
+        }
+}
+
+static void sound_latch_load() {
+        uint64_t now = timer_read();
+        int c;
+
+        if (now - sound_load_start < timer_freq)
+                return;
+
+        for (c = 0; c < sound_handlers_num; c++) {
+                sound_handlers[c].load = (int)((sound_handlers[c].time * 10000) / (now - sound_load_start));
+                sound_handlers[c].time = 0;
+        }
+        sound_load_start = now;
+}
+
 static int cd_pos = 0;
 void sound_poll(void *priv) {
         timer_advance_u64(&sound_poll_timer, sound_poll_latch);
@@ -226,32 +433,64 @@ void sound_poll(void *priv) {
         sound_pos_global++;
         if (sound_pos_global == sound_buf_len_al) {
                 int c;
-                /*                int16_t buf16[sound_buf_len_al * 2 ];*/
+
+                /*Synths must be complete for this buffer before the handlers mix them*/
+                if (sound_synths_num)
+                        sound_synth_sync();
 
                 memset(outbuffer, 0, sound_buf_len_al * 2 * sizeof(int32_t));
 
-                for (c = 0; c < sound_handlers_num; c++)
-                        sound_handlers[c].get_buffer(outbuffer, sound_buf_len_al, sound_handlers[c].priv);
+                for (c = 0; c < sound_handlers_num; c++) {
+                        uint64_t start_time = timer_read();
+
+                        if (sound_handlers[c].volume == 100 && !sound_handlers[c].pan &&
+                            !(sound_capture && sound_capture_devices)) {
+                                /*Handlers add into the buffer they are given*/
+                                sound_handlers[c].get_buffer(outbuffer, sound_buf_len_al, sound_handlers[c].priv);
+                                sound_handlers[c].time += timer_read() - start_time;
+                                continue;
+                        }
 
-                /*                for (c=0;c<sound_buf_len_al*2;c++)
-                                {
-                                        if (outbuffer[c] < -32768)
-                                                buf16[c] = -32768;
-                                        else if (outbuffer[c] > 32767)
-                                                buf16[c] = 32767;
-                                        else
-                                                buf16[c] = outbuffer[c];
-                                }
+                        memset(devbuffer, 0, sound_buf_len_al * 2 * sizeof(int32_t));
+                        sound_handlers[c].get_buffer(devbuffer, sound_buf_len_al, sound_handlers[c].priv);
+                        sound_handlers[c].time += timer_read() - start_time;
 
-                        if (!soundf) soundf=fopen("sound.pcm","wb");
-                        fwrite(buf16,(sound_buf_len_al)*2*2,1,soundf);*/
+                        if (sound_capture && sound_capture_devices)
+                                sound_capture_device(c, sound_handlers[c].name, devbuffer, sound_buf_len_al);
+
+                        if (sound_handlers[c].volume == 100 && !sound_handlers[c].pan)
+                                sound_mix_add(outbuffer, devbuffer, sound_buf_len_al * 2);
+                        else if (sound_handlers[c].volume)
+                                sound_mix_add_gain(outbuffer, devbuffer, sound_buf_len_al * 2, sound_handlers[c].gain_l,
+                                                   sound_handlers[c].gain_r);
+                }
+                sound_latch_load();
+
+                if (sound_capture)
+                        sound_capture_mix(outbuffer, sound_buf_len_al);
 
                 if (soundon)
-                        givealbuffer(outbuffer);
+                        sound_out_write(outbuffer, sound_buf_len_al);
 
                 sound_pos_global = 0;
                 sound_update_buf_length();
-        }
+        } else if (sound_synths_num && !(sound_pos_global % SOUND_SYNTH_STEP))
+                sound_synth_wake();
+}
+
+/*Return the sound buffer position at timestamp ts, in timer 32:32 format, which must not be in the future. This
+  is the value sound_pos_global had then, so a device generating samples after the fact can place them where
+  they would have gone had it been polled at the time*/
+int sound_pos_at(uint64_t ts) {
+        uint64_t next = ((uint64_t)(tsc + (int32_t)(timer_get_ts_int(&sound_poll_timer) - (uint32_t)tsc)) << 32) |
+                        sound_poll_timer.ts_frac;
+        uint64_t polls;
+
+        if (next <= ts)
+                return sound_pos_global;
+
+        polls = (next - ts - 1) / sound_poll_latch;
+        return (polls >= sound_pos_global) ? 0 : sound_pos_global - (int)polls;
 }
 
 void sound_speed_changed() { sound_poll_latch = (uint64_t)((double)TIMER_USEC * (1000000.0 / 48000.0)); }
@@ -260,6 +499,9 @@ void sound_reset() {
         timer_add(&sound_poll_timer, sound_poll, NULL, 1);
 
         sound_handlers_num = 0;
+        sound_handlers_builtin = 0;
+        sound_load_start = timer_read();
+        sound_synth_stop();
 
         sound_set_cd_volume(65535, 65535);
         ioctl_audio_stop();
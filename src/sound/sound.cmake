@@ -13,14 +13,17 @@ set(PCEM_PRIVATE_API ${PCEM_PRIVATE_API}
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_adlib.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_audiopci.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_azt2316a.h
+        ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_capture.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_cms.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_dbopl.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_emu8k.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_gus.h
+        ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_mixer.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_mmb.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_mpu401_uart.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_opl.h
+        ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_out.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_pas16.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_ps1.h
         ${CMAKE_SOURCE_DIR}/includes/private/sound/sound_pssj.h
@@ -41,13 +44,16 @@ set(PCEM_SRC ${PCEM_SRC}
         sound/sound_adlibgold.c
         sound/sound_audiopci.c
         sound/sound_azt2316a.c
+        sound/sound_capture.c
         sound/sound_cms.c
         sound/sound_dbopl.cc
         sound/sound_emu8k.c
         sound/sound_gus.c
+        sound/sound_mixer.c
         sound/sound_mmb.c
         sound/sound_mpu401_uart.c
         sound/sound_opl.c
+        sound/sound_out.c
         sound/sound_pas16.c
         sound/sound_ps1.c
         sound/sound_pssj.c
@@ -68,8 +74,9 @@ set(PCEM_SRC ${PCEM_SRC}
         )
 
 # RESID-FP
-set(PCEM_SRC ${PCEM_SRC}
+set(RESID_FP_SRC
         sound/resid-fp/convolve.cc
+        sound/resid-fp/convolve-avx2.cc
         sound/resid-fp/convolve-sse.cc
         sound/resid-fp/envelope.cc
         sound/resid-fp/extfilt.cc
@@ -87,6 +94,17 @@ set(PCEM_SRC ${PCEM_SRC}
         sound/resid-fp/wave8580__ST.cc
         sound/resid-fp/wave.cc
         )
+set(PCEM_SRC ${PCEM_SRC} ${RESID_FP_SRC})
+
+if(BUILD_RESID_BENCH)
+        add_executable(resid-bench sound/sound_resid_bench.cc ${RESID_FP_SRC})
+        target_compile_definitions(resid-bench PUBLIC ${PCEM_DEFINES})
+endif()
+
+if(BUILD_NUKEDOPL_TEST)
+        add_executable(nukedopl-test sound/sound_nukedopl_test.cc sound/sound_nukedopl_ref.cc dosbox/nukedopl.cpp)
+        target_compile_definitions(nukedopl-test PUBLIC ${PCEM_DEFINES})
+endif()
 
 if(${CMAKE_SYSTEM_NAME} STREQUAL "Linux" AND USE_ALSA)
         set(PCEM_SRC ${PCEM_SRC}
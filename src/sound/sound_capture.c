@@ -0,0 +1,355 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ibm.h"
+#include "sound_capture.h"
+#include "sound_mixer.h"
+#include "thread.h"
+
+#define CAPTURE_BLOCK_LEN 16384 /*Frames*/
+#define CAPTURE_BLOCKS 64
+#define CAPTURE_MAX_DEVICES 8
+#define CAPTURE_MAX_SESSIONS 9999
+
+/*Largest data chunk a WAV file can describe, rounded down to whole blocks*/
+#define CAPTURE_MAX_SIZE (0xffffffffu - 36 - CAPTURE_BLOCK_LEN * 4)
+
+int sound_capture = 0;
+int sound_capture_devices = 0;
+int sound_capture_unthrottled = 0;
+char sound_capture_file[512] = "capture.wav";
+
+typedef struct capture_file_t capture_file_t;
+
+typedef struct capture_block_t {
+        capture_file_t *file;
+        int len;
+        int16_t data[CAPTURE_BLOCK_LEN * 2];
+} capture_block_t;
+
+struct capture_file_t {
+        FILE *f;
+        int failed;
+        char name[64]; /*Device name part of the file name, for per-device captures*/
+
+        /*Written by the capture thread only*/
+        uint32_t data_size;
+
+        /*Block being filled on the emulation thread*/
+        capture_block_t *block;
+};
+
+static capture_file_t capture_mix_file;
+static capture_file_t capture_dev_files[CAPTURE_MAX_DEVICES];
+
+/*Sequence number of the capture in progress, 0 if there isn't one. All files written by one capture share
+  it, and a new capture takes the first number whose mixed output file doesn't exist yet*/
+static int capture_session;
+static char capture_mix_fn[640];
+
+static capture_block_t *capture_blocks;
+static capture_block_t *capture_free[CAPTURE_BLOCKS];
+static int capture_free_num;
+static capture_block_t *capture_queue[CAPTURE_BLOCKS];
+static int capture_queue_read, capture_queue_num;
+
+static mutex_t *capture_mutex;
+static event_t *capture_event, *capture_free_event;
+static thread_t *capture_thread_h;
+
+static int capture_stalls;
+static uint64_t capture_frames;
+
+static void capture_put16(uint8_t *p, uint16_t val) {
+        p[0] = val & 0xff;
+        p[1] = val >> 8;
+}
+
+static void capture_put32(uint8_t *p, uint32_t val) {
+        p[0] = val & 0xff;
+        p[1] = (val >> 8) & 0xff;
+        p[2] = (val >> 16) & 0xff;
+        p[3] = val >> 24;
+}
+
+/*Rewrite the header with the current data size, so a capture that is never closed properly is still
+  readable up to the last block written*/
+static void capture_write_header(capture_file_t *file) {
+        uint8_t header[44];
+
+        memcpy(&header[0], "RIFF", 4);
+        capture_put32(&header[4], 36 + file->data_size);
+        memcpy(&header[8], "WAVEfmt ", 8);
+        capture_put32(&header[16], 16);
+        capture_put16(&header[20], 1);             /*PCM*/
+        capture_put16(&header[22], 2);             /*Channels*/
+        capture_put32(&header[24], 48000);         /*Sample rate*/
+        capture_put32(&header[28], 48000 * 2 * 2); /*Bytes per second*/
+        capture_put16(&header[32], 2 * 2);         /*Bytes per frame*/
+        capture_put16(&header[34], 16);            /*Bits per sample*/
+        memcpy(&header[36], "data", 4);
+        capture_put32(&header[40], file->data_size);
+
+        fseek(file->f, 0, SEEK_SET);
+        fwrite(header, sizeof(header), 1, file->f);
+        fseek(file->f, 0, SEEK_END);
+}
+
+static void capture_thread(void *param) {
+        while (1) {
+                thread_wait_event(capture_event, -1);
+                thread_reset_event(capture_event);
+
+                while (1) {
+                        capture_block_t *block = NULL;
+                        capture_file_t *file;
+
+                        thread_lock_mutex(capture_mutex);
+                        if (capture_queue_num) {
+                                block = capture_queue[capture_queue_read];
+                                capture_queue_read = (capture_queue_read + 1) % CAPTURE_BLOCKS;
+                                capture_queue_num--;
+                        }
+                        thread_unlock_mutex(capture_mutex);
+
+                        if (!block)
+                                break;
+
+                        file = block->file;
+                        if (file->data_size < CAPTURE_MAX_SIZE) {
+                                fwrite(block->data, block->len * 2 * 2, 1, file->f);
+                                file->data_size += block->len * 2 * 2;
+                                capture_write_header(file);
+                        }
+
+                        thread_lock_mutex(capture_mutex);
+                        capture_free[capture_free_num++] = block;
+                        thread_unlock_mutex(capture_mutex);
+                        thread_set_event(capture_free_event);
+                }
+        }
+}
+
+static void capture_init() {
+        int c;
+
+        capture_blocks = malloc(CAPTURE_BLOCKS * sizeof(capture_block_t));
+        for (c = 0; c < CAPTURE_BLOCKS; c++)
+                capture_free[c] = &capture_blocks[c];
+        capture_free_num = CAPTURE_BLOCKS;
+        capture_queue_read = capture_queue_num = 0;
+
+        capture_mutex = thread_create_mutex();
+        capture_event = thread_create_event();
+        capture_free_event = thread_create_event();
+        capture_thread_h = thread_create(capture_thread, NULL);
+}
+
+/*Take a free block, waiting for the capture thread if the disc has fallen behind. Dropping audio would
+  make the capture useless for comparisons, so emulation stalls instead*/
+static capture_block_t *capture_get_block() {
+        while (1) {
+                capture_block_t *block = NULL;
+
+                thread_lock_mutex(capture_mutex);
+                if (capture_free_num)
+                        block = capture_free[--capture_free_num];
+                thread_unlock_mutex(capture_mutex);
+
+                if (block)
+                        return block;
+
+                capture_stalls++;
+                thread_wait_event(capture_free_event, -1);
+                thread_reset_event(capture_free_event);
+        }
+}
+
+static void capture_queue_block(capture_file_t *file) {
+        thread_lock_mutex(capture_mutex);
+        capture_queue[(capture_queue_read + capture_queue_num) % CAPTURE_BLOCKS] = file->block;
+        capture_queue_num++;
+        thread_unlock_mutex(capture_mutex);
+        thread_set_event(capture_event);
+
+        file->block = NULL;
+}
+
+/*capture.wav -> capture_0001.wav, capture_0001_<device>.wav, etc*/
+static void capture_make_fn(char *fn, int len, int session, const char *dev_name) {
+        char base[512];
+        char *ext;
+
+        strcpy(base, sound_capture_file);
+        ext = strrchr(base, '.');
+        if (ext && !strchr(ext, '/') && !strchr(ext, '\\'))
+                *ext = 0;
+
+        if (dev_name)
+                snprintf(fn, len, "%s_%04i_%s.wav", base, session, dev_name);
+        else
+                snprintf(fn, len, "%s_%04i.wav", base, session);
+}
+
+static void capture_start_session() {
+        int session;
+
+        if (capture_session)
+                return;
+
+        for (session = 1; session < CAPTURE_MAX_SESSIONS; session++) {
+                FILE *f;
+
+                capture_make_fn(capture_mix_fn, sizeof(capture_mix_fn), session, NULL);
+                f = fopen(capture_mix_fn, "rb");
+                if (!f)
+                        break;
+                fclose(f);
+        }
+        capture_session = session;
+}
+
+static int capture_open(capture_file_t *file, const char *fn) {
+        if (file->f)
+                return 1;
+        if (file->failed)
+                return 0;
+
+        if (!capture_blocks)
+                capture_init();
+
+        file->f = fopen(fn, "wb");
+        if (!file->f) {
+                pclog("sound_capture: can't open %s\n", fn);
+                file->failed = 1;
+                return 0;
+        }
+        file->data_size = 0;
+        file->block = NULL;
+        capture_write_header(file);
+
+        return 1;
+}
+
+static void capture_write(capture_file_t *file, int32_t *buf, int len) {
+        while (len) {
+                capture_block_t *block;
+                int frames;
+
+                if (!file->block) {
+                        file->block = capture_get_block();
+                        file->block->file = file;
+                        file->block->len = 0;
+                }
+                block = file->block;
+
+                frames = CAPTURE_BLOCK_LEN - block->len;
+                if (frames > len)
+                        frames = len;
+
+                sound_mix_clamp16(&block->data[block->len * 2], buf, frames * 2);
+                block->len += frames;
+                buf += frames * 2;
+                len -= frames;
+
+                if (block->len == CAPTURE_BLOCK_LEN)
+                        capture_queue_block(file);
+        }
+}
+
+void sound_capture_mix(int32_t *buf, int len) {
+        if (!sound_capture)
+                return;
+
+        capture_start_session();
+        if (!capture_open(&capture_mix_file, capture_mix_fn))
+                return;
+
+        capture_write(&capture_mix_file, buf, len);
+        capture_frames += len;
+}
+
+void sound_capture_device(int dev, const char *name, int32_t *buf, int len) {
+        capture_file_t *file = &capture_dev_files[dev];
+
+        if (!sound_capture || !sound_capture_devices || dev >= CAPTURE_MAX_DEVICES)
+                return;
+
+        if (!file->f && !file->failed) {
+                char fn[640];
+                int c, same = 0;
+
+                /*Keep the device name file system safe, and number any further handlers with the same name*/
+                for (c = 0; name[c] && c < (int)sizeof(file->name) - 4; c++)
+                        file->name[c] = (isalnum((uint8_t)name[c]) || name[c] == '-') ? name[c] : '_';
+                file->name[c] = 0;
+                for (c = 0; c < dev; c++) {
+                        if (!strcmp(capture_dev_files[c].name, file->name))
+                                same++;
+                }
+                if (same)
+                        sprintf(&file->name[strlen(file->name)], "_%i", same + 1);
+
+                capture_start_session();
+                capture_make_fn(fn, sizeof(fn), capture_session, file->name);
+                if (!capture_open(file, fn))
+                        return;
+        }
+
+        capture_write(file, buf, len);
+}
+
+static void capture_close_file(capture_file_t *file) {
+        if (file->f && file->block)
+                capture_queue_block(file);
+}
+
+/*Flush everything to disc and close the files. A later capture starts new files*/
+void sound_capture_close() {
+        int c;
+
+        if (!capture_blocks)
+                return;
+
+        capture_close_file(&capture_mix_file);
+        for (c = 0; c < CAPTURE_MAX_DEVICES; c++)
+                capture_close_file(&capture_dev_files[c]);
+
+        while (1) {
+                int done;
+
+                thread_lock_mutex(capture_mutex);
+                done = (capture_free_num == CAPTURE_BLOCKS);
+                thread_unlock_mutex(capture_mutex);
+
+                if (done)
+                        break;
+
+                thread_wait_event(capture_free_event, -1);
+                thread_reset_event(capture_free_event);
+        }
+
+        if (capture_mix_file.f)
+                fclose(capture_mix_file.f);
+        memset(&capture_mix_file, 0, sizeof(capture_mix_file));
+        for (c = 0; c < CAPTURE_MAX_DEVICES; c++) {
+                if (capture_dev_files[c].f)
+                        fclose(capture_dev_files[c].f);
+                memset(&capture_dev_files[c], 0, sizeof(capture_dev_files[c]));
+        }
+        capture_frames = 0;
+        capture_session = 0;
+}
+
+void sound_capture_add_status_info(char *s, int max_len) {
+        char temps[256];
+
+        if (!sound_capture || !capture_mix_file.f)
+                return;
+
+        snprintf(temps, sizeof(temps), "Audio capture : %s\nAudio captured : %.1f s\nAudio capture stalls : %i\n",
+                 capture_mix_fn, (double)capture_frames / 48000.0, capture_stalls);
+
+        strncat(s, temps, max_len - strlen(s) - 1);
+}
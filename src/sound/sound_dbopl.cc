@@ -5,7 +5,8 @@
 static struct {
         DBOPL::Chip chip;
         struct opl3_chip opl3chip;
-        int addr;
+        int addr, chip_addr;
+        int opl3_active;
         int timer[2];
         uint8_t timer_ctrl;
         uint8_t status_mask;
@@ -43,6 +44,7 @@ void opl_init(void (*timer_callback)(void *param, int timer, int64_t period), vo
                 opl[nr].is_opl3 = is_opl3;
                 opl[nr].opl_emu = opl_emu;
         }
+        opl[nr].opl3_active = 0;
 }
 
 void opl_status_update(int nr) {
@@ -64,51 +66,80 @@ void opl_timer_over(int nr, int timer) {
         opl_status_update(nr);
 }
 
-void opl_write(int nr, uint16_t addr, uint8_t val) {
+/*Register write to the chip core. When the synth runs on the audio thread this is the only
+  part of a write that is replayed there*/
+void opl_write_chip(int nr, uint16_t addr, uint8_t val) {
         if (!(addr & 1)) {
                 if (!opl[nr].is_opl3 || !opl[nr].opl_emu)
-                        opl[nr].addr = (int)opl[nr].chip.WriteAddr(addr, val) & (opl[nr].is_opl3 ? 0x1ff : 0xff);
+                        opl[nr].chip_addr = (int)opl[nr].chip.WriteAddr(addr, val) & (opl[nr].is_opl3 ? 0x1ff : 0xff);
                 else
-                        opl[nr].addr = (int)OPL3_WriteAddr(&opl[nr].opl3chip, addr, val) & 0x1ff;
+                        opl[nr].chip_addr = (int)OPL3_WriteAddr(&opl[nr].opl3chip, addr, val) & 0x1ff;
         } else {
                 if (!opl[nr].is_opl3 || !opl[nr].opl_emu)
-                        opl[nr].chip.WriteReg(opl[nr].addr, val);
+                        opl[nr].chip.WriteReg(opl[nr].chip_addr, val);
                 else
-                        OPL3_WriteReg(&opl[nr].opl3chip, opl[nr].addr, val);
-
-                switch (opl[nr].addr) {
-                case 0x02: /*Timer 1*/
-                        opl[nr].timer[0] = 256 - val;
-                        break;
-                case 0x03: /*Timer 2*/
-                        opl[nr].timer[1] = 256 - val;
-                        break;
-                case 0x04:                        /*Timer control*/
-                        if (val & CTRL_IRQ_RESET) /*IRQ reset*/
-                        {
-                                opl[nr].status &= ~(STATUS_TIMER_1 | STATUS_TIMER_2);
-                                opl_status_update(nr);
-                                return;
-                        }
-                        if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER1_CTRL) {
-                                if (val & CTRL_TIMER1_CTRL)
-                                        opl[nr].timer_callback(opl[nr].timer_param, 0, opl[nr].timer[0] * 4);
-                                else
-                                        opl[nr].timer_callback(opl[nr].timer_param, 0, 0);
-                        }
-                        if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER2_CTRL) {
-                                if (val & CTRL_TIMER2_CTRL)
-                                        opl[nr].timer_callback(opl[nr].timer_param, 1, opl[nr].timer[1] * 16);
-                                else
-                                        opl[nr].timer_callback(opl[nr].timer_param, 1, 0);
-                        }
-                        opl[nr].status_mask = (~val & (CTRL_TIMER1_MASK | CTRL_TIMER2_MASK)) | 0x80;
-                        opl[nr].timer_ctrl = val;
-                        break;
+                        OPL3_WriteReg(&opl[nr].opl3chip, opl[nr].chip_addr, val);
+        }
+}
+
+static void opl_write_timer_reg(int nr, uint8_t val) {
+        switch (opl[nr].addr) {
+        case 0x02: /*Timer 1*/
+                opl[nr].timer[0] = 256 - val;
+                break;
+        case 0x03: /*Timer 2*/
+                opl[nr].timer[1] = 256 - val;
+                break;
+        case 0x04:                        /*Timer control*/
+                if (val & CTRL_IRQ_RESET) /*IRQ reset*/
+                {
+                        opl[nr].status &= ~(STATUS_TIMER_1 | STATUS_TIMER_2);
+                        opl_status_update(nr);
+                        return;
+                }
+                if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER1_CTRL) {
+                        if (val & CTRL_TIMER1_CTRL)
+                                opl[nr].timer_callback(opl[nr].timer_param, 0, opl[nr].timer[0] * 4);
+                        else
+                                opl[nr].timer_callback(opl[nr].timer_param, 0, 0);
                 }
+                if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER2_CTRL) {
+                        if (val & CTRL_TIMER2_CTRL)
+                                opl[nr].timer_callback(opl[nr].timer_param, 1, opl[nr].timer[1] * 16);
+                        else
+                                opl[nr].timer_callback(opl[nr].timer_param, 1, 0);
+                }
+                opl[nr].status_mask = (~val & (CTRL_TIMER1_MASK | CTRL_TIMER2_MASK)) | 0x80;
+                opl[nr].timer_ctrl = val;
+                break;
         }
 }
 
+/*Emulation side of a write when the chip core is on the audio thread. Tracks the register address
+  the same way the cores do, so that timer and status registers behave as with opl_write()*/
+void opl_write_timers(int nr, uint16_t addr, uint8_t val) {
+        if (!(addr & 1)) {
+                int reg = val;
+
+                if ((addr & 2) && (opl[nr].opl3_active || val == 0x05))
+                        reg |= 0x100;
+                opl[nr].addr = reg & (opl[nr].is_opl3 ? 0x1ff : 0xff);
+        } else {
+                if (opl[nr].addr == 0x105)
+                        opl[nr].opl3_active = val & 1;
+                opl_write_timer_reg(nr, val);
+        }
+}
+
+void opl_write(int nr, uint16_t addr, uint8_t val) {
+        opl_write_chip(nr, addr, val);
+
+        if (!(addr & 1))
+                opl[nr].addr = opl[nr].chip_addr;
+        else
+                opl_write_timer_reg(nr, val);
+}
+
 uint8_t opl_read(int nr, uint16_t addr) {
         if (!(addr & 1)) {
                 return (opl[nr].status & opl[nr].status_mask) | (opl[nr].is_opl3 ? 0 : 0x06);
@@ -1625,7 +1625,7 @@ void emu8k_update(emu8k_t *emu8k) {
                 emu_voice = &emu8k->voice[c];
                 buf = &emu8k->buffer[emu8k->pos * 2];
 
-                for (pos = emu8k->pos; pos < new_pos; pos++) {
+                for (pos = emu8k->pos; pos < new_pos; pos++, buf += 2) {
                         int32_t dat;
 
                         if (emu_voice->cvcf_curr_volume) {
@@ -1733,8 +1733,8 @@ void emu8k_update(emu8k_t *emu8k) {
                                         /*volume and pan*/
                                         dat = (dat * emu_voice->cvcf_curr_volume) >> 16;
 
-                                        (*buf++) += (dat * emu_voice->vol_l) >> 8;
-                                        (*buf++) += (dat * emu_voice->vol_r) >> 8;
+                                        buf[0] += (dat * emu_voice->vol_l) >> 8;
+                                        buf[1] += (dat * emu_voice->vol_r) >> 8;
 
                                         /* Effects section */
                                         if (emu_voice->ptrx_revb_send > 0) {
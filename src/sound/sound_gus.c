@@ -1,6 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "ibm.h"
 
 #include "device.h"
@@ -11,6 +16,9 @@
 #include "sound_gus.h"
 #include "timer.h"
 
+/*Maximum number of samples rendered in one pass, and the longest the wave timer will go between passes*/
+#define GUS_BLOCK_LEN 256
+
 typedef struct gus_t {
         int reset;
 
@@ -36,13 +44,17 @@ typedef struct gus_t {
         int voices;
         uint8_t dmactrl;
 
-        int32_t out_l, out_r;
-
         int16_t buffer[2][MAXSOUNDBUFLEN];
         int pos;
 
+        /*Samples rendered at the GUS playback rate, not yet mapped to the output buffer*/
+        int16_t wave[2][MAXSOUNDBUFLEN];
+        int wave_pos;
+        int16_t wave_hold[2];
+
         pc_timer_t samp_timer;
         uint64_t samp_latch;
+        uint64_t samp_ts; /*Timestamp of the next sample to render, in timer 32:32 format*/
 
         uint8_t *ram;
 
@@ -81,6 +93,9 @@ int gusfreqs[] = {44100, 41160, 38587, 36317, 34300, 32494, 30870, 29400, 28063,
 
 double vol16bit[4096];
 
+static void gus_wave_sync(gus_t *gus);
+static void gus_wave_schedule(gus_t *gus);
+
 enum { MIDI_INT_RECEIVE = 0x01, MIDI_INT_TRANSMIT = 0x02, MIDI_INT_MASTER = 0x80 };
 
 enum { MIDI_CTRL_TRANSMIT_MASK = 0x60, MIDI_CTRL_TRANSMIT = 0x20, MIDI_CTRL_RECEIVE = 0x80 };
@@ -166,7 +181,7 @@ void gus_midi_update_int_status(gus_t *gus) {
         gus_update_int_status(gus);
 }
 
-void writegus(uint16_t addr, uint8_t val, void *p) {
+static void gus_write(uint16_t addr, uint8_t val, void *p) {
         gus_t *gus = (gus_t *)p;
         int c, d;
         int old;
@@ -383,6 +398,8 @@ void writegus(uint16_t addr, uint8_t val, void *p) {
 
                 case 0x41: /*DMA*/
                         if (val & 1 && gus->dma != -1) {
+                                /*Voices must have played everything due from the old RAM contents*/
+                                gus_wave_sync(gus);
                                 //                                printf("DMA start! %05X %02X\n",gus->dmaaddr,val);
                                 if (val & 2) {
                                         c = 0;
@@ -496,6 +513,7 @@ void writegus(uint16_t addr, uint8_t val, void *p) {
                 }
                 break;
         case 0x347: /*DRAM access*/
+                gus_wave_sync(gus);
                 gus->ram[gus->addr] = val;
                 //                pclog("GUS RAM write %05X %02X\n",gus->addr,val);
                 gus->addr &= 0xFFFFF;
@@ -613,7 +631,7 @@ void writegus(uint16_t addr, uint8_t val, void *p) {
         }
 }
 
-uint8_t readgus(uint16_t addr, void *p) {
+static uint8_t gus_read(uint16_t addr, void *p) {
         gus_t *gus = (gus_t *)p;
         uint8_t val = 0xff;
         //        /*if (addr!=0x246) */printf("Read GUS %04X %04X(%06X):%04X %02X\n",addr,CS,cs,pc,gus->global);
@@ -840,6 +858,36 @@ uint8_t readgus(uint16_t addr, void *p) {
         return val;
 }
 
+/*Voice registers are only touched once the voices have been rendered up to the current time. The write may
+  change when the next voice IRQ is due, so the wave timer is rescheduled afterwards. gus_write() syncs again
+  before anything that changes GUS RAM (DRAM pokes and DMA), so RAM never changes under samples that are
+  already due, whichever path the write arrives by*/
+void writegus(uint16_t addr, uint8_t val, void *p) {
+        gus_t *gus = (gus_t *)p;
+
+        if (addr == 0x344 || addr == 0x345 || addr == 0x347) {
+                gus_wave_sync(gus);
+                gus_write(addr, val, p);
+                gus_wave_schedule(gus);
+        } else
+                gus_write(addr, val, p);
+}
+
+/*Reading the voice IRQ status clears the IRQ, so register reads reschedule as well*/
+uint8_t readgus(uint16_t addr, void *p) {
+        gus_t *gus = (gus_t *)p;
+        uint8_t val;
+
+        if (addr == 0x344 || addr == 0x345) {
+                gus_wave_sync(gus);
+                val = gus_read(addr, p);
+                gus_wave_schedule(gus);
+        } else
+                val = gus_read(addr, p);
+
+        return val;
+}
+
 void gus_poll_timer_1(void *p) {
         gus_t *gus = (gus_t *)p;
 
@@ -893,181 +941,368 @@ void gus_poll_timer_2(void *p) {
         gus_update_int_status(gus);
 }
 
+/*Map the wave samples rendered since the last update onto the output buffer. Both run off fixed clocks, so
+  output sample c takes the last wave sample rendered at or before its share of the interval*/
 static void gus_update(gus_t *gus) {
-        for (; gus->pos < sound_pos_global; gus->pos++) {
-                if (gus->out_l < -32768)
-                        gus->buffer[0][gus->pos] = -32768;
-                else if (gus->out_l > 32767)
-                        gus->buffer[0][gus->pos] = 32767;
-                else
-                        gus->buffer[0][gus->pos] = gus->out_l;
-                if (gus->out_r < -32768)
-                        gus->buffer[1][gus->pos] = -32768;
-                else if (gus->out_r > 32767)
-                        gus->buffer[1][gus->pos] = 32767;
-                else
-                        gus->buffer[1][gus->pos] = gus->out_r;
-        }
-}
+        int len = sound_pos_global - gus->pos;
+        int c;
 
-void gus_poll_wave(void *p) {
-        gus_t *gus = (gus_t *)p;
-        uint32_t addr;
-        int d;
-        int16_t v;
-        int32_t vl;
-        int update_irqs = 0;
+        if (len <= 0)
+                return;
 
-        gus_update(gus);
+        for (c = 0; c < len; c++) {
+                if (gus->wave_pos) {
+                        int s = ((c + 1) * gus->wave_pos - 1) / len;
 
-        timer_advance_u64(&gus->samp_timer, gus->samp_latch);
+                        gus->buffer[0][gus->pos + c] = gus->wave[0][s];
+                        gus->buffer[1][gus->pos + c] = gus->wave[1][s];
+                } else {
+                        gus->buffer[0][gus->pos + c] = gus->wave_hold[0];
+                        gus->buffer[1][gus->pos + c] = gus->wave_hold[1];
+                }
+        }
 
-        gus->out_l = gus->out_r = 0;
+        if (gus->wave_pos) {
+                gus->wave_hold[0] = gus->wave[0][gus->wave_pos - 1];
+                gus->wave_hold[1] = gus->wave[1][gus->wave_pos - 1];
+                gus->wave_pos = 0;
+        }
+        gus->pos = sound_pos_global;
+}
 
-        if ((gus->reset & 3) != 3)
-                return;
-        // pclog("gus_poll_wave\n");
-        for (d = 0; d < 32; d++) {
-                if (!(gus->ctrl[d] & 3)) {
-                        if (gus->ctrl[d] & 4) {
-                                addr = gus->cur[d] >> 9;
+/*Run one voice for len samples, writing its output level to buf. Returns 1 if the voice produced any output*/
+static int gus_render_voice(gus_t *gus, int d, int16_t *buf, int len, int *update_irqs) {
+        uint32_t cur = gus->cur[d];
+        uint8_t ctrl = gus->ctrl[d];
+        int rcur = gus->rcur[d];
+        uint8_t rctrl = gus->rctrl[d];
+        uint32_t freq = gus->freq[d] >> 1;
+        int interpolate = !(gus->freq[d] >> 10);
+        int playing = 0;
+        int c;
+
+        for (c = 0; c < len; c++) {
+                if (!(ctrl & 3)) {
+                        uint32_t addr;
+                        int32_t vl;
+                        int16_t v;
+
+                        if (ctrl & 4) {
+                                addr = cur >> 9;
                                 addr = (addr & 0xC0000) | ((addr << 1) & 0x3FFFE);
-                                if (!(gus->freq[d] >> 10)) /*Interpolate*/
-                                {
+                                if (interpolate) {
                                         vl = (int16_t)(int8_t)((gus->ram[(addr + 1) & 0xFFFFF] ^ 0x80) - 0x80) *
-                                             (511 - (gus->cur[d] & 511));
-                                        vl += (int16_t)(int8_t)((gus->ram[(addr + 3) & 0xFFFFF] ^ 0x80) - 0x80) *
-                                              (gus->cur[d] & 511);
+                                             (511 - (cur & 511));
+                                        vl += (int16_t)(int8_t)((gus->ram[(addr + 3) & 0xFFFFF] ^ 0x80) - 0x80) * (cur & 511);
                                         v = vl >> 9;
                                 } else
                                         v = (int16_t)(int8_t)((gus->ram[(addr + 1) & 0xFFFFF] ^ 0x80) - 0x80);
                         } else {
-                                if (!(gus->freq[d] >> 10)) /*Interpolate*/
-                                {
-                                        vl = ((int8_t)((gus->ram[(gus->cur[d] >> 9) & 0xFFFFF] ^ 0x80) - 0x80)) *
-                                             (511 - (gus->cur[d] & 511));
-                                        vl += ((int8_t)((gus->ram[((gus->cur[d] >> 9) + 1) & 0xFFFFF] ^ 0x80) - 0x80)) *
-                                              (gus->cur[d] & 511);
+                                if (interpolate) {
+                                        vl = ((int8_t)((gus->ram[(cur >> 9) & 0xFFFFF] ^ 0x80) - 0x80)) * (511 - (cur & 511));
+                                        vl += ((int8_t)((gus->ram[((cur >> 9) + 1) & 0xFFFFF] ^ 0x80) - 0x80)) * (cur & 511);
                                         v = vl >> 9;
                                 } else
-                                        v = (int16_t)(int8_t)((gus->ram[(gus->cur[d] >> 9) & 0xFFFFF] ^ 0x80) - 0x80);
+                                        v = (int16_t)(int8_t)((gus->ram[(cur >> 9) & 0xFFFFF] ^ 0x80) - 0x80);
                         }
 
-                        //                        pclog("Voice %i : %04X %05X %04X ", d, v, gus->cur[d] >> 9, gus->rcur[d] >> 10);
-                        if ((gus->rcur[d] >> 14) > 4095)
+                        if ((rcur >> 14) > 4095)
                                 v = (int16_t)(float)(v)*24.0 * vol16bit[4095];
                         else
-                                v = (int16_t)(float)(v)*24.0 * vol16bit[(gus->rcur[d] >> 10) & 4095];
-                        //                        pclog("%f %04X\n", vol16bit[(gus->rcur[d]>>10) & 4095], v);
-
-                        gus->out_l += (v * gus->pan_l[d]) / 7;
-                        gus->out_r += (v * gus->pan_r[d]) / 7;
-
-                        if (gus->ctrl[d] & 0x40) {
-                                gus->cur[d] -= (gus->freq[d] >> 1);
-                                if (gus->cur[d] <= gus->start[d]) {
-                                        int diff = gus->start[d] - gus->cur[d];
-
-                                        if (gus->ctrl[d] & 8) {
-                                                if (gus->ctrl[d] & 0x10)
-                                                        gus->ctrl[d] ^= 0x40;
-                                                gus->cur[d] =
-                                                        (gus->ctrl[d] & 0x40) ? (gus->end[d] - diff) : (gus->start[d] + diff);
-                                        } else if (!(gus->rctrl[d] & 4)) {
-                                                gus->ctrl[d] |= 1;
-                                                gus->cur[d] = (gus->ctrl[d] & 0x40) ? gus->end[d] : gus->start[d];
+                                v = (int16_t)(float)(v)*24.0 * vol16bit[(rcur >> 10) & 4095];
+                        buf[c] = v;
+                        playing = 1;
+
+                        if (ctrl & 0x40) {
+                                cur -= freq;
+                                if (cur <= gus->start[d]) {
+                                        int diff = gus->start[d] - cur;
+
+                                        if (ctrl & 8) {
+                                                if (ctrl & 0x10)
+                                                        ctrl ^= 0x40;
+                                                cur = (ctrl & 0x40) ? (gus->end[d] - diff) : (gus->start[d] + diff);
+                                        } else if (!(rctrl & 4)) {
+                                                ctrl |= 1;
+                                                cur = (ctrl & 0x40) ? gus->end[d] : gus->start[d];
                                         }
 
-                                        if ((gus->ctrl[d] & 0x20) && !gus->waveirqs[d]) {
+                                        if ((ctrl & 0x20) && !gus->waveirqs[d]) {
                                                 gus->waveirqs[d] = 1;
-                                                update_irqs = 1;
-                                                //                                                pclog("Causing wave IRQ %02X
-                                                //                                                %i\n", gus->ctrl[d], d);
+                                                *update_irqs = 1;
                                         }
                                 }
                         } else {
-                                gus->cur[d] += (gus->freq[d] >> 1);
-
-                                if (gus->cur[d] >= gus->end[d]) {
-                                        int diff = gus->cur[d] - gus->end[d];
-
-                                        if (gus->ctrl[d] & 8) {
-                                                if (gus->ctrl[d] & 0x10)
-                                                        gus->ctrl[d] ^= 0x40;
-                                                gus->cur[d] =
-                                                        (gus->ctrl[d] & 0x40) ? (gus->end[d] - diff) : (gus->start[d] + diff);
-                                        } else if (!(gus->rctrl[d] & 4)) {
-                                                gus->ctrl[d] |= 1;
-                                                gus->cur[d] = (gus->ctrl[d] & 0x40) ? gus->end[d] : gus->start[d];
+                                cur += freq;
+                                if (cur >= gus->end[d]) {
+                                        int diff = cur - gus->end[d];
+
+                                        if (ctrl & 8) {
+                                                if (ctrl & 0x10)
+                                                        ctrl ^= 0x40;
+                                                cur = (ctrl & 0x40) ? (gus->end[d] - diff) : (gus->start[d] + diff);
+                                        } else if (!(rctrl & 4)) {
+                                                ctrl |= 1;
+                                                cur = (ctrl & 0x40) ? gus->end[d] : gus->start[d];
                                         }
 
-                                        if ((gus->ctrl[d] & 0x20) && !gus->waveirqs[d]) {
+                                        if ((ctrl & 0x20) && !gus->waveirqs[d]) {
                                                 gus->waveirqs[d] = 1;
-                                                update_irqs = 1;
-                                                //                                                pclog("Causing wave IRQ %02X
-                                                //                                                %i\n", gus->ctrl[d], d);
+                                                *update_irqs = 1;
                                         }
                                 }
                         }
-                }
-                if (!(gus->rctrl[d] & 3)) {
-                        if (gus->rctrl[d] & 0x40) {
-                                gus->rcur[d] -= gus->rfreq[d];
-                                if (gus->rcur[d] <= gus->rstart[d]) {
-                                        int diff = gus->rstart[d] - gus->rcur[d];
-                                        if (!(gus->rctrl[d] & 8)) {
-                                                gus->rctrl[d] |= 1;
-                                                gus->rcur[d] = (gus->rctrl[d] & 0x40) ? gus->rstart[d] : gus->rend[d];
+                } else
+                        buf[c] = 0;
+
+                if (!(rctrl & 3)) {
+                        if (rctrl & 0x40) {
+                                rcur -= gus->rfreq[d];
+                                if (rcur <= gus->rstart[d]) {
+                                        int diff = gus->rstart[d] - rcur;
+
+                                        if (!(rctrl & 8)) {
+                                                rctrl |= 1;
+                                                rcur = (rctrl & 0x40) ? gus->rstart[d] : gus->rend[d];
                                         } else {
-                                                if (gus->rctrl[d] & 0x10)
-                                                        gus->rctrl[d] ^= 0x40;
-                                                gus->rcur[d] =
-                                                        (gus->rctrl[d] & 0x40) ? (gus->rend[d] - diff) : (gus->rstart[d] + diff);
+                                                if (rctrl & 0x10)
+                                                        rctrl ^= 0x40;
+                                                rcur = (rctrl & 0x40) ? (gus->rend[d] - diff) : (gus->rstart[d] + diff);
                                         }
 
-                                        if ((gus->rctrl[d] & 0x20) && !gus->rampirqs[d]) {
+                                        if ((rctrl & 0x20) && !gus->rampirqs[d]) {
                                                 gus->rampirqs[d] = 1;
-                                                update_irqs = 1;
-                                                //                                                pclog("Causing ramp IRQ %02X
-                                                //                                                %i\n",gus->rctrl[d], d);
+                                                *update_irqs = 1;
                                         }
                                 }
                         } else {
-                                gus->rcur[d] += gus->rfreq[d];
-                                //                                        if (d == 1) printf("RCUR+ %i %08X %08X %08X
-                                //                                        %08X\n",d,gus->rfreq[d],gus->rcur[d],gus->rstart[d],gus->rend[d]);
-                                if (gus->rcur[d] >= gus->rend[d]) {
-                                        int diff = gus->rcur[d] - gus->rend[d];
-                                        if (!(gus->rctrl[d] & 8)) {
-                                                gus->rctrl[d] |= 1;
-                                                gus->rcur[d] = (gus->rctrl[d] & 0x40) ? gus->rstart[d] : gus->rend[d];
+                                rcur += gus->rfreq[d];
+                                if (rcur >= gus->rend[d]) {
+                                        int diff = rcur - gus->rend[d];
+
+                                        if (!(rctrl & 8)) {
+                                                rctrl |= 1;
+                                                rcur = (rctrl & 0x40) ? gus->rstart[d] : gus->rend[d];
                                         } else {
-                                                if (gus->rctrl[d] & 0x10)
-                                                        gus->rctrl[d] ^= 0x40;
-                                                gus->rcur[d] =
-                                                        (gus->rctrl[d] & 0x40) ? (gus->rend[d] - diff) : (gus->rstart[d] + diff);
+                                                if (rctrl & 0x10)
+                                                        rctrl ^= 0x40;
+                                                rcur = (rctrl & 0x40) ? (gus->rend[d] - diff) : (gus->rstart[d] + diff);
                                         }
 
-                                        if ((gus->rctrl[d] & 0x20) && !gus->rampirqs[d]) {
+                                        if ((rctrl & 0x20) && !gus->rampirqs[d]) {
                                                 gus->rampirqs[d] = 1;
-                                                update_irqs = 1;
-                                                //                                                        pclog("Causing ramp IRQ
-                                                //                                                        %02X
-                                                //                                                        %i\n",gus->rctrl[d], d);
+                                                *update_irqs = 1;
                                         }
                                 }
                         }
                 }
         }
 
+        gus->cur[d] = cur;
+        gus->ctrl[d] = ctrl;
+        gus->rcur[d] = rcur;
+        gus->rctrl[d] = rctrl;
+
+        return playing;
+}
+
+/*Add (v * pan) / 7 for each sample to the mix. The product is exact in single precision, and 1/7 rounds up in
+  single precision, so truncating the scaled product matches the integer division*/
+static void gus_mix_voice(int32_t *out_l, int32_t *out_r, const int16_t *buf, int pan_l, int pan_r, int len) {
+        int c = 0;
+#if defined(__SSE2__)
+        const __m128 fpan_l = _mm_set1_ps((float)pan_l);
+        const __m128 fpan_r = _mm_set1_ps((float)pan_r);
+        const __m128 div7 = _mm_set1_ps(1.0f / 7.0f);
+
+        for (; c + 4 <= len; c += 4) {
+                __m128i v = _mm_loadl_epi64((const __m128i *)&buf[c]);
+                __m128 fv = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+                __m128i l = _mm_cvttps_epi32(_mm_mul_ps(_mm_mul_ps(fv, fpan_l), div7));
+                __m128i r = _mm_cvttps_epi32(_mm_mul_ps(_mm_mul_ps(fv, fpan_r), div7));
+
+                _mm_storeu_si128((__m128i *)&out_l[c], _mm_add_epi32(_mm_loadu_si128((__m128i *)&out_l[c]), l));
+                _mm_storeu_si128((__m128i *)&out_r[c], _mm_add_epi32(_mm_loadu_si128((__m128i *)&out_r[c]), r));
+        }
+#elif defined(__ARM_NEON)
+        for (; c + 4 <= len; c += 4) {
+                float32x4_t fv = vcvtq_f32_s32(vmovl_s16(vld1_s16(&buf[c])));
+                int32x4_t l = vcvtq_s32_f32(vmulq_n_f32(vmulq_n_f32(fv, (float)pan_l), 1.0f / 7.0f));
+                int32x4_t r = vcvtq_s32_f32(vmulq_n_f32(vmulq_n_f32(fv, (float)pan_r), 1.0f / 7.0f));
+
+                vst1q_s32(&out_l[c], vaddq_s32(vld1q_s32(&out_l[c]), l));
+                vst1q_s32(&out_r[c], vaddq_s32(vld1q_s32(&out_r[c]), r));
+        }
+#endif
+        for (; c < len; c++) {
+                out_l[c] += (buf[c] * pan_l) / 7;
+                out_r[c] += (buf[c] * pan_r) / 7;
+        }
+}
+
+/*Render len samples (at most GUS_BLOCK_LEN) into the wave buffer*/
+static void gus_render(gus_t *gus, int len) {
+        int32_t out_l[GUS_BLOCK_LEN], out_r[GUS_BLOCK_LEN];
+        int16_t buf[GUS_BLOCK_LEN];
+        int16_t *wave_l = &gus->wave[0][gus->wave_pos];
+        int16_t *wave_r = &gus->wave[1][gus->wave_pos];
+        int update_irqs = 0;
+        int c, d;
+
+        gus->wave_pos += len;
+
+        if ((gus->reset & 3) != 3) {
+                memset(wave_l, 0, len * sizeof(int16_t));
+                memset(wave_r, 0, len * sizeof(int16_t));
+                return;
+        }
+
+        memset(out_l, 0, len * sizeof(int32_t));
+        memset(out_r, 0, len * sizeof(int32_t));
+
+        for (d = 0; d < 32; d++) {
+                if ((gus->ctrl[d] & 3) && (gus->rctrl[d] & 3))
+                        continue; /*Voice and ramp both stopped*/
+
+                if (gus_render_voice(gus, d, buf, len, &update_irqs))
+                        gus_mix_voice(out_l, out_r, buf, gus->pan_l[d], gus->pan_r[d], len);
+        }
+
+        c = 0;
+#if defined(__SSE2__)
+        for (; c + 8 <= len; c += 8) {
+                __m128i l = _mm_packs_epi32(_mm_loadu_si128((__m128i *)&out_l[c]), _mm_loadu_si128((__m128i *)&out_l[c + 4]));
+                __m128i r = _mm_packs_epi32(_mm_loadu_si128((__m128i *)&out_r[c]), _mm_loadu_si128((__m128i *)&out_r[c + 4]));
+
+                _mm_storeu_si128((__m128i *)&wave_l[c], l);
+                _mm_storeu_si128((__m128i *)&wave_r[c], r);
+        }
+#elif defined(__ARM_NEON)
+        for (; c + 4 <= len; c += 4) {
+                vst1_s16(&wave_l[c], vqmovn_s32(vld1q_s32(&out_l[c])));
+                vst1_s16(&wave_r[c], vqmovn_s32(vld1q_s32(&out_r[c])));
+        }
+#endif
+        for (; c < len; c++) {
+                if (out_l[c] < -32768)
+                        wave_l[c] = -32768;
+                else if (out_l[c] > 32767)
+                        wave_l[c] = 32767;
+                else
+                        wave_l[c] = out_l[c];
+                if (out_r[c] < -32768)
+                        wave_r[c] = -32768;
+                else if (out_r[c] > 32767)
+                        wave_r[c] = 32767;
+                else
+                        wave_r[c] = out_r[c];
+        }
+
         if (update_irqs)
                 gus_update_int_status(gus);
 }
 
+/*Render every sample due up to the current time. A sample is due once the integer part of its timestamp has
+  been reached, matching when a timer with that timestamp would have fired*/
+static void gus_wave_sync(gus_t *gus) {
+        int64_t due = (int64_t)(((uint64_t)(tsc + 1) << 32) - gus->samp_ts);
+        uint64_t count;
+
+        if (due <= 0)
+                return;
+
+        count = (due - 1) / gus->samp_latch + 1;
+        gus->samp_ts += count * gus->samp_latch;
+
+        while (count) {
+                int len = (count > GUS_BLOCK_LEN) ? GUS_BLOCK_LEN : count;
+
+                if (gus->wave_pos + len > MAXSOUNDBUFLEN) {
+                        gus_update(gus);
+                        if (gus->wave_pos + len > MAXSOUNDBUFLEN)
+                                gus->wave_pos = 0; /*Output hasn't advanced - drop the oldest samples*/
+                }
+                gus_render(gus, len);
+                count -= len;
+        }
+}
+
+/*Return the number of samples until a boundary crossing raises a voice IRQ, counting the sample that crosses.
+  Only crossings that raise an IRQ are externally visible before the next register access, so rendering can run
+  in blocks up to the next one. Wrapping below zero is ignored; that can only cause an early, harmless, wakeup*/
+static int gus_next_irq(gus_t *gus) {
+        int next = GUS_BLOCK_LEN;
+        int d;
+
+        if ((gus->reset & 3) != 3)
+                return next;
+
+        for (d = 0; d < 32; d++) {
+                uint32_t k = next;
+
+                if (!(gus->ctrl[d] & 3) && (gus->ctrl[d] & 0x20) && !gus->waveirqs[d]) {
+                        uint32_t freq = gus->freq[d] >> 1;
+                        uint32_t cur = gus->cur[d];
+
+                        if (gus->ctrl[d] & 0x40) {
+                                if (cur <= gus->start[d] + freq)
+                                        k = 1;
+                                else if (freq)
+                                        k = (cur - gus->start[d] - 1) / freq + 1;
+                        } else {
+                                if (cur + freq >= gus->end[d])
+                                        k = 1;
+                                else if (freq)
+                                        k = (gus->end[d] - cur - 1) / freq + 1;
+                        }
+                        if (k < next)
+                                next = k;
+                }
+                if (!(gus->rctrl[d] & 3) && (gus->rctrl[d] & 0x20) && !gus->rampirqs[d]) {
+                        int rfreq = gus->rfreq[d];
+                        int rcur = gus->rcur[d];
+
+                        /*The distances are taken as unsigned so that a far out of range volume can't overflow*/
+                        k = next;
+                        if (gus->rctrl[d] & 0x40) {
+                                if (rcur - rfreq <= gus->rstart[d])
+                                        k = 1;
+                                else if (rfreq)
+                                        k = ((uint32_t)rcur - (uint32_t)gus->rstart[d] - 1) / rfreq + 1;
+                        } else {
+                                if (rcur + rfreq >= gus->rend[d])
+                                        k = 1;
+                                else if (rfreq)
+                                        k = ((uint32_t)gus->rend[d] - (uint32_t)rcur - 1) / rfreq + 1;
+                        }
+                        if (k < next)
+                                next = k;
+                }
+        }
+
+        return next;
+}
+
+/*Set the wave timer to fire on the sample that raises the next voice IRQ, or after a full block*/
+static void gus_wave_schedule(gus_t *gus) {
+        uint64_t target = gus->samp_ts + (gus_next_irq(gus) - 1) * gus->samp_latch;
+        int64_t delay = (int64_t)(target - ((uint64_t)tsc << 32));
+
+        timer_set_delay_u64(&gus->samp_timer, (delay > 0) ? delay : 0);
+}
+
+void gus_poll_wave(void *p) {
+        gus_t *gus = (gus_t *)p;
+
+        gus_wave_sync(gus);
+        gus_wave_schedule(gus);
+}
+
 static void gus_get_buffer(int32_t *buffer, int len, void *p) {
         gus_t *gus = (gus_t *)p;
         int c;
 
+        gus_wave_sync(gus);
         gus_update(gus);
 
         for (c = 0; c < len * 2; c++) {
@@ -1103,6 +1338,7 @@ void *gus_init() {
         gus->voices = 14;
 
         gus->samp_latch = (uint64_t)(TIMER_USEC * (1000000.0 / 44100.0));
+        gus->samp_ts = (uint64_t)tsc << 32;
 
         gus->t1l = gus->t2l = 0xff;
 
@@ -1129,10 +1365,12 @@ void gus_close(void *p) {
 void gus_speed_changed(void *p) {
         gus_t *gus = (gus_t *)p;
 
+        gus_wave_sync(gus);
         if (gus->voices < 14)
                 gus->samp_latch = (uint64_t)(TIMER_USEC * (1000000.0 / 44100.0));
         else
                 gus->samp_latch = (uint64_t)(TIMER_USEC * (1000000.0 / gusfreqs[gus->voices - 14]));
+        gus_wave_schedule(gus);
 }
 
 static void gus_add_status_info(char *s, int max_len, void *p) {
@@ -0,0 +1,103 @@
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "sound_mixer.h"
+
+void sound_mix_add(int32_t *dst, const int32_t *src, int len) {
+        int c = 0;
+
+#if defined(__SSE2__)
+        for (; c + 4 <= len; c += 4) {
+                __m128i v = _mm_add_epi32(_mm_loadu_si128((__m128i *)&dst[c]), _mm_loadu_si128((const __m128i *)&src[c]));
+
+                _mm_storeu_si128((__m128i *)&dst[c], v);
+        }
+#elif defined(__ARM_NEON)
+        for (; c + 4 <= len; c += 4)
+                vst1q_s32(&dst[c], vaddq_s32(vld1q_s32(&dst[c]), vld1q_s32(&src[c])));
+#endif
+        for (; c < len; c++)
+                dst[c] += src[c];
+}
+
+/*Scaled samples are truncated towards zero, the same as the scalar tail*/
+void sound_mix_add_gain(int32_t *dst, const int32_t *src, int len, float gain_l, float gain_r) {
+        int c = 0;
+
+#if defined(__SSE2__)
+        const __m128 gain = _mm_setr_ps(gain_l, gain_r, gain_l, gain_r);
+
+        for (; c + 4 <= len; c += 4) {
+                __m128 fv = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&src[c]));
+                __m128i v = _mm_cvttps_epi32(_mm_mul_ps(fv, gain));
+
+                _mm_storeu_si128((__m128i *)&dst[c], _mm_add_epi32(_mm_loadu_si128((__m128i *)&dst[c]), v));
+        }
+#elif defined(__ARM_NEON)
+        const float gains[4] = {gain_l, gain_r, gain_l, gain_r};
+        const float32x4_t gain = vld1q_f32(gains);
+
+        for (; c + 4 <= len; c += 4) {
+                int32x4_t v = vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(vld1q_s32(&src[c])), gain));
+
+                vst1q_s32(&dst[c], vaddq_s32(vld1q_s32(&dst[c]), v));
+        }
+#endif
+        for (; c < len; c += 2) {
+                dst[c] += (int32_t)((float)src[c] * gain_l);
+                dst[c + 1] += (int32_t)((float)src[c + 1] * gain_r);
+        }
+}
+
+/*In place, truncating as sound_mix_add_gain() does*/
+void sound_mix_scale(int32_t *buf, int len, float gain) {
+        int c = 0;
+
+#if defined(__SSE2__)
+        const __m128 gain_v = _mm_set1_ps(gain);
+
+        for (; c + 4 <= len; c += 4) {
+                __m128 fv = _mm_cvtepi32_ps(_mm_loadu_si128((__m128i *)&buf[c]));
+
+                _mm_storeu_si128((__m128i *)&buf[c], _mm_cvttps_epi32(_mm_mul_ps(fv, gain_v)));
+        }
+#elif defined(__ARM_NEON)
+        const float32x4_t gain_v = vdupq_n_f32(gain);
+
+        for (; c + 4 <= len; c += 4)
+                vst1q_s32(&buf[c], vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(vld1q_s32(&buf[c])), gain_v)));
+#endif
+        for (; c < len; c++)
+                buf[c] = (int32_t)((float)buf[c] * gain);
+}
+
+void sound_mix_clamp16(int16_t *dst, const int32_t *src, int len) {
+        int c = 0;
+
+#if defined(__SSE2__)
+        for (; c + 8 <= len; c += 8) {
+                __m128i a = _mm_loadu_si128((const __m128i *)&src[c]);
+                __m128i b = _mm_loadu_si128((const __m128i *)&src[c + 4]);
+
+                _mm_storeu_si128((__m128i *)&dst[c], _mm_packs_epi32(a, b));
+        }
+#elif defined(__ARM_NEON)
+        for (; c + 8 <= len; c += 8) {
+                int16x4_t a = vqmovn_s32(vld1q_s32(&src[c]));
+                int16x4_t b = vqmovn_s32(vld1q_s32(&src[c + 4]));
+
+                vst1q_s16(&dst[c], vcombine_s16(a, b));
+        }
+#endif
+        for (; c < len; c++) {
+                if (src[c] < -32768)
+                        dst[c] = -32768;
+                else if (src[c] > 32767)
+                        dst[c] = 32767;
+                else
+                        dst[c] = src[c];
+        }
+}
@@ -0,0 +1,12 @@
+/*The NukedOPL core built as the per-sample reference (no envelope-off fast path, no block generation), with
+  its external symbols renamed so it can be linked next to the normal core in nukedopl-test*/
+#define OPL3_REFERENCE_PATH
+#define OPL3_Generate ref_OPL3_Generate
+#define OPL3_GenerateBlock ref_OPL3_GenerateBlock
+#define OPL3_GenerateResampled ref_OPL3_GenerateResampled
+#define OPL3_GenerateStream ref_OPL3_GenerateStream
+#define OPL3_Reset ref_OPL3_Reset
+#define OPL3_WriteAddr ref_OPL3_WriteAddr
+#define OPL3_WriteReg ref_OPL3_WriteReg
+#define envelope_gen ref_envelope_gen
+#include "../dosbox/nukedopl.cpp"
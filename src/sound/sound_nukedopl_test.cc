@@ -0,0 +1,283 @@
+/*Standalone NukedOPL regression test. Plays OPL register streams through the normal core (block generation and
+  envelope-off fast path) and through the per-sample reference core (sound_nukedopl_ref.cc), checks that the 48 kHz
+  output is bit-identical, and reports the time taken by each.
+
+  nukedopl-test [dump.dro ...]
+
+  With no arguments a set of generated register programs is played, covering OPL2 and OPL3 modes, 4-op
+  connections, rhythm mode, all waveforms, key on/off and arbitrary register writes. Otherwise each argument is a
+  DOSBox raw OPL capture (DRO version 2).
+
+  Output is rendered in varying lengths, as sound_dbopl.cc asks for it, so that block and resampler boundaries
+  land everywhere. Exits with status 1 on the first difference*/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "dosbox/nukedopl.h"
+
+void ref_OPL3_Reset(opl3_chip *chip, Bit32u samplerate);
+void ref_OPL3_WriteReg(opl3_chip *chip, Bit16u reg, Bit8u v);
+void ref_OPL3_GenerateStream(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples);
+
+#define TEST_SAMPLE_RATE 48000
+#define TEST_MAX_CHUNK 1024
+#define TEST_PROGRAMS 200
+
+typedef struct opl_event_t {
+        uint32_t delay; /*Samples rendered before this write*/
+        uint16_t reg;
+        uint8_t val;
+        uint8_t chip;
+} opl_event_t;
+
+static uint32_t test_seed;
+
+static uint32_t test_rand() {
+        test_seed ^= test_seed << 13;
+        test_seed ^= test_seed >> 17;
+        test_seed ^= test_seed << 5;
+        return test_seed;
+}
+
+static void test_write(std::vector<opl_event_t> &events, uint32_t delay, uint16_t reg, uint8_t val) {
+        opl_event_t event = {delay, reg, val, 0};
+
+        events.push_back(event);
+}
+
+/*Random voices, rhythm and stray writes, with a few milliseconds between each change*/
+static void test_generate(std::vector<opl_event_t> &events, int program) {
+        static const uint8_t slot_offset[9] = {0x00, 0x01, 0x02, 0x08, 0x09, 0x0a, 0x10, 0x11, 0x12};
+        int opl3 = program & 1;
+        int step;
+
+        test_seed = (program + 1) * 2654435761u;
+
+        test_write(events, 0, 0x105, opl3);
+        test_write(events, 0, 0x001, 0x20);
+        if (opl3)
+                test_write(events, 0, 0x104, test_rand() & 0x3f);
+
+        for (step = 0; step < 400; step++) {
+                uint32_t delay = test_rand() % (TEST_SAMPLE_RATE / 100);
+                int action = test_rand() % 10;
+                int ch = test_rand() % (opl3 ? 18 : 9);
+                uint16_t bank = (ch >= 9) ? 0x100 : 0;
+                int c = ch % 9;
+
+                if (action < 6) {
+                        int op;
+
+                        for (op = 0; op < 2; op++) {
+                                uint16_t off = bank | (slot_offset[c] + op * 3);
+
+                                test_write(events, delay, 0x20 | off, test_rand());
+                                test_write(events, 0, 0x40 | off, test_rand());
+                                test_write(events, 0, 0x60 | off, test_rand());
+                                test_write(events, 0, 0x80 | off, test_rand());
+                                test_write(events, 0, 0xe0 | off, test_rand() & 7);
+                                delay = 0;
+                        }
+                        test_write(events, 0, bank | (0xc0 + c), test_rand() | 0x30);
+                        test_write(events, 0, bank | (0xa0 + c), test_rand());
+                        test_write(events, 0, bank | (0xb0 + c), test_rand() & 0x3f);
+                } else if (action < 8) {
+                        test_write(events, delay, bank | (0xb0 + c), test_rand() & 0x1f); /*Key off*/
+                } else if (action < 9) {
+                        test_write(events, delay, 0xbd, test_rand());
+                } else {
+                        test_write(events, delay, test_rand() & 0x1ff, test_rand());
+                }
+        }
+        /*Let the last notes release*/
+        test_write(events, TEST_SAMPLE_RATE / 2, 0xbd, 0);
+}
+
+static uint16_t test_read16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static uint32_t test_read32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+/*Returns the number of chips, or 0 if the file can't be used*/
+static int test_load_dro(std::vector<opl_event_t> &events, const char *fn) {
+        std::vector<uint8_t> data;
+        uint8_t buf[4096];
+        size_t len, pos, end;
+        uint32_t delay_ms = 0;
+        int hw_type, short_delay, long_delay, codemap_len;
+        const uint8_t *codemap;
+        FILE *f = fopen(fn, "rb");
+
+        if (!f) {
+                fprintf(stderr, "can't open %s\n", fn);
+                return 0;
+        }
+        while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+                data.insert(data.end(), buf, buf + len);
+        fclose(f);
+
+        if (data.size() < 26 || memcmp(&data[0], "DBRAWOPL", 8) || test_read16(&data[8]) != 2) {
+                fprintf(stderr, "%s is not a DRO version 2 file\n", fn);
+                return 0;
+        }
+        hw_type = data[20];
+        short_delay = data[23];
+        long_delay = data[24];
+        codemap_len = data[25];
+        if (data[21] != 0 || data[22] != 0 || hw_type > 2 || codemap_len > 128 || data.size() < 26u + codemap_len) {
+                fprintf(stderr, "%s uses an unsupported DRO format\n", fn);
+                return 0;
+        }
+        codemap = &data[26];
+
+        pos = 26 + codemap_len;
+        end = pos + (size_t)test_read32(&data[12]) * 2;
+        if (end > data.size())
+                end = data.size() & ~(size_t)1;
+        for (; pos + 1 < end; pos += 2) {
+                int code = data[pos];
+                uint8_t val = data[pos + 1];
+                opl_event_t event;
+
+                if (code == short_delay) {
+                        delay_ms += val + 1;
+                        continue;
+                }
+                if (code == long_delay) {
+                        delay_ms += (val + 1) << 8;
+                        continue;
+                }
+                if ((code & 0x7f) >= codemap_len)
+                        continue;
+
+                event.delay = delay_ms * (TEST_SAMPLE_RATE / 1000);
+                event.val = val;
+                if (hw_type == 1) {
+                        /*Dual OPL2, the bank selects the chip*/
+                        event.reg = codemap[code & 0x7f];
+                        event.chip = code >> 7;
+                } else {
+                        event.reg = codemap[code & 0x7f] | ((code & 0x80) ? 0x100 : 0);
+                        event.chip = 0;
+                }
+                events.push_back(event);
+                delay_ms = 0;
+        }
+        if (delay_ms)
+                test_write(events, delay_ms * (TEST_SAMPLE_RATE / 1000), 0xbd, 0);
+
+        return (hw_type == 1) ? 2 : 1;
+}
+
+static void test_render(opl3_chip *chips, int nr_chips, bool ref, uint32_t samples, std::vector<int16_t> &out) {
+        int16_t buf[TEST_MAX_CHUNK * 2];
+
+        while (samples) {
+                uint32_t len = 1 + test_rand() % TEST_MAX_CHUNK;
+                int c;
+
+                if (len > samples)
+                        len = samples;
+                for (c = 0; c < nr_chips; c++) {
+                        if (ref)
+                                ref_OPL3_GenerateStream(&chips[c], buf, len);
+                        else
+                                OPL3_GenerateStream(&chips[c], buf, len);
+                        out.insert(out.end(), buf, buf + len * 2);
+                }
+                samples -= len;
+        }
+}
+
+static double test_run(const std::vector<opl_event_t> &events, int nr_chips, bool ref, std::vector<int16_t> &out) {
+        static opl3_chip chips[2];
+        size_t i;
+        int c;
+
+        out.clear();
+        test_seed = 0x12345678; /*Same chunk lengths for both cores*/
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (c = 0; c < nr_chips; c++) {
+                if (ref)
+                        ref_OPL3_Reset(&chips[c], TEST_SAMPLE_RATE);
+                else
+                        OPL3_Reset(&chips[c], TEST_SAMPLE_RATE);
+        }
+        for (i = 0; i < events.size(); i++) {
+                test_render(chips, nr_chips, ref, events[i].delay, out);
+                if (ref)
+                        ref_OPL3_WriteReg(&chips[events[i].chip], events[i].reg, events[i].val);
+                else
+                        OPL3_WriteReg(&chips[events[i].chip], events[i].reg, events[i].val);
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+}
+
+/*Returns false if the outputs differ*/
+static bool test_compare(const char *name, const std::vector<opl_event_t> &events, int nr_chips, double *ref_time,
+                         double *block_time, uint64_t *samples) {
+        std::vector<int16_t> ref_out, block_out;
+        size_t c;
+
+        *ref_time += test_run(events, nr_chips, true, ref_out);
+        *block_time += test_run(events, nr_chips, false, block_out);
+        *samples += ref_out.size() / 2;
+
+        if (ref_out.size() != block_out.size()) {
+                printf("%s: output length differs, %u / %u\n", name, (unsigned)ref_out.size(), (unsigned)block_out.size());
+                return false;
+        }
+        for (c = 0; c < ref_out.size(); c++) {
+                if (ref_out[c] != block_out[c]) {
+                        printf("%s: differs at sample %u, reference %d, block %d\n", name, (unsigned)(c / 2), ref_out[c],
+                               block_out[c]);
+                        return false;
+                }
+        }
+        return true;
+}
+
+static void test_report(const char *name, uint64_t samples, double ref_time, double block_time) {
+        printf("%-24s %8.1f s of audio, reference %7.3f s, block %7.3f s, %.2fx\n", name,
+               (double)samples / TEST_SAMPLE_RATE, ref_time, block_time, ref_time / block_time);
+}
+
+int main(int argc, char **argv) {
+        double ref_time = 0.0, block_time = 0.0;
+        uint64_t samples = 0;
+        int c;
+
+        if (argc == 1) {
+                for (c = 0; c < TEST_PROGRAMS; c++) {
+                        std::vector<opl_event_t> events;
+                        char name[32];
+
+                        test_generate(events, c);
+                        snprintf(name, sizeof(name), "program %d", c);
+                        if (!test_compare(name, events, 1, &ref_time, &block_time, &samples))
+                                return 1;
+                }
+                test_report("generated programs", samples, ref_time, block_time);
+                return 0;
+        }
+
+        for (c = 1; c < argc; c++) {
+                std::vector<opl_event_t> events;
+                int nr_chips = test_load_dro(events, argv[c]);
+                uint64_t file_samples = 0;
+                double file_ref_time = 0.0, file_block_time = 0.0;
+
+                if (!nr_chips)
+                        return 1;
+                if (!test_compare(argv[c], events, nr_chips, &file_ref_time, &file_block_time, &file_samples))
+                        return 1;
+                test_report(argv[c], file_samples, file_ref_time, file_block_time);
+        }
+        return 0;
+}
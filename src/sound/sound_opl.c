@@ -9,6 +9,10 @@
 
 /*Interfaces between PCem and the actual OPL emulator*/
 
+/*Chips a logged write goes to, when the chip cores run on the audio thread*/
+#define OPL_SYNTH_CHIP0 (1 << 16)
+#define OPL_SYNTH_CHIP1 (1 << 17)
+
 uint8_t opl2_read(uint16_t a, void *priv) {
         opl_t *opl = (opl_t *)priv;
 
@@ -19,6 +23,12 @@ uint8_t opl2_read(uint16_t a, void *priv) {
 void opl2_write(uint16_t a, uint8_t v, void *priv) {
         opl_t *opl = (opl_t *)priv;
 
+        if (opl->synth) {
+                sound_synth_write(opl->synth, a | OPL_SYNTH_CHIP0 | OPL_SYNTH_CHIP1, v);
+                opl_write_timers(0, a, v);
+                opl_write_timers(1, a, v);
+                return;
+        }
         opl2_update2(opl);
         opl_write(0, a, v);
         opl_write(1, a, v);
@@ -34,6 +44,11 @@ uint8_t opl2_l_read(uint16_t a, void *priv) {
 void opl2_l_write(uint16_t a, uint8_t v, void *priv) {
         opl_t *opl = (opl_t *)priv;
 
+        if (opl->synth) {
+                sound_synth_write(opl->synth, a | OPL_SYNTH_CHIP0, v);
+                opl_write_timers(0, a, v);
+                return;
+        }
         opl2_update2(opl);
         opl_write(0, a, v);
 }
@@ -48,6 +63,11 @@ uint8_t opl2_r_read(uint16_t a, void *priv) {
 void opl2_r_write(uint16_t a, uint8_t v, void *priv) {
         opl_t *opl = (opl_t *)priv;
 
+        if (opl->synth) {
+                sound_synth_write(opl->synth, a | OPL_SYNTH_CHIP1, v);
+                opl_write_timers(1, a, v);
+                return;
+        }
         opl2_update2(opl);
         opl_write(1, a, v);
 }
@@ -62,31 +82,58 @@ uint8_t opl3_read(uint16_t a, void *priv) {
 void opl3_write(uint16_t a, uint8_t v, void *priv) {
         opl_t *opl = (opl_t *)priv;
 
+        if (opl->synth) {
+                sound_synth_write(opl->synth, a | OPL_SYNTH_CHIP0, v);
+                opl_write_timers(0, a, v);
+                return;
+        }
         opl3_update2(opl);
         opl_write(0, a, v);
 }
 
-void opl2_update2(opl_t *opl) {
-        if (opl->pos < sound_pos_global) {
-                opl2_update(0, &opl->buffer[opl->pos * 2], sound_pos_global - opl->pos);
-                opl2_update(1, &opl->buffer[opl->pos * 2 + 1], sound_pos_global - opl->pos);
-                for (; opl->pos < sound_pos_global; opl->pos++) {
+static void opl2_render(opl_t *opl, int end) {
+        if (opl->pos < end) {
+                opl2_update(0, &opl->buffer[opl->pos * 2], end - opl->pos);
+                opl2_update(1, &opl->buffer[opl->pos * 2 + 1], end - opl->pos);
+                for (; opl->pos < end; opl->pos++) {
                         opl->filtbuf[0] = opl->buffer[opl->pos * 2] = (opl->buffer[opl->pos * 2] / 2);
                         opl->filtbuf[1] = opl->buffer[opl->pos * 2 + 1] = (opl->buffer[opl->pos * 2 + 1] / 2);
                 }
         }
 }
 
-void opl3_update2(opl_t *opl) {
-        if (opl->pos < sound_pos_global) {
-                opl3_update(0, &opl->buffer[opl->pos * 2], sound_pos_global - opl->pos);
-                for (; opl->pos < sound_pos_global; opl->pos++) {
+static void opl3_render(opl_t *opl, int end) {
+        if (opl->pos < end) {
+                opl3_update(0, &opl->buffer[opl->pos * 2], end - opl->pos);
+                for (; opl->pos < end; opl->pos++) {
                         opl->filtbuf[0] = opl->buffer[opl->pos * 2] = (opl->buffer[opl->pos * 2] / 2);
                         opl->filtbuf[1] = opl->buffer[opl->pos * 2 + 1] = (opl->buffer[opl->pos * 2 + 1] / 2);
                 }
         }
 }
 
+/*With the chip cores on the audio thread, the buffer is only written by the synth thread, which is
+  always up to date by the time the sound handlers run*/
+void opl2_update2(opl_t *opl) {
+        if (!opl->synth)
+                opl2_render(opl, sound_pos_global);
+}
+
+void opl3_update2(opl_t *opl) {
+        if (!opl->synth)
+                opl3_render(opl, sound_pos_global);
+}
+
+static void opl2_synth_write(uint32_t addr, uint8_t val, void *p) {
+        if (addr & OPL_SYNTH_CHIP0)
+                opl_write_chip(0, addr & 0xffff, val);
+        if (addr & OPL_SYNTH_CHIP1)
+                opl_write_chip(1, addr & 0xffff, val);
+}
+
+static void opl2_synth_render(int end, void *p) { opl2_render((opl_t *)p, end); }
+static void opl3_synth_render(int end, void *p) { opl3_render((opl_t *)p, end); }
+
 void ym3812_timer_set_0(void *param, int timer, int64_t period) {
         opl_t *opl = (opl_t *)param;
 
@@ -121,6 +168,7 @@ static void opl_timer_callback11(void *p) { opl_timer_over(1, 1); }
 void opl2_init(opl_t *opl) {
         opl_init(ym3812_timer_set_0, opl, 0, 0, 0);
         opl_init(ym3812_timer_set_1, opl, 1, 0, 0);
+        opl->synth = sound_synth_add(opl2_synth_write, opl2_synth_render, opl);
         timer_add(&opl->timers[0][0], opl_timer_callback00, (void *)opl, 0);
         timer_add(&opl->timers[0][1], opl_timer_callback01, (void *)opl, 0);
         timer_add(&opl->timers[1][0], opl_timer_callback10, (void *)opl, 0);
@@ -129,6 +177,7 @@ void opl2_init(opl_t *opl) {
 
 void opl3_init(opl_t *opl, int opl_emu) {
         opl_init(ymf262_timer_set, opl, 0, 1, opl_emu);
+        opl->synth = sound_synth_add(opl2_synth_write, opl3_synth_render, opl);
         timer_add(&opl->timers[0][0], opl_timer_callback00, (void *)opl, 0);
         timer_add(&opl->timers[0][1], opl_timer_callback01, (void *)opl, 0);
 }
@@ -0,0 +1,297 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ibm.h"
+#include "sound.h"
+#include "sound_mixer.h"
+#include "sound_out.h"
+
+#define SOUND_RING_LEN 65536 /*Frames*/
+#define SOUND_RING_MASK (SOUND_RING_LEN - 1)
+
+/*Largest rate deviation the latency controller may apply. 0.5% is below what can be heard as a pitch
+  change*/
+#define SOUND_RATE_MAX_ADJ 0.005
+#define SOUND_RATE_GAIN 0.05
+
+char sound_backend_name[64] = "openal";
+char sound_output_file[512] = "sound.pcm";
+int sound_latency = 100;
+
+static sound_backend_t *backend;
+
+static int16_t ring[SOUND_RING_LEN * 2];
+static int ring_read, ring_fill;
+static int ring_priming;
+
+/*Resampler position between ring[ring_read] and the frame after, as a 32-bit fraction*/
+static uint32_t resample_frac;
+static double resample_ratio;
+static double fill_avg;
+static int16_t last_l, last_r;
+
+static int underruns, overruns;
+
+static int16_t out_buf[MAXSOUNDBUFLEN * 2];
+static int16_t cd_out_buf[CD_BUFLEN * 2];
+
+static FILE *null_file;
+
+static int null_init() {
+        if (!strcmp(sound_backend_name, "file")) {
+                null_file = fopen(sound_output_file, "wb");
+                if (!null_file) {
+                        pclog("sound_out: can't open %s\n", sound_output_file);
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+static void null_close() {
+        if (null_file)
+                fclose(null_file);
+        null_file = NULL;
+}
+
+static int null_get_space() { return SOUND_RING_LEN; }
+
+static void null_write(int16_t *buf, int frames) {
+        if (null_file)
+                fwrite(buf, frames * 2 * sizeof(int16_t), 1, null_file);
+}
+
+static void null_write_cd(int16_t *buf, int frames) {}
+
+/*Discards the output, or with the file backend writes it as raw 16-bit stereo 48 kHz PCM. Neither is
+  paced by real time, so they get the stream exactly as it was mixed*/
+static sound_backend_t sound_backend_null = {"null", 0, null_init, null_close, null_get_space, null_write, null_write_cd};
+static sound_backend_t sound_backend_file = {"file", 0, null_init, null_close, null_get_space, null_write, null_write_cd};
+
+static sound_backend_t *sound_backends[] = {&sound_backend_openal, &sound_backend_null, &sound_backend_file, NULL};
+
+void sound_out_init() {
+        int c;
+
+        backend = NULL;
+        for (c = 0; sound_backends[c]; c++) {
+                if (!strcmp(sound_backends[c]->name, sound_backend_name))
+                        backend = sound_backends[c];
+        }
+        if (!backend || !backend->init()) {
+                pclog("sound_out: backend %s not available, using null\n", sound_backend_name);
+                backend = &sound_backend_null;
+                backend->init();
+        }
+
+        ring_read = ring_fill = 0;
+        ring_priming = 1;
+        resample_frac = 0;
+        resample_ratio = 1.0;
+        fill_avg = 0.0;
+        last_l = last_r = 0;
+        underruns = overruns = 0;
+}
+
+void sound_out_close() {
+        if (backend)
+                backend->close();
+        backend = NULL;
+}
+
+static int sound_out_target() {
+        int target = (48000 * sound_latency) / 1000;
+
+        /*Data arrives and leaves one buffer at a time, and the device can ask for two buffers at once
+          when its clock has drifted a buffer ahead, so keep three in hand*/
+        if (target < sound_buf_len_al * 3)
+                target = sound_buf_len_al * 3;
+        if (target > SOUND_RING_LEN / 2)
+                target = SOUND_RING_LEN / 2;
+
+        return target;
+}
+
+static void sound_out_ring_put(int32_t *buf, int len) {
+        int write_pos;
+
+        if (len > SOUND_RING_LEN) {
+                buf += (len - SOUND_RING_LEN) * 2;
+                len = SOUND_RING_LEN;
+        }
+        if (ring_fill + len > SOUND_RING_LEN) {
+                /*Backend has stalled. Drop the oldest audio rather than the newest*/
+                int drop = ring_fill + len - SOUND_RING_LEN;
+
+                ring_read = (ring_read + drop) & SOUND_RING_MASK;
+                ring_fill -= drop;
+                overruns++;
+        }
+
+        write_pos = (ring_read + ring_fill) & SOUND_RING_MASK;
+        ring_fill += len;
+        while (len) {
+                int frames = len;
+
+                if (frames > SOUND_RING_LEN - write_pos)
+                        frames = SOUND_RING_LEN - write_pos;
+                sound_mix_clamp16(&ring[write_pos * 2], buf, frames * 2);
+                buf += frames * 2;
+                len -= frames;
+                write_pos = (write_pos + frames) & SOUND_RING_MASK;
+        }
+}
+
+static void sound_out_ring_get(int16_t *out, int frames) {
+        uint64_t step = (uint64_t)(resample_ratio * 4294967296.0);
+        int c;
+
+        for (c = 0; c < frames; c++) {
+                int16_t *a = &ring[ring_read * 2];
+                int16_t *b = &ring[((ring_read + 1) & SOUND_RING_MASK) * 2];
+                int frac = resample_frac >> 17;
+                uint64_t next = resample_frac + step;
+
+                out[c * 2] = a[0] + (((b[0] - a[0]) * frac) >> 15);
+                out[c * 2 + 1] = a[1] + (((b[1] - a[1]) * frac) >> 15);
+
+                resample_frac = (uint32_t)next;
+                ring_read = (ring_read + (int)(next >> 32)) & SOUND_RING_MASK;
+                ring_fill -= (int)(next >> 32);
+        }
+}
+
+/*Produce frames of output for a realtime backend. The ring must hold a frame beyond the last one
+  interpolated; if it runs out, the rest is filled from the last frame played and the ring primes again
+  to the target level before playing on*/
+static void sound_out_resample(int16_t *out, int frames) {
+        int target = sound_out_target();
+        double pos;
+        int c;
+
+        if (ring_priming) {
+                if (ring_fill < target) {
+                        for (c = 0; c < frames; c++) {
+                                out[c * 2] = last_l;
+                                out[c * 2 + 1] = last_r;
+                        }
+                        return;
+                }
+                ring_priming = 0;
+                fill_avg = ring_fill;
+        }
+
+        /*Steer the rate from a smoothed fill level, so single buffers arriving late don't wobble the
+          pitch*/
+        fill_avg += (ring_fill - fill_avg) * 0.0625;
+        resample_ratio = 1.0 + ((fill_avg - target) / target) * SOUND_RATE_GAIN;
+        if (resample_ratio > 1.0 + SOUND_RATE_MAX_ADJ)
+                resample_ratio = 1.0 + SOUND_RATE_MAX_ADJ;
+        if (resample_ratio < 1.0 - SOUND_RATE_MAX_ADJ)
+                resample_ratio = 1.0 - SOUND_RATE_MAX_ADJ;
+
+        /*The last frame interpolated is at (frames - 1) * ratio past the current position, and its
+          right-hand neighbour must be in the ring too*/
+        pos = (double)resample_frac / 4294967296.0;
+        if (pos + (frames - 1) * resample_ratio + 2.0 <= ring_fill) {
+                sound_out_ring_get(out, frames);
+        } else {
+                int avail = 0;
+
+                if (ring_fill - 2.0 - pos >= 0.0)
+                        avail = (int)((ring_fill - 2.0 - pos) / resample_ratio) + 1;
+                if (avail > frames)
+                        avail = frames;
+                sound_out_ring_get(out, avail);
+                if (avail) {
+                        last_l = out[(avail - 1) * 2];
+                        last_r = out[(avail - 1) * 2 + 1];
+                }
+                for (c = avail; c < frames; c++) {
+                        out[c * 2] = last_l;
+                        out[c * 2 + 1] = last_r;
+                }
+                underruns++;
+                ring_priming = 1;
+                return;
+        }
+
+        last_l = out[(frames - 1) * 2];
+        last_r = out[(frames - 1) * 2 + 1];
+}
+
+/*sound_gain is in dB*/
+static float sound_out_gain() { return (float)pow(10.0, (double)sound_gain / 20.0); }
+
+/*Called with each mixed buffer of len 48 kHz stereo frames. The output gain is applied to buf in place, so
+  that every backend gets it*/
+void sound_out_write(int32_t *buf, int len) {
+        if (!backend)
+                return;
+
+        if (sound_gain)
+                sound_mix_scale(buf, len * 2, sound_out_gain());
+        sound_out_ring_put(buf, len);
+
+        if (!backend->realtime) {
+                while (ring_fill) {
+                        int frames = ring_fill;
+
+                        if (frames > SOUND_RING_LEN - ring_read)
+                                frames = SOUND_RING_LEN - ring_read;
+                        backend->write(&ring[ring_read * 2], frames);
+                        ring_read = (ring_read + frames) & SOUND_RING_MASK;
+                        ring_fill -= frames;
+                }
+                return;
+        }
+
+        while (backend->get_space() >= sound_buf_len_al) {
+                sound_out_resample(out_buf, sound_buf_len_al);
+                backend->write(out_buf, sound_buf_len_al);
+        }
+}
+
+/*Called from the CD audio thread, which keeps running after the output has been closed*/
+void sound_out_write_cd(int16_t *buf) {
+        sound_backend_t *cd_backend = backend;
+
+        if (!cd_backend)
+                return;
+
+        if (sound_gain) {
+                float gain = sound_out_gain();
+                int c;
+
+                for (c = 0; c < CD_BUFLEN * 2; c++) {
+                        int32_t val = (int32_t)((float)buf[c] * gain);
+
+                        if (val < -32768)
+                                val = -32768;
+                        else if (val > 32767)
+                                val = 32767;
+                        cd_out_buf[c] = val;
+                }
+                buf = cd_out_buf;
+        }
+        cd_backend->write_cd(buf, CD_BUFLEN);
+}
+
+void sound_out_add_status_info(char *s, int max_len) {
+        char temps[256];
+
+        if (!backend)
+                return;
+
+        if (backend->realtime)
+                snprintf(temps, sizeof(temps),
+                         "Audio output : %s\nAudio buffered : %i ms (target %i ms)\nAudio rate : %+.3f%%\n"
+                         "Audio underruns : %i\nAudio overruns : %i\n",
+                         backend->name, (ring_fill * 1000) / 48000, (sound_out_target() * 1000) / 48000,
+                         (resample_ratio - 1.0) * 100.0, underruns, overruns);
+        else
+                snprintf(temps, sizeof(temps), "Audio output : %s\n", backend->name);
+
+        strncat(s, temps, max_len - strlen(s) - 1);
+}
@@ -709,6 +709,8 @@ void *pas16_init() {
 void pas16_close(void *p) {
         pas16_t *pas16 = (pas16_t *)p;
 
+        sb_dsp_close(&pas16->dsp);
+
         free(pas16);
 }
 
@@ -5,19 +5,24 @@
 #include "resid-fp/sid.h"
 #include "sound_resid.h"
 
+#define SID_CYCLES_PER_SEC (14318180.0 / 16.0)
+/*SID cycles per 48 kHz sample, 32.32 fixed point*/
+#define SID_CYCLES_PER_SAMPLE ((uint64_t)((SID_CYCLES_PER_SEC / 48000.0) * 4294967296.0))
+
 typedef struct psid_t {
         /* resid sid implementation */
         SIDFP *sid;
         int16_t last_sample;
+        uint64_t cycle_frac;
 } psid_t;
 
 psid_t *psid;
 
-void *sid_init() {
+void *sid_init(int resample) {
         //        psid_t *psid;
         int c;
-        sampling_method method = SAMPLE_INTERPOLATE;
-        float cycles_per_sec = 14318180.0 / 16.0;
+        sampling_method method = resample ? SAMPLE_RESAMPLE_INTERPOLATE : SAMPLE_INTERPOLATE;
+        float cycles_per_sec = SID_CYCLES_PER_SEC;
 
         psid = new psid_t;
         //        psid = (psid_t *)malloc(sizeof(sound_t));
@@ -80,18 +85,25 @@ void sid_write(uint16_t addr, uint8_t val, void *p) {
         psid->sid->write(addr & 0x1f, val);
 }
 
-#define CLOCK_DELTA(n) (int)(((14318180.0 * n) / 16.0) / 48000.0)
-
-static void fillbuf2(int &count, int16_t *buf, int len) {
-        int c;
-        c = psid->sid->clock(count, buf, len, 1);
-        if (!c)
-                *buf = psid->last_sample;
-        psid->last_sample = *buf;
-}
+/*Run the SID for exactly the cycles len samples take, carrying the fraction of a cycle over to the next
+  call, so the clock doesn't drift however finely rendering is split up*/
 void sid_fillbuf(int16_t *buf, int len, void *p) {
         //        psid_t *psid = (psid_t *)p;
-        int x = CLOCK_DELTA(len);
+        int16_t spare[4];
+        cycle_count delta;
+        int c;
 
-        fillbuf2(x, buf, len);
+        psid->cycle_frac += (uint64_t)len * SID_CYCLES_PER_SAMPLE;
+        delta = (cycle_count)(psid->cycle_frac >> 32);
+        psid->cycle_frac &= 0xffffffff;
+
+        c = psid->sid->clock(delta, buf, len, 1);
+        /*The SID's own sample timing can come out a sample over or under. Drop the extra sample or repeat
+          the last one rather than leaving cycles unrun*/
+        while (delta)
+                psid->sid->clock(delta, spare, 4, 1);
+        if (c)
+                psid->last_sample = buf[c - 1];
+        for (; c < len; c++)
+                buf[c] = psid->last_sample;
 }
@@ -0,0 +1,147 @@
+/*Standalone reSID-fp benchmark. Runs the SID as the SSI-2001 sets it up, with a simple three voice
+  pattern rewritten every 20 ms, and reports emulated SID cycles per second of host time for each
+  sampling method and FIR kernel the host supports.
+
+  resid-bench [seconds] [buffer length]
+
+  seconds is the emulated time run for each configuration (default 20), buffer length the number of
+  samples rendered per call (default 1024, roughly a mixer period; small values show the cost of
+  rendering a few samples at each register write)*/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "resid-fp/sid.h"
+
+#define SID_CYCLES_PER_SEC (14318180.0 / 16.0)
+#define SID_CYCLES_PER_SAMPLE ((uint64_t)((SID_CYCLES_PER_SEC / 48000.0) * 4294967296.0))
+
+static SIDFP *bench_create(sampling_method method) {
+        SIDFP *sid = new SIDFP;
+        int c;
+
+        sid->set_chip_model(MOS6581FP);
+        sid->set_voice_nonlinearity(0.96f);
+        sid->get_filter().set_distortion_properties(3.7e-3f, 2048.f, 1.2e-4f);
+        sid->get_filter().set_type3_properties(1.33e6f, 2.2e9f, 1.0056f, 7e3f);
+        sid->enable_filter(true);
+        sid->enable_external_filter(true);
+        sid->reset();
+        for (c = 0; c < 32; c++)
+                sid->write(c, 0);
+        sid->set_sampling_parameters((float)SID_CYCLES_PER_SEC, method, 48000.f, 0.9f * 48000.f / 2.f);
+        sid->input(0);
+
+        return sid;
+}
+
+/*Saw, pulse and noise voices, with the notes and filter cutoff moving every step*/
+static void bench_step(SIDFP *sid, int step) {
+        static const uint8_t waves[3] = {0x21, 0x41, 0x81};
+        int v;
+
+        for (v = 0; v < 3; v++) {
+                int freq = 0x0800 + ((step * (v + 3) * 131) & 0x3fff);
+
+                sid->write(v * 7 + 0, freq & 0xff);
+                sid->write(v * 7 + 1, freq >> 8);
+                sid->write(v * 7 + 2, 0x00);
+                sid->write(v * 7 + 3, 0x08);
+                sid->write(v * 7 + 5, 0x22);
+                sid->write(v * 7 + 6, 0xa8);
+                /*Gate off every eighth step, so the envelopes release and attack again*/
+                sid->write(v * 7 + 4, ((step & 7) == 7) ? (waves[v] & ~1) : waves[v]);
+        }
+        sid->write(0x15, 0);
+        sid->write(0x16, (step * 7) & 0xff);
+        sid->write(0x17, 0xf7);
+        sid->write(0x18, 0x1f);
+}
+
+static double bench_run(SIDFP *sid, int seconds, int buf_len, int16_t *buf) {
+        int samples_per_step = 48000 / 50;
+        int steps = seconds * 50;
+        uint64_t cycle_frac = 0;
+        int16_t spare[4];
+        int step, pos;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (step = 0; step < steps; step++) {
+                bench_step(sid, step);
+                for (pos = 0; pos < samples_per_step; pos += buf_len) {
+                        int len = (samples_per_step - pos < buf_len) ? samples_per_step - pos : buf_len;
+                        cycle_count delta;
+
+                        /*As sid_fillbuf() does*/
+                        cycle_frac += (uint64_t)len * SID_CYCLES_PER_SAMPLE;
+                        delta = (cycle_count)(cycle_frac >> 32);
+                        cycle_frac &= 0xffffffff;
+                        sid->clock(delta, &buf[pos], len, 1);
+                        while (delta)
+                                sid->clock(delta, spare, 4, 1);
+                }
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+}
+
+static void bench_report(const char *name, int seconds, double elapsed) {
+        double cycles = SID_CYCLES_PER_SEC * seconds;
+
+        printf("%-24s %8.3f s  %10.2f Mcycles/s  %7.1fx realtime\n", name, elapsed, cycles / elapsed / 1000000.0,
+               seconds / elapsed);
+}
+
+int main(int argc, char **argv) {
+        int seconds = (argc > 1) ? atoi(argv[1]) : 20;
+        int buf_len = (argc > 2) ? atoi(argv[2]) : 1024;
+        int16_t *buf = new int16_t[48000 / 50];
+        int16_t *ref = new int16_t[48000 / 50];
+        static const convolve_kernel kernels[] = {CONVOLVE_C, CONVOLVE_SSE, CONVOLVE_AVX2};
+        SIDFP *sid;
+        unsigned int k;
+
+        if (seconds < 1 || buf_len < 1) {
+                fprintf(stderr, "usage: %s [seconds] [buffer length]\n", argv[0]);
+                return 1;
+        }
+
+        printf("%d s emulated per run, %d samples per call\n", seconds, buf_len);
+
+        sid = bench_create(SAMPLE_INTERPOLATE);
+        bench_report("interpolate", seconds, bench_run(sid, seconds, buf_len, buf));
+        delete sid;
+
+        for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+                char name[64];
+                int c, diff = 0;
+
+                sid = bench_create(SAMPLE_RESAMPLE_INTERPOLATE);
+                if (!sid->set_convolve_kernel(kernels[k])) {
+                        delete sid;
+                        continue;
+                }
+                snprintf(name, sizeof(name), "resample (%s)", SIDFP::convolve_kernel_name(kernels[k]));
+                bench_report(name, seconds, bench_run(sid, seconds, buf_len, buf));
+                delete sid;
+
+                /*The SIMD kernels sum in a different order, and AVX2 also fuses the multiply and add, so the
+                  last step of output should agree with the C kernel to within a few LSBs rather than exactly*/
+                if (kernels[k] == CONVOLVE_C) {
+                        for (c = 0; c < 48000 / 50; c++)
+                                ref[c] = buf[c];
+                } else {
+                        for (c = 0; c < 48000 / 50; c++) {
+                                if (abs(buf[c] - ref[c]) > diff)
+                                        diff = abs(buf[c] - ref[c]);
+                        }
+                        printf("%-24s max difference from C kernel %d\n", "", diff);
+                }
+        }
+
+        delete[] buf;
+        delete[] ref;
+        return 0;
+}
@@ -26,6 +26,11 @@
 void pollsb(void *p);
 void sb_poll_i(void *p);
 
+static void sb_dsp_sync(sb_dsp_t *dsp);
+static void sb_dsp_output_schedule(sb_dsp_t *dsp);
+static void sb_dsp_input_schedule(sb_dsp_t *dsp);
+static void sb_dsp_dma_sync(void *p);
+
 //#define SB_DSP_RECORD_DEBUG
 //#define SB_TEST_RECORDING_SAW
 
@@ -121,6 +126,7 @@ void sb_irqc(sb_dsp_t *dsp, int irq8) {
 }
 
 void sb_dsp_reset(sb_dsp_t *dsp) {
+        dsp->out_running = dsp->in_running = 0;
         timer_disable(&dsp->output_timer);
         timer_disable(&dsp->input_timer);
 
@@ -178,6 +184,8 @@ void sb_doreset(sb_dsp_t *dsp) {
 }
 
 void sb_dsp_speed_changed(sb_dsp_t *dsp) {
+        sb_dsp_sync(dsp);
+
         if (dsp->sb_timeo < 256)
                 dsp->sblatcho = TIMER_USEC * (256 - dsp->sb_timeo);
         else
@@ -187,6 +195,9 @@ void sb_dsp_speed_changed(sb_dsp_t *dsp) {
                 dsp->sblatchi = TIMER_USEC * (256 - dsp->sb_timei);
         else
                 dsp->sblatchi = (uint64_t)(TIMER_USEC * (1000000.0f / (float)(dsp->sb_timei - 256)));
+
+        sb_dsp_output_schedule(dsp);
+        sb_dsp_input_schedule(dsp);
 }
 
 void sb_add_data(sb_dsp_t *dsp, uint8_t v) {
@@ -198,6 +209,14 @@ void sb_add_data(sb_dsp_t *dsp, uint8_t v) {
 #define ADPCM_26 2
 #define ADPCM_2 3
 
+/*Start the output sample clock if it isn't already running. The first sample is one period from now*/
+static void sb_dsp_output_start(sb_dsp_t *dsp) {
+        if (!dsp->out_running) {
+                dsp->out_running = 1;
+                dsp->out_ts = ((uint64_t)tsc << 32) + dsp->sblatcho;
+        }
+}
+
 void sb_start_dma(sb_dsp_t *dsp, int dma8, int autoinit, uint8_t format, int len) {
         dsp->sb_pausetime = -1;
         if (dma8) {
@@ -209,8 +228,7 @@ void sb_start_dma(sb_dsp_t *dsp, int dma8, int autoinit, uint8_t format, int len
                 if (dsp->sb_16_enable && dsp->sb_16_output)
                         dsp->sb_16_enable = 0;
                 dsp->sb_8_output = 1;
-                if (!timer_is_enabled(&dsp->output_timer))
-                        timer_set_delay_u64(&dsp->output_timer, dsp->sblatcho);
+                sb_dsp_output_start(dsp);
                 dsp->sbleftright = 0;
                 dsp->sbdacpos = 0;
                 //                pclog("Start 8-bit DMA addr %06X len %04X\n",dma.ac[1]+(dma.page[1]<<16),len);
@@ -223,12 +241,18 @@ void sb_start_dma(sb_dsp_t *dsp, int dma8, int autoinit, uint8_t format, int len
                 if (dsp->sb_8_enable && dsp->sb_8_output)
                         dsp->sb_8_enable = 0;
                 dsp->sb_16_output = 1;
-                if (!timer_is_enabled(&dsp->output_timer))
-                        timer_set_delay_u64(&dsp->output_timer, dsp->sblatcho);
+                sb_dsp_output_start(dsp);
                 //                pclog("Start 16-bit DMA addr %06X len %04X\n",dma16.ac[1]+(dma16.page[1]<<16),len);
         }
 }
 
+static void sb_dsp_input_start(sb_dsp_t *dsp) {
+        if (!dsp->in_running) {
+                dsp->in_running = 1;
+                dsp->in_ts = ((uint64_t)tsc << 32) + dsp->sblatchi;
+        }
+}
+
 void sb_start_dma_i(sb_dsp_t *dsp, int dma8, int autoinit, uint8_t format, int len) {
         if (dma8) {
 #ifdef SB_TEST_RECORDING_SAW
@@ -251,8 +275,7 @@ void sb_start_dma_i(sb_dsp_t *dsp, int dma8, int autoinit, uint8_t format, int l
                 if (dsp->sb_16_enable && !dsp->sb_16_output)
                         dsp->sb_16_enable = 0;
                 dsp->sb_8_output = 0;
-                if (!timer_is_enabled(&dsp->input_timer))
-                        timer_set_delay_u64(&dsp->input_timer, dsp->sblatchi);
+                sb_dsp_input_start(dsp);
                 //                pclog("Start 8-bit input DMA addr %06X len %04X\n",dma.ac[1]+(dma.page[1]<<16),len);
         } else {
 #ifdef SB_TEST_RECORDING_SAW
@@ -275,8 +298,7 @@ void sb_start_dma_i(sb_dsp_t *dsp, int dma8, int autoinit, uint8_t format, int l
                 if (dsp->sb_8_enable && !dsp->sb_8_output)
                         dsp->sb_8_enable = 0;
                 dsp->sb_16_output = 0;
-                if (!timer_is_enabled(&dsp->input_timer))
-                        timer_set_delay_u64(&dsp->input_timer, dsp->sblatchi);
+                sb_dsp_input_start(dsp);
                 //                pclog("Start 16-bit input DMA addr %06X len %04X\n",dma.ac[1]+(dma.page[1]<<16),len);
         }
         memset(dsp->record_buffer, 0, sizeof(dsp->record_buffer));
@@ -289,18 +311,34 @@ void sb_start_dma_i(sb_dsp_t *dsp, int dma8, int autoinit, uint8_t format, int l
 #endif
 }
 
-int sb_8_read_dma(sb_dsp_t *dsp) { return dma_channel_read(dsp->sb_8_dmanum); }
+int sb_8_read_dma(sb_dsp_t *dsp) {
+        if (dsp->dma_buf_active)
+                return (dsp->dma_buf_pos < dsp->dma_buf_len) ? dsp->dma_buf[dsp->dma_buf_pos++] : DMA_NODATA;
+        return dma_channel_read(dsp->sb_8_dmanum);
+}
 void sb_8_write_dma(sb_dsp_t *dsp, uint8_t val) {
-        dma_channel_write(dsp->sb_8_dmanum, val);
+        if (dsp->dma_in_active)
+                dsp->dma_in_buf[dsp->dma_in_len++] = val;
+        else
+                dma_channel_write(dsp->sb_8_dmanum, val);
 #ifdef SB_DSP_RECORD_DEBUG
         if (!soundf)
                 soundf = fopen("sound_dsp.pcm", "wb");
         fwrite(&val, 1, 1, soundf);
 #endif
 }
-int sb_16_read_dma(sb_dsp_t *dsp) { return dma_channel_read(dsp->sb_16_dmanum); }
+int sb_16_read_dma(sb_dsp_t *dsp) {
+        if (dsp->dma_buf_active)
+                return (dsp->dma_buf_pos < dsp->dma_buf_len) ? dsp->dma_buf[dsp->dma_buf_pos++] : DMA_NODATA;
+        return dma_channel_read(dsp->sb_16_dmanum);
+}
 int sb_16_write_dma(sb_dsp_t *dsp, uint16_t val) {
-        int ret = dma_channel_write(dsp->sb_16_dmanum, val);
+        int ret = 0;
+
+        if (dsp->dma_in_active)
+                dsp->dma_in_buf[dsp->dma_in_len++] = val;
+        else
+                ret = dma_channel_write(dsp->sb_16_dmanum, val);
 #ifdef SB_DSP_RECORD_DEBUG
         if (!soundf)
                 soundf = fopen("sound_dsp.pcm", "wb");
@@ -309,11 +347,20 @@ int sb_16_write_dma(sb_dsp_t *dsp, uint16_t val) {
         return (ret == DMA_NODATA);
 }
 
-void sb_dsp_setirq(sb_dsp_t *dsp, int irq) { dsp->sb_irqnum = irq; }
+void sb_dsp_setirq(sb_dsp_t *dsp, int irq) {
+        sb_dsp_sync(dsp);
+        dsp->sb_irqnum = irq;
+}
 
-void sb_dsp_setdma8(sb_dsp_t *dsp, int dma) { dsp->sb_8_dmanum = dma; }
+void sb_dsp_setdma8(sb_dsp_t *dsp, int dma) {
+        sb_dsp_sync(dsp);
+        dsp->sb_8_dmanum = dma;
+}
 
-void sb_dsp_setdma16(sb_dsp_t *dsp, int dma) { dsp->sb_16_dmanum = dma; }
+void sb_dsp_setdma16(sb_dsp_t *dsp, int dma) {
+        sb_dsp_sync(dsp);
+        dsp->sb_16_dmanum = dma;
+}
 void sb_exec_command(sb_dsp_t *dsp) {
         int temp, c;
         //        pclog("sb_exec_command : SB command %02X\n", dsp->sb_command);
@@ -360,12 +407,12 @@ void sb_exec_command(sb_dsp_t *dsp) {
                 sb_add_data(dsp, (dsp->record_buffer[dsp->record_pos_read] >> 8) ^ 0x80);
                 /*Due to the current implementation, I need to emulate a samplerate, even if this
                  * mode does not imply such samplerate. Position is increased in sb_poll_i*/
-                if (!timer_is_enabled(&dsp->input_timer)) {
+                if (!dsp->in_running) {
                         dsp->sb_timei = 256 - 22;
                         dsp->sblatchi = TIMER_USEC * 22;
                         temp = 1000000 / 22;
                         dsp->sb_freq = temp;
-                        timer_set_delay_u64(&dsp->input_timer, dsp->sblatchi);
+                        sb_dsp_input_start(dsp);
                 }
                 break;
         case 0x24: /*8-bit single cycle DMA input*/
@@ -442,8 +489,7 @@ void sb_exec_command(sb_dsp_t *dsp) {
         case 0x80: /*Pause DAC*/
                 dsp->sb_pausetime = dsp->sb_data[0] + (dsp->sb_data[1] << 8);
                 //                pclog("SB pause %04X\n",sb_pausetime);
-                if (!timer_is_enabled(&dsp->output_timer))
-                        timer_set_delay_u64(&dsp->output_timer, dsp->sblatcho);
+                sb_dsp_output_start(dsp);
                 break;
         case 0x90: /*High speed 8-bit autoinit DMA output*/
                 if (dsp->sb_type < SB2)
@@ -714,8 +760,7 @@ void sb_exec_command(sb_dsp_t *dsp) {
         }
 }
 
-void sb_write(uint16_t a, uint8_t v, void *priv) {
-        sb_dsp_t *dsp = (sb_dsp_t *)priv;
+static void sb_dsp_write(sb_dsp_t *dsp, uint16_t a, uint8_t v) {
         //        pclog("sb_write : Write soundblaster %04X %02X %04X:%04X %02X\n",a,v,CS,pc,dsp->sb_command);
         switch (a & 0xF) {
         case 6: /*Reset*/
@@ -764,6 +809,17 @@ void sb_write(uint16_t a, uint8_t v, void *priv) {
         }
 }
 
+/*DMA state only changes at the sample clocks, or through a write. Bring the DSP up to date before the
+  write, and reschedule the timers afterwards as the write may have started, stopped or retimed them*/
+void sb_write(uint16_t a, uint8_t v, void *priv) {
+        sb_dsp_t *dsp = (sb_dsp_t *)priv;
+
+        sb_dsp_sync(dsp);
+        sb_dsp_write(dsp, a, v);
+        sb_dsp_output_schedule(dsp);
+        sb_dsp_input_schedule(dsp);
+}
+
 uint8_t sb_read(uint16_t a, void *priv) {
         sb_dsp_t *dsp = (sb_dsp_t *)priv;
         //        pclog("sb_read : Read soundblaster %04X %04X:%04X\n",a,CS,pc);
@@ -830,6 +886,7 @@ void sb_dsp_init(sb_dsp_t *dsp, int type, int subtype, void *parent) {
         sb_doreset(dsp);
 
         timer_add(&dsp->output_timer, pollsb, dsp, 0);
+        dma_add_sync_handler(sb_dsp_dma_sync, dsp);
         timer_add(&dsp->input_timer, sb_poll_i, dsp, 0);
         timer_add(&dsp->wb_timer, sb_wb_clear, dsp, 0);
 
@@ -849,19 +906,31 @@ void sb_dsp_setaddr(sb_dsp_t *dsp, uint16_t addr) {
         }
 }
 
-void sb_dsp_set_stereo(sb_dsp_t *dsp, int stereo) { dsp->stereo = stereo; }
+void sb_dsp_set_stereo(sb_dsp_t *dsp, int stereo) {
+        sb_dsp_sync(dsp);
+        dsp->stereo = stereo;
+}
 
-void pollsb(void *p) {
-        sb_dsp_t *dsp = (sb_dsp_t *)p;
-        int tempi, ref;
+/*Hold the current output level into the buffer, up to sample end*/
+static void sb_dsp_fill(sb_dsp_t *dsp, int end) {
+        if (dsp->muted) {
+                dsp->sbdatl = 0;
+                dsp->sbdatr = 0;
+        }
+        for (; dsp->pos < end; dsp->pos++) {
+                dsp->buffer[dsp->pos * 2] = dsp->sbdatl;
+                dsp->buffer[dsp->pos * 2 + 1] = dsp->sbdatr;
+        }
+}
 
-        timer_advance_u64(&dsp->output_timer, dsp->sblatcho);
+/*Run one tick of the output sample clock*/
+static void sb_dsp_output_sample(sb_dsp_t *dsp) {
+        int tempi, ref;
 
         //        pclog("PollSB %i %i %i %i\n",sb_8_enable,sb_8_pause,sb_pausetime,sb_8_output);
         if (dsp->sb_8_enable && !dsp->sb_8_pause && dsp->sb_pausetime < 0 && dsp->sb_8_output) {
                 int data[2];
 
-                sb_dsp_update(dsp);
                 //                pclog("Dopoll %i %02X %i\n", sb_8_length, sb_8_format, sblatcho);
                 switch (dsp->sb_8_format) {
                 case 0x00: /*Mono unsigned*/
@@ -1038,7 +1107,7 @@ void pollsb(void *p) {
                                 dsp->sb_8_length = dsp->sb_8_autolen;
                         else {
                                 dsp->sb_8_enable = 0;
-                                timer_disable(&dsp->output_timer);
+                                dsp->out_running = 0;
                         }
                         sb_irq(dsp, 1);
                 }
@@ -1046,7 +1115,6 @@ void pollsb(void *p) {
         if (dsp->sb_16_enable && !dsp->sb_16_pause && dsp->sb_pausetime < 0 && dsp->sb_16_output) {
                 int data[2];
 
-                sb_dsp_update(dsp);
 
                 switch (dsp->sb_16_format) {
                 case 0x00: /*Mono unsigned*/
@@ -1091,7 +1159,7 @@ void pollsb(void *p) {
                                 dsp->sb_16_length = dsp->sb_16_autolen;
                         else {
                                 dsp->sb_16_enable = 0;
-                                timer_disable(&dsp->output_timer);
+                                dsp->out_running = 0;
                         }
                         sb_irq(dsp, 0);
                 }
@@ -1101,17 +1169,129 @@ void pollsb(void *p) {
                 if (dsp->sb_pausetime < 0) {
                         sb_irq(dsp, 1);
                         if (!dsp->sb_8_enable)
-                                timer_disable(&dsp->output_timer);
+                                dsp->out_running = 0;
                         //                        pclog("SB pause over\n");
                 }
         }
 }
 
-void sb_poll_i(void *p) {
+static int sb_dsp_samples_to_irq(int format, int length, int next) {
+        int samples;
+
+        switch (format) {
+        case 0x00: /*Mono*/
+        case 0x10:
+                samples = length + 1;
+                break;
+        case 0x20: /*Stereo*/
+        case 0x30:
+                samples = length / 2 + 1;
+                break;
+        default: /*ADPCM, which doesn't read DMA every sample*/
+                samples = 1;
+                break;
+        }
+        if (samples < 1)
+                samples = 1;
+
+        return (samples < next) ? samples : next;
+}
+
+/*Number of output samples up to and including the next one that can raise an IRQ or stop the output,
+  capped at SB_DSP_BLOCK_LEN*/
+static int sb_dsp_next_event(sb_dsp_t *dsp) {
+        int next = SB_DSP_BLOCK_LEN;
+
+        if (dsp->sb_pausetime > -1)
+                return (dsp->sb_pausetime < next) ? dsp->sb_pausetime + 1 : next;
+
+        if (dsp->sb_8_enable && !dsp->sb_8_pause && dsp->sb_8_output)
+                next = sb_dsp_samples_to_irq(dsp->sb_8_format, dsp->sb_8_length, next);
+        if (dsp->sb_16_enable && !dsp->sb_16_pause && dsp->sb_16_output)
+                next = sb_dsp_samples_to_irq(dsp->sb_16_format, dsp->sb_16_length, next);
+
+        return next;
+}
+
+/*Run len output samples, none of which but the last can raise an IRQ. PCM reads the same amount of DMA
+  every sample, so the block's DMA is fetched in one go*/
+static void sb_dsp_output_block(sb_dsp_t *dsp, int len) {
+        int out_8 = dsp->sb_8_enable && !dsp->sb_8_pause && dsp->sb_8_output;
+        int out_16 = dsp->sb_16_enable && !dsp->sb_16_pause && dsp->sb_16_output;
+        int c;
+
+        if (dsp->sb_pausetime < 0 && out_8 != out_16) {
+                int format = out_8 ? dsp->sb_8_format : dsp->sb_16_format;
+
+                if (!(format & 0xf)) {
+                        int n = dma_channel_read_block(out_8 ? dsp->sb_8_dmanum : dsp->sb_16_dmanum, dsp->dma_buf,
+                                                       (format & 0x20) ? len * 2 : len);
+
+                        dsp->dma_buf_len = (n == DMA_NODATA) ? 0 : (n & ~DMA_OVER);
+                        dsp->dma_buf_pos = 0;
+                        dsp->dma_buf_active = 1;
+                }
+        }
+
+        for (c = 0; c < len && dsp->out_running; c++) {
+                sb_dsp_fill(dsp, sound_pos_at(dsp->out_ts));
+                dsp->out_ts += dsp->sblatcho;
+                sb_dsp_output_sample(dsp);
+        }
+
+        dsp->dma_buf_active = 0;
+}
+
+/*Run all output samples due up to the current time*/
+static void sb_dsp_output_sync(sb_dsp_t *dsp) {
+        while (dsp->out_running && dsp->sblatcho) {
+                int64_t due = (int64_t)(((uint64_t)(tsc + 1) << 32) - dsp->out_ts);
+                int64_t count;
+                int len;
+
+                if (due <= 0)
+                        break;
+
+                count = (due - 1) / (int64_t)dsp->sblatcho + 1;
+                len = sb_dsp_next_event(dsp);
+                if (len > count)
+                        len = count;
+                sb_dsp_output_block(dsp, len);
+        }
+}
+
+/*Set the timer for the next sample that can raise an IRQ. Samples before it are only generated when
+  something looks at the output*/
+static void sb_dsp_output_schedule(sb_dsp_t *dsp) {
+        int64_t delay;
+
+        if (!dsp->out_running) {
+                timer_disable(&dsp->output_timer);
+                return;
+        }
+
+        delay = (int64_t)(dsp->out_ts + (sb_dsp_next_event(dsp) - 1) * dsp->sblatcho - ((uint64_t)tsc << 32));
+        timer_set_delay_u64(&dsp->output_timer, (delay > 0) ? delay : 0);
+}
+
+void pollsb(void *p) {
+        sb_dsp_t *dsp = (sb_dsp_t *)p;
+
+        sb_dsp_sync(dsp);
+        sb_dsp_output_schedule(dsp);
+}
+
+/*Called before the guest accesses the DMA controller, so it sees the address and count as of the current
+  sample. Reprogramming the channel can only delay the next IRQ, which pollsb() copes with by rescheduling*/
+static void sb_dsp_dma_sync(void *p) {
         sb_dsp_t *dsp = (sb_dsp_t *)p;
-        int processed = 0;
 
-        timer_advance_u64(&dsp->input_timer, dsp->sblatchi);
+        sb_dsp_sync(dsp);
+}
+
+/*Run one tick of the input sample clock*/
+static void sb_dsp_input_sample(sb_dsp_t *dsp) {
+        int processed = 0;
 
         //        pclog("PollSBi %i %i %i %i\n",sb_8_enable,sb_8_pause,sb_pausetime,sb_8_output);
         if (dsp->sb_8_enable && !dsp->sb_8_pause && dsp->sb_pausetime < 0 && !dsp->sb_8_output) {
@@ -1170,7 +1350,7 @@ void sb_poll_i(void *p) {
                                 dsp->sb_8_length = dsp->sb_8_autolen;
                         else {
                                 dsp->sb_8_enable = 0;
-                                timer_disable(&dsp->input_timer);
+                                dsp->in_running = 0;
                         }
                         sb_irq(dsp, 1);
                 }
@@ -1238,7 +1418,7 @@ void sb_poll_i(void *p) {
                                 dsp->sb_16_length = dsp->sb_16_autolen;
                         else {
                                 dsp->sb_16_enable = 0;
-                                timer_disable(&dsp->input_timer);
+                                dsp->in_running = 0;
                         }
                         sb_irq(dsp, 0);
                 }
@@ -1251,17 +1431,123 @@ void sb_poll_i(void *p) {
         }
 }
 
-void sb_dsp_update(sb_dsp_t *dsp) {
-        if (dsp->muted) {
-                dsp->sbdatl = 0;
-                dsp->sbdatr = 0;
+/*Number of input samples up to and including the next one that can raise an IRQ or stop the input,
+  capped at SB_DSP_BLOCK_LEN. A pause holds off input, so while one runs input is stepped in time with
+  the output*/
+static int sb_dsp_input_next_event(sb_dsp_t *dsp) {
+        int next = SB_DSP_BLOCK_LEN;
+
+        if (dsp->sb_pausetime > -1)
+                return 1;
+
+        if (dsp->sb_8_enable && !dsp->sb_8_pause && !dsp->sb_8_output)
+                next = sb_dsp_samples_to_irq(dsp->sb_8_format, dsp->sb_8_length, next);
+        if (dsp->sb_16_enable && !dsp->sb_16_pause && !dsp->sb_16_output)
+                next = sb_dsp_samples_to_irq(dsp->sb_16_format, dsp->sb_16_length, next);
+
+        return next;
+}
+
+/*Run up to len input samples, none of which but the last can raise an IRQ. As long as the DMA channel is
+  sure to take them, the samples' DMA writes are gathered and written in one go. A 16-bit sample whose
+  write fails is retried on the next sample, so once the channel might refuse a write, samples are run
+  one at a time with direct writes*/
+static void sb_dsp_input_block(sb_dsp_t *dsp, int len) {
+        int in_8 = dsp->sb_8_enable && !dsp->sb_8_pause && !dsp->sb_8_output;
+        int in_16 = dsp->sb_16_enable && !dsp->sb_16_pause && !dsp->sb_16_output;
+        int channel = in_8 ? dsp->sb_8_dmanum : dsp->sb_16_dmanum;
+        int c;
+
+        if (dsp->sb_pausetime < 0 && in_8 != in_16) {
+                int space = dma_channel_write_space(channel);
+
+                if ((in_8 ? dsp->sb_8_format : dsp->sb_16_format) & 0x20)
+                        space /= 2;
+
+                if (space) {
+                        if (len > space)
+                                len = space;
+                        dsp->dma_in_len = 0;
+                        dsp->dma_in_active = 1;
+                } else
+                        len = 1;
         }
-        for (; dsp->pos < sound_pos_global; dsp->pos++) {
-                dsp->buffer[dsp->pos * 2] = dsp->sbdatl;
-                dsp->buffer[dsp->pos * 2 + 1] = dsp->sbdatr;
+
+        for (c = 0; c < len && dsp->in_running; c++) {
+                dsp->in_ts += dsp->sblatchi;
+                sb_dsp_input_sample(dsp);
         }
+
+        if (dsp->dma_in_active) {
+                dsp->dma_in_active = 0;
+                dma_channel_write_block(channel, dsp->dma_in_buf, dsp->dma_in_len);
+        }
+}
+
+/*Run all input samples due up to the current time*/
+static void sb_dsp_input_sync(sb_dsp_t *dsp) {
+        while (dsp->in_running && dsp->sblatchi) {
+                int64_t due = (int64_t)(((uint64_t)(tsc + 1) << 32) - dsp->in_ts);
+                int64_t count;
+                int len;
+
+                if (due <= 0)
+                        break;
+
+                count = (due - 1) / (int64_t)dsp->sblatchi + 1;
+                len = sb_dsp_input_next_event(dsp);
+                if (len > count)
+                        len = count;
+                sb_dsp_input_block(dsp, len);
+        }
+}
+
+static void sb_dsp_input_schedule(sb_dsp_t *dsp) {
+        int64_t delay;
+
+        if (!dsp->in_running) {
+                timer_disable(&dsp->input_timer);
+                return;
+        }
+
+        delay = (int64_t)(dsp->in_ts + (sb_dsp_input_next_event(dsp) - 1) * dsp->sblatchi - ((uint64_t)tsc << 32));
+        timer_set_delay_u64(&dsp->input_timer, (delay > 0) ? delay : 0);
+}
+
+/*Run both sample clocks up to the current time. They are independent, other than a pause holding off
+  input until an output sample ends it, so while a pause runs the two are stepped in time order*/
+static void sb_dsp_sync(sb_dsp_t *dsp) {
+        while (dsp->sb_pausetime > -1 && dsp->out_running && dsp->in_running && dsp->sblatcho && dsp->sblatchi) {
+                uint64_t now = (uint64_t)(tsc + 1) << 32;
+
+                if (dsp->out_ts <= dsp->in_ts) {
+                        if (dsp->out_ts >= now)
+                                break;
+                        sb_dsp_output_block(dsp, 1);
+                } else {
+                        if (dsp->in_ts >= now)
+                                break;
+                        sb_dsp_input_block(dsp, 1);
+                }
+        }
+
+        sb_dsp_output_sync(dsp);
+        sb_dsp_input_sync(dsp);
+}
+
+void sb_poll_i(void *p) {
+        sb_dsp_t *dsp = (sb_dsp_t *)p;
+
+        sb_dsp_sync(dsp);
+        sb_dsp_input_schedule(dsp);
+}
+
+void sb_dsp_update(sb_dsp_t *dsp) {
+        sb_dsp_sync(dsp);
+        sb_dsp_fill(dsp, sound_pos_global);
 }
 void sb_dsp_close(sb_dsp_t *dsp) {
+        dma_remove_sync_handler(sb_dsp_dma_sync, dsp);
 #ifdef SB_DSP_RECORD_DEBUG
         if (soundf != 0) {
                 fclose(soundf);
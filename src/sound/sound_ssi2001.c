@@ -7,13 +7,36 @@
 #include "sound_resid.h"
 #include "sound_ssi2001.h"
 
+#define SSI2001_LOG_LEN 256
+
 typedef struct ssi2001_t {
         void *psid;
         int16_t buffer[MAXSOUNDBUFLEN * 2];
         int pos;
+
+        /*Register writes not yet seen by the SID, with the sample position each was made at*/
+        struct {
+                int pos;
+                uint8_t addr, val;
+        } log[SSI2001_LOG_LEN];
+        int log_len;
 } ssi2001_t;
 
+/*Render up to the current sample position, applying logged writes at the positions they were made at.
+  Writes don't render on their own, so normally a whole buffer is rendered at once in get_buffer, with
+  the SID only stopping at the positions of writes*/
 static void ssi2001_update(ssi2001_t *ssi2001) {
+        int c;
+
+        for (c = 0; c < ssi2001->log_len; c++) {
+                if (ssi2001->log[c].pos > ssi2001->pos) {
+                        sid_fillbuf(&ssi2001->buffer[ssi2001->pos], ssi2001->log[c].pos - ssi2001->pos, ssi2001->psid);
+                        ssi2001->pos = ssi2001->log[c].pos;
+                }
+                sid_write(ssi2001->log[c].addr, ssi2001->log[c].val, ssi2001->psid);
+        }
+        ssi2001->log_len = 0;
+
         if (ssi2001->pos >= sound_pos_global)
                 return;
 
@@ -33,6 +56,7 @@ static void ssi2001_get_buffer(int32_t *buffer, int len, void *p) {
         ssi2001->pos = 0;
 }
 
+/*Reads return oscillator and envelope state, so the SID must be brought up to date first*/
 static uint8_t ssi2001_read(uint16_t addr, void *p) {
         ssi2001_t *ssi2001 = (ssi2001_t *)p;
 
@@ -44,8 +68,13 @@ static uint8_t ssi2001_read(uint16_t addr, void *p) {
 static void ssi2001_write(uint16_t addr, uint8_t val, void *p) {
         ssi2001_t *ssi2001 = (ssi2001_t *)p;
 
-        ssi2001_update(ssi2001);
-        sid_write(addr, val, p);
+        if (ssi2001->log_len == SSI2001_LOG_LEN)
+                ssi2001_update(ssi2001);
+
+        ssi2001->log[ssi2001->log_len].pos = sound_pos_global;
+        ssi2001->log[ssi2001->log_len].addr = addr;
+        ssi2001->log[ssi2001->log_len].val = val;
+        ssi2001->log_len++;
 }
 
 void *ssi2001_init() {
@@ -53,7 +82,7 @@ void *ssi2001_init() {
         memset(ssi2001, 0, sizeof(ssi2001_t));
 
         pclog("ssi2001_init\n");
-        ssi2001->psid = sid_init();
+        ssi2001->psid = sid_init(device_get_config_int("resample"));
         sid_reset(ssi2001->psid);
         io_sethandler(0x0280, 0x0020, ssi2001_read, NULL, NULL, ssi2001_write, NULL, NULL, ssi2001);
         sound_add_handler(ssi2001_get_buffer, ssi2001);
@@ -68,4 +97,14 @@ void ssi2001_close(void *p) {
         free(ssi2001);
 }
 
-device_t ssi2001_device = {"Innovation SSI-2001", 0, ssi2001_init, ssi2001_close, NULL, NULL, NULL, NULL};
+static device_config_t ssi2001_config[] = {
+        {.name = "resample",
+         .description = "Output filter",
+         .type = CONFIG_SELECTION,
+         .selection = {{.description = "Interpolate", .value = 0},
+                       {.description = "Resample (higher quality)", .value = 1},
+                       {.description = ""}},
+         .default_int = 0},
+        {.type = -1}};
+
+device_t ssi2001_device = {"Innovation SSI-2001", 0, ssi2001_init, ssi2001_close, NULL, NULL, NULL, NULL, ssi2001_config};
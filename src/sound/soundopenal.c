@@ -3,7 +3,6 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <math.h>
 #ifdef USE_OPENAL
 #ifdef __APPLE__
 #include <OpenAL/al.h>
@@ -15,6 +14,7 @@
 #endif
 #include "ibm.h"
 #include "sound.h"
+#include "sound_out.h"
 
 FILE *allog;
 #ifdef USE_OPENAL
@@ -26,7 +26,7 @@ static ALuint source[2]; // audio source
 
 int sound_buf_len_al = 48000 / 20;
 
-void closeal();
+static void closeal();
 ALvoid alutInit(ALint *argc, ALbyte **argv) {
         ALCcontext *Context;
         ALCdevice *Device;
@@ -58,22 +58,13 @@ ALvoid alutExit(ALvoid) {
         // Close device
         alcCloseDevice(Device);
 }
-void initalmain(int argc, char *argv[]) {
-#ifdef USE_OPENAL
-        alutInit(0, 0);
-        //        printf("AlutInit\n");
-        atexit(closeal);
-//        printf("AlutInit\n");
-#endif
-}
-
-void closeal() {
+static void closeal() {
 #ifdef USE_OPENAL
         alutExit();
 #endif
 }
 
-void check() {
+static void check() {
 #ifdef USE_OPENAL
         ALenum error;
         if ((error = alGetError()) != AL_NO_ERROR) {
@@ -83,7 +74,7 @@ void check() {
 #endif
 }
 
-void inital() {
+static int openal_init() {
 #ifdef USE_OPENAL
         int c;
         int16_t buf[MAXSOUNDBUFLEN * 2];
@@ -91,6 +82,9 @@ void inital() {
 
         assert(sound_buf_len_al <= MAXSOUNDBUFLEN);
 
+        alutInit(0, 0);
+        atexit(closeal);
+
         //        printf("1\n");
         check();
 
@@ -137,24 +131,22 @@ void inital() {
         alSourcePlay(source[1]);
         check();
 //        printf("InitAL!!! %08X\n",source);
+        return 1;
+#else
+        return 0;
 #endif
 }
 
-void givealbuffer(int32_t *buf) {
+/*Device is closed by the atexit handler*/
+static void openal_close() {}
+
+static int openal_get_space() {
 #ifdef USE_OPENAL
-        int16_t buf16[MAXSOUNDBUFLEN * 2];
         int processed;
         int state;
 
-        assert(sound_buf_len_al <= MAXSOUNDBUFLEN);
-
-        // return;
-
-        //        printf("Start\n");
         check();
 
-        //        printf("GiveALBuffer %08X\n",source);
-
         alGetSourcei(source[0], AL_SOURCE_STATE, &state);
 
         check();
@@ -163,51 +155,34 @@ void givealbuffer(int32_t *buf) {
                 alSourcePlay(source[0]);
                 //                printf("Resetting sound\n");
         }
-        //        printf("State - %i %08X\n",state,state);
         alGetSourcei(source[0], AL_BUFFERS_PROCESSED, &processed);
 
-        //        printf("P ");
         check();
-        //        printf("Processed - %i\n",processed);
 
-        if (processed >= 1) {
-                int c;
-                ALuint buffer;
-                double gain = pow(10.0, (double)sound_gain / 20.0);
-
-                alListenerf(AL_GAIN, gain);
+        return processed * sound_buf_len_al;
+#else
+        return 0;
+#endif
+}
 
-                alSourceUnqueueBuffers(source[0], 1, &buffer);
-                //                printf("U ");
-                check();
+static void openal_write(int16_t *buf, int frames) {
+#ifdef USE_OPENAL
+        ALuint buffer;
 
-                for (c = 0; c < sound_buf_len_al * 2; c++) {
-                        if (buf[c] < -32768)
-                                buf16[c] = -32768;
-                        else if (buf[c] > 32767)
-                                buf16[c] = 32767;
-                        else
-                                buf16[c] = buf[c];
-                }
-                //                for (c=0;c<sound_buf_len_al*2;c++) buf[c]^=0x8000;
-                alBufferData(buffer, AL_FORMAT_STEREO16, buf16, sound_buf_len_al * 2 * 2, FREQ);
-                //                printf("B ");
-                check();
+        assert(frames <= MAXSOUNDBUFLEN);
 
-                alSourceQueueBuffers(source[0], 1, &buffer);
-                //                printf("Q ");
-                check();
+        alSourceUnqueueBuffers(source[0], 1, &buffer);
+        check();
 
-                //                printf("\n");
+        alBufferData(buffer, AL_FORMAT_STEREO16, buf, frames * 2 * 2, FREQ);
+        check();
 
-                //                if (!allog) allog=fopen("al.pcm","wb");
-                //                fwrite(buf,sound_buf_len_al*2,1,allog);
-        }
-//        printf("\n");
+        alSourceQueueBuffers(source[0], 1, &buffer);
+        check();
 #endif
 }
 
-void givealbuffer_cd(int16_t *buf) {
+static void openal_write_cd(int16_t *buf, int frames) {
 #ifdef USE_OPENAL
         int processed;
         int state;
@@ -236,16 +211,13 @@ void givealbuffer_cd(int16_t *buf) {
 
         if (processed >= 1) {
                 ALuint buffer;
-                double gain = pow(10.0, (double)sound_gain / 20.0);
-
-                alListenerf(AL_GAIN, gain);
 
                 alSourceUnqueueBuffers(source[1], 1, &buffer);
                 //                printf("U ");
                 check();
 
                 //                for (c=0;c<sound_buf_len_al*2;c++) buf[c]^=0x8000;
-                alBufferData(buffer, AL_FORMAT_STEREO16, buf, CD_BUFLEN * 2 * 2, CD_FREQ);
+                alBufferData(buffer, AL_FORMAT_STEREO16, buf, frames * 2 * 2, CD_FREQ);
                 //                printf("B ");
                 check();
 
@@ -261,3 +233,5 @@ void givealbuffer_cd(int16_t *buf) {
 //        printf("\n");
 #endif
 }
+
+sound_backend_t sound_backend_openal = {"openal", 1, openal_init, openal_close, openal_get_space, openal_write, openal_write_cd};
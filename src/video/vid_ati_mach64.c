@@ -4014,6 +4014,8 @@ static void *mach64_common_init() {
 
         mem_mapping_add(&mach64->linear_mapping, 0, 0, svga_read_linear, svga_readw_linear, svga_readl_linear, svga_write_linear,
                         svga_writew_linear, svga_writel_linear, NULL, 0, &mach64->svga);
+        if (device_get_config_int("lfb_direct"))
+                mach64->svga.lfb_direct_mapping = &mach64->linear_mapping;
         mem_mapping_add(&mach64->mmio_linear_mapping, 0, 0, mach64_ext_readb, mach64_ext_readw, mach64_ext_readl,
                         mach64_ext_writeb, mach64_ext_writew, mach64_ext_writel, NULL, 0, mach64);
         mem_mapping_add(&mach64->mmio_linear_mapping_2, 0, 0, mach64_ext_readb, mach64_ext_readw, mach64_ext_readl,
@@ -4174,6 +4176,10 @@ static device_config_t mach64gx_config[] = {{.name = "memory",
                                                            {.description = "4 MB", .value = 4},
                                                            {.description = ""}},
                                              .default_int = 4},
+                                            {.name = "lfb_direct",
+                                             .description = "Direct linear framebuffer writes",
+                                             .type = CONFIG_BINARY,
+                                             .default_int = 0},
                                             {.type = -1}};
 static device_config_t mach64vt2_config[] = {
         {.name = "memory",
@@ -4181,6 +4187,7 @@ static device_config_t mach64vt2_config[] = {
          .type = CONFIG_SELECTION,
          .selection = {{.description = "2 MB", .value = 2}, {.description = "4 MB", .value = 4}, {.description = ""}},
          .default_int = 4},
+        {.name = "lfb_direct", .description = "Direct linear framebuffer writes", .type = CONFIG_BINARY, .default_int = 0},
         {.type = -1}};
 
 device_t mach64gx_device = {"ATI Mach64GX",      0,
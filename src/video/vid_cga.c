@@ -116,6 +116,40 @@ void cga_recalctimings(cga_t *cga) {
         cga->dispofftime = (uint64_t)_dispofftime;
 }
 
+/*Returns 1 if the current line is a text line holding the same text as when it was last drawn,
+  in which case it does not need to be drawn again*/
+static int cga_text_line_cached(cga_t *cga, uint16_t ca) {
+        text_cache_key_t key;
+        int x;
+
+        if (!cga->text_cache.lines)
+                return 0;
+        if ((cga->cgamode & 2) || cga->composite) {
+                text_cache_invalidate_line(&cga->text_cache, cga->displine);
+                return 0;
+        }
+
+        key.params[0] = cga->ma;
+        key.params[1] = cga->sc & 7;
+        key.params[2] = cga->crtc[1];
+        key.params[3] = (cga->con && cga->cursoron) ? ca : -1;
+        key.params[4] = cga->cgamode;
+        key.params[5] = cga->cgacol;
+        key.params[6] = ((cga->cgablink & 8) ? 1 : 0) | (cga->drawcursor ? 2 : 0);
+        key.params[7] = cga->fontbase;
+        for (x = 0; x < cga->crtc[1]; x++) {
+                if (cga->cgamode & 1) {
+                        key.cells[x * 2] = cga->charbuffer[x << 1];
+                        key.cells[x * 2 + 1] = cga->charbuffer[(x << 1) + 1];
+                } else {
+                        key.cells[x * 2] = cga->vram[((cga->ma + x) << 1) & 0x3fff];
+                        key.cells[x * 2 + 1] = cga->vram[(((cga->ma + x) << 1) + 1) & 0x3fff];
+                }
+        }
+
+        return text_cache_check(&cga->text_cache, cga->displine, &key, TEXT_CACHE_KEY_LEN(cga->crtc[1]));
+}
+
 void cga_poll(void *p) {
         cga_t *cga = (cga_t *)p;
         uint16_t ca = (cga->crtc[15] | (cga->crtc[14] << 8)) & 0x3fff;
@@ -127,6 +161,7 @@ void cga_poll(void *p) {
         uint32_t cols[4];
         int col;
         int oldsc;
+        int line_cached = 0;
 
         if (!cga->linepos) {
                 timer_advance_u64(&cga->timer, cga->dispofftime);
@@ -142,7 +177,12 @@ void cga_poll(void *p) {
                                 //                                printf("Firstline %i\n",firstline);
                         }
                         cga->lastline = cga->displine;
-
+                        line_cached = cga_text_line_cached(cga, ca);
+                }
+                if (line_cached) {
+                        /*Line in buffer is already up to date*/
+                        cga->ma += cga->crtc[1];
+                } else if (cga->cgadispon) {
                         cols[0] = ((cga->cgamode & 0x12) == 0x12) ? 0 : (cga->cgacol & 15);
                         for (c = 0; c < 8; c++) {
                                 ((uint32_t *)buffer32->line[cga->displine])[c] = cols[0];
@@ -270,6 +310,7 @@ void cga_poll(void *p) {
                                 }
                         }
                 } else {
+                        text_cache_invalidate_line(&cga->text_cache, cga->displine);
                         cols[0] = ((cga->cgamode & 0x12) == 0x12) ? 0 : (cga->cgacol & 15);
                         if (cga->cgamode & 1)
                                 hline(buffer32, 0, cga->displine, (cga->crtc[1] << 3) + 16, cols[0]);
@@ -287,7 +328,7 @@ void cga_poll(void *p) {
                                 buffer32->line[cga->displine][c] = ((uint32_t *)buffer32->line[cga->displine])[c] & 0xf;
 
                         Composite_Process(cga->cgamode, 0, x >> 2, buffer32->line[cga->displine]);
-                } else {
+                } else if (!line_cached) {
                         for (c = 0; c < x; c++)
                                 ((uint32_t *)buffer32->line[cga->displine])[c] =
                                         cgapal[((uint32_t *)buffer32->line[cga->displine])[c] & 0xf];
@@ -425,6 +466,8 @@ void *cga_standalone_init() {
         contrast = device_get_config_int("contrast");
 
         cga->vram = malloc(0x4000);
+        if (!cga->composite)
+                text_cache_init(&cga->text_cache, 360);
 
         cga_comp_init(cga->revision);
 
@@ -441,6 +484,7 @@ void *cga_standalone_init() {
 void cga_close(void *p) {
         cga_t *cga = (cga_t *)p;
 
+        text_cache_close(&cga->text_cache);
         free(cga->vram);
         free(cga);
 }
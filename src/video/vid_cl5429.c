@@ -177,6 +177,7 @@ void gd5429_out(uint16_t addr, uint8_t val, void *p) {
 
                         case 0x07:
                                 svga->set_reset_disabled = svga->seqregs[7] & 1;
+                                svga_recalc_write_state(svga);
                                 svga->packed_chain4 = svga->seqregs[7] & 1;
                                 svga_recalctimings(svga);
                         case 0x17:
@@ -255,9 +255,52 @@ void ega_recalctimings(ega_t *ega) {
         //        %02X\n",disptime*crtcconst,dispontime,dispofftime,(dispontime+dispofftime)*ega_vtotal,(dispontime+dispofftime)*ega_vtotal*70,seqregs[1]);
 }
 
+/*Returns 1 if the current text line is unchanged since it was last drawn, in which case ega->ma is
+  advanced past the line and the caller can skip it*/
+static int ega_text_line_unchanged(ega_t *ega) {
+        text_cache_key_t key;
+        uint32_t ma = ega->ma;
+        int x;
+
+        if (!ega->text_cache.lines)
+                return 0;
+        if (ega->hdisp > TEXT_CACHE_MAX_CELLS) {
+                text_cache_invalidate_line(&ega->text_cache, ega->displine);
+                return 0;
+        }
+
+        for (x = 0; x < ega->hdisp; x++) {
+                key.cells[x * 2] = ega->vram[(ma << 1) & ega->vrammask];
+                key.cells[x * 2 + 1] = ega->vram[((ma << 1) + 1) & ega->vrammask];
+                ma = (ma + 4) & ega->vrammask;
+        }
+
+        key.params[0] = ega->ma;
+        key.params[1] = ega->sc;
+        key.params[2] = ega->hdisp;
+        key.params[3] = ega->seqregs[1] & 9;
+        key.params[4] = (ega->con && ega->cursoron) ? ega->ca : -1;
+        key.params[5] = (ega->blink & 16) | (ega->attrregs[0x10] << 8);
+        key.params[6] = ega->charseta;
+        key.params[7] = ega->charsetb;
+
+        if (fullchange) {
+                text_cache_store(&ega->text_cache, ega->displine, &key, TEXT_CACHE_KEY_LEN(ega->hdisp));
+                return 0;
+        }
+        if (!text_cache_check(&ega->text_cache, ega->displine, &key, TEXT_CACHE_KEY_LEN(ega->hdisp)))
+                return 0;
+
+        ega->ma = ma;
+        return 1;
+}
+
 static void ega_draw_text(ega_t *ega) {
         int x, xx;
 
+        if (ega_text_line_unchanged(ega))
+                return;
+
         for (x = 0; x < ega->hdisp; x++) {
                 int drawcursor = ((ega->ma == ega->ca) && ega->con && ega->cursoron);
                 uint8_t chr = ega->vram[(ega->ma << 1) & ega->vrammask];
@@ -556,7 +599,7 @@ void ega_poll(void *p) {
                                         }
                                 }
                         } else if (!(ega->gdcreg[6] & 1)) {
-                                if (fullchange)
+                                if (fullchange || ega->text_changed)
                                         ega_draw_text(ega);
                         } else {
                                 switch (ega->gdcreg[5] & 0x20) {
@@ -624,6 +667,8 @@ void ega_poll(void *p) {
                                 fullchange = 2;
                         ega->blink++;
 
+                        if (ega->text_changed)
+                                ega->text_changed--;
                         if (fullchange)
                                 fullchange--;
                 }
@@ -727,8 +772,14 @@ void ega_write(uint32_t addr, uint8_t val, void *p) {
         if (addr >= ega->vram_limit)
                 return;
 
-        if (!(ega->gdcreg[6] & 1))
-                fullchange = 2;
+        /*In text modes only writes to the font plane need a full redraw, character/attribute writes
+          are picked up by the text line cache*/
+        if (!(ega->gdcreg[6] & 1)) {
+                if (writemask2 & 0xc)
+                        fullchange = 2;
+                else
+                        ega->text_changed = 2;
+        }
 
         //        pclog("%i %08X %i %i %02X   %02X %02X %02X
         //        %02X\n",chain4,addr,writemode,writemask,gdcreg[8],vram[0],vram[1],vram[2],vram[3]);
@@ -1056,6 +1107,8 @@ void *ega_standalone_init() {
         ega->vram_limit = device_get_config_int("memory") * 1024;
         ega->vrammask = ega->vram_limit - 1;
 
+        text_cache_init(&ega->text_cache, 2048);
+
         mem_mapping_add(&ega->mapping, 0xa0000, 0x20000, ega_read, NULL, NULL, ega_write, NULL, NULL, NULL, MEM_MAPPING_EXTERNAL,
                         ega);
         io_sethandler(0x03a0, 0x0040, ega_in, NULL, NULL, ega_out, NULL, NULL, ega);
@@ -1068,6 +1121,7 @@ static int ega_standalone_available() { return rom_present("ibm_6277356_ega_card
 void ega_close(void *p) {
         ega_t *ega = (ega_t *)p;
 
+        text_cache_close(&ega->text_cache);
         free(ega->vram);
         free(ega);
 }
@@ -1369,6 +1369,8 @@ void *et4000w32p_init() {
 
         mem_mapping_add(&et4000->linear_mapping, 0, 0, svga_read_linear, svga_readw_linear, svga_readl_linear, svga_write_linear,
                         svga_writew_linear, svga_writel_linear, NULL, 0, &et4000->svga);
+        if (device_get_config_int("lfb_direct"))
+                et4000->svga.lfb_direct_mapping = &et4000->linear_mapping;
         mem_mapping_add(&et4000->mmu_mapping, 0, 0, et4000w32p_mmu_read, NULL, NULL, et4000w32p_mmu_write, NULL, NULL, NULL, 0,
                         et4000);
 
@@ -1440,6 +1442,7 @@ static device_config_t et4000w32p_config[] = {
          .type = CONFIG_SELECTION,
          .selection = {{.description = "1 MB", .value = 1}, {.description = "2 MB", .value = 2}, {.description = ""}},
          .default_int = 2},
+        {.name = "lfb_direct", .description = "Direct linear framebuffer writes", .type = CONFIG_BINARY, .default_int = 0},
         {.type = -1}};
 
 device_t et4000w32p_device = {"Tseng Labs ET4000/w32p", 0,
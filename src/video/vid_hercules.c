@@ -7,6 +7,7 @@
 #include "timer.h"
 #include "video.h"
 #include "vid_hercules.h"
+#include "vid_text_cache.h"
 
 typedef struct hercules_t {
         mem_mapping_t mapping;
@@ -29,6 +30,8 @@ typedef struct hercules_t {
         int vsynctime, vadj;
 
         uint8_t *vram;
+
+        text_cache_t text_cache;
 } hercules_t;
 
 static uint32_t mdacols[256][2][2];
@@ -118,6 +121,26 @@ void hercules_recalctimings(hercules_t *hercules) {
         hercules->dispofftime = (uint64_t)_dispofftime;
 }
 
+/*Returns 1 if the current line holds the same text as when it was last drawn, in which case
+  it does not need to be drawn again*/
+static int hercules_text_line_cached(hercules_t *hercules, uint16_t ca) {
+        text_cache_key_t key;
+        int x;
+
+        memset(key.params, 0, sizeof(key.params));
+        key.params[0] = hercules->ma;
+        key.params[1] = hercules->sc;
+        key.params[2] = hercules->crtc[1];
+        key.params[3] = (hercules->con && hercules->cursoron) ? ca : -1;
+        key.params[4] = (hercules->blink & 16) && (hercules->ctrl & 0x20);
+        for (x = 0; x < hercules->crtc[1]; x++) {
+                key.cells[x * 2] = hercules->vram[((hercules->ma + x) << 1) & 0xfff];
+                key.cells[x * 2 + 1] = hercules->vram[(((hercules->ma + x) << 1) + 1) & 0xfff];
+        }
+
+        return text_cache_check(&hercules->text_cache, hercules->displine, &key, TEXT_CACHE_KEY_LEN(hercules->crtc[1]));
+}
+
 void hercules_poll(void *p) {
         hercules_t *hercules = (hercules_t *)p;
         uint16_t ca = (hercules->crtc[15] | (hercules->crtc[14] << 8)) & 0x3fff;
@@ -143,6 +166,7 @@ void hercules_poll(void *p) {
                         }
                         hercules->lastline = hercules->displine;
                         if ((hercules->ctrl & 2) && (hercules->ctrl2 & 1)) {
+                                text_cache_invalidate_line(&hercules->text_cache, hercules->displine);
                                 ca = (hercules->sc & 3) * 0x2000;
                                 if ((hercules->ctrl & 0x80) && (hercules->ctrl2 & 2))
                                         ca += 0x8000;
@@ -155,6 +179,8 @@ void hercules_poll(void *p) {
                                                 ((uint32_t *)buffer32->line[hercules->displine])[(x << 4) + c] =
                                                         (dat & (32768 >> c)) ? cgapal[0x7] : 0;
                                 }
+                        } else if (hercules_text_line_cached(hercules, ca)) {
+                                hercules->ma += hercules->crtc[1];
                         } else {
                                 for (x = 0; x < hercules->crtc[1]; x++) {
                                         chr = hercules->vram[(hercules->ma << 1) & 0xfff];
@@ -306,6 +332,7 @@ void *hercules_init() {
         memset(hercules, 0, sizeof(hercules_t));
 
         hercules->vram = malloc(0x10000);
+        text_cache_init(&hercules->text_cache, 500);
 
         timer_add(&hercules->timer, hercules_poll, hercules, 1);
         mem_mapping_add(&hercules->mapping, 0xb0000, 0x08000, hercules_read, NULL, NULL, hercules_write, NULL, NULL, NULL,
@@ -341,6 +368,7 @@ void *hercules_init() {
 void hercules_close(void *p) {
         hercules_t *hercules = (hercules_t *)p;
 
+        text_cache_close(&hercules->text_cache);
         free(hercules->vram);
         free(hercules);
 }
@@ -82,6 +82,29 @@ void mda_recalctimings(mda_t *mda) {
         mda->dispofftime = (uint64_t)_dispofftime;
 }
 
+/*Returns 1 if the current line holds the same text as when it was last drawn, in which case
+  it does not need to be drawn again*/
+static int mda_text_line_cached(mda_t *mda, uint16_t ca) {
+        text_cache_key_t key;
+        int x;
+
+        if (!mda->text_cache.lines)
+                return 0;
+
+        memset(key.params, 0, sizeof(key.params));
+        key.params[0] = mda->ma;
+        key.params[1] = mda->sc;
+        key.params[2] = mda->crtc[1];
+        key.params[3] = (mda->con && mda->cursoron) ? ca : -1;
+        key.params[4] = (mda->blink & 16) && (mda->ctrl & 0x20);
+        for (x = 0; x < mda->crtc[1]; x++) {
+                key.cells[x * 2] = mda->vram[((mda->ma + x) << 1) & 0xfff];
+                key.cells[x * 2 + 1] = mda->vram[(((mda->ma + x) << 1) + 1) & 0xfff];
+        }
+
+        return text_cache_check(&mda->text_cache, mda->displine, &key, TEXT_CACHE_KEY_LEN(mda->crtc[1]));
+}
+
 void mda_poll(void *p) {
         mda_t *mda = (mda_t *)p;
         uint16_t ca = (mda->crtc[15] | (mda->crtc[14] << 8)) & 0x3fff;
@@ -104,30 +127,36 @@ void mda_poll(void *p) {
                                 video_wait_for_buffer();
                         }
                         mda->lastline = mda->displine;
-                        for (x = 0; x < mda->crtc[1]; x++) {
-                                chr = mda->vram[(mda->ma << 1) & 0xfff];
-                                attr = mda->vram[((mda->ma << 1) + 1) & 0xfff];
-                                drawcursor = ((mda->ma == ca) && mda->con && mda->cursoron);
-                                blink = ((mda->blink & 16) && (mda->ctrl & 0x20) && (attr & 0x80) && !drawcursor);
-                                if (mda->sc == 12 && ((attr & 7) == 1)) {
-                                        for (c = 0; c < 9; c++)
-                                                ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + c] =
-                                                        mdacols[attr][blink][1];
-                                } else {
-                                        for (c = 0; c < 8; c++)
-                                                ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + c] =
-                                                        mdacols[attr][blink][(fontdatm[chr][mda->sc] & (1 << (c ^ 7))) ? 1 : 0];
-                                        if ((chr & ~0x1f) == 0xc0)
-                                                ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + 8] =
-                                                        mdacols[attr][blink][fontdatm[chr][mda->sc] & 1];
-                                        else
-                                                ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + 8] =
-                                                        mdacols[attr][blink][0];
-                                }
-                                mda->ma++;
-                                if (drawcursor) {
-                                        for (c = 0; c < 9; c++)
-                                                ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + c] ^= mdacols[attr][0][1];
+                        if (mda_text_line_cached(mda, ca)) {
+                                mda->ma += mda->crtc[1];
+                        } else {
+                                for (x = 0; x < mda->crtc[1]; x++) {
+                                        chr = mda->vram[(mda->ma << 1) & 0xfff];
+                                        attr = mda->vram[((mda->ma << 1) + 1) & 0xfff];
+                                        drawcursor = ((mda->ma == ca) && mda->con && mda->cursoron);
+                                        blink = ((mda->blink & 16) && (mda->ctrl & 0x20) && (attr & 0x80) && !drawcursor);
+                                        if (mda->sc == 12 && ((attr & 7) == 1)) {
+                                                for (c = 0; c < 9; c++)
+                                                        ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + c] =
+                                                                mdacols[attr][blink][1];
+                                        } else {
+                                                for (c = 0; c < 8; c++)
+                                                        ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + c] =
+                                                                mdacols[attr][blink]
+                                                                       [(fontdatm[chr][mda->sc] & (1 << (c ^ 7))) ? 1 : 0];
+                                                if ((chr & ~0x1f) == 0xc0)
+                                                        ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + 8] =
+                                                                mdacols[attr][blink][fontdatm[chr][mda->sc] & 1];
+                                                else
+                                                        ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + 8] =
+                                                                mdacols[attr][blink][0];
+                                        }
+                                        mda->ma++;
+                                        if (drawcursor) {
+                                                for (c = 0; c < 9; c++)
+                                                        ((uint32_t *)buffer32->line[mda->displine])[(x * 9) + c] ^=
+                                                                mdacols[attr][0][1];
+                                        }
                                 }
                         }
                 }
@@ -235,6 +264,7 @@ void *mda_standalone_init() {
 
         memset(mda, 0, sizeof(mda_t));
         mda_init(mda);
+        text_cache_init(&mda->text_cache, 500);
 
         mda->vram = malloc(0x1000);
         mem_mapping_add(&mda->mapping, 0xb0000, 0x08000, mda_read, NULL, NULL, mda_write, NULL, NULL, NULL, MEM_MAPPING_EXTERNAL,
@@ -280,6 +310,7 @@ void mda_close(void *p) {
         mda_t *mda = (mda_t *)p;
 
         mem_mapping_remove(&mda->mapping);
+        text_cache_close(&mda->text_cache);
         free(mda->vram);
         free(mda);
 }
@@ -39,6 +39,28 @@ typedef struct {
         uint32_t val;
 } fifo_entry_t;
 
+#define MGA_MAX_RENDER_THREADS 4
+#define MGA_MAX_SPANS 1024        /*Spans queued before they are drawn*/
+#define MGA_BAND_LINES 4          /*Lines per band when spans are split between render threads*/
+#define MGA_SPLIT_MIN_PIXELS 8192 /*Smaller batches are not worth waking the render threads for*/
+
+/*One destination line of a trapezoid or bitblt*/
+typedef struct mystique_span_t {
+        int16_t x_l, x_r;
+        int ydst;
+        uint32_t ydst_lin;
+        int selline;
+        uint32_t dr[4];  /*Z, R, G, B at x_l*/
+        uint32_t tmr[3]; /*S/W, T/W, Q/W at x_l*/
+        uint32_t src_addr;
+        uint32_t ar0, ar3; /*Bitblt AR0/AR3 at the start of the line*/
+} mystique_span_t;
+
+typedef struct mystique_render_worker_t {
+        struct mystique_t *mystique;
+        int index;
+} mystique_render_worker_t;
+
 enum {
         MGA_2064W, /*Millennium*/
         MGA_1064SG /*Mystique*/
@@ -217,6 +239,17 @@ typedef struct mystique_t {
         event_t *fifo_not_full_event;
 
         pc_timer_t wake_timer;
+
+        int render_threads;
+        thread_t *render_thread[MGA_MAX_RENDER_THREADS];
+        event_t *wake_render_thread[MGA_MAX_RENDER_THREADS];
+        event_t *render_done_event[MGA_MAX_RENDER_THREADS];
+        mystique_render_worker_t render_worker[MGA_MAX_RENDER_THREADS];
+
+        void (*span_func)(struct mystique_t *mystique, const mystique_span_t *span);
+        mystique_span_t spans[MGA_MAX_SPANS];
+        int nr_spans;
+        int span_pixels;
 } mystique_t;
 
 static void mystique_start_blit(mystique_t *mystique);
@@ -224,6 +257,8 @@ static void mystique_update_irqs(mystique_t *mystique);
 
 static void wake_fifo_thread(mystique_t *mystique);
 static void wait_fifo_idle(mystique_t *mystique);
+static void mystique_render_init(mystique_t *mystique);
+static void mystique_render_close(mystique_t *mystique);
 static void mystique_queue(mystique_t *mystique, uint32_t addr, uint32_t val, uint32_t type);
 
 static uint8_t mystique_readb_linear(uint32_t addr, void *p);
@@ -2479,6 +2514,7 @@ static uint32_t mystique_readl_linear(uint32_t addr, void *p) {
 
 static void mystique_writeb_linear(uint32_t addr, uint8_t val, void *p) {
         svga_t *svga = (svga_t *)p;
+        uint32_t phys_addr = addr;
 
         egawrites++;
 
@@ -2491,9 +2527,13 @@ static void mystique_writeb_linear(uint32_t addr, uint8_t val, void *p) {
         addr &= svga->vram_mask;
         svga->changedvram[addr >> 12] = changeframecount;
         svga->vram[addr] = val;
+
+        if (svga->lfb_direct_mapping)
+                svga_lfb_map_direct(svga, phys_addr, addr);
 }
 static void mystique_writew_linear(uint32_t addr, uint16_t val, void *p) {
         svga_t *svga = (svga_t *)p;
+        uint32_t phys_addr = addr;
 
         egawrites += 2;
 
@@ -2506,9 +2546,13 @@ static void mystique_writew_linear(uint32_t addr, uint16_t val, void *p) {
         addr &= svga->vram_mask;
         svga->changedvram[addr >> 12] = changeframecount;
         *(uint16_t *)&svga->vram[addr] = val;
+
+        if (svga->lfb_direct_mapping)
+                svga_lfb_map_direct(svga, phys_addr, addr);
 }
 static void mystique_writel_linear(uint32_t addr, uint32_t val, void *p) {
         svga_t *svga = (svga_t *)p;
+        uint32_t phys_addr = addr;
 
         egawrites += 4;
 
@@ -2521,6 +2565,9 @@ static void mystique_writel_linear(uint32_t addr, uint32_t val, void *p) {
         addr &= svga->vram_mask;
         svga->changedvram[addr >> 12] = changeframecount;
         *(uint32_t *)&svga->vram[addr] = val;
+
+        if (svga->lfb_direct_mapping)
+                svga_lfb_map_direct(svga, phys_addr, addr);
 }
 
 static uint32_t mystique_dma_read(uint32_t addr) {
@@ -4119,448 +4166,595 @@ static void blit_autoline(mystique_t *mystique, int closed) {
                 ((int32_t)(int16_t)mystique->dwgreg.ydst * (mystique->dwgreg.pitch & PITCH_MASK)) + mystique->dwgreg.ydstorg;
 }
 
-static void blit_trap(mystique_t *mystique) {
-        svga_t *svga = &mystique->svga;
-        uint32_t z_back, r_back, g_back, b_back;
-        int z_write;
-        int y;
-        const int trans_sel = (mystique->dwgreg.dwgctrl_running & DWGCTRL_TRANS_MASK) >> DWGCTRL_TRANS_SHIFT;
-
-        mystique->trap_count++;
-
-        switch (mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK) {
-        case DWGCTRL_ATYPE_BLK:
-        case DWGCTRL_ATYPE_RPL:
-                // fxleft, fxright
-                // fcol
-                /*                pclog("fxleft=%i fxright=%i\n", mystique->dwgreg.fxleft, mystique->dwgreg.fxright);
-                                pclog("fcol=%08x\n", mystique->dwgreg.fcol);
-                                pclog("ytop=%i length=%i\n", mystique->dwgreg.ytop, mystique->dwgreg.length);
-                                pclog("pitch=%08x\n", mystique->dwgreg.pitch);
-                                pclog("ydst_lin=%08x\n", mystique->dwgreg.ydst_lin);*/
-                //                if (!(mystique->dwgreg.dwgctrl_running & DWGCTRL_SGNZERO))
-                //                        fatal("Not rectangle\n");
-
-                for (y = 0; y < mystique->dwgreg.length; y++) {
-                        uint8_t const *const trans = &trans_masks[trans_sel][(mystique->dwgreg.selline & 3) * 4];
-                        int16_t x_l = mystique->dwgreg.fxleft & 0xffff;
-                        int16_t x_r = mystique->dwgreg.fxright & 0xffff;
-                        int yoff = (mystique->dwgreg.yoff + mystique->dwgreg.ydst) & 7;
-
-                        //                        pclog("  line %03i: %08x\n", y, mystique->dwgreg.ydst_lin);
-                        while (x_l != x_r) {
-                                if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright &&
-                                    mystique->dwgreg.ydst_lin >= mystique->dwgreg.ytop &&
-                                    mystique->dwgreg.ydst_lin <= mystique->dwgreg.ybot && trans[x_l & 3]) {
-                                        int xoff = (mystique->dwgreg.xoff + x_l) & 7;
-                                        int pattern = mystique->dwgreg.pattern[yoff][xoff];
-                                        uint32_t dst;
-
-                                        //                                        pclog("     %06x %02x\n",
-                                        //                                        mystique->dwgreg.ydst_lin + x,
-                                        //                                        mystique->dwgreg.fcol & 0xff);
-                                        switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
-                                        case MACCESS_PWIDTH_8:
-                                                svga->vram[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask] =
-                                                        (pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol) & 0xff;
-                                                svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask) >>
-                                                                  12] = changeframecount;
-                                                break;
-
-                                        case MACCESS_PWIDTH_16:
-                                                ((uint16_t *)
-                                                         svga->vram)[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_w] =
-                                                        (pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol) & 0xffff;
-                                                svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_w) >>
-                                                                  11] = changeframecount;
-                                                break;
+/*Large primitives are drawn as a list of independent spans, one per destination line. The
+  blitter thread walks the edges (and any per-line interpolants) to build the span list, then
+  the spans are drawn either in order, or split into bands of MGA_BAND_LINES lines shared
+  between the render threads. The blitter thread does not continue until every span has been
+  drawn, so ordering between primitives is unchanged. The span renderers themselves are the
+  previous per-pixel loops, apart from the solid fill and plain copy runs*/
+static void mystique_draw_spans(mystique_t *mystique, int thread) {
+        int c;
 
-                                        case MACCESS_PWIDTH_24:
-                                                dst = *(uint32_t *)(&svga->vram[((mystique->dwgreg.ydst_lin + x_l) * 3) &
-                                                                                mystique->vram_mask]) &
-                                                      0xff000000;
-                                                *(uint32_t *)(&svga->vram[((mystique->dwgreg.ydst_lin + x_l) * 3) &
-                                                                          mystique->vram_mask]) =
-                                                        ((pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol) & 0xffffff) |
-                                                        dst;
-                                                svga->changedvram[(((mystique->dwgreg.ydst_lin + x_l) * 3) &
-                                                                   mystique->vram_mask) >>
-                                                                  12] = changeframecount;
-                                                break;
+        for (c = 0; c < mystique->nr_spans; c++) {
+                if (((c / MGA_BAND_LINES) % mystique->render_threads) == thread)
+                        mystique->span_func(mystique, &mystique->spans[c]);
+        }
+}
 
-                                        case MACCESS_PWIDTH_32:
-                                                ((uint32_t *)
-                                                         svga->vram)[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_l] =
-                                                        pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol;
-                                                svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_l) >>
-                                                                  10] = changeframecount;
-                                                break;
+static void mystique_render_thread(void *param) {
+        mystique_render_worker_t *worker = (mystique_render_worker_t *)param;
+        mystique_t *mystique = worker->mystique;
+        int thread = worker->index;
 
-#ifndef RELEASE_BUILD
-                                        default:
-                                                fatal("TRAP BLK/RPL PWIDTH %x %08x\n",
-                                                      mystique->maccess_running & MACCESS_PWIDTH_MASK,
-                                                      mystique->dwgreg.dwgctrl_running);
-#endif
-                                        }
-                                }
-                                x_l++;
-                                mystique->pixel_count++;
-                        }
+        while (1) {
+                thread_wait_event(mystique->wake_render_thread[thread], -1);
+                thread_reset_event(mystique->wake_render_thread[thread]);
 
-                        if ((int32_t)mystique->dwgreg.ar[1] < 0) {
-                                while ((int32_t)mystique->dwgreg.ar[1] < 0 && mystique->dwgreg.ar[0]) {
-                                        mystique->dwgreg.ar[1] += mystique->dwgreg.ar[0];
-                                        mystique->dwgreg.fxleft += (mystique->dwgreg.sgn.sdxl ? -1 : 1);
-                                }
-                        } else
-                                mystique->dwgreg.ar[1] += mystique->dwgreg.ar[2];
+                mystique_draw_spans(mystique, thread);
 
-                        if ((int32_t)mystique->dwgreg.ar[4] < 0) {
-                                while ((int32_t)mystique->dwgreg.ar[4] < 0 && mystique->dwgreg.ar[6]) {
-                                        mystique->dwgreg.ar[4] += mystique->dwgreg.ar[6];
-                                        mystique->dwgreg.fxright += (mystique->dwgreg.sgn.sdxr ? -1 : 1);
-                                }
-                        } else
-                                mystique->dwgreg.ar[4] += mystique->dwgreg.ar[5];
+                thread_set_event(mystique->render_done_event[thread]);
+        }
+}
 
-                        mystique->dwgreg.ydst++;
-                        mystique->dwgreg.ydst &= 0x7fffff;
-                        mystique->dwgreg.ydst_lin += (mystique->dwgreg.pitch & PITCH_MASK);
+/*Draw all queued spans. split indicates that the spans can be drawn in any order, ie no span
+  reads or writes memory written by another span*/
+static void mystique_flush_spans(mystique_t *mystique, int split) {
+        int c;
 
-                        mystique->dwgreg.selline = (mystique->dwgreg.selline + 1) & 7;
+        if (mystique->render_threads > 1 && split && mystique->span_pixels >= MGA_SPLIT_MIN_PIXELS) {
+                for (c = 1; c < mystique->render_threads; c++) {
+                        thread_reset_event(mystique->render_done_event[c]);
+                        thread_set_event(mystique->wake_render_thread[c]);
                 }
-                break;
-
-        case DWGCTRL_ATYPE_RSTR:
-                for (y = 0; y < mystique->dwgreg.length; y++) {
-                        uint8_t const *const trans = &trans_masks[trans_sel][(mystique->dwgreg.selline & 3) * 4];
-                        int16_t x_l = mystique->dwgreg.fxleft & 0xffff;
-                        int16_t x_r = mystique->dwgreg.fxright & 0xffff;
-                        int yoff = (mystique->dwgreg.yoff + mystique->dwgreg.ydst) & 7;
-
-                        //                        pclog("  line %03i: %08x\n", y, mystique->dwgreg.ydst_lin);
-                        while (x_l != x_r) {
-                                if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright &&
-                                    mystique->dwgreg.ydst_lin >= mystique->dwgreg.ytop &&
-                                    mystique->dwgreg.ydst_lin <= mystique->dwgreg.ybot && trans[x_l & 3]) {
-                                        int xoff = (mystique->dwgreg.xoff + x_l) & 7;
-                                        int pattern = mystique->dwgreg.pattern[yoff][xoff];
-                                        uint32_t src = pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol;
-                                        uint32_t dst, old_dst;
-
-                                        switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
-                                        case MACCESS_PWIDTH_8:
-                                                dst = svga->vram[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask];
-
-                                                dst = bitop(src, dst, mystique->dwgreg.dwgctrl_running);
-                                                //                                                pclog("     %06x %02x\n",
-                                                //                                                mystique->dwgreg.ydst_lin + x,
-                                                //                                                mystique->dwgreg.fcol & 0xff);
-                                                svga->vram[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask] = dst;
-                                                svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask) >>
-                                                                  12] = changeframecount;
-                                                break;
-
-                                        case MACCESS_PWIDTH_16:
-                                                dst = ((uint16_t *)svga
-                                                               ->vram)[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_w];
-
-                                                dst = bitop(src, dst, mystique->dwgreg.dwgctrl_running);
-                                                //                                                pclog("     %06x %02x\n",
-                                                //                                                mystique->dwgreg.ydst_lin + x,
-                                                //                                                mystique->dwgreg.fcol & 0xff);
-                                                ((uint16_t *)
-                                                         svga->vram)[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_w] =
-                                                        dst;
-                                                svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_w) >>
-                                                                  11] = changeframecount;
-                                                break;
-
-                                        case MACCESS_PWIDTH_24:
-                                                old_dst = *(uint32_t *)&svga->vram[((mystique->dwgreg.ydst_lin + x_l) * 3) &
-                                                                                   mystique->vram_mask];
-
-                                                dst = bitop(src, old_dst, mystique->dwgreg.dwgctrl_running);
-                                                //                                                pclog("     %06x %02x\n",
-                                                //                                                mystique->dwgreg.ydst_lin + x,
-                                                //                                                mystique->dwgreg.fcol & 0xff);
-                                                *(uint32_t *)&svga
-                                                         ->vram[((mystique->dwgreg.ydst_lin + x_l) * 3) & mystique->vram_mask] =
-                                                        (dst & 0xffffff) | (old_dst & 0xff000000);
-                                                svga->changedvram[(((mystique->dwgreg.ydst_lin + x_l) * 3) &
-                                                                   mystique->vram_mask) >>
-                                                                  12] = changeframecount;
-                                                break;
-
-                                        case MACCESS_PWIDTH_32:
-                                                dst = ((uint32_t *)svga
-                                                               ->vram)[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_l];
-
-                                                dst = bitop(src, dst, mystique->dwgreg.dwgctrl_running);
-                                                //                                                pclog("     %06x %02x\n",
-                                                //                                                mystique->dwgreg.ydst_lin + x,
-                                                //                                                mystique->dwgreg.fcol & 0xff);
-                                                ((uint32_t *)
-                                                         svga->vram)[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_l] =
-                                                        dst;
-                                                svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask_l) >>
-                                                                  10] = changeframecount;
-                                                break;
-
-#ifndef RELEASE_BUILD
-                                        default:
-                                                fatal("TRAP RSTR PWIDTH %x %08x\n",
-                                                      mystique->maccess_running & MACCESS_PWIDTH_MASK,
-                                                      mystique->dwgreg.dwgctrl_running);
-#endif
-                                        }
-                                }
-                                x_l++;
-                                mystique->pixel_count++;
-                        }
-
-                        if ((int32_t)mystique->dwgreg.ar[1] < 0) {
-                                while ((int32_t)mystique->dwgreg.ar[1] < 0 && mystique->dwgreg.ar[0]) {
-                                        mystique->dwgreg.ar[1] += mystique->dwgreg.ar[0];
-                                        mystique->dwgreg.fxleft += (mystique->dwgreg.sgn.sdxl ? -1 : 1);
-                                }
-                        } else
-                                mystique->dwgreg.ar[1] += mystique->dwgreg.ar[2];
+                mystique_draw_spans(mystique, 0);
+                for (c = 1; c < mystique->render_threads; c++)
+                        thread_wait_event(mystique->render_done_event[c], -1);
+        } else {
+                for (c = 0; c < mystique->nr_spans; c++)
+                        mystique->span_func(mystique, &mystique->spans[c]);
+        }
 
-                        if ((int32_t)mystique->dwgreg.ar[4] < 0) {
-                                while ((int32_t)mystique->dwgreg.ar[4] < 0 && mystique->dwgreg.ar[6]) {
-                                        mystique->dwgreg.ar[4] += mystique->dwgreg.ar[6];
-                                        mystique->dwgreg.fxright += (mystique->dwgreg.sgn.sdxr ? -1 : 1);
-                                }
-                        } else
-                                mystique->dwgreg.ar[4] += mystique->dwgreg.ar[5];
+        mystique->nr_spans = 0;
+        mystique->span_pixels = 0;
+}
 
-                        mystique->dwgreg.ydst++;
-                        mystique->dwgreg.ydst &= 0x7fffff;
-                        mystique->dwgreg.ydst_lin += (mystique->dwgreg.pitch & PITCH_MASK);
+static void mystique_render_init(mystique_t *mystique) {
+        int c;
 
-                        mystique->dwgreg.selline = (mystique->dwgreg.selline + 1) & 7;
-                }
-                break;
+        if (mystique->render_threads < 1)
+                mystique->render_threads = 1;
+        if (mystique->render_threads > MGA_MAX_RENDER_THREADS)
+                mystique->render_threads = MGA_MAX_RENDER_THREADS;
+
+        /*Thread 0 is the blitter thread itself*/
+        for (c = 1; c < mystique->render_threads; c++) {
+                mystique->render_worker[c].mystique = mystique;
+                mystique->render_worker[c].index = c;
+                mystique->wake_render_thread[c] = thread_create_event();
+                mystique->render_done_event[c] = thread_create_event();
+                mystique->render_thread[c] = thread_create(mystique_render_thread, &mystique->render_worker[c]);
+        }
+}
 
-        case DWGCTRL_ATYPE_I:
-        case DWGCTRL_ATYPE_ZI:
-                z_write = ((mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK) == DWGCTRL_ATYPE_ZI);
-                /*                pclog("fxleft=%i fxright=%i\n", mystique->dwgreg.fxleft, mystique->dwgreg.fxright);
-                                pclog("fcol=%08x\n", mystique->dwgreg.fcol);
-                                pclog("ytop=%i length=%i\n", mystique->dwgreg.ytop, mystique->dwgreg.length);
-                                pclog("pitch=%08x\n", mystique->dwgreg.pitch);
-                                pclog("ydst_lin=%08x\n", mystique->dwgreg.ydst_lin);
-                                pclog("trap! maccess=%08x  %08x %08x %08x\n", mystique->maccess_running, mystique->dwgreg.dr[4],
-                   mystique->dwgreg.dr[8], mystique->dwgreg.dr[12]);*/
-
-                for (y = 0; y < mystique->dwgreg.length; y++) {
-                        uint8_t const *const trans = &trans_masks[trans_sel][(mystique->dwgreg.selline & 3) * 4];
-                        uint16_t *z_p =
-                                (uint16_t *)&svga
-                                        ->vram[(mystique->dwgreg.ydst_lin * 2 + mystique->dwgreg.zorg) & mystique->vram_mask];
-                        int16_t x_l = mystique->dwgreg.fxleft & 0xffff;
-                        int16_t x_r = mystique->dwgreg.fxright & 0xffff;
-                        int16_t old_x_l = x_l;
-                        int dx;
-
-                        z_back = mystique->dwgreg.dr[0];
-                        r_back = mystique->dwgreg.dr[4];
-                        g_back = mystique->dwgreg.dr[8];
-                        b_back = mystique->dwgreg.dr[12];
-
-                        //                        pclog("  line %03i: %08x\n", y, mystique->dwgreg.ydst_lin);
-                        while (x_l != x_r) {
-                                if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright &&
-                                    mystique->dwgreg.ydst_lin >= mystique->dwgreg.ytop &&
-                                    mystique->dwgreg.ydst_lin <= mystique->dwgreg.ybot && trans[x_l & 3]) {
-                                        uint16_t z = ((int32_t)mystique->dwgreg.dr[0] < 0) ? 0 : (mystique->dwgreg.dr[0] >> 15);
-                                        uint16_t old_z = z_p[x_l];
+static void mystique_render_close(mystique_t *mystique) {
+        int c;
 
-                                        if (z_check(z, old_z, mystique->dwgreg.dwgctrl_running & DWGCTRL_ZMODE_MASK)) {
-                                                uint32_t dst = 0, old_dst;
-                                                int r = 0, g = 0, b = 0;
+        for (c = 1; c < mystique->render_threads; c++) {
+                thread_kill(mystique->render_thread[c]);
+                thread_destroy_event(mystique->wake_render_thread[c]);
+                thread_destroy_event(mystique->render_done_event[c]);
+        }
+}
 
-                                                if (!(mystique->dwgreg.dr[4] & (1 << 23)))
-                                                        r = (mystique->dwgreg.dr[4] >> 15) & 0xff;
-                                                if (!(mystique->dwgreg.dr[8] & (1 << 23)))
-                                                        g = (mystique->dwgreg.dr[8] >> 15) & 0xff;
-                                                if (!(mystique->dwgreg.dr[12] & (1 << 23)))
-                                                        b = (mystique->dwgreg.dr[12] >> 15) & 0xff;
+static int mystique_bytes_per_pixel(mystique_t *mystique) {
+        switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
+        case MACCESS_PWIDTH_8:
+                return 1;
+        case MACCESS_PWIDTH_16:
+                return 2;
+        case MACCESS_PWIDTH_24:
+                return 3;
+        default:
+                return 4;
+        }
+}
 
-                                                if (z_write)
-                                                        z_p[x_l] = z;
+/*Returns 1 if the lines of a trapezoid can be drawn in any order. Every line must stay within
+  its own pitch (24 bpp writes touch one byte past the pixel), nothing may wrap around the end
+  of VRAM, and the Z buffer and texture must not overlap the destination*/
+static int mystique_trap_can_split(mystique_t *mystique, int z_buffer, int texture) {
+        const uint64_t pitch = mystique->dwgreg.pitch & PITCH_MASK;
+        const uint64_t vram_size = (uint64_t)mystique->vram_mask + 1;
+        const int bpp = mystique_bytes_per_pixel(mystique);
+        uint64_t dst_start, dst_end;
 
-                                                //                                                pclog("     %06x %02x\n",
-                                                //                                                mystique->dwgreg.ydst_lin + x,
-                                                //                                                mystique->dwgreg.fcol & 0xff);
-                                                switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
-                                                case MACCESS_PWIDTH_8:
-                                                        svga->vram[(mystique->dwgreg.ydst_lin + x_l) & mystique->vram_mask] = dst;
-                                                        svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) &
-                                                                           mystique->vram_mask) >>
-                                                                          12] = changeframecount;
-                                                        break;
+        if ((uint64_t)mystique->dwgreg.cxright + 1 >= pitch || mystique->dwgreg.ytop > mystique->dwgreg.ybot)
+                return 0;
 
-                                                case MACCESS_PWIDTH_16:
-                                                        dst = dither(mystique, r, g, b, x_l & 1, mystique->dwgreg.selline & 1);
-                                                        //                                                        pclog("  %08x
-                                                        //                                                        %08x %08x
-                                                        //                                                        %04x\n",
-                                                        //                                                        mystique->dwgreg.dr[4],
-                                                        //                                                        mystique->dwgreg.dr[8],
-                                                        //                                                        mystique->dwgreg.dr[12],
-                                                        //                                                        dst);
-                                                        ((uint16_t *)svga->vram)[(mystique->dwgreg.ydst_lin + x_l) &
-                                                                                 mystique->vram_mask_w] = dst;
-                                                        svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) &
-                                                                           mystique->vram_mask_w) >>
-                                                                          11] = changeframecount;
-                                                        break;
+        dst_start = (uint64_t)mystique->dwgreg.ytop * bpp;
+        dst_end = ((uint64_t)mystique->dwgreg.ybot + pitch) * bpp;
+        if (dst_end > vram_size)
+                return 0;
 
-                                                case MACCESS_PWIDTH_24:
-                                                        old_dst =
-                                                                *(uint32_t
-                                                                          *)(&svga->vram[((mystique->dwgreg.ydst_lin + x_l) * 3) &
-                                                                                         mystique->vram_mask]) &
-                                                                0xff000000;
-                                                        *(uint32_t *)(&svga->vram[((mystique->dwgreg.ydst_lin + x_l) * 3) &
-                                                                                  mystique->vram_mask]) = old_dst | dst;
-                                                        svga->changedvram[(((mystique->dwgreg.ydst_lin + x_l) * 3) &
-                                                                           mystique->vram_mask) >>
-                                                                          12] = changeframecount;
-                                                        break;
+        if (z_buffer) {
+                uint64_t z_start = (uint64_t)mystique->dwgreg.ytop * 2 + mystique->dwgreg.zorg;
+                uint64_t z_end = ((uint64_t)mystique->dwgreg.ybot + pitch) * 2 + mystique->dwgreg.zorg;
 
-                                                case MACCESS_PWIDTH_32:
-                                                        ((uint32_t *)svga->vram)[(mystique->dwgreg.ydst_lin + x_l) &
-                                                                                 mystique->vram_mask_l] =
-                                                                b | (g << 8) | (r << 16);
-                                                        svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) &
-                                                                           mystique->vram_mask_l) >>
-                                                                          10] = changeframecount;
-                                                        break;
+                if (z_end > vram_size || (z_start < dst_end && dst_start < z_end))
+                        return 0;
+        }
 
-#ifndef RELEASE_BUILD
-                                                default:
-                                                        fatal("TRAP BLK/RPL PWIDTH %x %08x\n",
-                                                              mystique->maccess_running & MACCESS_PWIDTH_MASK,
-                                                              mystique->dwgreg.dwgctrl_running);
-#endif
-                                                }
-                                        }
-                                }
+        if (texture) {
+                const int tex_shift = 3 + ((mystique->dwgreg.texctl & TEXCTL_TPITCH_MASK) >> TEXCTL_TPITCH_SHIFT);
+                const uint64_t w_mask = (mystique->dwgreg.texwidth & TEXWIDTH_TWMASK_MASK) >> TEXWIDTH_TWMASK_SHIFT;
+                const uint64_t h_mask = (mystique->dwgreg.texheight & TEXHEIGHT_THMASK_MASK) >> TEXHEIGHT_THMASK_SHIFT;
+                uint64_t tex_start = mystique->dwgreg.texorg & ~1;
+                uint64_t tex_end = tex_start + (((h_mask << tex_shift) + w_mask + 1) * 2);
 
-                                mystique->dwgreg.dr[0] += mystique->dwgreg.dr[2];
-                                mystique->dwgreg.dr[4] += mystique->dwgreg.dr[6];
-                                mystique->dwgreg.dr[8] += mystique->dwgreg.dr[10];
-                                mystique->dwgreg.dr[12] += mystique->dwgreg.dr[14];
+                if (tex_end > vram_size || (tex_start < dst_end && dst_start < tex_end))
+                        return 0;
+        }
 
-                                x_l++;
-                                mystique->pixel_count++;
-                        }
+        return 1;
+}
 
-                        mystique->dwgreg.dr[0] = z_back + mystique->dwgreg.dr[3];
-                        mystique->dwgreg.dr[4] = r_back + mystique->dwgreg.dr[7];
-                        mystique->dwgreg.dr[8] = g_back + mystique->dwgreg.dr[11];
-                        mystique->dwgreg.dr[12] = b_back + mystique->dwgreg.dr[15];
+static void mystique_trap_step_edges(mystique_t *mystique, int shaded) {
+        if (shaded) {
+                while ((int32_t)mystique->dwgreg.ar[1] < 0 && mystique->dwgreg.ar[0]) {
+                        mystique->dwgreg.ar[1] += mystique->dwgreg.ar[0];
+                        mystique->dwgreg.fxleft += (mystique->dwgreg.sgn.sdxl ? -1 : 1);
+                }
+                mystique->dwgreg.ar[1] += mystique->dwgreg.ar[2];
 
+                while ((int32_t)mystique->dwgreg.ar[4] < 0 && mystique->dwgreg.ar[6]) {
+                        mystique->dwgreg.ar[4] += mystique->dwgreg.ar[6];
+                        mystique->dwgreg.fxright += (mystique->dwgreg.sgn.sdxr ? -1 : 1);
+                }
+                mystique->dwgreg.ar[4] += mystique->dwgreg.ar[5];
+        } else {
+                if ((int32_t)mystique->dwgreg.ar[1] < 0) {
                         while ((int32_t)mystique->dwgreg.ar[1] < 0 && mystique->dwgreg.ar[0]) {
                                 mystique->dwgreg.ar[1] += mystique->dwgreg.ar[0];
                                 mystique->dwgreg.fxleft += (mystique->dwgreg.sgn.sdxl ? -1 : 1);
                         }
+                } else
                         mystique->dwgreg.ar[1] += mystique->dwgreg.ar[2];
 
+                if ((int32_t)mystique->dwgreg.ar[4] < 0) {
                         while ((int32_t)mystique->dwgreg.ar[4] < 0 && mystique->dwgreg.ar[6]) {
                                 mystique->dwgreg.ar[4] += mystique->dwgreg.ar[6];
                                 mystique->dwgreg.fxright += (mystique->dwgreg.sgn.sdxr ? -1 : 1);
                         }
+                } else
                         mystique->dwgreg.ar[4] += mystique->dwgreg.ar[5];
+        }
+}
 
-                        dx = (int16_t)((mystique->dwgreg.fxleft - old_x_l) & 0xffff);
-                        mystique->dwgreg.dr[0] += dx * mystique->dwgreg.dr[2];
-                        mystique->dwgreg.dr[4] += dx * mystique->dwgreg.dr[6];
-                        mystique->dwgreg.dr[8] += dx * mystique->dwgreg.dr[10];
-                        mystique->dwgreg.dr[12] += dx * mystique->dwgreg.dr[14];
+static void mystique_mark_changed(mystique_t *mystique, uint32_t start, uint32_t end) {
+        uint32_t page;
 
-                        mystique->dwgreg.ydst++;
-                        mystique->dwgreg.ydst &= 0x7fffff;
-                        mystique->dwgreg.ydst_lin += (mystique->dwgreg.pitch & PITCH_MASK);
+        for (page = start >> 12; page <= (end - 1) >> 12; page++)
+                mystique->svga.changedvram[page] = changeframecount;
+}
 
-                        mystique->dwgreg.selline = (mystique->dwgreg.selline + 1) & 7;
+/*Fill count pixels from pixel address addr with one row of the 8x8 pattern. The run must not
+  wrap around the end of VRAM. Solid fills (the common case) are a plain store loop the compiler
+  can vectorise*/
+static void mystique_fill_run(mystique_t *mystique, uint32_t addr, int count, const uint32_t *col, int xoff) {
+        svga_t *svga = &mystique->svga;
+        int solid = 1;
+        int c;
+
+        for (c = 1; c < 8; c++) {
+                if (col[c] != col[0])
+                        solid = 0;
+        }
+
+        switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
+        case MACCESS_PWIDTH_8: {
+                uint8_t *p = &svga->vram[addr];
+
+                if (solid)
+                        memset(p, col[0], count);
+                else {
+                        for (c = 0; c < count; c++)
+                                p[c] = col[(xoff + c) & 7];
                 }
+                mystique_mark_changed(mystique, addr, addr + count);
                 break;
+        }
+        case MACCESS_PWIDTH_16: {
+                uint16_t *p = &((uint16_t *)svga->vram)[addr];
 
-#ifndef RELEASE_BUILD
-        default:
-                fatal("Unknown atype %03x %08x TRAP\n", mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK,
-                      mystique->dwgreg.dwgctrl_running);
-#endif
+                if (solid) {
+                        const uint16_t fill = col[0];
+
+                        for (c = 0; c < count; c++)
+                                p[c] = fill;
+                } else {
+                        for (c = 0; c < count; c++)
+                                p[c] = col[(xoff + c) & 7];
+                }
+                mystique_mark_changed(mystique, addr << 1, (addr + count) << 1);
+                break;
         }
+        case MACCESS_PWIDTH_32: {
+                uint32_t *p = &((uint32_t *)svga->vram)[addr];
 
-        mystique->blitter_complete_refcount++;
+                if (solid) {
+                        const uint32_t fill = col[0];
+
+                        for (c = 0; c < count; c++)
+                                p[c] = fill;
+                } else {
+                        for (c = 0; c < count; c++)
+                                p[c] = col[(xoff + c) & 7];
+                }
+                mystique_mark_changed(mystique, addr << 2, (addr + count) << 2);
+                break;
+        }
+        }
 }
 
-static int texture_read(mystique_t *mystique, int *tex_r, int *tex_g, int *tex_b, int *atransp) {
+/*TRAP, ATYPE BLK/RPL : solid or patterned fill with fcol/bcol*/
+static void trap_span_blk(mystique_t *mystique, const mystique_span_t *span) {
         svga_t *svga = &mystique->svga;
-        const int tex_shift = 3 + ((mystique->dwgreg.texctl & TEXCTL_TPITCH_MASK) >> TEXCTL_TPITCH_SHIFT);
-        const unsigned int palsel = mystique->dwgreg.texctl & TEXCTL_PALSEL_MASK;
-        const uint16_t tckey = mystique->dwgreg.textrans & TEXTRANS_TCKEY_MASK;
-        const uint16_t tkmask = (mystique->dwgreg.textrans & TEXTRANS_TKMASK_MASK) >> TEXTRANS_TKMASK_SHIFT;
-        const unsigned int w_mask = (mystique->dwgreg.texwidth & TEXWIDTH_TWMASK_MASK) >> TEXWIDTH_TWMASK_SHIFT;
-        const unsigned int h_mask = (mystique->dwgreg.texheight & TEXHEIGHT_THMASK_MASK) >> TEXHEIGHT_THMASK_SHIFT;
-        uint16_t src = 0;
-        int s, t;
+        const int trans_sel = (mystique->dwgreg.dwgctrl_running & DWGCTRL_TRANS_MASK) >> DWGCTRL_TRANS_SHIFT;
+        uint8_t const *const trans = &trans_masks[trans_sel][(span->selline & 3) * 4];
+        const uint32_t ydst_lin = span->ydst_lin;
+        int16_t x_l = span->x_l;
+        int16_t x_r = span->x_r;
+        int yoff = (mystique->dwgreg.yoff + span->ydst) & 7;
 
-        if (mystique->dwgreg.texctl & TEXCTL_NPCEN) {
-                const int s_shift = 20 - (mystique->dwgreg.texwidth & TEXWIDTH_TW_MASK);
-                const int t_shift = 20 - (mystique->dwgreg.texheight & TEXHEIGHT_TH_MASK);
+        if (ydst_lin < mystique->dwgreg.ytop || ydst_lin > mystique->dwgreg.ybot)
+                return;
 
-                s = (int32_t)mystique->dwgreg.tmr[6] >> s_shift;
-                t = (int32_t)mystique->dwgreg.tmr[7] >> t_shift;
-        } else {
-                const int s_shift = (20 + 16) - (mystique->dwgreg.texwidth & TEXWIDTH_TW_MASK);
-                const int t_shift = (20 + 16) - (mystique->dwgreg.texheight & TEXHEIGHT_TH_MASK);
-                int64_t q = mystique->dwgreg.tmr[8] ? ((0x100000000ll / (int64_t)(int32_t)mystique->dwgreg.tmr[8]) /*>> 16*/) : 0;
+        if (!trans_sel && x_l < x_r && (mystique->maccess_running & MACCESS_PWIDTH_MASK) != MACCESS_PWIDTH_24) {
+                int x_start = MAX(x_l, mystique->dwgreg.cxleft);
+                int x_end = MIN(x_r - 1, mystique->dwgreg.cxright);
+                uint32_t mask = mystique->vram_mask / mystique_bytes_per_pixel(mystique);
 
-                s = (((int64_t)(int32_t)mystique->dwgreg.tmr[6] * q) /*<< 8*/) >> s_shift; /*((16+20)-12);*/
-                t = (((int64_t)(int32_t)mystique->dwgreg.tmr[7] * q) /*<< 8*/) >> t_shift; /*((16+20)-9);*/
+                if (x_start > x_end)
+                        return;
+                if (ydst_lin + x_start >= ydst_lin && ydst_lin + x_end <= mask) {
+                        uint32_t col[8];
+                        int c;
+
+                        for (c = 0; c < 8; c++)
+                                col[c] = mystique->dwgreg.pattern[yoff][c] ? mystique->dwgreg.fcol : mystique->dwgreg.bcol;
+                        mystique_fill_run(mystique, ydst_lin + x_start, (x_end - x_start) + 1, col,
+                                          mystique->dwgreg.xoff + x_start);
+                        return;
+                }
         }
 
-        if (mystique->dwgreg.texctl & TEXCTL_CLAMPU) {
-                if (s < 0)
-                        s = 0;
-                else if (s > w_mask)
-                        s = w_mask;
-        } else
-                s &= w_mask;
+        while (x_l != x_r) {
+                if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright && trans[x_l & 3]) {
+                        int xoff = (mystique->dwgreg.xoff + x_l) & 7;
+                        int pattern = mystique->dwgreg.pattern[yoff][xoff];
+                        uint32_t dst;
 
-        if (mystique->dwgreg.texctl & TEXCTL_CLAMPV) {
-                if (t < 0)
-                        t = 0;
-                else if (t > h_mask)
-                        t = h_mask;
-        } else
-                t &= h_mask;
+                        switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
+                        case MACCESS_PWIDTH_8:
+                                svga->vram[(ydst_lin + x_l) & mystique->vram_mask] =
+                                        (pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol) & 0xff;
+                                svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask) >> 12] = changeframecount;
+                                break;
 
-        switch (mystique->dwgreg.texctl & TEXCTL_TEXFORMAT_MASK) {
-        case TEXCTL_TEXFORMAT_TW4:
-                src = svga->vram[(mystique->dwgreg.texorg + (((t << tex_shift) + s) >> 1)) & mystique->vram_mask];
-                if (s & 1)
-                        src >>= 4;
-                else
-                        src &= 0xf;
-                *tex_r = mystique->lut[src | palsel].r;
-                *tex_g = mystique->lut[src | palsel].g;
-                *tex_b = mystique->lut[src | palsel].b;
-                *atransp = 0;
-                break;
-        case TEXCTL_TEXFORMAT_TW8:
-                src = svga->vram[(mystique->dwgreg.texorg + (t << tex_shift) + s) & mystique->vram_mask];
-                *tex_r = mystique->lut[src].r;
-                *tex_g = mystique->lut[src].g;
-                *tex_b = mystique->lut[src].b;
-                *atransp = 0;
+                        case MACCESS_PWIDTH_16:
+                                ((uint16_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_w] =
+                                        (pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol) & 0xffff;
+                                svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask_w) >> 11] = changeframecount;
+                                break;
+
+                        case MACCESS_PWIDTH_24:
+                                dst = *(uint32_t *)(&svga->vram[((ydst_lin + x_l) * 3) & mystique->vram_mask]) & 0xff000000;
+                                *(uint32_t *)(&svga->vram[((ydst_lin + x_l) * 3) & mystique->vram_mask]) =
+                                        ((pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol) & 0xffffff) | dst;
+                                svga->changedvram[(((ydst_lin + x_l) * 3) & mystique->vram_mask) >> 12] = changeframecount;
+                                break;
+
+                        case MACCESS_PWIDTH_32:
+                                ((uint32_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_l] =
+                                        pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol;
+                                svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask_l) >> 10] = changeframecount;
+                                break;
+
+#ifndef RELEASE_BUILD
+                        default:
+                                fatal("TRAP BLK/RPL PWIDTH %x %08x\n", mystique->maccess_running & MACCESS_PWIDTH_MASK,
+                                      mystique->dwgreg.dwgctrl_running);
+#endif
+                        }
+                }
+                x_l++;
+        }
+}
+
+/*TRAP, ATYPE RSTR : fcol/bcol combined with the destination*/
+static void trap_span_rstr(mystique_t *mystique, const mystique_span_t *span) {
+        svga_t *svga = &mystique->svga;
+        const int trans_sel = (mystique->dwgreg.dwgctrl_running & DWGCTRL_TRANS_MASK) >> DWGCTRL_TRANS_SHIFT;
+        uint8_t const *const trans = &trans_masks[trans_sel][(span->selline & 3) * 4];
+        const uint32_t ydst_lin = span->ydst_lin;
+        int16_t x_l = span->x_l;
+        int16_t x_r = span->x_r;
+        int yoff = (mystique->dwgreg.yoff + span->ydst) & 7;
+
+        if (ydst_lin < mystique->dwgreg.ytop || ydst_lin > mystique->dwgreg.ybot)
+                return;
+
+        while (x_l != x_r) {
+                if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright && trans[x_l & 3]) {
+                        int xoff = (mystique->dwgreg.xoff + x_l) & 7;
+                        int pattern = mystique->dwgreg.pattern[yoff][xoff];
+                        uint32_t src = pattern ? mystique->dwgreg.fcol : mystique->dwgreg.bcol;
+                        uint32_t dst, old_dst;
+
+                        switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
+                        case MACCESS_PWIDTH_8:
+                                dst = svga->vram[(ydst_lin + x_l) & mystique->vram_mask];
+
+                                dst = bitop(src, dst, mystique->dwgreg.dwgctrl_running);
+                                svga->vram[(ydst_lin + x_l) & mystique->vram_mask] = dst;
+                                svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask) >> 12] = changeframecount;
+                                break;
+
+                        case MACCESS_PWIDTH_16:
+                                dst = ((uint16_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_w];
+
+                                dst = bitop(src, dst, mystique->dwgreg.dwgctrl_running);
+                                ((uint16_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_w] = dst;
+                                svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask_w) >> 11] = changeframecount;
+                                break;
+
+                        case MACCESS_PWIDTH_24:
+                                old_dst = *(uint32_t *)&svga->vram[((ydst_lin + x_l) * 3) & mystique->vram_mask];
+
+                                dst = bitop(src, old_dst, mystique->dwgreg.dwgctrl_running);
+                                *(uint32_t *)&svga->vram[((ydst_lin + x_l) * 3) & mystique->vram_mask] =
+                                        (dst & 0xffffff) | (old_dst & 0xff000000);
+                                svga->changedvram[(((ydst_lin + x_l) * 3) & mystique->vram_mask) >> 12] = changeframecount;
+                                break;
+
+                        case MACCESS_PWIDTH_32:
+                                dst = ((uint32_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_l];
+
+                                dst = bitop(src, dst, mystique->dwgreg.dwgctrl_running);
+                                ((uint32_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_l] = dst;
+                                svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask_l) >> 10] = changeframecount;
+                                break;
+
+#ifndef RELEASE_BUILD
+                        default:
+                                fatal("TRAP RSTR PWIDTH %x %08x\n", mystique->maccess_running & MACCESS_PWIDTH_MASK,
+                                      mystique->dwgreg.dwgctrl_running);
+#endif
+                        }
+                }
+                x_l++;
+        }
+}
+
+/*TRAP, ATYPE I/ZI : Gouraud shaded, optionally Z buffered*/
+static void trap_span_i(mystique_t *mystique, const mystique_span_t *span) {
+        svga_t *svga = &mystique->svga;
+        const int trans_sel = (mystique->dwgreg.dwgctrl_running & DWGCTRL_TRANS_MASK) >> DWGCTRL_TRANS_SHIFT;
+        const int z_write = ((mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK) == DWGCTRL_ATYPE_ZI);
+        uint8_t const *const trans = &trans_masks[trans_sel][(span->selline & 3) * 4];
+        const uint32_t ydst_lin = span->ydst_lin;
+        uint16_t *z_p = (uint16_t *)&svga->vram[(ydst_lin * 2 + mystique->dwgreg.zorg) & mystique->vram_mask];
+        int16_t x_l = span->x_l;
+        int16_t x_r = span->x_r;
+        uint32_t dr[4];
+
+        if (ydst_lin < mystique->dwgreg.ytop || ydst_lin > mystique->dwgreg.ybot)
+                return;
+
+        dr[0] = span->dr[0];
+        dr[1] = span->dr[1];
+        dr[2] = span->dr[2];
+        dr[3] = span->dr[3];
+
+        while (x_l != x_r) {
+                if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright && trans[x_l & 3]) {
+                        uint16_t z = ((int32_t)dr[0] < 0) ? 0 : (dr[0] >> 15);
+                        uint16_t old_z = z_p[x_l];
+
+                        if (z_check(z, old_z, mystique->dwgreg.dwgctrl_running & DWGCTRL_ZMODE_MASK)) {
+                                uint32_t dst = 0, old_dst;
+                                int r = 0, g = 0, b = 0;
+
+                                if (!(dr[1] & (1 << 23)))
+                                        r = (dr[1] >> 15) & 0xff;
+                                if (!(dr[2] & (1 << 23)))
+                                        g = (dr[2] >> 15) & 0xff;
+                                if (!(dr[3] & (1 << 23)))
+                                        b = (dr[3] >> 15) & 0xff;
+
+                                if (z_write)
+                                        z_p[x_l] = z;
+
+                                switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
+                                case MACCESS_PWIDTH_8:
+                                        svga->vram[(ydst_lin + x_l) & mystique->vram_mask] = dst;
+                                        svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask) >> 12] = changeframecount;
+                                        break;
+
+                                case MACCESS_PWIDTH_16:
+                                        dst = dither(mystique, r, g, b, x_l & 1, span->selline & 1);
+                                        ((uint16_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_w] = dst;
+                                        svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask_w) >> 11] = changeframecount;
+                                        break;
+
+                                case MACCESS_PWIDTH_24:
+                                        old_dst = *(uint32_t *)(&svga->vram[((ydst_lin + x_l) * 3) & mystique->vram_mask]) &
+                                                  0xff000000;
+                                        *(uint32_t *)(&svga->vram[((ydst_lin + x_l) * 3) & mystique->vram_mask]) = old_dst | dst;
+                                        svga->changedvram[(((ydst_lin + x_l) * 3) & mystique->vram_mask) >> 12] =
+                                                changeframecount;
+                                        break;
+
+                                case MACCESS_PWIDTH_32:
+                                        ((uint32_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_l] =
+                                                b | (g << 8) | (r << 16);
+                                        svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask_l) >> 10] = changeframecount;
+                                        break;
+
+#ifndef RELEASE_BUILD
+                                default:
+                                        fatal("TRAP BLK/RPL PWIDTH %x %08x\n", mystique->maccess_running & MACCESS_PWIDTH_MASK,
+                                              mystique->dwgreg.dwgctrl_running);
+#endif
+                                }
+                        }
+                }
+
+                dr[0] += mystique->dwgreg.dr[2];
+                dr[1] += mystique->dwgreg.dr[6];
+                dr[2] += mystique->dwgreg.dr[10];
+                dr[3] += mystique->dwgreg.dr[14];
+
+                x_l++;
+        }
+}
+
+static void blit_trap(mystique_t *mystique) {
+        int shaded = 0, split = 0;
+        int y;
+
+        mystique->trap_count++;
+
+        switch (mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK) {
+        case DWGCTRL_ATYPE_BLK:
+        case DWGCTRL_ATYPE_RPL:
+                mystique->span_func = trap_span_blk;
+                split = mystique_trap_can_split(mystique, 0, 0);
+                break;
+
+        case DWGCTRL_ATYPE_RSTR:
+                mystique->span_func = trap_span_rstr;
+                split = mystique_trap_can_split(mystique, 0, 0);
+                break;
+
+        case DWGCTRL_ATYPE_I:
+        case DWGCTRL_ATYPE_ZI:
+                mystique->span_func = trap_span_i;
+                split = mystique_trap_can_split(mystique, 1, 0);
+                shaded = 1;
+                break;
+
+        default:
+#ifndef RELEASE_BUILD
+                fatal("Unknown atype %03x %08x TRAP\n", mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK,
+                      mystique->dwgreg.dwgctrl_running);
+#endif
+                mystique->blitter_complete_refcount++;
+                return;
+        }
+
+        for (y = 0; y < mystique->dwgreg.length; y++) {
+                mystique_span_t *span = &mystique->spans[mystique->nr_spans++];
+                int16_t old_x_l = mystique->dwgreg.fxleft;
+
+                span->x_l = mystique->dwgreg.fxleft;
+                span->x_r = mystique->dwgreg.fxright;
+                span->ydst = mystique->dwgreg.ydst;
+                span->ydst_lin = mystique->dwgreg.ydst_lin;
+                span->selline = mystique->dwgreg.selline;
+                span->dr[0] = mystique->dwgreg.dr[0];
+                span->dr[1] = mystique->dwgreg.dr[4];
+                span->dr[2] = mystique->dwgreg.dr[8];
+                span->dr[3] = mystique->dwgreg.dr[12];
+                mystique->span_pixels += (uint16_t)(span->x_r - span->x_l);
+                mystique->pixel_count += (uint16_t)(span->x_r - span->x_l);
+
+                mystique_trap_step_edges(mystique, shaded);
+
+                if (shaded) {
+                        int dx = (int16_t)((mystique->dwgreg.fxleft - old_x_l) & 0xffff);
+
+                        mystique->dwgreg.dr[0] += mystique->dwgreg.dr[3] + dx * mystique->dwgreg.dr[2];
+                        mystique->dwgreg.dr[4] += mystique->dwgreg.dr[7] + dx * mystique->dwgreg.dr[6];
+                        mystique->dwgreg.dr[8] += mystique->dwgreg.dr[11] + dx * mystique->dwgreg.dr[10];
+                        mystique->dwgreg.dr[12] += mystique->dwgreg.dr[15] + dx * mystique->dwgreg.dr[14];
+                }
+
+                mystique->dwgreg.ydst++;
+                mystique->dwgreg.ydst &= 0x7fffff;
+                mystique->dwgreg.ydst_lin += (mystique->dwgreg.pitch & PITCH_MASK);
+
+                mystique->dwgreg.selline = (mystique->dwgreg.selline + 1) & 7;
+
+                if (mystique->nr_spans == MGA_MAX_SPANS)
+                        mystique_flush_spans(mystique, split);
+        }
+        mystique_flush_spans(mystique, split);
+
+        mystique->blitter_complete_refcount++;
+}
+
+static int texture_read(mystique_t *mystique, uint32_t s_wc, uint32_t t_wc, uint32_t q_wc, int *tex_r, int *tex_g, int *tex_b,
+                        int *atransp) {
+        svga_t *svga = &mystique->svga;
+        const int tex_shift = 3 + ((mystique->dwgreg.texctl & TEXCTL_TPITCH_MASK) >> TEXCTL_TPITCH_SHIFT);
+        const unsigned int palsel = mystique->dwgreg.texctl & TEXCTL_PALSEL_MASK;
+        const uint16_t tckey = mystique->dwgreg.textrans & TEXTRANS_TCKEY_MASK;
+        const uint16_t tkmask = (mystique->dwgreg.textrans & TEXTRANS_TKMASK_MASK) >> TEXTRANS_TKMASK_SHIFT;
+        const unsigned int w_mask = (mystique->dwgreg.texwidth & TEXWIDTH_TWMASK_MASK) >> TEXWIDTH_TWMASK_SHIFT;
+        const unsigned int h_mask = (mystique->dwgreg.texheight & TEXHEIGHT_THMASK_MASK) >> TEXHEIGHT_THMASK_SHIFT;
+        uint16_t src = 0;
+        int s, t;
+
+        if (mystique->dwgreg.texctl & TEXCTL_NPCEN) {
+                const int s_shift = 20 - (mystique->dwgreg.texwidth & TEXWIDTH_TW_MASK);
+                const int t_shift = 20 - (mystique->dwgreg.texheight & TEXHEIGHT_TH_MASK);
+
+                s = (int32_t)s_wc >> s_shift;
+                t = (int32_t)t_wc >> t_shift;
+        } else {
+                const int s_shift = (20 + 16) - (mystique->dwgreg.texwidth & TEXWIDTH_TW_MASK);
+                const int t_shift = (20 + 16) - (mystique->dwgreg.texheight & TEXHEIGHT_TH_MASK);
+                int64_t q = q_wc ? ((0x100000000ll / (int64_t)(int32_t)q_wc) /*>> 16*/) : 0;
+
+                s = (((int64_t)(int32_t)s_wc * q) /*<< 8*/) >> s_shift; /*((16+20)-12);*/
+                t = (((int64_t)(int32_t)t_wc * q) /*<< 8*/) >> t_shift; /*((16+20)-9);*/
+        }
+
+        if (mystique->dwgreg.texctl & TEXCTL_CLAMPU) {
+                if (s < 0)
+                        s = 0;
+                else if (s > w_mask)
+                        s = w_mask;
+        } else
+                s &= w_mask;
+
+        if (mystique->dwgreg.texctl & TEXCTL_CLAMPV) {
+                if (t < 0)
+                        t = 0;
+                else if (t > h_mask)
+                        t = h_mask;
+        } else
+                t &= h_mask;
+
+        switch (mystique->dwgreg.texctl & TEXCTL_TEXFORMAT_MASK) {
+        case TEXCTL_TEXFORMAT_TW4:
+                src = svga->vram[(mystique->dwgreg.texorg + (((t << tex_shift) + s) >> 1)) & mystique->vram_mask];
+                if (s & 1)
+                        src >>= 4;
+                else
+                        src &= 0xf;
+                *tex_r = mystique->lut[src | palsel].r;
+                *tex_g = mystique->lut[src | palsel].g;
+                *tex_b = mystique->lut[src | palsel].b;
+                *atransp = 0;
+                break;
+        case TEXCTL_TEXFORMAT_TW8:
+                src = svga->vram[(mystique->dwgreg.texorg + (t << tex_shift) + s) & mystique->vram_mask];
+                *tex_r = mystique->lut[src].r;
+                *tex_g = mystique->lut[src].g;
+                *tex_b = mystique->lut[src].b;
+                *atransp = 0;
                 break;
         case TEXCTL_TEXFORMAT_TW15:
                 src = ((uint16_t *)svga->vram)[((mystique->dwgreg.texorg >> 1) + (t << tex_shift) + s) & mystique->vram_mask_w];
@@ -4590,212 +4784,417 @@ static int texture_read(mystique_t *mystique, int *tex_r, int *tex_g, int *tex_b
         return ((src & tkmask) == tckey);
 }
 
-static void blit_texture_trap(mystique_t *mystique) {
+/*TEXTURE_TRAP, ATYPE I/ZI : point sampled, perspective correct texture mapping. Every pixel needs
+  its own 64-bit divide and texel read, so this stays a per-pixel loop; large primitives are only
+  sped up by splitting their spans between the render threads*/
+static void texture_trap_span(mystique_t *mystique, const mystique_span_t *span) {
         svga_t *svga = &mystique->svga;
-        int y;
-        int z_write;
         const int trans_sel = (mystique->dwgreg.dwgctrl_running & DWGCTRL_TRANS_MASK) >> DWGCTRL_TRANS_SHIFT;
         const int dest32 = ((mystique->maccess_running & MACCESS_PWIDTH_MASK) == MACCESS_PWIDTH_32);
+        const int z_write = ((mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK) == DWGCTRL_ATYPE_ZI);
+        uint8_t const *const trans = &trans_masks[trans_sel][(span->selline & 3) * 4];
+        const uint32_t ydst_lin = span->ydst_lin;
+        uint16_t *z_p = (uint16_t *)&svga->vram[(ydst_lin * 2 + mystique->dwgreg.zorg) & mystique->vram_mask];
+        int16_t x_l = span->x_l;
+        int16_t x_r = span->x_r;
+        uint32_t dr[4], tmr[3];
+
+        if (ydst_lin < mystique->dwgreg.ytop || ydst_lin > mystique->dwgreg.ybot)
+                return;
+
+        dr[0] = span->dr[0];
+        dr[1] = span->dr[1];
+        dr[2] = span->dr[2];
+        dr[3] = span->dr[3];
+        tmr[0] = span->tmr[0];
+        tmr[1] = span->tmr[1];
+        tmr[2] = span->tmr[2];
+
+        while (x_l != x_r) {
+                if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright && trans[x_l & 3]) {
+                        uint16_t z = ((int32_t)dr[0] < 0) ? 0 : (dr[0] >> 15);
+                        uint16_t old_z = z_p[x_l];
+
+                        if (z_check(z, old_z, mystique->dwgreg.dwgctrl_running & DWGCTRL_ZMODE_MASK)) {
+                                int tex_r = 0, tex_g = 0, tex_b = 0;
+                                int ctransp, atransp = 0;
+                                int i_r = 0, i_g = 0, i_b = 0;
+
+                                if (!(dr[1] & (1 << 23)))
+                                        i_r = (dr[1] >> 15) & 0xff;
+                                if (!(dr[2] & (1 << 23)))
+                                        i_g = (dr[2] >> 15) & 0xff;
+                                if (!(dr[3] & (1 << 23)))
+                                        i_b = (dr[3] >> 15) & 0xff;
+
+                                ctransp = texture_read(mystique, tmr[0], tmr[1], tmr[2], &tex_r, &tex_g, &tex_b, &atransp);
+
+                                switch (mystique->dwgreg.texctl &
+                                        (TEXCTL_TMODULATE | TEXCTL_STRANS | TEXCTL_ITRANS | TEXCTL_DECALCKEY)) {
+                                case 0:
+                                        if (ctransp)
+                                                goto skip_pixel;
+                                        if (atransp) {
+                                                tex_r = i_r;
+                                                tex_g = i_g;
+                                                tex_b = i_b;
+                                        }
+                                        break;
+
+                                case TEXCTL_DECALCKEY:
+                                        if (ctransp) {
+                                                tex_r = i_r;
+                                                tex_g = i_g;
+                                                tex_b = i_b;
+                                        }
+                                        break;
+
+                                case (TEXCTL_STRANS | TEXCTL_DECALCKEY):
+                                        if (ctransp)
+                                                goto skip_pixel;
+                                        break;
+
+                                case TEXCTL_TMODULATE:
+                                        if (ctransp)
+                                                goto skip_pixel;
+                                        if (mystique->dwgreg.texctl & TEXCTL_TMODULATE) {
+                                                tex_r = (tex_r * i_r) >> 8;
+                                                tex_g = (tex_g * i_g) >> 8;
+                                                tex_b = (tex_b * i_b) >> 8;
+                                        }
+                                        break;
+
+                                case (TEXCTL_TMODULATE | TEXCTL_STRANS):
+                                        if (ctransp || atransp)
+                                                goto skip_pixel;
+                                        if (mystique->dwgreg.texctl & TEXCTL_TMODULATE) {
+                                                tex_r = (tex_r * i_r) >> 8;
+                                                tex_g = (tex_g * i_g) >> 8;
+                                                tex_b = (tex_b * i_b) >> 8;
+                                        }
+                                        break;
+
+#ifndef RELEASE_BUILD
+                                default:
+                                        fatal("Bad TEXCTL %08x %08x\n", mystique->dwgreg.texctl,
+                                              mystique->dwgreg.texctl & (TEXCTL_TMODULATE | TEXCTL_STRANS |
+                                                                         TEXCTL_ITRANS | TEXCTL_DECALCKEY));
+#endif
+                                }
+
+                                if (dest32) {
+                                        ((uint32_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_l] =
+                                                tex_b | (tex_g << 8) | (tex_r << 16);
+                                        svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask_l) >> 10] = changeframecount;
+                                } else {
+                                        ((uint16_t *)svga->vram)[(ydst_lin + x_l) & mystique->vram_mask_w] =
+                                                dither(mystique, tex_r, tex_g, tex_b, x_l & 1, span->selline & 1);
+                                        svga->changedvram[((ydst_lin + x_l) & mystique->vram_mask_w) >> 11] = changeframecount;
+                                }
+                                if (z_write)
+                                        z_p[x_l] = z;
+                        }
+                }
+        skip_pixel:
+                x_l++;
+
+                dr[0] += mystique->dwgreg.dr[2];
+                dr[1] += mystique->dwgreg.dr[6];
+                dr[2] += mystique->dwgreg.dr[10];
+                dr[3] += mystique->dwgreg.dr[14];
+                tmr[0] += mystique->dwgreg.tmr[0];
+                tmr[1] += mystique->dwgreg.tmr[2];
+                tmr[2] += mystique->dwgreg.tmr[4];
+        }
+}
+
+static void blit_texture_trap(mystique_t *mystique) {
+        int split;
+        int y;
 
         mystique->trap_count++;
 
         switch (mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK) {
         case DWGCTRL_ATYPE_I:
         case DWGCTRL_ATYPE_ZI:
-                z_write = ((mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK) == DWGCTRL_ATYPE_ZI);
-                //                pclog("fxleft=%i fxright=%i texctl=%08x texorg=%08x ydst=%i len=%i\n", mystique->dwgreg.fxleft,
-                //                mystique->dwgreg.fxright, mystique->dwgreg.texctl, mystique->dwgreg.texorg,
-                //                mystique->dwgreg.ydst, mystique->dwgreg.length);
-                /*                pclog("fcol=%08x\n", mystique->dwgreg.fcol);
-                                pclog("ytop=%i length=%i\n", mystique->dwgreg.ytop, mystique->dwgreg.length);
-                                pclog("pitch=%08x\n", mystique->dwgreg.pitch);
-                                pclog("ydst=%i ydst_lin=%08x\n", mystique->dwgreg.ydst, mystique->dwgreg.ydst_lin);
-                                pclog("dYl =%08x errl  =%08x -|dXl|=%08x\n", mystique->dwgreg.ar[0], mystique->dwgreg.ar[1],
-                   mystique->dwgreg.ar[2]); pclog("errr=%08x -|dXr|=%08x dYr   =%08x\n", mystique->dwgreg.ar[4],
-                   mystique->dwgreg.ar[5], mystique->dwgreg.ar[6]); pclog(" q/wc=%08x q/wc/dX=%08x q/wc/dY=%08x\n",
-                                        mystique->dwgreg.tmr[8], mystique->dwgreg.tmr[4], mystique->dwgreg.tmr[5]);
-                                pclog(" s/wc=%08x s/wc/dX=%08x s/wc/dY=%08x\n",
-                                        mystique->dwgreg.tmr[6], mystique->dwgreg.tmr[0], mystique->dwgreg.tmr[1]);
-                                pclog(" t/wc=%08x t/wc/dX=%08x t/wc/dY=%08x\n",
-                                        mystique->dwgreg.tmr[7], mystique->dwgreg.tmr[2], mystique->dwgreg.tmr[3]);*/
-
-                for (y = 0; y < mystique->dwgreg.length; y++) {
-                        uint8_t const *const trans = &trans_masks[trans_sel][(mystique->dwgreg.selline & 3) * 4];
-                        uint16_t *z_p =
-                                (uint16_t *)&svga
-                                        ->vram[(mystique->dwgreg.ydst_lin * 2 + mystique->dwgreg.zorg) & mystique->vram_mask];
-                        int16_t x_l = mystique->dwgreg.fxleft & 0xffff;
-                        int16_t x_r = mystique->dwgreg.fxright & 0xffff;
-                        int16_t old_x_l = x_l;
-                        int dx;
-
-                        uint32_t z_back = mystique->dwgreg.dr[0];
-                        uint32_t r_back = mystique->dwgreg.dr[4];
-                        uint32_t g_back = mystique->dwgreg.dr[8];
-                        uint32_t b_back = mystique->dwgreg.dr[12];
-                        uint32_t s_back = mystique->dwgreg.tmr[6];
-                        uint32_t t_back = mystique->dwgreg.tmr[7];
-                        uint32_t q_back = mystique->dwgreg.tmr[8];
-
-                        //                        pclog("  line %i: %i %i  %08x %08x %08x  %08x %i\n", __y, x_l, x_r,
-                        //                        mystique->dwgreg.dr[0],mystique->dwgreg.dr[2],mystique->dwgreg.dr[3],
-                        //                        mystique->dwgreg.ydst_lin*2 + mystique->dwgreg.zorg, z_write); pclog("    %08x
-                        //                        %08x %08x\n", mystique->dwgreg.tmr[4],mystique->dwgreg.tmr[5],
-                        //                        mystique->dwgreg.tmr[8]); pclog("    %08x %08x %08x\n", mystique->dwgreg.ar[4],
-                        //                        mystique->dwgreg.ar[5], mystique->dwgreg.ar[6]);
-
-                        while (x_l != x_r) {
-                                if (x_l >= mystique->dwgreg.cxleft && x_l <= mystique->dwgreg.cxright &&
-                                    mystique->dwgreg.ydst_lin >= mystique->dwgreg.ytop &&
-                                    mystique->dwgreg.ydst_lin <= mystique->dwgreg.ybot && trans[x_l & 3]) {
-                                        uint16_t z = ((int32_t)mystique->dwgreg.dr[0] < 0) ? 0 : (mystique->dwgreg.dr[0] >> 15);
-                                        uint16_t old_z = z_p[x_l];
+                break;
 
-                                        if (z_check(z, old_z, mystique->dwgreg.dwgctrl_running & DWGCTRL_ZMODE_MASK)) {
-                                                int tex_r = 0, tex_g = 0, tex_b = 0;
-                                                int ctransp, atransp = 0;
-                                                int i_r = 0, i_g = 0, i_b = 0;
+        default:
+#ifndef RELEASE_BUILD
+                fatal("Unknown atype %03x %08x TEXTURE_TRAP\n", mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK,
+                      mystique->dwgreg.dwgctrl_running);
+#endif
+                mystique->blitter_complete_refcount++;
+                return;
+        }
 
-                                                if (!(mystique->dwgreg.dr[4] & (1 << 23)))
-                                                        i_r = (mystique->dwgreg.dr[4] >> 15) & 0xff;
-                                                if (!(mystique->dwgreg.dr[8] & (1 << 23)))
-                                                        i_g = (mystique->dwgreg.dr[8] >> 15) & 0xff;
-                                                if (!(mystique->dwgreg.dr[12] & (1 << 23)))
-                                                        i_b = (mystique->dwgreg.dr[12] >> 15) & 0xff;
-
-                                                ctransp = texture_read(mystique, &tex_r, &tex_g, &tex_b, &atransp);
-
-                                                switch (mystique->dwgreg.texctl &
-                                                        (TEXCTL_TMODULATE | TEXCTL_STRANS | TEXCTL_ITRANS | TEXCTL_DECALCKEY)) {
-                                                case 0:
-                                                        if (ctransp)
-                                                                goto skip_pixel;
-                                                        if (atransp) {
-                                                                tex_r = i_r;
-                                                                tex_g = i_g;
-                                                                tex_b = i_b;
-                                                        }
-                                                        break;
+        mystique->span_func = texture_trap_span;
+        split = mystique_trap_can_split(mystique, 1, 1);
 
-                                                case TEXCTL_DECALCKEY:
-                                                        if (ctransp) {
-                                                                tex_r = i_r;
-                                                                tex_g = i_g;
-                                                                tex_b = i_b;
-                                                        }
-                                                        break;
+        for (y = 0; y < mystique->dwgreg.length; y++) {
+                mystique_span_t *span = &mystique->spans[mystique->nr_spans++];
+                int16_t old_x_l = mystique->dwgreg.fxleft;
+                int dx;
+
+                span->x_l = mystique->dwgreg.fxleft;
+                span->x_r = mystique->dwgreg.fxright;
+                span->ydst = mystique->dwgreg.ydst;
+                span->ydst_lin = mystique->dwgreg.ydst_lin;
+                span->selline = mystique->dwgreg.selline;
+                span->dr[0] = mystique->dwgreg.dr[0];
+                span->dr[1] = mystique->dwgreg.dr[4];
+                span->dr[2] = mystique->dwgreg.dr[8];
+                span->dr[3] = mystique->dwgreg.dr[12];
+                span->tmr[0] = mystique->dwgreg.tmr[6];
+                span->tmr[1] = mystique->dwgreg.tmr[7];
+                span->tmr[2] = mystique->dwgreg.tmr[8];
+                mystique->span_pixels += (uint16_t)(span->x_r - span->x_l);
+                mystique->pixel_count += (uint16_t)(span->x_r - span->x_l);
+
+                mystique_trap_step_edges(mystique, 1);
+
+                dx = (int16_t)((mystique->dwgreg.fxleft - old_x_l) & 0xffff);
+                mystique->dwgreg.dr[0] += mystique->dwgreg.dr[3] + dx * mystique->dwgreg.dr[2];
+                mystique->dwgreg.dr[4] += mystique->dwgreg.dr[7] + dx * mystique->dwgreg.dr[6];
+                mystique->dwgreg.dr[8] += mystique->dwgreg.dr[11] + dx * mystique->dwgreg.dr[10];
+                mystique->dwgreg.dr[12] += mystique->dwgreg.dr[15] + dx * mystique->dwgreg.dr[14];
+                mystique->dwgreg.tmr[6] += mystique->dwgreg.tmr[1] + dx * mystique->dwgreg.tmr[0];
+                mystique->dwgreg.tmr[7] += mystique->dwgreg.tmr[3] + dx * mystique->dwgreg.tmr[2];
+                mystique->dwgreg.tmr[8] += mystique->dwgreg.tmr[5] + dx * mystique->dwgreg.tmr[4];
+
+                mystique->dwgreg.ydst++;
+                mystique->dwgreg.ydst &= 0x7fffff;
+                mystique->dwgreg.ydst_lin += (mystique->dwgreg.pitch & PITCH_MASK);
+
+                mystique->dwgreg.selline = (mystique->dwgreg.selline + 1) & 7;
+
+                if (mystique->nr_spans == MGA_MAX_SPANS)
+                        mystique_flush_spans(mystique, split);
+        }
+        mystique_flush_spans(mystique, split);
 
-                                                case (TEXCTL_STRANS | TEXCTL_DECALCKEY):
-                                                        if (ctransp)
-                                                                goto skip_pixel;
-                                                        break;
+        mystique->blitter_complete_refcount++;
+}
 
-                                                case TEXCTL_TMODULATE:
-                                                        if (ctransp)
-                                                                goto skip_pixel;
-                                                        if (mystique->dwgreg.texctl & TEXCTL_TMODULATE) {
-                                                                tex_r = (tex_r * i_r) >> 8;
-                                                                tex_g = (tex_g * i_g) >> 8;
-                                                                tex_b = (tex_b * i_b) >> 8;
-                                                        }
-                                                        break;
+/*Copy a run of pixels for a plain (BOP 0xc) bitblt. Pixels are copied in the same order as the
+  per-pixel path, so this is only used when that order gives the same result as memmove*/
+static int bitblt_copy_run(mystique_t *mystique, uint32_t dst_addr, uint32_t src_addr, int count, int x_dir) {
+        const int bpp = mystique_bytes_per_pixel(mystique);
+        const uint64_t vram_size = (uint64_t)mystique->vram_mask + 1;
+        uint64_t dst = (uint64_t)dst_addr * bpp;
+        uint64_t src = (uint64_t)src_addr * bpp;
+        uint64_t len = (uint64_t)count * bpp;
 
-                                                case (TEXCTL_TMODULATE | TEXCTL_STRANS):
-                                                        if (ctransp || atransp)
-                                                                goto skip_pixel;
-                                                        if (mystique->dwgreg.texctl & TEXCTL_TMODULATE) {
-                                                                tex_r = (tex_r * i_r) >> 8;
-                                                                tex_g = (tex_g * i_g) >> 8;
-                                                                tex_b = (tex_b * i_b) >> 8;
-                                                        }
-                                                        break;
+        if (bpp == 3 || dst + len > vram_size || src + len > vram_size)
+                return 0;
+        if (x_dir > 0 ? (dst > src && dst < src + len) : (dst < src && dst + len > src))
+                return 0;
+
+        memmove(&mystique->svga.vram[dst], &mystique->svga.vram[src], len);
+        mystique_mark_changed(mystique, dst, dst + len);
+        return 1;
+}
+
+/*BITBLT, BLTMOD BFCOL/BU32RGB*/
+static void bitblt_span_fcol(mystique_t *mystique, const mystique_span_t *span) {
+        svga_t *svga = &mystique->svga;
+        const int trans_sel = (mystique->dwgreg.dwgctrl_running & DWGCTRL_TRANS_MASK) >> DWGCTRL_TRANS_SHIFT;
+        uint8_t const *const trans = &trans_masks[trans_sel][(span->selline & 3) * 4];
+        const uint32_t ydst_lin = span->ydst_lin;
+        const int x_dir = mystique->dwgreg.sgn.scanleft ? -1 : 1;
+        int16_t x = mystique->dwgreg.sgn.scanleft ? mystique->dwgreg.fxright : mystique->dwgreg.fxleft;
+        int16_t x_end = mystique->dwgreg.sgn.scanleft ? mystique->dwgreg.fxleft : mystique->dwgreg.fxright;
+        uint32_t src_addr = span->src_addr;
+        uint32_t ar0 = span->ar0, ar3 = span->ar3;
+
+        if (ydst_lin < mystique->dwgreg.ytop || ydst_lin > mystique->dwgreg.ybot)
+                return;
+
+        /*Plain copy where the whole line is read from one contiguous source run*/
+        if ((mystique->dwgreg.dwgctrl_running & (DWGCTRL_BOP_MASK | DWGCTRL_PATTERN)) == BOP(0xc) && !trans_sel &&
+            (x_dir > 0 ? x <= x_end : x >= x_end)) {
+                int count = (x_end - x) * x_dir + 1;
+                uint32_t steps = (x_dir > 0) ? (ar0 - src_addr) : (src_addr - ar0);
+
+                if (steps >= (uint32_t)count - 1) {
+                        int x_start = MAX(MIN(x, x_end), mystique->dwgreg.cxleft);
+                        int x_last = MIN(MAX(x, x_end), mystique->dwgreg.cxright);
+
+                        if (x_start > x_last)
+                                return;
+                        if (bitblt_copy_run(mystique, ydst_lin + x_start, src_addr + (x_start - x), (x_last - x_start) + 1,
+                                            x_dir))
+                                return;
+                }
+        }
+
+        while (1) {
+                if (x >= mystique->dwgreg.cxleft && x <= mystique->dwgreg.cxright && trans[x & 3]) {
+                        uint32_t src, dst, old_dst;
+
+                        switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
+                        case MACCESS_PWIDTH_8:
+                                src = svga->vram[src_addr & mystique->vram_mask];
+                                dst = svga->vram[(ydst_lin + x) & mystique->vram_mask];
+
+                                dst = bitop(src, dst, mystique->dwgreg.dwgctrl_running);
+
+                                svga->vram[(ydst_lin + x) & mystique->vram_mask] = dst;
+                                svga->changedvram[((ydst_lin + x) & mystique->vram_mask) >> 12] = changeframecount;
+                                break;
+
+                        case MACCESS_PWIDTH_16:
+                                src = ((uint16_t *)svga->vram)[src_addr & mystique->vram_mask_w];
+                                dst = ((uint16_t *)svga->vram)[(ydst_lin + x) & mystique->vram_mask_w];
+
+                                dst = bitop(src, dst, mystique->dwgreg.dwgctrl_running);
+
+                                ((uint16_t *)svga->vram)[(ydst_lin + x) & mystique->vram_mask_w] = dst;
+                                svga->changedvram[((ydst_lin + x) & mystique->vram_mask_w) >> 11] = changeframecount;
+                                break;
+
+                        case MACCESS_PWIDTH_24:
+                                src = *(uint32_t *)&svga->vram[(src_addr * 3) & mystique->vram_mask];
+                                old_dst = *(uint32_t *)&svga->vram[((ydst_lin + x) * 3) & mystique->vram_mask];
+
+                                dst = bitop(src, old_dst, mystique->dwgreg.dwgctrl_running);
+
+                                *(uint32_t *)&svga->vram[((ydst_lin + x) * 3) & mystique->vram_mask] =
+                                        (dst & 0xffffff) | (old_dst & 0xff000000);
+                                svga->changedvram[(((ydst_lin + x) * 3) & mystique->vram_mask) >> 12] = changeframecount;
+                                break;
+
+                        case MACCESS_PWIDTH_32:
+                                src = ((uint32_t *)svga->vram)[src_addr & mystique->vram_mask_l];
+                                dst = ((uint32_t *)svga->vram)[(ydst_lin + x) & mystique->vram_mask_l];
+
+                                dst = bitop(src, dst, mystique->dwgreg.dwgctrl_running);
+
+                                ((uint32_t *)svga->vram)[(ydst_lin + x) & mystique->vram_mask_l] = dst;
+                                svga->changedvram[((ydst_lin + x) & mystique->vram_mask_l) >> 10] = changeframecount;
+                                break;
 
 #ifndef RELEASE_BUILD
-                                                default:
-                                                        fatal("Bad TEXCTL %08x %08x\n", mystique->dwgreg.texctl,
-                                                              mystique->dwgreg.texctl & (TEXCTL_TMODULATE | TEXCTL_STRANS |
-                                                                                         TEXCTL_ITRANS | TEXCTL_DECALCKEY));
+                        default:
+                                fatal("BITBLT RPL BFCOL PWIDTH %x %08x\n", mystique->maccess_running & MACCESS_PWIDTH_MASK,
+                                      mystique->dwgreg.dwgctrl_running);
 #endif
-                                                }
-
-                                                if (dest32) {
-                                                        ((uint32_t *)svga->vram)[(mystique->dwgreg.ydst_lin + x_l) &
-                                                                                 mystique->vram_mask_l] =
-                                                                tex_b | (tex_g << 8) | (tex_r << 16);
-                                                        svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) &
-                                                                           mystique->vram_mask_l) >>
-                                                                          10] = changeframecount;
-                                                } else {
-                                                        ((uint16_t *)svga->vram)[(mystique->dwgreg.ydst_lin + x_l) &
-                                                                                 mystique->vram_mask_w] =
-                                                                dither(mystique, tex_r, tex_g, tex_b, x_l & 1,
-                                                                       mystique->dwgreg.selline & 1);
-                                                        svga->changedvram[((mystique->dwgreg.ydst_lin + x_l) &
-                                                                           mystique->vram_mask_w) >>
-                                                                          11] = changeframecount;
-                                                }
-                                                if (z_write)
-                                                        z_p[x_l] = z;
-                                        }
-                                }
-                        skip_pixel:
-                                x_l++;
-                                mystique->pixel_count++;
-
-                                mystique->dwgreg.dr[0] += mystique->dwgreg.dr[2];
-                                mystique->dwgreg.dr[4] += mystique->dwgreg.dr[6];
-                                mystique->dwgreg.dr[8] += mystique->dwgreg.dr[10];
-                                mystique->dwgreg.dr[12] += mystique->dwgreg.dr[14];
-                                mystique->dwgreg.tmr[6] += mystique->dwgreg.tmr[0];
-                                mystique->dwgreg.tmr[7] += mystique->dwgreg.tmr[2];
-                                mystique->dwgreg.tmr[8] += mystique->dwgreg.tmr[4];
                         }
+                }
 
-                        mystique->dwgreg.dr[0] = z_back + mystique->dwgreg.dr[3];
-                        mystique->dwgreg.dr[4] = r_back + mystique->dwgreg.dr[7];
-                        mystique->dwgreg.dr[8] = g_back + mystique->dwgreg.dr[11];
-                        mystique->dwgreg.dr[12] = b_back + mystique->dwgreg.dr[15];
-                        mystique->dwgreg.tmr[6] = s_back + mystique->dwgreg.tmr[1];
-                        mystique->dwgreg.tmr[7] = t_back + mystique->dwgreg.tmr[3];
-                        mystique->dwgreg.tmr[8] = q_back + mystique->dwgreg.tmr[5];
+                if (mystique->dwgreg.dwgctrl_running & DWGCTRL_PATTERN)
+                        src_addr = ((src_addr + x_dir) & 7) | (src_addr & ~7);
+                else if (src_addr == ar0) {
+                        ar0 += mystique->dwgreg.ar[5];
+                        ar3 += mystique->dwgreg.ar[5];
+                        src_addr = ar3;
+                } else
+                        src_addr += x_dir;
 
-                        while ((int32_t)mystique->dwgreg.ar[1] < 0 && mystique->dwgreg.ar[0]) {
-                                mystique->dwgreg.ar[1] += mystique->dwgreg.ar[0];
-                                mystique->dwgreg.fxleft += (mystique->dwgreg.sgn.sdxl ? -1 : 1);
-                        }
-                        mystique->dwgreg.ar[1] += mystique->dwgreg.ar[2];
+                if (x != x_end)
+                        x += x_dir;
+                else
+                        break;
+        }
+}
 
-                        while ((int32_t)mystique->dwgreg.ar[4] < 0 && mystique->dwgreg.ar[6]) {
-                                mystique->dwgreg.ar[4] += mystique->dwgreg.ar[6];
-                                mystique->dwgreg.fxright += (mystique->dwgreg.sgn.sdxr ? -1 : 1);
+static void bitblt_src_range(uint32_t start, uint32_t end, uint32_t *src_min, uint32_t *src_max) {
+        if (end < start) {
+                uint32_t temp = start;
+
+                start = end;
+                end = temp;
+        }
+        if (start < *src_min)
+                *src_min = start;
+        if (end > *src_max)
+                *src_max = end;
+}
+
+/*Returns 1 if the queued bitblt lines can be drawn in any order, ie the source does not overlap
+  the destination and neither wraps around the end of VRAM*/
+static int bitblt_can_split(mystique_t *mystique, uint32_t src_min, uint32_t src_max, uint32_t dst_min, uint32_t dst_max) {
+        const uint64_t pitch = mystique->dwgreg.pitch & PITCH_MASK;
+        const uint64_t vram_size = (uint64_t)mystique->vram_mask + 1;
+        const int bpp = mystique_bytes_per_pixel(mystique);
+        uint64_t src_start = (uint64_t)src_min * bpp;
+        uint64_t src_end = ((uint64_t)src_max + 1) * bpp + 1;
+        uint64_t dst_start = (uint64_t)dst_min * bpp;
+        uint64_t dst_end = ((uint64_t)dst_max + pitch) * bpp;
+
+        if ((uint64_t)mystique->dwgreg.cxright + 1 >= pitch || src_min > src_max)
+                return 0;
+        if (src_end > vram_size || dst_end > vram_size)
+                return 0;
+        return (src_end <= dst_start || dst_end <= src_start);
+}
+
+/*BITBLT, BLTMOD BFCOL/BU32RGB. The source address at the start of each line only depends on the
+  line length and the AR registers, so it is worked out here and the lines drawn as spans*/
+static void blit_bitblt_fcol(mystique_t *mystique) {
+        const int x_dir = mystique->dwgreg.sgn.scanleft ? -1 : 1;
+        int16_t x_start = mystique->dwgreg.sgn.scanleft ? mystique->dwgreg.fxright : mystique->dwgreg.fxleft;
+        int16_t x_end = mystique->dwgreg.sgn.scanleft ? mystique->dwgreg.fxleft : mystique->dwgreg.fxright;
+        const int count = (uint16_t)((x_end - x_start) * x_dir) + 1;
+        uint32_t src_addr = mystique->dwgreg.ar[3];
+        uint32_t src_min = 0xffffffff, src_max = 0;
+        uint32_t dst_min = 0xffffffff, dst_max = 0;
+        int y;
+
+        mystique->span_func = bitblt_span_fcol;
+
+        for (y = 0; y < mystique->dwgreg.length; y++) {
+                mystique_span_t *span = &mystique->spans[mystique->nr_spans++];
+
+                span->ydst_lin = mystique->dwgreg.ydst_lin;
+                span->selline = mystique->dwgreg.selline;
+                span->src_addr = src_addr;
+                span->ar0 = mystique->dwgreg.ar[0];
+                span->ar3 = mystique->dwgreg.ar[3];
+                mystique->span_pixels += count;
+                if (span->ydst_lin < dst_min)
+                        dst_min = span->ydst_lin;
+                if (span->ydst_lin > dst_max)
+                        dst_max = span->ydst_lin;
+
+                if (mystique->dwgreg.dwgctrl_running & DWGCTRL_PATTERN) {
+                        bitblt_src_range(src_addr & ~0xff, src_addr | 0xff, &src_min, &src_max);
+                        if (mystique->dwgreg.sgn.sdy)
+                                src_addr = ((src_addr - 32) & 0xe0) | (src_addr & ~0xe0);
+                        else
+                                src_addr = ((src_addr + 32) & 0xe0) | (src_addr & ~0xe0);
+                } else {
+                        int remaining = count;
+
+                        while (remaining) {
+                                /*Pixels until the source reaches the end of its line (AR0)*/
+                                uint32_t steps = (x_dir > 0) ? (mystique->dwgreg.ar[0] - src_addr)
+                                                             : (src_addr - mystique->dwgreg.ar[0]);
+
+                                if (steps >= (uint32_t)remaining) {
+                                        bitblt_src_range(src_addr, src_addr + (remaining - 1) * x_dir, &src_min, &src_max);
+                                        src_addr += remaining * x_dir;
+                                        break;
+                                }
+                                bitblt_src_range(src_addr, mystique->dwgreg.ar[0], &src_min, &src_max);
+                                remaining -= steps + 1;
+                                mystique->dwgreg.ar[0] += mystique->dwgreg.ar[5];
+                                mystique->dwgreg.ar[3] += mystique->dwgreg.ar[5];
+                                src_addr = mystique->dwgreg.ar[3];
                         }
-                        mystique->dwgreg.ar[4] += mystique->dwgreg.ar[5];
+                }
 
-                        dx = (int16_t)((mystique->dwgreg.fxleft - old_x_l) & 0xffff);
-                        mystique->dwgreg.dr[0] += dx * mystique->dwgreg.dr[2];
-                        mystique->dwgreg.dr[4] += dx * mystique->dwgreg.dr[6];
-                        mystique->dwgreg.dr[8] += dx * mystique->dwgreg.dr[10];
-                        mystique->dwgreg.dr[12] += dx * mystique->dwgreg.dr[14];
-                        mystique->dwgreg.tmr[6] += dx * mystique->dwgreg.tmr[0];
-                        mystique->dwgreg.tmr[7] += dx * mystique->dwgreg.tmr[2];
-                        mystique->dwgreg.tmr[8] += dx * mystique->dwgreg.tmr[4];
-
-                        mystique->dwgreg.ydst++;
-                        mystique->dwgreg.ydst &= 0x7fffff;
+                if (mystique->dwgreg.sgn.sdy)
+                        mystique->dwgreg.ydst_lin -= (mystique->dwgreg.pitch & PITCH_MASK);
+                else
                         mystique->dwgreg.ydst_lin += (mystique->dwgreg.pitch & PITCH_MASK);
 
-                        mystique->dwgreg.selline = (mystique->dwgreg.selline + 1) & 7;
+                if (mystique->nr_spans == MGA_MAX_SPANS || y == mystique->dwgreg.length - 1) {
+                        mystique_flush_spans(mystique, bitblt_can_split(mystique, src_min, src_max, dst_min, dst_max));
+                        src_min = dst_min = 0xffffffff;
+                        src_max = dst_max = 0;
                 }
-                break;
-
-#ifndef RELEASE_BUILD
-        default:
-                fatal("Unknown atype %03x %08x TEXTURE_TRAP\n", mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK,
-                      mystique->dwgreg.dwgctrl_running);
-#endif
         }
-
-        mystique->blitter_complete_refcount++;
 }
 
 static void blit_bitblt(mystique_t *mystique) {
@@ -5176,162 +5575,7 @@ static void blit_bitblt(mystique_t *mystique) {
 
                 case DWGCTRL_BLTMOD_BFCOL:
                 case DWGCTRL_BLTMOD_BU32RGB:
-                        //                        pclog("ar0=%08x ar3=%08x ar5=%08x\n", mystique->dwgreg.ar[0],
-                        //                        mystique->dwgreg.ar[3], mystique->dwgreg.ar[5]); pclog("fxleft=%i fxright=%i\n",
-                        //                        mystique->dwgreg.fxleft, mystique->dwgreg.fxright);
-
-                        src_addr = mystique->dwgreg.ar[3];
-
-                        for (y = 0; y < mystique->dwgreg.length; y++) {
-                                uint8_t const *const trans = &trans_masks[trans_sel][(mystique->dwgreg.selline & 3) * 4];
-                                uint32_t old_src_addr = src_addr;
-                                int16_t x = x_start;
-
-                                //                                pclog("  line %03i: %08x %08x\n", y, mystique->dwgreg.ydst_lin,
-                                //                                src_addr);
-                                while (1) {
-                                        if (x >= mystique->dwgreg.cxleft && x <= mystique->dwgreg.cxright &&
-                                            mystique->dwgreg.ydst_lin >= mystique->dwgreg.ytop &&
-                                            mystique->dwgreg.ydst_lin <= mystique->dwgreg.ybot && trans[x & 3]) {
-                                                uint32_t src, dst, old_dst;
-
-                                                switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
-                                                case MACCESS_PWIDTH_8:
-                                                        src = svga->vram[src_addr & mystique->vram_mask];
-                                                        dst = svga->vram[(mystique->dwgreg.ydst_lin + x) & mystique->vram_mask];
-
-                                                        //                                                        pclog("    %02x
-                                                        //                                                        %02x  ", src,
-                                                        //                                                        dst);
-                                                        dst = bitop(src, dst,
-                                                                    mystique->dwgreg.dwgctrl_running); // & DWGCTRL_BOP_MASK
-                                                        //                                                        pclog("%08x %08x
-                                                        //                                                        %i dst=%02x\n",
-                                                        //                                                        src_addr,
-                                                        //                                                        mystique->dwgreg.ydst_lin
-                                                        //                                                        + x,
-                                                        //                                                        mystique->dwgreg.sgn.scanleft,
-                                                        //                                                        dst);
-
-                                                        svga->vram[(mystique->dwgreg.ydst_lin + x) & mystique->vram_mask] = dst;
-                                                        svga->changedvram[((mystique->dwgreg.ydst_lin + x) &
-                                                                           mystique->vram_mask) >>
-                                                                          12] = changeframecount;
-                                                        break;
-
-                                                case MACCESS_PWIDTH_16:
-                                                        src = ((uint16_t *)svga->vram)[src_addr & mystique->vram_mask_w];
-                                                        dst = ((uint16_t *)svga->vram)[(mystique->dwgreg.ydst_lin + x) &
-                                                                                       mystique->vram_mask_w];
-
-                                                        //                                                        pclog("    %02x
-                                                        //                                                        %02x  ", src,
-                                                        //                                                        dst);
-                                                        dst = bitop(src, dst,
-                                                                    mystique->dwgreg.dwgctrl_running); // & DWGCTRL_BOP_MASK
-                                                        //                                                        pclog("%08x %08x
-                                                        //                                                        %i dst=%02x\n",
-                                                        //                                                        src_addr,
-                                                        //                                                        mystique->dwgreg.ydst_lin
-                                                        //                                                        + x,
-                                                        //                                                        mystique->dwgreg.sgn.scanleft,
-                                                        //                                                        dst);
-
-                                                        ((uint16_t *)svga->vram)[(mystique->dwgreg.ydst_lin + x) &
-                                                                                 mystique->vram_mask_w] = dst;
-                                                        svga->changedvram[((mystique->dwgreg.ydst_lin + x) &
-                                                                           mystique->vram_mask_w) >>
-                                                                          11] = changeframecount;
-                                                        break;
-
-                                                case MACCESS_PWIDTH_24:
-                                                        src = *(uint32_t *)&svga->vram[(src_addr * 3) & mystique->vram_mask];
-                                                        old_dst = *(uint32_t *)&svga->vram[((mystique->dwgreg.ydst_lin + x) * 3) &
-                                                                                           mystique->vram_mask];
-
-                                                        //                                                        pclog("    %02x
-                                                        //                                                        %02x  ", src,
-                                                        //                                                        old_dst);
-                                                        dst = bitop(src, old_dst,
-                                                                    mystique->dwgreg.dwgctrl_running); // & DWGCTRL_BOP_MASK
-                                                        //                                                        pclog("%08x %08x
-                                                        //                                                        %i dst=%02x\n",
-                                                        //                                                        src_addr,
-                                                        //                                                        mystique->dwgreg.ydst_lin
-                                                        //                                                        + x,
-                                                        //                                                        mystique->dwgreg.sgn.scanleft,
-                                                        //                                                        dst);
-
-                                                        *(uint32_t *)&svga->vram[((mystique->dwgreg.ydst_lin + x) * 3) &
-                                                                                 mystique->vram_mask] =
-                                                                (dst & 0xffffff) | (old_dst & 0xff000000);
-                                                        svga->changedvram[(((mystique->dwgreg.ydst_lin + x) * 3) &
-                                                                           mystique->vram_mask) >>
-                                                                          12] = changeframecount;
-                                                        break;
-
-                                                case MACCESS_PWIDTH_32:
-                                                        src = ((uint32_t *)svga->vram)[src_addr & mystique->vram_mask_l];
-                                                        dst = ((uint32_t *)svga->vram)[(mystique->dwgreg.ydst_lin + x) &
-                                                                                       mystique->vram_mask_l];
-
-                                                        //                                                        pclog("    %02x
-                                                        //                                                        %02x  ", src,
-                                                        //                                                        dst);
-                                                        dst = bitop(src, dst,
-                                                                    mystique->dwgreg.dwgctrl_running); // & DWGCTRL_BOP_MASK
-                                                        //                                                        pclog("%08x %08x
-                                                        //                                                        %i dst=%02x\n",
-                                                        //                                                        src_addr,
-                                                        //                                                        mystique->dwgreg.ydst_lin
-                                                        //                                                        + x,
-                                                        //                                                        mystique->dwgreg.sgn.scanleft,
-                                                        //                                                        dst);
-
-                                                        ((uint32_t *)svga->vram)[(mystique->dwgreg.ydst_lin + x) &
-                                                                                 mystique->vram_mask_l] = dst;
-                                                        svga->changedvram[((mystique->dwgreg.ydst_lin + x) &
-                                                                           mystique->vram_mask_l) >>
-                                                                          10] = changeframecount;
-                                                        break;
-
-#ifndef RELEASE_BUILD
-                                                default:
-                                                        fatal("BITBLT RPL BFCOL PWIDTH %x %08x\n",
-                                                              mystique->maccess_running & MACCESS_PWIDTH_MASK,
-                                                              mystique->dwgreg.dwgctrl_running);
-#endif
-                                                }
-                                        }
-
-                                        if (mystique->dwgreg.dwgctrl_running & DWGCTRL_PATTERN)
-                                                src_addr = ((src_addr + x_dir) & 7) | (src_addr & ~7);
-                                        else if (src_addr == mystique->dwgreg.ar[0]) {
-                                                mystique->dwgreg.ar[0] += mystique->dwgreg.ar[5];
-                                                mystique->dwgreg.ar[3] += mystique->dwgreg.ar[5];
-                                                src_addr = mystique->dwgreg.ar[3];
-                                        } else
-                                                src_addr += x_dir;
-
-                                        if (x != x_end)
-                                                x += x_dir;
-                                        else
-                                                break;
-                                }
-
-                                if (mystique->dwgreg.dwgctrl_running & DWGCTRL_PATTERN) {
-                                        src_addr = old_src_addr;
-                                        if (mystique->dwgreg.sgn.sdy)
-                                                src_addr = ((src_addr - 32) & 0xe0) | (src_addr & ~0xe0);
-                                        else
-                                                src_addr = ((src_addr + 32) & 0xe0) | (src_addr & ~0xe0);
-                                }
-
-                                if (mystique->dwgreg.sgn.sdy)
-                                        mystique->dwgreg.ydst_lin -= (mystique->dwgreg.pitch & PITCH_MASK);
-                                else
-                                        mystique->dwgreg.ydst_lin += (mystique->dwgreg.pitch & PITCH_MASK);
-                        }
+                        blit_bitblt_fcol(mystique);
                         break;
 
 #ifndef RELEASE_BUILD
@@ -5927,6 +6171,8 @@ void *mga_init_common(char *bios_fn, int type) {
                         NULL, mystique_ctrl_write_l, NULL, 0, mystique);
         mem_mapping_add(&mystique->lfb_mapping, 0, 0, mystique_readb_linear, mystique_readw_linear, mystique_readl_linear,
                         mystique_writeb_linear, mystique_writew_linear, mystique_writel_linear, NULL, 0, mystique);
+        if (device_get_config_int("lfb_direct"))
+                mystique->svga.lfb_direct_mapping = &mystique->lfb_mapping;
         mem_mapping_add(&mystique->iload_mapping, 0, 0, mystique_iload_read_b, NULL, mystique_iload_read_l,
                         mystique_iload_write_b, NULL, mystique_iload_write_l, NULL, 0, mystique);
 
@@ -5972,6 +6218,9 @@ void *mga_init_common(char *bios_fn, int type) {
         mystique->fifo_thread = thread_create(fifo_thread, mystique);
         mystique->dma.lock = thread_create_mutex();
 
+        mystique->render_threads = device_get_config_int("render_threads");
+        mystique_render_init(mystique);
+
         timer_add(&mystique->wake_timer, mystique_wake_timer, (void *)mystique, 0);
         timer_add(&mystique->softrap_pending_timer, mystique_softrap_pending_timer, (void *)mystique, 1);
 
@@ -6001,6 +6250,7 @@ static void mystique_close(void *p) {
         mystique_t *mystique = (mystique_t *)p;
 
         thread_kill(mystique->fifo_thread);
+        mystique_render_close(mystique);
         thread_destroy_event(mystique->wake_fifo_thread);
         thread_destroy_event(mystique->fifo_not_full_event);
         thread_destroy_mutex(mystique->dma.lock);
@@ -6051,6 +6301,18 @@ static device_config_t millennium_config[] = {{.name = "memory",
                                                              {.description = "8 MB", .value = 8},
                                                              {.description = ""}},
                                                .default_int = 4},
+                                              {.name = "render_threads",
+                                               .description = "Render threads",
+                                               .type = CONFIG_SELECTION,
+                                               .selection = {{.description = "1", .value = 1},
+                                                             {.description = "2", .value = 2},
+                                                             {.description = "4", .value = 4},
+                                                             {.description = ""}},
+                                               .default_int = 1},
+                                              {.name = "lfb_direct",
+                                               .description = "Direct linear framebuffer writes",
+                                               .type = CONFIG_BINARY,
+                                               .default_int = 0},
                                               {.type = -1}};
 
 static device_config_t mystique_config[] = {
@@ -6059,6 +6321,15 @@ static device_config_t mystique_config[] = {
          .type = CONFIG_SELECTION,
          .selection = {{.description = "2 MB", .value = 2}, {.description = "4 MB", .value = 4}, {.description = ""}},
          .default_int = 4},
+        {.name = "render_threads",
+         .description = "Render threads",
+         .type = CONFIG_SELECTION,
+         .selection = {{.description = "1", .value = 1},
+                       {.description = "2", .value = 2},
+                       {.description = "4", .value = 4},
+                       {.description = ""}},
+         .default_int = 1},
+        {.name = "lfb_direct", .description = "Direct linear framebuffer writes", .type = CONFIG_BINARY, .default_int = 0},
         {.type = -1}};
 
 device_t millennium_device = {"Matrox Millennium",   0,
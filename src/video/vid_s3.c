@@ -43,6 +43,19 @@ typedef struct {
         uint32_t val;
 } fifo_entry_t;
 
+/*Blitter state derived from the drawing registers. Recomputed for every command, and
+  once per run of queued PIX_TRANS writes rather than once per write*/
+typedef struct s3_accel_setup_t {
+        int clip_t, clip_l, clip_b, clip_r;
+        int vram_mask;
+        uint32_t mix_mask;
+        uint32_t compare;
+        int compare_mode;
+        uint32_t rd_mask;
+        int cmd;
+        uint32_t srcbase, dstbase;
+} s3_accel_setup_t;
+
 typedef struct s3_t {
         mem_mapping_t linear_mapping;
         mem_mapping_t mmio_mapping;
@@ -126,6 +139,11 @@ typedef struct s3_t {
         uint64_t blitter_time;
         uint64_t status_time;
 
+        s3_accel_setup_t accel_setup;
+        int accel_setup_valid;
+
+        int accel_ops, accel_pix_trans, accel_setup_runs;
+
         uint8_t subsys_cntl, subsys_stat;
 
         uint32_t hwc_fg_col, hwc_bg_col;
@@ -166,6 +184,7 @@ static void s3_update_irqs(s3_t *s3) {
 }
 
 void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat, s3_t *s3);
+static void s3_accel_setup(s3_t *s3, s3_accel_setup_t *setup);
 
 #define WRITE8(addr, var, val)                                                                                                   \
         switch ((addr)&3) {                                                                                                      \
@@ -837,6 +856,49 @@ static void s3_accel_write_fifo_l(s3_t *s3, uint32_t addr, uint32_t val) {
         }
 }
 
+static inline void s3_fifo_dispatch(s3_t *s3, fifo_entry_t *fifo) {
+        switch (fifo->addr_type & FIFO_TYPE) {
+        case FIFO_WRITE_BYTE:
+                s3_accel_write_fifo(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
+                break;
+        case FIFO_WRITE_WORD:
+                s3_accel_write_fifo_w(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
+                break;
+        case FIFO_WRITE_DWORD:
+                s3_accel_write_fifo_l(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
+                break;
+        case FIFO_OUT_BYTE:
+                s3_accel_out_fifo(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
+                break;
+        case FIFO_OUT_WORD:
+                s3_accel_out_fifo_w(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
+                break;
+        case FIFO_OUT_DWORD:
+                s3_accel_out_fifo_l(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
+                break;
+        }
+}
+
+/*Returns non-zero if this FIFO entry only feeds PIX_TRANS, and so can not change any
+  drawing register. Word and dword port writes are only ever decoded as PIX_TRANS*/
+static inline int s3_fifo_is_pix_trans(fifo_entry_t *fifo) {
+        uint32_t addr = fifo->addr_type & FIFO_ADDR;
+
+        switch (fifo->addr_type & FIFO_TYPE) {
+        case FIFO_WRITE_BYTE:
+                return !(addr & 0x8000) || (addr & 0xfffc) == 0xe2e8;
+        case FIFO_WRITE_WORD:
+        case FIFO_WRITE_DWORD:
+                return !(addr & 0x8000);
+        case FIFO_OUT_BYTE:
+                return (addr & 0xfffc) == 0xe2e8;
+        case FIFO_OUT_WORD:
+        case FIFO_OUT_DWORD:
+                return 1;
+        }
+        return 0;
+}
+
 static void fifo_thread(void *param) {
         s3_t *s3 = (s3_t *)param;
 
@@ -850,32 +912,37 @@ static void fifo_thread(void *param) {
                         uint64_t end_time;
                         fifo_entry_t *fifo = &s3->fifo[s3->fifo_read_idx & FIFO_MASK];
 
-                        switch (fifo->addr_type & FIFO_TYPE) {
-                        case FIFO_WRITE_BYTE:
-                                s3_accel_write_fifo(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                                break;
-                        case FIFO_WRITE_WORD:
-                                s3_accel_write_fifo_w(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                                break;
-                        case FIFO_WRITE_DWORD:
-                                s3_accel_write_fifo_l(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                                break;
-                        case FIFO_OUT_BYTE:
-                                s3_accel_out_fifo(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                                break;
-                        case FIFO_OUT_WORD:
-                                s3_accel_out_fifo_w(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                                break;
-                        case FIFO_OUT_DWORD:
-                                s3_accel_out_fifo_l(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                                break;
-                        }
+                        if (s3_fifo_is_pix_trans(fifo)) {
+                                /*Drawing registers can not change within a run of queued PIX_TRANS
+                                  writes, so compute the blitter setup once for the run. Each write
+                                  is still dispatched, and calls s3_accel_start(), on its own*/
+                                s3_accel_setup(s3, &s3->accel_setup);
+                                s3->accel_setup_valid = 1;
+                                s3->accel_setup_runs++;
 
-                        s3->fifo_read_idx++;
-                        fifo->addr_type = FIFO_INVALID;
+                                do {
+                                        s3_fifo_dispatch(s3, fifo);
+                                        s3->accel_pix_trans++;
 
-                        if (FIFO_ENTRIES > 0xe000)
-                                thread_set_event(s3->fifo_not_full_event);
+                                        s3->fifo_read_idx++;
+                                        fifo->addr_type = FIFO_INVALID;
+
+                                        if (FIFO_ENTRIES > 0xe000)
+                                                thread_set_event(s3->fifo_not_full_event);
+
+                                        fifo = &s3->fifo[s3->fifo_read_idx & FIFO_MASK];
+                                } while (!FIFO_EMPTY && s3_fifo_is_pix_trans(fifo));
+
+                                s3->accel_setup_valid = 0;
+                        } else {
+                                s3_fifo_dispatch(s3, fifo);
+
+                                s3->fifo_read_idx++;
+                                fifo->addr_type = FIFO_INVALID;
+
+                                if (FIFO_ENTRIES > 0xe000)
+                                        thread_set_event(s3->fifo_not_full_event);
+                        }
 
                         end_time = timer_read();
                         s3->blitter_time += end_time - start_time;
@@ -1774,43 +1841,261 @@ static inline uint32_t dword_remap_l(uint32_t in_addr) {
                 svga->changedvram[(dword_remap_l(addr) & (s3->vram_mask >> 2)) >> 10] = changeframecount;                        \
         }
 
-void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat, s3_t *s3) {
-        svga_t *svga = &s3->svga;
-        uint32_t src_dat, dest_dat;
-        int frgd_mix, bkgd_mix;
-        int clip_t = s3->accel.multifunc[1] & 0xfff;
-        int clip_l = s3->accel.multifunc[2] & 0xfff;
-        int clip_b = s3->accel.multifunc[3] & 0xfff;
-        int clip_r = s3->accel.multifunc[4] & 0xfff;
-        int vram_mask = (s3->accel.multifunc[0xa] & 0xc0) == 0xc0;
-        uint32_t mix_mask = 0;
-        uint16_t *vram_w = (uint16_t *)svga->vram;
-        uint32_t *vram_l = (uint32_t *)svga->vram;
-        uint32_t compare = s3->accel.color_cmp;
-        int compare_mode = (s3->accel.multifunc[0xe] >> 7) & 3;
-        uint32_t rd_mask = s3->accel.rd_mask;
-        int cmd = s3->accel.cmd >> 13;
-        uint32_t srcbase, dstbase;
+static void s3_accel_setup(s3_t *s3, s3_accel_setup_t *setup) {
+        setup->clip_t = s3->accel.multifunc[1] & 0xfff;
+        setup->clip_l = s3->accel.multifunc[2] & 0xfff;
+        setup->clip_b = s3->accel.multifunc[3] & 0xfff;
+        setup->clip_r = s3->accel.multifunc[4] & 0xfff;
+        setup->vram_mask = (s3->accel.multifunc[0xa] & 0xc0) == 0xc0;
+        setup->compare = s3->accel.color_cmp;
+        setup->compare_mode = (s3->accel.multifunc[0xe] >> 7) & 3;
+        setup->rd_mask = s3->accel.rd_mask;
+        setup->cmd = s3->accel.cmd >> 13;
 
         if ((s3->chip == S3_TRIO64) && (s3->accel.cmd & (1 << 11)))
-                cmd |= 8;
+                setup->cmd |= 8;
 
         if ((s3->accel.multifunc[13] >> 4) & 7)
-                srcbase = 0x100000 * ((s3->accel.multifunc[13] >> 4) & 3);
+                setup->srcbase = 0x100000 * ((s3->accel.multifunc[13] >> 4) & 3);
         else
-                srcbase = 0x100000 * ((s3->accel.multifunc[14] >> 2) & 3);
+                setup->srcbase = 0x100000 * ((s3->accel.multifunc[14] >> 2) & 3);
         if ((s3->accel.multifunc[13] >> 0) & 7)
-                dstbase = 0x100000 * ((s3->accel.multifunc[13] >> 0) & 3);
+                setup->dstbase = 0x100000 * ((s3->accel.multifunc[13] >> 0) & 3);
         else
-                dstbase = 0x100000 * ((s3->accel.multifunc[14] >> 0) & 3);
+                setup->dstbase = 0x100000 * ((s3->accel.multifunc[14] >> 0) & 3);
         if (s3->bpp == 1) {
-                srcbase >>= 1;
-                dstbase >>= 1;
+                setup->srcbase >>= 1;
+                setup->dstbase >>= 1;
         } else if (s3->bpp == 3) {
-                srcbase >>= 2;
-                dstbase >>= 2;
+                setup->srcbase >>= 2;
+                setup->dstbase >>= 2;
+        }
+
+        if (s3->bpp == 0)
+                setup->rd_mask &= 0xff;
+        else if (s3->bpp == 1)
+                setup->rd_mask &= 0xffff;
+
+        switch (s3->accel.cmd & 0x600) {
+        case 0x000:
+                setup->mix_mask = 0x80;
+                break;
+        case 0x200:
+                setup->mix_mask = 0x8000;
+                break;
+        case 0x400:
+                setup->mix_mask = 0x80000000;
+                break;
+        case 0x600:
+                setup->mix_mask = (s3->chip == S3_TRIO32) ? 0x80 : 0x80000000;
+                break;
+        }
+
+        if (s3->bpp == 0)
+                setup->compare &= 0xff;
+        if (s3->bpp == 1)
+                setup->compare &= 0xffff;
+}
+
+/*Solid rectangle fill in the foreground colour. Only handles the common mixes that do not
+  depend on the source, so the mix is resolved once per span rather than once per pixel.
+  Returns 0 if the generic path must be used*/
+static int s3_accel_fill_fast(s3_t *s3, const s3_accel_setup_t *setup) {
+        svga_t *svga = &s3->svga;
+        uint16_t *vram_w = (uint16_t *)svga->vram;
+        uint32_t *vram_l = (uint32_t *)svga->vram;
+        uint32_t src_dat = s3->accel.frgd_color;
+        uint32_t dest_dat;
+        uint32_t wrt_mask = s3->accel.wrt_mask;
+        uint32_t full_mask = (s3->bpp == 0) ? 0xff : ((s3->bpp == 1) ? 0xffff : 0xffffffff);
+        int rop = s3->accel.frgd_mix & 0xf;
+        int width = (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+        int x_inc = (s3->accel.cmd & 0x20) ? 1 : -1;
+        int y_inc = (s3->accel.cmd & 0x80) ? 1 : -1;
+
+        switch (rop) {
+        case 0x1:
+                src_dat = 0;
+                rop = 0x7;
+                break;
+        case 0x2:
+                src_dat = ~0;
+                rop = 0x7;
+                break;
+        case 0x0:
+        case 0x5:
+        case 0x7:
+                break;
+        default:
+                return 0;
+        }
+
+#define FILL_SPAN(new_dat)                                                                                                       \
+        for (c = 0; c < width; c++, cx += x_inc) {                                                                               \
+                if ((cx & 0xfff) >= setup->clip_l && (cx & 0xfff) <= setup->clip_r) {                                            \
+                        READ_DST(s3->accel.dest + cx, dest_dat);                                                                 \
+                        dest_dat = ((new_dat)&wrt_mask) | (dest_dat & ~wrt_mask);                                                \
+                        WRITE(s3->accel.dest + cx);                                                                              \
+                }                                                                                                                \
+        }
+
+        while (s3->accel.sy >= 0) {
+                if ((s3->accel.cy & 0xfff) >= setup->clip_t && (s3->accel.cy & 0xfff) <= setup->clip_b) {
+                        int cx = s3->accel.cx;
+                        int c;
+
+                        switch (rop) {
+                        case 0x0:
+                                FILL_SPAN(~dest_dat);
+                                break;
+                        case 0x5:
+                                FILL_SPAN(src_dat ^ dest_dat);
+                                break;
+                        case 0x7:
+                                if ((wrt_mask & full_mask) == full_mask) {
+                                        /*Plain fill, destination does not need to be read*/
+                                        dest_dat = src_dat;
+                                        for (c = 0; c < width; c++, cx += x_inc) {
+                                                if ((cx & 0xfff) >= setup->clip_l && (cx & 0xfff) <= setup->clip_r) {
+                                                        WRITE(s3->accel.dest + cx);
+                                                }
+                                        }
+                                } else
+                                        FILL_SPAN(src_dat);
+                                break;
+                        }
+                }
+
+                s3->accel.cy += y_inc;
+                s3->accel.dest = setup->dstbase + s3->accel.cy * s3->width;
+                s3->accel.sy--;
+        }
+
+#undef FILL_SPAN
+
+        s3->accel.cur_x = s3->accel.cx;
+        s3->accel.cur_y = s3->accel.cy;
+        return 1;
+}
+
+/*Screen to screen BitBlt for the common mixes, in any direction. Returns 0 if the generic
+  path must be used*/
+static int s3_accel_blit_fast(s3_t *s3, const s3_accel_setup_t *setup) {
+        svga_t *svga = &s3->svga;
+        uint16_t *vram_w = (uint16_t *)svga->vram;
+        uint32_t *vram_l = (uint32_t *)svga->vram;
+        uint32_t src_dat, dest_dat;
+        uint32_t wrt_mask = s3->accel.wrt_mask;
+        uint32_t full_mask = (s3->bpp == 0) ? 0xff : ((s3->bpp == 1) ? 0xffff : 0xffffffff);
+        int rop = s3->accel.frgd_mix & 0xf;
+        int width = (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+        int x_inc = (s3->accel.cmd & 0x20) ? 1 : -1;
+        int y_inc = (s3->accel.cmd & 0x80) ? 1 : -1;
+
+        switch (rop) {
+        case 0x5:
+        case 0x7:
+        case 0xb:
+        case 0xc:
+        case 0xe:
+                break;
+        default:
+                return 0;
+        }
+
+#define BLIT_SPAN(new_dat)                                                                                                       \
+        for (c = 0; c < width; c++, cx += x_inc, dx += x_inc) {                                                                  \
+                if ((dx & 0xfff) >= setup->clip_l && (dx & 0xfff) <= setup->clip_r) {                                            \
+                        READ_DST(s3->accel.src + cx, src_dat);                                                                   \
+                        READ_DST(s3->accel.dest + dx, dest_dat);                                                                 \
+                        dest_dat = ((new_dat)&wrt_mask) | (dest_dat & ~wrt_mask);                                                \
+                        WRITE(s3->accel.dest + dx);                                                                              \
+                }                                                                                                                \
+        }
+
+        while (s3->accel.sy >= 0) {
+                if ((s3->accel.dy & 0xfff) >= setup->clip_t && (s3->accel.dy & 0xfff) <= setup->clip_b) {
+                        int cx = s3->accel.cx, dx = s3->accel.dx;
+                        int c;
+
+                        switch (rop) {
+                        case 0x5:
+                                BLIT_SPAN(src_dat ^ dest_dat);
+                                break;
+                        case 0x7:
+                                if ((wrt_mask & full_mask) == full_mask) {
+                                        /*Plain copy, destination does not need to be read*/
+                                        for (c = 0; c < width; c++, cx += x_inc, dx += x_inc) {
+                                                if ((dx & 0xfff) >= setup->clip_l && (dx & 0xfff) <= setup->clip_r) {
+                                                        READ_DST(s3->accel.src + cx, dest_dat);
+                                                        WRITE(s3->accel.dest + dx);
+                                                }
+                                        }
+                                } else
+                                        BLIT_SPAN(src_dat);
+                                break;
+                        case 0xb:
+                                BLIT_SPAN(src_dat | dest_dat);
+                                break;
+                        case 0xc:
+                                BLIT_SPAN(src_dat & dest_dat);
+                                break;
+                        case 0xe:
+                                BLIT_SPAN(~src_dat & dest_dat);
+                                break;
+                        }
+                }
+
+                s3->accel.cy += y_inc;
+                s3->accel.dy += y_inc;
+                s3->accel.src = setup->srcbase + s3->accel.cy * s3->width;
+                s3->accel.dest = setup->dstbase + s3->accel.dy * s3->width;
+                s3->accel.sy--;
         }
 
+#undef BLIT_SPAN
+
+        return 1;
+}
+
+void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat, s3_t *s3) {
+        svga_t *svga = &s3->svga;
+        uint32_t src_dat, dest_dat;
+        int frgd_mix, bkgd_mix;
+        s3_accel_setup_t local_setup;
+        const s3_accel_setup_t *setup;
+        int clip_t, clip_l, clip_b, clip_r;
+        int vram_mask;
+        uint32_t mix_mask;
+        uint16_t *vram_w = (uint16_t *)svga->vram;
+        uint32_t *vram_l = (uint32_t *)svga->vram;
+        uint32_t compare;
+        int compare_mode;
+        uint32_t rd_mask;
+        int cmd;
+        uint32_t srcbase, dstbase;
+
+        if (cpu_input && s3->accel_setup_valid)
+                setup = &s3->accel_setup;
+        else {
+                s3_accel_setup(s3, &local_setup);
+                setup = &local_setup;
+                if (!cpu_input)
+                        s3->accel_ops++;
+        }
+        clip_t = setup->clip_t;
+        clip_l = setup->clip_l;
+        clip_b = setup->clip_b;
+        clip_r = setup->clip_r;
+        vram_mask = setup->vram_mask;
+        mix_mask = setup->mix_mask;
+        compare = setup->compare;
+        compare_mode = setup->compare_mode;
+        rd_mask = setup->rd_mask;
+        cmd = setup->cmd;
+        srcbase = setup->srcbase;
+        dstbase = setup->dstbase;
+
         s3->force_busy = 1;
         // return;
         //        if (!cpu_input) pclog("Start S3 command %i  %i, %i  %i, %i (clip %i, %i to %i, %i  %i)\n", s3->accel.cmd >> 13,
@@ -1837,30 +2122,6 @@ void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat
                         count >>= 2;
         }
 
-        if (s3->bpp == 0)
-                rd_mask &= 0xff;
-        else if (s3->bpp == 1)
-                rd_mask &= 0xffff;
-
-        switch (s3->accel.cmd & 0x600) {
-        case 0x000:
-                mix_mask = 0x80;
-                break;
-        case 0x200:
-                mix_mask = 0x8000;
-                break;
-        case 0x400:
-                mix_mask = 0x80000000;
-                break;
-        case 0x600:
-                mix_mask = (s3->chip == S3_TRIO32) ? 0x80 : 0x80000000;
-                break;
-        }
-
-        if (s3->bpp == 0)
-                compare &= 0xff;
-        if (s3->bpp == 1)
-                compare &= 0xffff;
         switch (cmd) {
         case 1:                 /*Draw line*/
                 if (!cpu_input) /*!cpu_input is trigger to start operation*/
@@ -2100,6 +2361,9 @@ void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat
                 frgd_mix = (s3->accel.frgd_mix >> 5) & 3;
                 bkgd_mix = (s3->accel.bkgd_mix >> 5) & 3;
 
+                if (!cpu_input && frgd_mix == 1 && compare_mode < 2 && s3_accel_fill_fast(s3, setup))
+                        return;
+
                 while (count-- && s3->accel.sy >= 0) {
                         if ((s3->accel.cx & 0xfff) >= clip_l && (s3->accel.cx & 0xfff) <= clip_r &&
                             (s3->accel.cy & 0xfff) >= clip_t && (s3->accel.cy & 0xfff) <= clip_b) {
@@ -2212,124 +2476,92 @@ void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat
                 frgd_mix = (s3->accel.frgd_mix >> 5) & 3;
                 bkgd_mix = (s3->accel.bkgd_mix >> 5) & 3;
 
-                if (!cpu_input && frgd_mix == 3 && !vram_mask && !compare_mode && (s3->accel.cmd & 0xa0) == 0xa0 &&
-                    (s3->accel.frgd_mix & 0xf) == 7) {
-                        while (1) {
-                                if ((s3->accel.dx & 0xfff) >= clip_l && (s3->accel.dx & 0xfff) <= clip_r &&
-                                    (s3->accel.dy & 0xfff) >= clip_t && (s3->accel.dy & 0xfff) <= clip_b) {
-                                        READ_SRC(s3->accel.src + s3->accel.cx, src_dat);
-                                        READ_DST(s3->accel.dest + s3->accel.dx, dest_dat);
+                if (!cpu_input && frgd_mix == 3 && !vram_mask && compare_mode < 2 && s3_accel_blit_fast(s3, setup))
+                        return;
 
-                                        dest_dat = (src_dat & s3->accel.wrt_mask) | (dest_dat & ~s3->accel.wrt_mask);
+                while (count-- && s3->accel.sy >= 0) {
+                        if ((s3->accel.dx & 0xfff) >= clip_l && (s3->accel.dx & 0xfff) <= clip_r &&
+                            (s3->accel.dy & 0xfff) >= clip_t && (s3->accel.dy & 0xfff) <= clip_b) {
+                                if (vram_mask) {
+                                        READ_SRC(s3->accel.src + s3->accel.cx, mix_dat)
 
-                                        WRITE(s3->accel.dest + s3->accel.dx);
+                                        mix_dat = mix_dat ? mix_mask : 0;
                                 }
-
-                                s3->accel.cx++;
-                                s3->accel.dx++;
-                                s3->accel.sx--;
-                                if (s3->accel.sx < 0) {
-                                        s3->accel.cx -= (s3->accel.maj_axis_pcnt & 0xfff) + 1;
-                                        s3->accel.dx -= (s3->accel.maj_axis_pcnt & 0xfff) + 1;
-                                        s3->accel.sx = s3->accel.maj_axis_pcnt & 0xfff;
-
-                                        s3->accel.cy++;
-                                        s3->accel.dy++;
-
-                                        s3->accel.src = srcbase + s3->accel.cy * s3->width;
-                                        s3->accel.dest = dstbase + s3->accel.dy * s3->width;
-
-                                        s3->accel.sy--;
-
-                                        if (s3->accel.sy < 0)
-                                                return;
+                                switch ((mix_dat & mix_mask) ? frgd_mix : bkgd_mix) {
+                                case 0:
+                                        src_dat = s3->accel.bkgd_color;
+                                        break;
+                                case 1:
+                                        src_dat = s3->accel.frgd_color;
+                                        break;
+                                case 2:
+                                        src_dat = cpu_dat;
+                                        break;
+                                case 3:
+                                        READ_SRC(s3->accel.src + s3->accel.cx, src_dat);
+                                        break;
                                 }
-                        }
-                } else {
-                        while (count-- && s3->accel.sy >= 0) {
-                                if ((s3->accel.dx & 0xfff) >= clip_l && (s3->accel.dx & 0xfff) <= clip_r &&
-                                    (s3->accel.dy & 0xfff) >= clip_t && (s3->accel.dy & 0xfff) <= clip_b) {
-                                        if (vram_mask) {
-                                                READ_SRC(s3->accel.src + s3->accel.cx, mix_dat)
-
-                                                mix_dat = mix_dat ? mix_mask : 0;
-                                        }
-                                        switch ((mix_dat & mix_mask) ? frgd_mix : bkgd_mix) {
-                                        case 0:
-                                                src_dat = s3->accel.bkgd_color;
-                                                break;
-                                        case 1:
-                                                src_dat = s3->accel.frgd_color;
-                                                break;
-                                        case 2:
-                                                src_dat = cpu_dat;
-                                                break;
-                                        case 3:
-                                                READ_SRC(s3->accel.src + s3->accel.cx, src_dat);
-                                                break;
-                                        }
 
-                                        if ((compare_mode == 2 && src_dat != compare) ||
-                                            (compare_mode == 3 && src_dat == compare) || compare_mode < 2) {
-                                                READ_DST(s3->accel.dest + s3->accel.dx, dest_dat);
+                                if ((compare_mode == 2 && src_dat != compare) ||
+                                    (compare_mode == 3 && src_dat == compare) || compare_mode < 2) {
+                                        READ_DST(s3->accel.dest + s3->accel.dx, dest_dat);
 
-                                                //                                pclog("BitBlt : %04i, %04i (%06X) - %02X (%02X
-                                                //                                %04X %05X) %02X   ", s3->accel.dx, s3->accel.dy,
-                                                //                                s3->accel.dest + s3->accel.dx, src_dat,
-                                                //                                vram[s3->accel.src + s3->accel.cx], mix_dat,
-                                                //                                s3->accel.src + s3->accel.cx, dest_dat);
+                                        //                                pclog("BitBlt : %04i, %04i (%06X) - %02X (%02X
+                                        //                                %04X %05X) %02X   ", s3->accel.dx, s3->accel.dy,
+                                        //                                s3->accel.dest + s3->accel.dx, src_dat,
+                                        //                                vram[s3->accel.src + s3->accel.cx], mix_dat,
+                                        //                                s3->accel.src + s3->accel.cx, dest_dat);
 
-                                                MIX
+                                        MIX
 
-                                                        //                                pclog("%02X\n", dest_dat);
+                                                //                                pclog("%02X\n", dest_dat);
 
-                                                        WRITE(s3->accel.dest + s3->accel.dx);
-                                        }
+                                                WRITE(s3->accel.dest + s3->accel.dx);
                                 }
+                        }
 
-                                mix_dat <<= 1;
-                                mix_dat |= 1;
-                                if (s3->bpp == 0)
-                                        cpu_dat >>= 8;
-                                else
-                                        cpu_dat >>= 16;
+                        mix_dat <<= 1;
+                        mix_dat |= 1;
+                        if (s3->bpp == 0)
+                                cpu_dat >>= 8;
+                        else
+                                cpu_dat >>= 16;
 
+                        if (s3->accel.cmd & 0x20) {
+                                s3->accel.cx++;
+                                s3->accel.dx++;
+                        } else {
+                                s3->accel.cx--;
+                                s3->accel.dx--;
+                        }
+                        s3->accel.sx--;
+                        if (s3->accel.sx < 0) {
                                 if (s3->accel.cmd & 0x20) {
-                                        s3->accel.cx++;
-                                        s3->accel.dx++;
+                                        s3->accel.cx -= (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+                                        s3->accel.dx -= (s3->accel.maj_axis_pcnt & 0xfff) + 1;
                                 } else {
-                                        s3->accel.cx--;
-                                        s3->accel.dx--;
+                                        s3->accel.cx += (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+                                        s3->accel.dx += (s3->accel.maj_axis_pcnt & 0xfff) + 1;
                                 }
-                                s3->accel.sx--;
-                                if (s3->accel.sx < 0) {
-                                        if (s3->accel.cmd & 0x20) {
-                                                s3->accel.cx -= (s3->accel.maj_axis_pcnt & 0xfff) + 1;
-                                                s3->accel.dx -= (s3->accel.maj_axis_pcnt & 0xfff) + 1;
-                                        } else {
-                                                s3->accel.cx += (s3->accel.maj_axis_pcnt & 0xfff) + 1;
-                                                s3->accel.dx += (s3->accel.maj_axis_pcnt & 0xfff) + 1;
-                                        }
-                                        s3->accel.sx = s3->accel.maj_axis_pcnt & 0xfff;
+                                s3->accel.sx = s3->accel.maj_axis_pcnt & 0xfff;
 
-                                        if (s3->accel.cmd & 0x80) {
-                                                s3->accel.cy++;
-                                                s3->accel.dy++;
-                                        } else {
-                                                s3->accel.cy--;
-                                                s3->accel.dy--;
-                                        }
+                                if (s3->accel.cmd & 0x80) {
+                                        s3->accel.cy++;
+                                        s3->accel.dy++;
+                                } else {
+                                        s3->accel.cy--;
+                                        s3->accel.dy--;
+                                }
 
-                                        s3->accel.src = srcbase + s3->accel.cy * s3->width;
-                                        s3->accel.dest = dstbase + s3->accel.dy * s3->width;
+                                s3->accel.src = srcbase + s3->accel.cy * s3->width;
+                                s3->accel.dest = dstbase + s3->accel.dy * s3->width;
 
-                                        s3->accel.sy--;
+                                s3->accel.sy--;
 
-                                        if (cpu_input /* && (s3->accel.multifunc[0xa] & 0xc0) == 0x80*/)
-                                                return;
-                                        if (s3->accel.sy < 0)
-                                                return;
-                                }
+                                if (cpu_input /* && (s3->accel.multifunc[0xa] & 0xc0) == 0x80*/)
+                                        return;
+                                if (s3->accel.sy < 0)
+                                        return;
                         }
                 }
                 break;
@@ -2897,6 +3129,8 @@ static void *s3_init(char *bios_fn, int chip) {
 
         svga_init(&s3->svga, s3, vram_size, /*4mb - 864 supports 8mb but buggy VESA driver reports 0mb*/
                   s3_recalctimings, s3_in, s3_out, s3_hwcursor_draw, NULL);
+        if (device_get_config_int("lfb_direct"))
+                svga->lfb_direct_mapping = &s3->linear_mapping;
 
         svga->decode_mask = (4 << 20) - 1;
         switch (vram) {
@@ -3051,11 +3285,19 @@ void s3_add_status_info(char *s, int max_len, void *p) {
                 status_diff = 1;
 
         svga_add_status_info(s, max_len, &s3->svga);
-        sprintf(temps, "%f%% CPU\n%f%% CPU (real)\n\n", ((double)s3->blitter_time * 100.0) / timer_freq,
+        sprintf(temps, "%f%% CPU\n%f%% CPU (real)\n", ((double)s3->blitter_time * 100.0) / timer_freq,
                 ((double)s3->blitter_time * 100.0) / status_diff);
         strncat(s, temps, max_len);
+        sprintf(temps, "%f kops/sec\n%f kPIX_TRANS/sec (%f ksetup runs/sec)\n\n",
+                ((double)s3->accel_ops * timer_freq) / (status_diff * 1000.0),
+                ((double)s3->accel_pix_trans * timer_freq) / (status_diff * 1000.0),
+                ((double)s3->accel_setup_runs * timer_freq) / (status_diff * 1000.0));
+        strncat(s, temps, max_len);
 
         s3->blitter_time = 0;
+        s3->accel_ops = 0;
+        s3->accel_pix_trans = 0;
+        s3->accel_setup_runs = 0;
 }
 
 static device_config_t s3_bahamas64_config[] = {{.name = "memory",
@@ -3069,6 +3311,10 @@ static device_config_t s3_bahamas64_config[] = {{.name = "memory",
                                                                  up to 2 MB on the board anyway. */
                                                                {.description = ""}},
                                                  .default_int = 4},
+                                                {.name = "lfb_direct",
+                                                 .description = "Direct linear framebuffer writes",
+                                                 .type = CONFIG_BINARY,
+                                                 .default_int = 0},
                                                 {.type = -1}};
 
 static device_config_t s3_9fx_config[] = {{.name = "memory",
@@ -3079,6 +3325,10 @@ static device_config_t s3_9fx_config[] = {{.name = "memory",
                                                          /*Trio64 also supports 4 MB, however the Number Nine BIOS does not*/
                                                          {.description = ""}},
                                            .default_int = 2},
+                                          {.name = "lfb_direct",
+                                           .description = "Direct linear framebuffer writes",
+                                           .type = CONFIG_BINARY,
+                                           .default_int = 0},
                                           {.type = -1}};
 
 static device_config_t s3_phoenix_trio32_config[] = {{.name = "memory",
@@ -3089,6 +3339,10 @@ static device_config_t s3_phoenix_trio32_config[] = {{.name = "memory",
                                                                     {.description = "2 MB", .value = 2},
                                                                     {.description = ""}},
                                                       .default_int = 2},
+                                                     {.name = "lfb_direct",
+                                                      .description = "Direct linear framebuffer writes",
+                                                      .type = CONFIG_BINARY,
+                                                      .default_int = 0},
                                                      {.type = -1}};
 
 static device_config_t s3_phoenix_trio64_config[] = {{.name = "memory",
@@ -3099,6 +3353,10 @@ static device_config_t s3_phoenix_trio64_config[] = {{.name = "memory",
                                                                     {.description = "4 MB", .value = 4},
                                                                     {.description = ""}},
                                                       .default_int = 2},
+                                                     {.name = "lfb_direct",
+                                                      .description = "Direct linear framebuffer writes",
+                                                      .type = CONFIG_BINARY,
+                                                      .default_int = 0},
                                                      {.type = -1}};
 
 device_t s3_bahamas64_device = {"Paradise Bahamas 64 (S3 Vision864)",
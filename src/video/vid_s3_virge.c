@@ -37,9 +37,14 @@ static int dither[4][4] = {
 #define RB_SIZE 256
 #define RB_MASK (RB_SIZE - 1)
 
-#define RB_ENTRIES (virge->s3d_write_idx - virge->s3d_read_idx)
-#define RB_FULL (RB_ENTRIES == RB_SIZE)
-#define RB_EMPTY (!RB_ENTRIES)
+/*Each render thread has its own read index into the triangle ringbuffer*/
+#define RB_ENTRIES(x) (virge->s3d_write_idx - virge->s3d_read_idx[x])
+#define RB_FULL(x) (RB_ENTRIES(x) == RB_SIZE)
+#define RB_EMPTY(x) (!RB_ENTRIES(x))
+
+#define S3D_MAX_RENDER_THREADS 4
+/*Triangles are split between render threads by bands of 1 << S3D_BAND_SHIFT scanlines*/
+#define S3D_BAND_SHIFT 2
 
 #define FIFO_SIZE 65536
 #define FIFO_MASK (FIFO_SIZE - 1)
@@ -104,6 +109,11 @@ typedef struct s3d_t {
         int ty01, ty12, tlr;
 } s3d_t;
 
+typedef struct s3d_render_worker_t {
+        struct virge_t *virge;
+        int index;
+} s3d_render_worker_t;
+
 typedef struct virge_t {
         mem_mapping_t linear_mapping;
         mem_mapping_t mmio_mapping;
@@ -129,12 +139,15 @@ typedef struct virge_t {
         int dithering_enabled;
         int memory_size;
 
-        int pixel_count, tri_count;
+        int pixel_count[S3D_MAX_RENDER_THREADS], tri_count;
 
-        thread_t *render_thread;
-        event_t *wake_render_thread;
+        int render_threads;
+        s3d_render_worker_t render_worker[S3D_MAX_RENDER_THREADS];
+        thread_t *render_thread[S3D_MAX_RENDER_THREADS];
+        event_t *wake_render_thread[S3D_MAX_RENDER_THREADS];
         event_t *wake_main_thread;
         event_t *not_full_event;
+        mutex_t *s3d_idle_mutex;
 
         uint32_t hwc_fg_col, hwc_bg_col;
         int hwc_col_stack_pos;
@@ -185,8 +198,8 @@ typedef struct virge_t {
         s3d_t s3d_tri;
 
         s3d_t s3d_buffer[RB_SIZE];
-        int s3d_read_idx, s3d_write_idx;
-        int s3d_busy;
+        volatile int s3d_read_idx[S3D_MAX_RENDER_THREADS], s3d_write_idx;
+        volatile int s3d_busy[S3D_MAX_RENDER_THREADS];
 
         struct {
                 uint32_t pri_ctrl;
@@ -786,6 +799,16 @@ static void s3_virge_wait_fifo_idle(virge_t *virge) {
         }
 }
 
+static int s3_virge_s3d_busy(virge_t *virge) {
+        int c;
+
+        for (c = 0; c < virge->render_threads; c++) {
+                if (virge->s3d_busy[c] || !RB_EMPTY(c))
+                        return 1;
+        }
+        return 0;
+}
+
 static uint8_t s3_virge_mmio_read(uint32_t addr, void *p) {
         virge_t *virge = (virge_t *)p;
         uint8_t ret;
@@ -794,7 +817,7 @@ static uint8_t s3_virge_mmio_read(uint32_t addr, void *p) {
         //        pclog("New MMIO readb %08X\n", addr);
         switch (addr & 0xffff) {
         case 0x8505:
-                if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+                if (s3_virge_s3d_busy(virge) || virge->virge_busy || !FIFO_EMPTY)
                         ret = 0x10;
                 else
                         ret = 0x10 | (1 << 5);
@@ -946,7 +969,7 @@ static uint32_t s3_virge_mmio_read_l(uint32_t addr, void *p) {
                 break;
 
         case 0x8504:
-                if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+                if (s3_virge_s3d_busy(virge) || virge->virge_busy || !FIFO_EMPTY)
                         ret = (0x10 << 8);
                 else
                         ret = (0x10 << 8) | (1 << 13);
@@ -2623,7 +2646,7 @@ static void s3_virge_bitblt(virge_t *virge, int count, uint32_t cpu_dat) {
 
 #define RGB15(r, g, b, dest)                                                                                                     \
         if (virge->dithering_enabled) {                                                                                          \
-                int add = dither[_y & 3][_x & 3];                                                                                \
+                int add = dither[state->y & 3][x & 3];                                                                           \
                 int _r = (r > 248) ? 248 : r + add;                                                                              \
                 int _g = (g > 248) ? 248 : g + add;                                                                              \
                 int _b = (b > 248) ? 248 : b + add;                                                                              \
@@ -2657,6 +2680,11 @@ typedef struct s3d_state_t {
         int y;
 
         rgba_t dest_rgba;
+
+        void (*tex_span)(struct s3d_state_t *state, s3d_t *s3d_tri, rgba_t *out, int count);
+        void (*dest_pixel)(struct s3d_state_t *state, const rgba_t *texel);
+
+        int thread;
 } s3d_state_t;
 
 typedef struct s3d_texture_state_t {
@@ -2666,16 +2694,17 @@ typedef struct s3d_texture_state_t {
         int32_t u, v;
 } s3d_texture_state_t;
 
-static void (*tex_read)(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out);
-static void (*tex_sample)(s3d_state_t *state);
-static void (*dest_pixel)(s3d_state_t *state);
+typedef void (*tex_read_t)(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out);
+
+/*The texel readers, samplers, dest pixel stages and span loop are building blocks for the
+  specialised renderers generated below. GCC stops inlining them once there are this many
+  copies, which would leave every stage an indirect call again, so force it*/
+#define S3D_INLINE inline __attribute__((always_inline))
 
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-static int _x, _y;
-
-static void tex_ARGB1555(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
+static S3D_INLINE void tex_ARGB1555(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
         int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
                      (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
         uint16_t val = state->texture[texture_state->level][offset];
@@ -2686,7 +2715,7 @@ static void tex_ARGB1555(s3d_state_t *state, s3d_texture_state_t *texture_state,
         out->a = (val & 0x8000) ? 0xff : 0;
 }
 
-static void tex_ARGB1555_nowrap(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
+static S3D_INLINE void tex_ARGB1555_nowrap(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
         int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
                      (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
         uint16_t val = state->texture[texture_state->level][offset];
@@ -2700,7 +2729,7 @@ static void tex_ARGB1555_nowrap(s3d_state_t *state, s3d_texture_state_t *texture
         out->a = (val & 0x8000) ? 0xff : 0;
 }
 
-static void tex_ARGB4444(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
+static S3D_INLINE void tex_ARGB4444(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
         int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
                      (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
         uint16_t val = state->texture[texture_state->level][offset];
@@ -2711,7 +2740,7 @@ static void tex_ARGB4444(s3d_state_t *state, s3d_texture_state_t *texture_state,
         out->a = ((val & 0xf000) >> 8) | ((val & 0xf000) >> 12);
 }
 
-static void tex_ARGB4444_nowrap(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
+static S3D_INLINE void tex_ARGB4444_nowrap(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
         int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
                      (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
         uint16_t val = state->texture[texture_state->level][offset];
@@ -2725,7 +2754,7 @@ static void tex_ARGB4444_nowrap(s3d_state_t *state, s3d_texture_state_t *texture
         out->a = ((val & 0xf000) >> 8) | ((val & 0xf000) >> 12);
 }
 
-static void tex_ARGB8888(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
+static S3D_INLINE void tex_ARGB8888(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
         int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
                      (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
         uint32_t val = ((uint32_t *)state->texture[texture_state->level])[offset];
@@ -2735,7 +2764,7 @@ static void tex_ARGB8888(s3d_state_t *state, s3d_texture_state_t *texture_state,
         out->b = val & 0xff;
         out->a = (val >> 24) & 0xff;
 }
-static void tex_ARGB8888_nowrap(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
+static S3D_INLINE void tex_ARGB8888_nowrap(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
         int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
                      (((texture_state->v & 0x7fc0000) >> texture_state->texture_shift) << texture_state->level);
         uint32_t val = ((uint32_t *)state->texture[texture_state->level])[offset];
@@ -2749,7 +2778,7 @@ static void tex_ARGB8888_nowrap(s3d_state_t *state, s3d_texture_state_t *texture
         out->a = (val >> 24) & 0xff;
 }
 
-static void tex_sample_normal(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_normal(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
 
         texture_state.level = state->max_d;
@@ -2760,7 +2789,7 @@ static void tex_sample_normal(s3d_state_t *state) {
         tex_read(state, &texture_state, &state->dest_rgba);
 }
 
-static void tex_sample_normal_filter(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_normal_filter(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int tex_offset;
         rgba_t tex_samples[4];
@@ -2804,7 +2833,7 @@ static void tex_sample_normal_filter(s3d_state_t *state) {
                 (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
 }
 
-static void tex_sample_mipmap(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_mipmap(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
 
         texture_state.level = (state->d < 0) ? state->max_d : state->max_d - ((state->d >> 27) & 0xf);
@@ -2817,7 +2846,7 @@ static void tex_sample_mipmap(s3d_state_t *state) {
         tex_read(state, &texture_state, &state->dest_rgba);
 }
 
-static void tex_sample_mipmap_filter(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_mipmap_filter(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int tex_offset;
         rgba_t tex_samples[4];
@@ -2863,7 +2892,7 @@ static void tex_sample_mipmap_filter(s3d_state_t *state) {
                 (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
 }
 
-static void tex_sample_persp_normal(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_persp_normal(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int32_t w = 0;
 
@@ -2878,7 +2907,7 @@ static void tex_sample_persp_normal(s3d_state_t *state) {
         tex_read(state, &texture_state, &state->dest_rgba);
 }
 
-static void tex_sample_persp_normal_filter(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_persp_normal_filter(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int32_t w = 0, u, v;
         int tex_offset;
@@ -2929,7 +2958,7 @@ static void tex_sample_persp_normal_filter(s3d_state_t *state) {
                 (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
 }
 
-static void tex_sample_persp_normal_375(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_persp_normal_375(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int32_t w = 0;
 
@@ -2944,7 +2973,7 @@ static void tex_sample_persp_normal_375(s3d_state_t *state) {
         tex_read(state, &texture_state, &state->dest_rgba);
 }
 
-static void tex_sample_persp_normal_filter_375(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_persp_normal_filter_375(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int32_t w = 0, u, v;
         int tex_offset;
@@ -2995,7 +3024,7 @@ static void tex_sample_persp_normal_filter_375(s3d_state_t *state) {
                 (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
 }
 
-static void tex_sample_persp_mipmap(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_persp_mipmap(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int32_t w = 0;
 
@@ -3012,7 +3041,7 @@ static void tex_sample_persp_mipmap(s3d_state_t *state) {
         tex_read(state, &texture_state, &state->dest_rgba);
 }
 
-static void tex_sample_persp_mipmap_filter(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_persp_mipmap_filter(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int32_t w = 0, u, v;
         int tex_offset;
@@ -3065,7 +3094,7 @@ static void tex_sample_persp_mipmap_filter(s3d_state_t *state) {
                 (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
 }
 
-static void tex_sample_persp_mipmap_375(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_persp_mipmap_375(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int32_t w = 0;
 
@@ -3082,7 +3111,7 @@ static void tex_sample_persp_mipmap_375(s3d_state_t *state) {
         tex_read(state, &texture_state, &state->dest_rgba);
 }
 
-static void tex_sample_persp_mipmap_filter_375(s3d_state_t *state) {
+static S3D_INLINE void tex_sample_persp_mipmap_filter_375(s3d_state_t *state, tex_read_t tex_read) {
         s3d_texture_state_t texture_state;
         int32_t w = 0, u, v;
         int tex_offset;
@@ -3135,6 +3164,92 @@ static void tex_sample_persp_mipmap_filter_375(s3d_state_t *state) {
                 (tex_samples[0].a * d[0] + tex_samples[1].a * d[1] + tex_samples[2].a * d[2] + tex_samples[3].a * d[3]) >> 16;
 }
 
+/*Texture samplers specialised for each texel format, so that the texel reads are
+  inlined into the sampler instead of going through a function pointer*/
+/*Sample count texels along a span, stepping u, v, d and w. Generated for each sampling mode and
+  texel format, so the texel read and filter are inlined and the span loop makes one call per chunk
+  rather than one per pixel*/
+#define TEX_SAMPLER(sample, fmt)                                                                                                 \
+        static void tex_span_##sample##_##fmt(s3d_state_t *state, s3d_t *s3d_tri, rgba_t *out, int count) {                    \
+                int c;                                                                                                           \
+                                                                                                                                 \
+                for (c = 0; c < count; c++) {                                                                                    \
+                        tex_sample_##sample(state, tex_##fmt);                                                                   \
+                        out[c] = state->dest_rgba;                                                                               \
+                                                                                                                                 \
+                        state->u += s3d_tri->TdUdX;                                                                              \
+                        state->v += s3d_tri->TdVdX;                                                                              \
+                        state->d += s3d_tri->TdDdX;                                                                              \
+                        state->w += s3d_tri->TdWdX;                                                                              \
+                }                                                                                                                \
+        }
+
+#define TEX_SAMPLERS(sample)                                                                                                     \
+        TEX_SAMPLER(sample, ARGB8888)                                                                                            \
+        TEX_SAMPLER(sample, ARGB8888_nowrap)                                                                                     \
+        TEX_SAMPLER(sample, ARGB4444)                                                                                            \
+        TEX_SAMPLER(sample, ARGB4444_nowrap)                                                                                     \
+        TEX_SAMPLER(sample, ARGB1555)                                                                                            \
+        TEX_SAMPLER(sample, ARGB1555_nowrap)
+
+TEX_SAMPLERS(normal)
+TEX_SAMPLERS(normal_filter)
+TEX_SAMPLERS(mipmap)
+TEX_SAMPLERS(mipmap_filter)
+TEX_SAMPLERS(persp_normal)
+TEX_SAMPLERS(persp_normal_filter)
+TEX_SAMPLERS(persp_normal_375)
+TEX_SAMPLERS(persp_normal_filter_375)
+TEX_SAMPLERS(persp_mipmap)
+TEX_SAMPLERS(persp_mipmap_filter)
+TEX_SAMPLERS(persp_mipmap_375)
+TEX_SAMPLERS(persp_mipmap_filter_375)
+
+enum {
+        TEX_SAMPLE_NORMAL = 0,
+        TEX_SAMPLE_NORMAL_FILTER,
+        TEX_SAMPLE_MIPMAP,
+        TEX_SAMPLE_MIPMAP_FILTER,
+        TEX_SAMPLE_PERSP_NORMAL,
+        TEX_SAMPLE_PERSP_NORMAL_FILTER,
+        TEX_SAMPLE_PERSP_NORMAL_375,
+        TEX_SAMPLE_PERSP_NORMAL_FILTER_375,
+        TEX_SAMPLE_PERSP_MIPMAP,
+        TEX_SAMPLE_PERSP_MIPMAP_FILTER,
+        TEX_SAMPLE_PERSP_MIPMAP_375,
+        TEX_SAMPLE_PERSP_MIPMAP_FILTER_375,
+        TEX_SAMPLE_MODES
+};
+
+enum {
+        TEX_FORMAT_ARGB8888 = 0,
+        TEX_FORMAT_ARGB8888_NOWRAP,
+        TEX_FORMAT_ARGB4444,
+        TEX_FORMAT_ARGB4444_NOWRAP,
+        TEX_FORMAT_ARGB1555,
+        TEX_FORMAT_ARGB1555_NOWRAP,
+        TEX_FORMATS
+};
+
+#define TEX_SAMPLER_FORMATS(sample)                                                                                              \
+        {tex_span_##sample##_ARGB8888, tex_span_##sample##_ARGB8888_nowrap, tex_span_##sample##_ARGB4444,                        \
+         tex_span_##sample##_ARGB4444_nowrap, tex_span_##sample##_ARGB1555, tex_span_##sample##_ARGB1555_nowrap}
+
+static void (*const tex_spans[TEX_SAMPLE_MODES][TEX_FORMATS])(s3d_state_t *state, s3d_t *s3d_tri, rgba_t *out, int count) = {
+        TEX_SAMPLER_FORMATS(normal),
+        TEX_SAMPLER_FORMATS(normal_filter),
+        TEX_SAMPLER_FORMATS(mipmap),
+        TEX_SAMPLER_FORMATS(mipmap_filter),
+        TEX_SAMPLER_FORMATS(persp_normal),
+        TEX_SAMPLER_FORMATS(persp_normal_filter),
+        TEX_SAMPLER_FORMATS(persp_normal_375),
+        TEX_SAMPLER_FORMATS(persp_normal_filter_375),
+        TEX_SAMPLER_FORMATS(persp_mipmap),
+        TEX_SAMPLER_FORMATS(persp_mipmap_filter),
+        TEX_SAMPLER_FORMATS(persp_mipmap_375),
+        TEX_SAMPLER_FORMATS(persp_mipmap_filter_375),
+};
+
 #define CLAMP(x)                                                                                                                 \
         do {                                                                                                                     \
                 if ((x) & ~0xff)                                                                                                 \
@@ -3167,7 +3282,7 @@ static void tex_sample_persp_mipmap_filter_375(s3d_state_t *state) {
                         b = 0xff;                                                                                                \
         } while (0)
 
-static void dest_pixel_gouraud_shaded_triangle(s3d_state_t *state) {
+static S3D_INLINE void dest_pixel_gouraud_shaded_triangle(s3d_state_t *state, const rgba_t *texel) {
         state->dest_rgba.r = state->r >> 7;
         CLAMP(state->dest_rgba.r);
 
@@ -3181,22 +3296,22 @@ static void dest_pixel_gouraud_shaded_triangle(s3d_state_t *state) {
         CLAMP(state->dest_rgba.a);
 }
 
-static void dest_pixel_unlit_texture_triangle(s3d_state_t *state) {
-        tex_sample(state);
+static S3D_INLINE void dest_pixel_unlit_texture_triangle(s3d_state_t *state, const rgba_t *texel) {
+        state->dest_rgba = *texel;
 
         if (state->cmd_set & CMD_SET_ABC_SRC)
                 state->dest_rgba.a = state->a >> 7;
 }
 
-static void dest_pixel_lit_texture_decal(s3d_state_t *state) {
-        tex_sample(state);
+static S3D_INLINE void dest_pixel_lit_texture_decal(s3d_state_t *state, const rgba_t *texel) {
+        state->dest_rgba = *texel;
 
         if (state->cmd_set & CMD_SET_ABC_SRC)
                 state->dest_rgba.a = state->a >> 7;
 }
 
-static void dest_pixel_lit_texture_reflection(s3d_state_t *state) {
-        tex_sample(state);
+static S3D_INLINE void dest_pixel_lit_texture_reflection(s3d_state_t *state, const rgba_t *texel) {
+        state->dest_rgba = *texel;
 
         state->dest_rgba.r += (state->r >> 7);
         state->dest_rgba.g += (state->g >> 7);
@@ -3207,10 +3322,10 @@ static void dest_pixel_lit_texture_reflection(s3d_state_t *state) {
         CLAMP_RGBA(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b, state->dest_rgba.a);
 }
 
-static void dest_pixel_lit_texture_modulate(s3d_state_t *state) {
+static S3D_INLINE void dest_pixel_lit_texture_modulate(s3d_state_t *state, const rgba_t *texel) {
         int r = state->r >> 7, g = state->g >> 7, b = state->b >> 7, a = state->a >> 7;
 
-        tex_sample(state);
+        state->dest_rgba = *texel;
 
         CLAMP_RGBA(r, g, b, a);
 
@@ -3222,14 +3337,165 @@ static void dest_pixel_lit_texture_modulate(s3d_state_t *state) {
                 state->dest_rgba.a = a;
 }
 
-static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int32_t dx1, int32_t dx2) {
+#define TEX_SPAN_CHUNK 64
+
+/*Draw one span of a triangle. This is inlined into the specialised span renderers
+  below, with bpp, the lighting mode and alpha blending known at compile time. Textured
+  modes sample the span in chunks through state->tex_span, which is specialised on texel
+  format, filtering and perspective correction. Texels are also sampled for pixels that
+  then fail the Z test; sampling has no side effects, so the output is unchanged*/
+static S3D_INLINE void tri_span(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int x, int xe, int x_dir, uint32_t dest_addr,
+                                uint32_t z_addr, uint32_t z, int bpp, void (*dest_pixel)(s3d_state_t *state, const rgba_t *texel),
+                                int textured, int blend) {
         svga_t *svga = &virge->svga;
         uint8_t *vram = virge->svga.vram;
-
-        int x_dir = s3d_tri->tlr ? 1 : -1;
+        rgba_t texels[TEX_SPAN_CHUNK];
 
         int use_z = !(s3d_tri->cmd_set & CMD_SET_ZB_MODE);
 
+        int x_offset = x_dir * (bpp + 1);
+        int xz_offset = x_dir << 1;
+
+        int count = ((xe - x) * x_dir) & 0xfff;
+        int c = TEX_SPAN_CHUNK;
+
+        for (; count > 0; count--, c++) {
+                int update = 1;
+                uint16_t src_z = 0;
+
+                if (textured && c == TEX_SPAN_CHUNK) {
+                        state->tex_span(state, s3d_tri, texels, MIN(count, TEX_SPAN_CHUNK));
+                        c = 0;
+                }
+
+                if (use_z) {
+                        src_z = Z_READ(z_addr);
+                        Z_CLIP(src_z, z >> 16);
+                }
+
+                if (update) {
+                        uint32_t dest_col;
+
+                        dest_pixel(state, textured ? &texels[c] : NULL);
+
+                        if (blend) {
+                                uint32_t src_col;
+                                int src_r = 0, src_g = 0, src_b = 0;
+
+                                switch (bpp) {
+                                case 0: /*8 bpp*/
+                                        /*Not implemented yet*/
+                                        break;
+                                case 1: /*16 bpp*/
+                                        src_col = *(uint16_t *)&vram[dest_addr & svga->vram_mask];
+                                        RGB15_TO_24(src_col, src_r, src_g, src_b);
+                                        break;
+                                case 2: /*24 bpp*/
+                                        src_col = (*(uint32_t *)&vram[dest_addr & svga->vram_mask]) & 0xffffff;
+                                        RGB24_TO_24(src_col, src_r, src_g, src_b);
+                                        break;
+                                }
+
+                                state->dest_rgba.r = ((state->dest_rgba.r * state->dest_rgba.a) +
+                                                      (src_r * (255 - state->dest_rgba.a))) /
+                                                     255;
+                                state->dest_rgba.g = ((state->dest_rgba.g * state->dest_rgba.a) +
+                                                      (src_g * (255 - state->dest_rgba.a))) /
+                                                     255;
+                                state->dest_rgba.b = ((state->dest_rgba.b * state->dest_rgba.a) +
+                                                      (src_b * (255 - state->dest_rgba.a))) /
+                                                     255;
+                        }
+
+                        switch (bpp) {
+                        case 0: /*8 bpp*/
+                                /*Not implemented yet*/
+                                break;
+                        case 1: /*16 bpp*/
+                                RGB15(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b, dest_col);
+                                *(uint16_t *)&vram[dest_addr] = dest_col;
+                                break;
+                        case 2: /*24 bpp*/
+                                dest_col = RGB24(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b);
+                                *(uint8_t *)&vram[dest_addr] = dest_col & 0xff;
+                                *(uint8_t *)&vram[dest_addr + 1] = (dest_col >> 8) & 0xff;
+                                *(uint8_t *)&vram[dest_addr + 2] = (dest_col >> 16) & 0xff;
+                                break;
+                        }
+
+                        if (use_z && (s3d_tri->cmd_set & CMD_SET_ZUP))
+                                Z_WRITE(z_addr, src_z);
+                }
+
+                z += s3d_tri->TdZdX;
+                state->r += s3d_tri->TdRdX;
+                state->g += s3d_tri->TdGdX;
+                state->b += s3d_tri->TdBdX;
+                state->a += s3d_tri->TdAdX;
+                x = (x + x_dir) & 0xfff;
+                dest_addr += x_offset;
+                z_addr += xz_offset;
+        }
+}
+
+typedef void (*tri_span_t)(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int x, int xe, int x_dir, uint32_t dest_addr,
+                           uint32_t z_addr, uint32_t z);
+
+/*Used for invalid destination formats*/
+static void tri_span_generic(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int x, int xe, int x_dir, uint32_t dest_addr,
+                             uint32_t z_addr, uint32_t z) {
+        tri_span(virge, s3d_tri, state, x, xe, x_dir, dest_addr, z_addr, z, (s3d_tri->cmd_set >> 2) & 7, state->dest_pixel,
+                 state->dest_pixel != dest_pixel_gouraud_shaded_triangle, s3d_tri->cmd_set & CMD_SET_ABC_ENABLE);
+}
+
+#define TRI_SPAN(name, bpp, dest_pixel, textured, blend)                                                                         \
+        static void tri_span_##name(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int x, int xe, int x_dir,                \
+                                    uint32_t dest_addr, uint32_t z_addr, uint32_t z) {                                           \
+                tri_span(virge, s3d_tri, state, x, xe, x_dir, dest_addr, z_addr, z, bpp, dest_pixel, textured, blend);           \
+        }
+
+#define TRI_SPANS(name, dest_pixel, textured)                                                                                    \
+        TRI_SPAN(name##_8, 0, dest_pixel, textured, 0)                                                                           \
+        TRI_SPAN(name##_8_blend, 0, dest_pixel, textured, 1)                                                                     \
+        TRI_SPAN(name##_16, 1, dest_pixel, textured, 0)                                                                          \
+        TRI_SPAN(name##_16_blend, 1, dest_pixel, textured, 1)                                                                    \
+        TRI_SPAN(name##_24, 2, dest_pixel, textured, 0)                                                                          \
+        TRI_SPAN(name##_24_blend, 2, dest_pixel, textured, 1)
+
+TRI_SPANS(gouraud_shaded_triangle, dest_pixel_gouraud_shaded_triangle, 0)
+TRI_SPANS(unlit_texture_triangle, dest_pixel_unlit_texture_triangle, 1)
+TRI_SPANS(lit_texture_decal, dest_pixel_lit_texture_decal, 1)
+TRI_SPANS(lit_texture_reflection, dest_pixel_lit_texture_reflection, 1)
+TRI_SPANS(lit_texture_modulate, dest_pixel_lit_texture_modulate, 1)
+
+enum {
+        DEST_PIXEL_GOURAUD_SHADED_TRIANGLE = 0,
+        DEST_PIXEL_UNLIT_TEXTURE_TRIANGLE,
+        DEST_PIXEL_LIT_TEXTURE_DECAL,
+        DEST_PIXEL_LIT_TEXTURE_REFLECTION,
+        DEST_PIXEL_LIT_TEXTURE_MODULATE,
+        DEST_PIXEL_MODES
+};
+
+static void (*const dest_pixels[DEST_PIXEL_MODES])(s3d_state_t *state, const rgba_t *texel) = {
+        dest_pixel_gouraud_shaded_triangle, dest_pixel_unlit_texture_triangle, dest_pixel_lit_texture_decal,
+        dest_pixel_lit_texture_reflection, dest_pixel_lit_texture_modulate};
+
+#define TRI_SPAN_FORMATS(name)                                                                                                   \
+        {{tri_span_##name##_8, tri_span_##name##_8_blend},                                                                       \
+         {tri_span_##name##_16, tri_span_##name##_16_blend},                                                                     \
+         {tri_span_##name##_24, tri_span_##name##_24_blend}}
+
+/*Indexed by [dest pixel mode][bpp][alpha blend enable]*/
+static const tri_span_t tri_spans[DEST_PIXEL_MODES][3][2] = {
+        TRI_SPAN_FORMATS(gouraud_shaded_triangle), TRI_SPAN_FORMATS(unlit_texture_triangle), TRI_SPAN_FORMATS(lit_texture_decal),
+        TRI_SPAN_FORMATS(lit_texture_reflection), TRI_SPAN_FORMATS(lit_texture_modulate)};
+
+static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, tri_span_t span, int yc, int32_t dx1, int32_t dx2) {
+        svga_t *svga = &virge->svga;
+
+        int x_dir = s3d_tri->tlr ? 1 : -1;
+
         int y_count = yc;
 
         int bpp = (s3d_tri->cmd_set >> 2) & 7;
@@ -3272,6 +3538,12 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
                 int x = (state->x1 + ((1 << 20) - 1)) >> 20;
                 int xe = (state->x2 + ((1 << 20) - 1)) >> 20;
                 uint32_t z = (state->base_z > 0) ? (state->base_z << 1) : 0;
+
+                /*Each render thread only draws the scanline bands it owns*/
+                if (virge->render_threads > 1 &&
+                    (((uint32_t)state->y >> S3D_BAND_SHIFT) % virge->render_threads) != state->thread)
+                        goto tri_skip_line;
+
                 if (x_dir < 0) {
                         x--;
                         xe--;
@@ -3280,8 +3552,6 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
                 if (x != xe && ((x_dir > 0 && x < xe) || (x_dir < 0 && x > xe))) {
                         uint32_t dest_addr, z_addr;
                         int dx = (x_dir > 0) ? ((31 - ((state->x1 - 1) >> 15)) & 0x1f) : (((state->x1 - 1) >> 15) & 0x1f);
-                        int x_offset = x_dir * (bpp + 1);
-                        int xz_offset = x_dir << 1;
                         if (x_dir > 0)
                                 dx += 1;
                         state->r = state->base_r + ((s3d_tri->TdRdX * dx) >> 5);
@@ -3355,84 +3625,8 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
                         x &= 0xfff;
                         xe &= 0xfff;
 
-                        for (; x != xe; x = (x + x_dir) & 0xfff) {
-                                int update = 1;
-                                uint16_t src_z = 0;
-                                _x = x;
-                                _y = state->y;
-
-                                if (use_z) {
-                                        src_z = Z_READ(z_addr);
-                                        Z_CLIP(src_z, z >> 16);
-                                }
-
-                                if (update) {
-                                        uint32_t dest_col;
-
-                                        dest_pixel(state);
-
-                                        if (s3d_tri->cmd_set & CMD_SET_ABC_ENABLE) {
-                                                uint32_t src_col;
-                                                int src_r = 0, src_g = 0, src_b = 0;
-
-                                                switch (bpp) {
-                                                case 0: /*8 bpp*/
-                                                        /*Not implemented yet*/
-                                                        break;
-                                                case 1: /*16 bpp*/
-                                                        src_col = *(uint16_t *)&vram[dest_addr & svga->vram_mask];
-                                                        RGB15_TO_24(src_col, src_r, src_g, src_b);
-                                                        break;
-                                                case 2: /*24 bpp*/
-                                                        src_col = (*(uint32_t *)&vram[dest_addr & svga->vram_mask]) & 0xffffff;
-                                                        RGB24_TO_24(src_col, src_r, src_g, src_b);
-                                                        break;
-                                                }
-
-                                                state->dest_rgba.r = ((state->dest_rgba.r * state->dest_rgba.a) +
-                                                                      (src_r * (255 - state->dest_rgba.a))) /
-                                                                     255;
-                                                state->dest_rgba.g = ((state->dest_rgba.g * state->dest_rgba.a) +
-                                                                      (src_g * (255 - state->dest_rgba.a))) /
-                                                                     255;
-                                                state->dest_rgba.b = ((state->dest_rgba.b * state->dest_rgba.a) +
-                                                                      (src_b * (255 - state->dest_rgba.a))) /
-                                                                     255;
-                                        }
-
-                                        switch (bpp) {
-                                        case 0: /*8 bpp*/
-                                                /*Not implemented yet*/
-                                                break;
-                                        case 1: /*16 bpp*/
-                                                RGB15(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b, dest_col);
-                                                *(uint16_t *)&vram[dest_addr] = dest_col;
-                                                break;
-                                        case 2: /*24 bpp*/
-                                                dest_col = RGB24(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b);
-                                                *(uint8_t *)&vram[dest_addr] = dest_col & 0xff;
-                                                *(uint8_t *)&vram[dest_addr + 1] = (dest_col >> 8) & 0xff;
-                                                *(uint8_t *)&vram[dest_addr + 2] = (dest_col >> 16) & 0xff;
-                                                break;
-                                        }
-
-                                        if (use_z && (s3d_tri->cmd_set & CMD_SET_ZUP))
-                                                Z_WRITE(z_addr, src_z);
-                                }
-
-                                z += s3d_tri->TdZdX;
-                                state->u += s3d_tri->TdUdX;
-                                state->v += s3d_tri->TdVdX;
-                                state->r += s3d_tri->TdRdX;
-                                state->g += s3d_tri->TdGdX;
-                                state->b += s3d_tri->TdBdX;
-                                state->a += s3d_tri->TdAdX;
-                                state->d += s3d_tri->TdDdX;
-                                state->w += s3d_tri->TdWdX;
-                                dest_addr += x_offset;
-                                z_addr += xz_offset;
-                                virge->pixel_count++;
-                        }
+                        span(virge, s3d_tri, state, x, xe, x_dir, dest_addr, z_addr, z);
+                        virge->pixel_count[state->thread] += ((xe - x) * x_dir) & 0xfff;
                 }
         tri_skip_line:
                 state->x1 += dx1;
@@ -3454,11 +3648,14 @@ static void tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int3
 
 static int tex_size[8] = {4 * 2, 2 * 2, 2 * 2, 1 * 2, 2 / 1, 2 / 1, 1 * 2, 1 * 2};
 
-static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
+static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri, int thread) {
         s3d_state_t state;
+        tri_span_t span;
 
         uint32_t tex_base;
         int c;
+        int dest_mode, sample_mode = TEX_SAMPLE_NORMAL, tex_format;
+        int bpp = (s3d_tri->cmd_set >> 2) & 7;
 
         uint64_t start_time = timer_read();
         uint64_t end_time;
@@ -3471,6 +3668,7 @@ static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
         state.tex_bdr_clr = s3d_tri->tex_bdr_clr;
 
         state.cmd_set = s3d_tri->cmd_set;
+        state.thread = thread;
 
         state.base_u = s3d_tri->tus;
         state.base_v = s3d_tri->tvs;
@@ -3491,22 +3689,22 @@ static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
 
         switch ((s3d_tri->cmd_set >> 27) & 0xf) {
         case 0:
-                dest_pixel = dest_pixel_gouraud_shaded_triangle;
+                dest_mode = DEST_PIXEL_GOURAUD_SHADED_TRIANGLE;
                 //                pclog("dest_pixel_gouraud_shaded_triangle\n");
                 break;
         case 1:
         case 5:
                 switch ((s3d_tri->cmd_set >> 15) & 0x3) {
                 case 0:
-                        dest_pixel = dest_pixel_lit_texture_reflection;
+                        dest_mode = DEST_PIXEL_LIT_TEXTURE_REFLECTION;
                         //                        pclog("dest_pixel_lit_texture_reflection\n");
                         break;
                 case 1:
-                        dest_pixel = dest_pixel_lit_texture_modulate;
+                        dest_mode = DEST_PIXEL_LIT_TEXTURE_MODULATE;
                         //                        pclog("dest_pixel_lit_texture_modulate\n");
                         break;
                 case 2:
-                        dest_pixel = dest_pixel_lit_texture_decal;
+                        dest_mode = DEST_PIXEL_LIT_TEXTURE_DECAL;
                         //                        pclog("dest_pixel_lit_texture_decal\n");
                         break;
                 default:
@@ -3516,7 +3714,7 @@ static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
                 break;
         case 2:
         case 6:
-                dest_pixel = dest_pixel_unlit_texture_triangle;
+                dest_mode = DEST_PIXEL_UNLIT_TEXTURE_TRIANGLE;
                 //                pclog("dest_pixel_unlit_texture_triangle\n");
                 break;
         default:
@@ -3527,127 +3725,202 @@ static void s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
         switch (((s3d_tri->cmd_set >> 12) & 7) | ((s3d_tri->cmd_set & (1 << 29)) ? 8 : 0)) {
         case 0:
         case 1:
-                tex_sample = tex_sample_mipmap;
+                sample_mode = TEX_SAMPLE_MIPMAP;
                 //                pclog("use tex_sample_mipmap\n");
                 break;
         case 2:
         case 3:
-                tex_sample = virge->bilinear_enabled ? tex_sample_mipmap_filter : tex_sample_mipmap;
+                sample_mode = virge->bilinear_enabled ? TEX_SAMPLE_MIPMAP_FILTER : TEX_SAMPLE_MIPMAP;
                 //                pclog("use tex_sample_mipmap_filter\n");
                 break;
         case 4:
         case 5:
-                tex_sample = tex_sample_normal;
+                sample_mode = TEX_SAMPLE_NORMAL;
                 //                pclog("use tex_sample_normal\n");
                 break;
         case 6:
         case 7:
-                tex_sample = virge->bilinear_enabled ? tex_sample_normal_filter : tex_sample_normal;
+                sample_mode = virge->bilinear_enabled ? TEX_SAMPLE_NORMAL_FILTER : TEX_SAMPLE_NORMAL;
                 //                pclog("use tex_sample_normal_filter\n");
                 break;
         case (0 | 8):
         case (1 | 8):
                 if (virge->is_375)
-                        tex_sample = tex_sample_persp_mipmap_375;
+                        sample_mode = TEX_SAMPLE_PERSP_MIPMAP_375;
                 else
-                        tex_sample = tex_sample_persp_mipmap;
+                        sample_mode = TEX_SAMPLE_PERSP_MIPMAP;
                 //                pclog("use tex_sample_persp_mipmap\n");
                 break;
         case (2 | 8):
         case (3 | 8):
                 if (virge->is_375)
-                        tex_sample = virge->bilinear_enabled ? tex_sample_persp_mipmap_filter_375 : tex_sample_persp_mipmap_375;
+                        sample_mode = virge->bilinear_enabled ? TEX_SAMPLE_PERSP_MIPMAP_FILTER_375 : TEX_SAMPLE_PERSP_MIPMAP_375;
                 else
-                        tex_sample = virge->bilinear_enabled ? tex_sample_persp_mipmap_filter : tex_sample_persp_mipmap;
+                        sample_mode = virge->bilinear_enabled ? TEX_SAMPLE_PERSP_MIPMAP_FILTER : TEX_SAMPLE_PERSP_MIPMAP;
                 //                pclog("use tex_sample_persp_mipmap_filter\n");
                 break;
         case (4 | 8):
         case (5 | 8):
                 if (virge->is_375)
-                        tex_sample = tex_sample_persp_normal_375;
+                        sample_mode = TEX_SAMPLE_PERSP_NORMAL_375;
                 else
-                        tex_sample = tex_sample_persp_normal;
+                        sample_mode = TEX_SAMPLE_PERSP_NORMAL;
                 //                pclog("use tex_sample_persp_normal\n");
                 break;
         case (6 | 8):
         case (7 | 8):
                 if (virge->is_375)
-                        tex_sample = virge->bilinear_enabled ? tex_sample_persp_normal_filter_375 : tex_sample_persp_normal_375;
+                        sample_mode = virge->bilinear_enabled ? TEX_SAMPLE_PERSP_NORMAL_FILTER_375 : TEX_SAMPLE_PERSP_NORMAL_375;
                 else
-                        tex_sample = virge->bilinear_enabled ? tex_sample_persp_normal_filter : tex_sample_persp_normal;
+                        sample_mode = virge->bilinear_enabled ? TEX_SAMPLE_PERSP_NORMAL_FILTER : TEX_SAMPLE_PERSP_NORMAL;
                 //                pclog("use tex_sample_persp_normal_filter\n");
                 break;
         }
 
         switch ((s3d_tri->cmd_set >> 5) & 7) {
         case 0:
-                tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB8888 : tex_ARGB8888_nowrap;
+                tex_format = (s3d_tri->cmd_set & CMD_SET_TWE) ? TEX_FORMAT_ARGB8888 : TEX_FORMAT_ARGB8888_NOWRAP;
                 break;
         case 1:
-                tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB4444 : tex_ARGB4444_nowrap;
+                tex_format = (s3d_tri->cmd_set & CMD_SET_TWE) ? TEX_FORMAT_ARGB4444 : TEX_FORMAT_ARGB4444_NOWRAP;
                 //                pclog("tex_ARGB4444\n");
                 break;
         case 2:
-                tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB1555 : tex_ARGB1555_nowrap;
+                tex_format = (s3d_tri->cmd_set & CMD_SET_TWE) ? TEX_FORMAT_ARGB1555 : TEX_FORMAT_ARGB1555_NOWRAP;
                 //                pclog("tex_ARGB1555 %i\n", (s3d_tri->cmd_set >> 5) & 7);
                 break;
         default:
                 pclog("bad texture type %i\n", (s3d_tri->cmd_set >> 5) & 7);
-                tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB1555 : tex_ARGB1555_nowrap;
+                tex_format = (s3d_tri->cmd_set & CMD_SET_TWE) ? TEX_FORMAT_ARGB1555 : TEX_FORMAT_ARGB1555_NOWRAP;
                 break;
         }
 
+        state.dest_pixel = dest_pixels[dest_mode];
+        state.tex_span = tex_spans[sample_mode][tex_format];
+
+        if (bpp <= 2)
+                span = tri_spans[dest_mode][bpp][(s3d_tri->cmd_set & CMD_SET_ABC_ENABLE) ? 1 : 0];
+        else
+                span = tri_span_generic;
+
         //        pclog("Triangle %i %i,%i to %i,%i  %08x\n", y, x1 >> 20, y, s3d_tri->txend01 >> 20, y - (s3d_tri->ty01 +
         //        s3d_tri->ty12), state.cmd_set);
 
         state.y = s3d_tri->tys;
         state.x1 = s3d_tri->txs;
         state.x2 = s3d_tri->txend01;
-        tri(virge, s3d_tri, &state, s3d_tri->ty01, s3d_tri->TdXdY02, s3d_tri->TdXdY01);
+        tri(virge, s3d_tri, &state, span, s3d_tri->ty01, s3d_tri->TdXdY02, s3d_tri->TdXdY01);
         state.x2 = s3d_tri->txend12;
-        tri(virge, s3d_tri, &state, s3d_tri->ty12, s3d_tri->TdXdY02, s3d_tri->TdXdY12);
+        tri(virge, s3d_tri, &state, span, s3d_tri->ty12, s3d_tri->TdXdY02, s3d_tri->TdXdY12);
 
-        virge->tri_count++;
+        /*Triangle count and render time are only tracked by the first render thread*/
+        if (!thread) {
+                virge->tri_count++;
 
-        end_time = timer_read();
+                end_time = timer_read();
 
-        virge_time += end_time - start_time;
+                virge_time += end_time - start_time;
+        }
 }
 
+/*Every render thread walks the whole triangle ringbuffer, drawing only the
+  scanline bands it owns. The S3D done interrupt is raised by whichever thread
+  finds all of them idle.*/
 static void render_thread(void *param) {
-        virge_t *virge = (virge_t *)param;
+        s3d_render_worker_t *worker = (s3d_render_worker_t *)param;
+        virge_t *virge = worker->virge;
+        int thread = worker->index;
 
         while (1) {
-                thread_wait_event(virge->wake_render_thread, -1);
-                thread_reset_event(virge->wake_render_thread);
-                virge->s3d_busy = 1;
-                while (!RB_EMPTY) {
-                        s3_virge_triangle(virge, &virge->s3d_buffer[virge->s3d_read_idx & RB_MASK]);
-                        virge->s3d_read_idx++;
-
-                        if (RB_ENTRIES == RB_SIZE - 1)
+                int c, idle = 1;
+
+                thread_wait_event(virge->wake_render_thread[thread], -1);
+                thread_reset_event(virge->wake_render_thread[thread]);
+                thread_lock_mutex(virge->s3d_idle_mutex);
+                virge->s3d_busy[thread] = 1;
+                thread_unlock_mutex(virge->s3d_idle_mutex);
+                while (!RB_EMPTY(thread)) {
+                        s3_virge_triangle(virge, &virge->s3d_buffer[virge->s3d_read_idx[thread] & RB_MASK], thread);
+                        virge->s3d_read_idx[thread]++;
+
+                        if (RB_ENTRIES(thread) == RB_SIZE - 1)
                                 thread_set_event(virge->not_full_event);
                 }
-                virge->s3d_busy = 0;
-                virge->subsys_stat |= INT_S3D_DONE;
-                s3_virge_update_irqs(virge);
+
+                thread_lock_mutex(virge->s3d_idle_mutex);
+                virge->s3d_busy[thread] = 0;
+                for (c = 0; c < virge->render_threads; c++) {
+                        if (virge->s3d_busy[c] || !RB_EMPTY(c))
+                                idle = 0;
+                }
+                thread_unlock_mutex(virge->s3d_idle_mutex);
+
+                if (idle) {
+                        virge->subsys_stat |= INT_S3D_DONE;
+                        s3_virge_update_irqs(virge);
+                }
         }
 }
 
+static int s3_virge_rb_full(virge_t *virge) {
+        int c;
+
+        for (c = 0; c < virge->render_threads; c++) {
+                if (RB_FULL(c))
+                        return 1;
+        }
+        return 0;
+}
+
 static void queue_triangle(virge_t *virge) {
+        int c;
+
         //        pclog("queue_triangle: read=%i write=%i RB_ENTRIES=%i RB_FULL=%i\n", virge->s3d_read_idx, virge->s3d_write_idx,
         //        RB_ENTRIES, RB_FULL);
-        if (RB_FULL) {
+        while (s3_virge_rb_full(virge)) {
                 thread_reset_event(virge->not_full_event);
-                if (RB_FULL)
-                        thread_wait_event(virge->not_full_event, -1); /*Wait for room in ringbuffer*/
+                if (s3_virge_rb_full(virge))
+                        thread_wait_event(virge->not_full_event, 1); /*Wait for room in ringbuffer*/
         }
         //        pclog("                add at read=%i write=%i %i\n", virge->s3d_read_idx, virge->s3d_write_idx,
         //        virge->s3d_write_idx & RB_MASK);
         virge->s3d_buffer[virge->s3d_write_idx & RB_MASK] = virge->s3d_tri;
         virge->s3d_write_idx++;
-        if (!virge->s3d_busy)
-                thread_set_event(virge->wake_render_thread); /*Wake up render thread if moving from idle*/
+        for (c = 0; c < virge->render_threads; c++) {
+                if (!virge->s3d_busy[c])
+                        thread_set_event(virge->wake_render_thread[c]); /*Wake up render thread if moving from idle*/
+        }
+}
+
+static void s3_virge_render_init(virge_t *virge) {
+        int c;
+
+        if (virge->render_threads < 1)
+                virge->render_threads = 1;
+        if (virge->render_threads > S3D_MAX_RENDER_THREADS)
+                virge->render_threads = S3D_MAX_RENDER_THREADS;
+
+        virge->wake_main_thread = thread_create_event();
+        virge->not_full_event = thread_create_event();
+        virge->s3d_idle_mutex = thread_create_mutex();
+        for (c = 0; c < virge->render_threads; c++) {
+                virge->render_worker[c].virge = virge;
+                virge->render_worker[c].index = c;
+                virge->wake_render_thread[c] = thread_create_event();
+                virge->render_thread[c] = thread_create(render_thread, &virge->render_worker[c]);
+        }
+}
+
+static void s3_virge_render_close(virge_t *virge) {
+        int c;
+
+        for (c = 0; c < virge->render_threads; c++) {
+                thread_kill(virge->render_thread[c]);
+                thread_destroy_event(virge->wake_render_thread[c]);
+        }
+        thread_destroy_mutex(virge->s3d_idle_mutex);
+        thread_destroy_event(virge->not_full_event);
+        thread_destroy_event(virge->wake_main_thread);
 }
 
 static void s3_virge_hwcursor_draw(svga_t *svga, int displine) {
@@ -4126,10 +4399,14 @@ static void *s3_virge_init() {
 
         virge->bilinear_enabled = device_get_config_int("bilinear");
         virge->dithering_enabled = device_get_config_int("dithering");
+        virge->render_threads = device_get_config_int("render_threads");
         virge->memory_size = device_get_config_int("memory");
 
         svga_init(&virge->svga, virge, virge->memory_size << 20, s3_virge_recalctimings, s3_virge_in, s3_virge_out,
                   s3_virge_hwcursor_draw, s3_virge_overlay_draw);
+        virge->svga.overlay_deferred = 1;
+        if (device_get_config_int("lfb_direct"))
+                virge->svga.lfb_direct_mapping = &virge->linear_mapping;
 
         rom_init(&virge->bios_rom, "s3virge.bin", 0xc0000, 0x8000, 0x7fff, 0, MEM_MAPPING_EXTERNAL);
         if (PCI)
@@ -4176,10 +4453,7 @@ static void *s3_virge_init() {
 
         pci_add(s3_virge_pci_read, s3_virge_pci_write, virge);
 
-        virge->wake_render_thread = thread_create_event();
-        virge->wake_main_thread = thread_create_event();
-        virge->not_full_event = thread_create_event();
-        virge->render_thread = thread_create(render_thread, virge);
+        s3_virge_render_init(virge);
 
         virge->wake_fifo_thread = thread_create_event();
         virge->fifo_not_full_event = thread_create_event();
@@ -4199,10 +4473,14 @@ static void *s3_virge_375_init() {
 
         virge->bilinear_enabled = device_get_config_int("bilinear");
         virge->dithering_enabled = device_get_config_int("dithering");
+        virge->render_threads = device_get_config_int("render_threads");
         virge->memory_size = device_get_config_int("memory");
 
         svga_init(&virge->svga, virge, virge->memory_size << 20, s3_virge_recalctimings, s3_virge_in, s3_virge_out,
                   s3_virge_hwcursor_draw, s3_virge_overlay_draw);
+        virge->svga.overlay_deferred = 1;
+        if (device_get_config_int("lfb_direct"))
+                virge->svga.lfb_direct_mapping = &virge->linear_mapping;
         virge->svga.vblank_start = s3_virge_vblank_start;
 
         rom_init(&virge->bios_rom, "86c375_1.bin", 0xc0000, 0x8000, 0x7fff, 0, MEM_MAPPING_EXTERNAL);
@@ -4252,10 +4530,7 @@ static void *s3_virge_375_init() {
 
         virge->card = pci_add(s3_virge_pci_read, s3_virge_pci_write, virge);
 
-        virge->wake_render_thread = thread_create_event();
-        virge->wake_main_thread = thread_create_event();
-        virge->not_full_event = thread_create_event();
-        virge->render_thread = thread_create(render_thread, virge);
+        s3_virge_render_init(virge);
 
         virge->wake_fifo_thread = thread_create_event();
         virge->fifo_not_full_event = thread_create_event();
@@ -4277,10 +4552,7 @@ static void s3_virge_close(void *p) {
         fclose(f);
 #endif
 
-        thread_kill(virge->render_thread);
-        thread_destroy_event(virge->not_full_event);
-        thread_destroy_event(virge->wake_main_thread);
-        thread_destroy_event(virge->wake_render_thread);
+        s3_virge_render_close(virge);
 
         thread_kill(virge->fifo_thread);
         thread_destroy_event(virge->wake_fifo_thread);
@@ -4312,18 +4584,24 @@ static void s3_virge_add_status_info(char *s, int max_len, void *p) {
         char temps[256];
         uint64_t new_time = timer_read();
         uint64_t status_diff = new_time - status_time;
+        int pixel_count = 0;
+        int c;
         status_time = new_time;
 
         if (!status_diff)
                 status_diff = 1;
 
         svga_add_status_info(s, max_len, &virge->svga);
+        for (c = 0; c < virge->render_threads; c++) {
+                pixel_count += virge->pixel_count[c];
+                virge->pixel_count[c] = 0;
+        }
         sprintf(temps, "%f Mpixels/sec\n%f ktris/sec\n%f%% CPU\n%f%% CPU (real)\n%d writes %i reads\n\n",
-                (double)virge->pixel_count / 1000000.0, (double)virge->tri_count / 1000.0,
+                (double)pixel_count / 1000000.0, (double)virge->tri_count / 1000.0,
                 ((double)virge_time * 100.0) / timer_freq, ((double)virge_time * 100.0) / status_diff, reg_writes, reg_reads);
         strncat(s, temps, max_len);
 
-        virge->pixel_count = virge->tri_count = 0;
+        virge->tri_count = 0;
         virge_time = 0;
         reg_reads = 0;
         reg_writes = 0;
@@ -4337,6 +4615,15 @@ static device_config_t s3_virge_config[] = {
          .default_int = 4},
         {.name = "bilinear", .description = "Bilinear filtering", .type = CONFIG_BINARY, .default_int = 1},
         {.name = "dithering", .description = "Dithering", .type = CONFIG_BINARY, .default_int = 1},
+        {.name = "render_threads",
+         .description = "Render threads",
+         .type = CONFIG_SELECTION,
+         .selection = {{.description = "1", .value = 1},
+                       {.description = "2", .value = 2},
+                       {.description = "4", .value = 4},
+                       {.description = ""}},
+         .default_int = 1},
+        {.name = "lfb_direct", .description = "Direct linear framebuffer writes", .type = CONFIG_BINARY, .default_int = 0},
         {.type = -1}};
 
 device_t s3_virge_device = {"Diamond Stealth 3D 2000 (S3 ViRGE)",
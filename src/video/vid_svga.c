@@ -109,6 +109,7 @@ void svga_out(uint16_t addr, uint8_t val, void *p) {
                         svga->chain4 = val & 8;
                         svga->fast = (svga->gdcreg[8] == 0xff && !(svga->gdcreg[3] & 0x18) && !svga->gdcreg[1]) &&
                                      ((svga->chain4 && svga->packed_chain4) || svga->fb_only);
+                        svga_lfb_flush_direct(svga);
                         break;
                 }
                 break;
@@ -199,8 +200,10 @@ void svga_out(uint16_t addr, uint8_t val, void *p) {
                         break;
                 }
                 svga->gdcreg[svga->gdcaddr & 15] = val;
+                svga_recalc_write_state(svga);
                 svga->fast = (svga->gdcreg[8] == 0xff && !(svga->gdcreg[3] & 0x18) && !svga->gdcreg[1]) &&
                              ((svga->chain4 && svga->packed_chain4) || svga->fb_only);
+                svga_lfb_flush_direct(svga);
                 if (((svga->gdcaddr & 15) == 5 && (val ^ o) & 0x70) || ((svga->gdcaddr & 15) == 6 && (val ^ o) & 1))
                         svga_recalctimings(svga);
                 break;
@@ -451,6 +454,7 @@ void svga_recalctimings(svga_t *svga) {
                 svga->dispofftime = TIMER_USEC;
 
         svga_recalc_remap_func(svga);
+        svga_lfb_flush_direct(svga);
         /*        printf("SVGA horiz total %i display end %i vidclock %f\n",svga->crtc[0],svga->crtc[1],svga->clock);
                 printf("SVGA vert total %i display end %i max row %i vsync
            %i\n",svga->vtotal,svga->dispend,(svga->crtc[9]&31)+1,svga->vsyncstart); printf("total %f on %i cycles off %i cycles
@@ -461,6 +465,112 @@ void svga_recalctimings(svga_t *svga) {
 }
 
 extern int cyc_total;
+static void svga_layers_record(svga_t *svga) {
+        svga_layer_line_t *line;
+
+        if (svga->nr_layer_lines >= SVGA_MAX_LAYER_LINES)
+                return;
+
+        line = &svga->layer_lines[svga->nr_layer_lines++];
+        line->displine = svga->displine;
+        line->hwcursor = svga->hwcursor_on ? 1 : 0;
+        line->hwcursor_oddeven = svga->hwcursor_oddeven;
+        line->overlay = (svga->overlay_on && svga->overlay_deferred) ? 1 : 0;
+        line->overlay_oddeven = svga->overlay_oddeven;
+}
+
+/*Draw the recorded layers over buffer32, saving what they cover first, and extend the
+  blit to cover them and the lines restored at the start of this frame*/
+static void svga_layers_composite(svga_t *svga) {
+        int save_size = 0;
+        int c;
+
+        for (c = 0; c < svga->nr_layer_lines; c++) {
+                svga_layer_line_t *line = &svga->layer_lines[c];
+                int x_start = buffer32->w, x_end = 0;
+
+                /*Cursor drawers plot at most 64 pixels (zoomed up to 2x) at or near hwcursor_latch.x + 32*/
+                if (line->hwcursor) {
+                        x_start = svga->hwcursor_latch.x - 32;
+                        x_end = svga->hwcursor_latch.x + 32 + 128;
+                }
+                /*Overlays may run to the right hand edge of the display*/
+                if (line->overlay) {
+                        if (svga->overlay_latch.x < x_start)
+                                x_start = svga->overlay_latch.x;
+                        if (svga->hdisp + 64 + 32 > x_end)
+                                x_end = svga->hdisp + 64 + 32;
+                }
+                if (x_start < 0)
+                        x_start = 0;
+                if (x_end > buffer32->w)
+                        x_end = buffer32->w;
+
+                line->x = x_start;
+                line->w = (x_end > x_start) ? (x_end - x_start) : 0;
+                line->save_offset = save_size;
+                save_size += line->w;
+        }
+
+        if (save_size > svga->layer_save_size) {
+                svga->layer_save = realloc(svga->layer_save, save_size * sizeof(uint32_t));
+                svga->layer_save_size = save_size;
+        }
+
+        for (c = 0; c < svga->nr_layer_lines; c++) {
+                svga_layer_line_t *line = &svga->layer_lines[c];
+
+                memcpy(&svga->layer_save[line->save_offset], &((uint32_t *)buffer32->line[line->displine])[line->x],
+                       line->w * sizeof(uint32_t));
+
+                if (line->overlay) {
+                        svga->overlay_oddeven = line->overlay_oddeven;
+                        svga->overlay_draw(svga, line->displine);
+                }
+                if (line->hwcursor) {
+                        svga->hwcursor_oddeven = line->hwcursor_oddeven;
+                        svga->hwcursor_draw(svga, line->displine);
+                }
+
+                if (line->displine < svga->firstline_draw)
+                        svga->firstline_draw = line->displine;
+                if (line->displine > svga->lastline_draw)
+                        svga->lastline_draw = line->displine;
+        }
+        svga->layers_saved = 1;
+
+        if (svga->layer_restored_first <= svga->layer_restored_last) {
+                if (svga->layer_restored_first < svga->firstline_draw)
+                        svga->firstline_draw = svga->layer_restored_first;
+                if (svga->layer_restored_last > svga->lastline_draw)
+                        svga->lastline_draw = svga->layer_restored_last;
+        }
+        svga->layer_restored_first = 2000;
+        svga->layer_restored_last = 0;
+}
+
+/*Put back the pixels saved by svga_layers_composite(). Must only be called once the blit
+  thread has finished with buffer32*/
+static void svga_layers_restore(svga_t *svga) {
+        int c;
+
+        if (svga->layers_saved && !svga->override) {
+                for (c = 0; c < svga->nr_layer_lines; c++) {
+                        svga_layer_line_t *line = &svga->layer_lines[c];
+
+                        memcpy(&((uint32_t *)buffer32->line[line->displine])[line->x], &svga->layer_save[line->save_offset],
+                               line->w * sizeof(uint32_t));
+
+                        if (line->displine < svga->layer_restored_first)
+                                svga->layer_restored_first = line->displine;
+                        if (line->displine > svga->layer_restored_last)
+                                svga->layer_restored_last = line->displine;
+                }
+        }
+        svga->layers_saved = 0;
+        svga->nr_layer_lines = 0;
+}
+
 void svga_poll(void *p) {
         svga_t *svga = (svga_t *)p;
         int x;
@@ -502,17 +612,23 @@ void svga_poll(void *p) {
                         if (svga->firstline == 2000) {
                                 svga->firstline = svga->displine;
                                 video_wait_for_buffer();
+                                svga_layers_restore(svga);
                         }
 
-                        if (svga->hwcursor_on || svga->overlay_on)
+                        if (svga->overlay_on && !svga->overlay_deferred)
                                 svga->changedvram[svga->ma >> 12] = svga->changedvram[(svga->ma >> 12) + 1] =
                                         svga->interlace ? 3 : 2;
 
+                        uint64_t start_time = timer_read();
+
                         if (!svga->override)
                                 svga->render(svga);
 
+                        if ((svga->hwcursor_on || (svga->overlay_on && svga->overlay_deferred)) && !svga->override)
+                                svga_layers_record(svga);
+
                         if (svga->overlay_on) {
-                                if (!svga->override)
+                                if (!svga->override && !svga->overlay_deferred)
                                         svga->overlay_draw(svga, svga->displine);
                                 svga->overlay_on--;
                                 if (svga->overlay_on && svga->interlace)
@@ -520,13 +636,14 @@ void svga_poll(void *p) {
                         }
 
                         if (svga->hwcursor_on) {
-                                if (!svga->override)
-                                        svga->hwcursor_draw(svga, svga->displine);
                                 svga->hwcursor_on--;
                                 if (svga->hwcursor_on && svga->interlace)
                                         svga->hwcursor_on--;
                         }
 
+                        video_stats.render_time += timer_read() - start_time;
+                        video_stats.render_lines++;
+
                         if (svga->lastline < svga->displine)
                                 svga->lastline = svga->displine;
                 }
@@ -623,6 +740,10 @@ void svga_poll(void *p) {
                                 }
                         }
                         //                        memset(changedvram,0,2048);
+                        /*Catch the first write to each page again next frame*/
+                        svga_lfb_flush_direct(svga);
+                        if (svga->text_changed)
+                                svga->text_changed--;
                         if (svga->fullchange) {
                                 svga->fullchange--;
                                 viewer_update(&viewer_palette, svga);
@@ -648,8 +769,10 @@ void svga_poll(void *p) {
                         wx = x;
                         wy = svga->lastline - svga->firstline;
 
-                        if (!svga->override)
+                        if (!svga->override) {
+                                svga_layers_composite(svga);
                                 svga_doblit(svga->firstline_draw, svga->lastline_draw + 1, wx, wy, svga);
+                        }
 
                         readflash = 0;
 
@@ -763,6 +886,7 @@ int svga_init(svga_t *svga, void *p, int memsize, void (*recalctimings_ex)(struc
                 }
         }
         svga->readmode = 0;
+        svga_recalc_write_state(svga);
 
         svga->crtc[0] = 63;
         svga->crtc[6] = 255;
@@ -775,6 +899,9 @@ int svga_init(svga_t *svga, void *p, int memsize, void (*recalctimings_ex)(struc
         svga->vram_mask = memsize - 1;
         svga->decode_mask = 0x7fffff;
         svga->changedvram = malloc(/*(memsize >> 12) << 1*/ 0x1000000 >> 12);
+        text_cache_init(&svga->text_cache, 2048);
+        svga->layer_lines = malloc(SVGA_MAX_LAYER_LINES * sizeof(svga_layer_line_t));
+        svga->layer_restored_first = 2000;
         svga->recalctimings_ex = recalctimings_ex;
         svga->video_in = video_in;
         svga->video_out = video_out;
@@ -802,15 +929,98 @@ int svga_init(svga_t *svga, void *p, int memsize, void (*recalctimings_ex)(struc
 }
 
 void svga_close(svga_t *svga) {
+        svga_lfb_flush_direct(svga);
+        text_cache_close(&svga->text_cache);
+        free(svga->layer_lines);
+        free(svga->layer_save);
         free(svga->changedvram);
         free(svga->vram);
 
         svga_pri = NULL;
 }
 
-void svga_write(uint32_t addr, uint8_t val, void *p) {
+/*Expands the low 4 bits of the index to one byte per plane*/
+static const uint32_t svga_plane_expand[16] = {0x00000000, 0x000000ff, 0x0000ff00, 0x0000ffff, 0x00ff0000, 0x00ff00ff,
+                                               0x00ffff00, 0x00ffffff, 0xff000000, 0xff0000ff, 0xff00ff00, 0xff00ffff,
+                                               0xffff0000, 0xffff00ff, 0xffffff00, 0xffffffff};
+
+void svga_recalc_write_state(svga_t *svga) {
+        svga->write_bitmask = svga->gdcreg[8] * 0x01010101;
+        svga->write_sr_value = svga_plane_expand[svga->gdcreg[0] & 0xf];
+        svga->write_rotate = svga->gdcreg[3] & 7;
+        svga->write_op = svga->gdcreg[3] & 0x18;
+        /*set_reset_disabled only takes effect when write mode 0 would otherwise be a
+          plain copy of the CPU data*/
+        if (svga->gdcreg[8] == 0xff && !(svga->gdcreg[3] & 0x18) && svga->set_reset_disabled)
+                svga->write_sr_enable = 0;
+        else
+                svga->write_sr_enable = svga_plane_expand[svga->gdcreg[1] & 0xf];
+}
+
+/*Rotate each byte of val right by rotate bits*/
+static inline uint32_t svga_rotate_planes(uint32_t val, int rotate) {
+        if (!rotate)
+                return val;
+        return ((val >> rotate) & ((0xff >> rotate) * 0x01010101)) |
+               ((val << (8 - rotate)) & (((0xff << (8 - rotate)) & 0xff) * 0x01010101));
+}
+
+/*Write to one planar VRAM dword through the GDC. val holds the CPU data for each
+  plane, and writemask2 the planes to be written*/
+static inline void svga_write_planes(svga_t *svga, uint32_t addr, uint32_t val, int writemask2) {
+        uint32_t *vram = (uint32_t *)&svga->vram[addr];
+        uint32_t latch = svga->la | (svga->lb << 8) | (svga->lc << 16) | ((uint32_t)svga->ld << 24);
+        uint32_t mask = svga_plane_expand[writemask2 & 0xf];
+        uint32_t bitmask = svga->write_bitmask;
+        uint32_t out;
+
+        if (!(svga->gdcreg[6] & 1)) {
+                /*Text mode. Character and attribute writes only need the text lines that
+                  changed redrawn, font writes need everything redrawn*/
+                if (writemask2 & 0xc)
+                        svga->fullchange = 2;
+                else
+                        svga->text_changed = 2;
+        }
+
+        switch (svga->writemode) {
+        case 0:
+                val = svga_rotate_planes(val, svga->write_rotate);
+                val = (val & ~svga->write_sr_enable) | (svga->write_sr_value & svga->write_sr_enable);
+                break;
+        case 1:
+                *vram = (*vram & ~mask) | (latch & mask);
+                return;
+        case 2:
+                val = svga_plane_expand[(val & 1) | ((val >> 8) & 2) | ((val >> 16) & 4) | ((val >> 24) & 8)];
+                break;
+        case 3:
+                bitmask &= svga_rotate_planes(val, svga->write_rotate);
+                val = svga->write_sr_value;
+                break;
+        default:
+                return;
+        }
+
+        switch (svga->write_op) {
+        case 0: /*Set*/
+                out = (val & bitmask) | (latch & ~bitmask);
+                break;
+        case 8: /*AND*/
+                out = (val | ~bitmask) & latch;
+                break;
+        case 0x10: /*OR*/
+                out = (val & bitmask) | latch;
+                break;
+        default: /*XOR*/
+                out = (val & bitmask) ^ latch;
+                break;
+        }
+        *vram = (*vram & ~mask) | (out & mask);
+}
+
+static void svga_write_common(uint32_t addr, uint8_t val, void *p) {
         svga_t *svga = (svga_t *)p;
-        uint8_t vala, valb, valc, vald, wm = svga->writemask;
         int writemask2 = svga->writemask;
 
         egawrites++;
@@ -823,8 +1033,6 @@ void svga_write(uint32_t addr, uint8_t val, void *p) {
         addr &= svga->banked_mask;
         addr += svga->write_bank;
 
-        if (!(svga->gdcreg[6] & 1))
-                svga->fullchange = 2;
         if ((svga->chain4 && svga->packed_chain4) || svga->fb_only) {
                 writemask2 = 1 << (addr & 3);
                 addr &= ~3;
@@ -853,213 +1061,10 @@ void svga_write(uint32_t addr, uint8_t val, void *p) {
                       svga->chain4, svga->gdcreg[8]);
         svga->changedvram[addr >> 12] = changeframecount;
 
-        switch (svga->writemode) {
-        case 1:
-                if (writemask2 & 1)
-                        svga->vram[addr] = svga->la;
-                if (writemask2 & 2)
-                        svga->vram[addr | 0x1] = svga->lb;
-                if (writemask2 & 4)
-                        svga->vram[addr | 0x2] = svga->lc;
-                if (writemask2 & 8)
-                        svga->vram[addr | 0x3] = svga->ld;
-                break;
-        case 0:
-                if (svga->gdcreg[3] & 7)
-                        val = svga_rotate[svga->gdcreg[3] & 7][val];
-                if (svga->gdcreg[8] == 0xff && !(svga->gdcreg[3] & 0x18) && (!svga->gdcreg[1] || svga->set_reset_disabled)) {
-                        if (writemask2 & 1)
-                                svga->vram[addr] = val;
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = val;
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = val;
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = val;
-                } else {
-                        if (svga->gdcreg[1] & 1)
-                                vala = (svga->gdcreg[0] & 1) ? 0xff : 0;
-                        else
-                                vala = val;
-                        if (svga->gdcreg[1] & 2)
-                                valb = (svga->gdcreg[0] & 2) ? 0xff : 0;
-                        else
-                                valb = val;
-                        if (svga->gdcreg[1] & 4)
-                                valc = (svga->gdcreg[0] & 4) ? 0xff : 0;
-                        else
-                                valc = val;
-                        if (svga->gdcreg[1] & 8)
-                                vald = (svga->gdcreg[0] & 8) ? 0xff : 0;
-                        else
-                                vald = val;
-
-                        switch (svga->gdcreg[3] & 0x18) {
-                        case 0: /*Set*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) | (svga->la & ~svga->gdcreg[8]);
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | (svga->lb & ~svga->gdcreg[8]);
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | (svga->lc & ~svga->gdcreg[8]);
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | (svga->ld & ~svga->gdcreg[8]);
-                                break;
-                        case 8: /*AND*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala | ~svga->gdcreg[8]) & svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb | ~svga->gdcreg[8]) & svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc | ~svga->gdcreg[8]) & svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald | ~svga->gdcreg[8]) & svga->ld;
-                                break;
-                        case 0x10: /*OR*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) | svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | svga->ld;
-                                break;
-                        case 0x18: /*XOR*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) ^ svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) ^ svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) ^ svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) ^ svga->ld;
-                                break;
-                        }
-                        //                        pclog("- %02X %02X %02X %02X
-                        //                        %08X\n",vram[addr],vram[addr|0x1],vram[addr|0x2],vram[addr|0x3],addr);
-                }
-                break;
-        case 2:
-                if (!(svga->gdcreg[3] & 0x18) && (!svga->gdcreg[1] || svga->set_reset_disabled)) {
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (((val & 1) ? 0xff : 0) & svga->gdcreg[8]) | (svga->la & ~svga->gdcreg[8]);
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] =
-                                        (((val & 2) ? 0xff : 0) & svga->gdcreg[8]) | (svga->lb & ~svga->gdcreg[8]);
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] =
-                                        (((val & 4) ? 0xff : 0) & svga->gdcreg[8]) | (svga->lc & ~svga->gdcreg[8]);
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] =
-                                        (((val & 8) ? 0xff : 0) & svga->gdcreg[8]) | (svga->ld & ~svga->gdcreg[8]);
-                } else {
-                        vala = ((val & 1) ? 0xff : 0);
-                        valb = ((val & 2) ? 0xff : 0);
-                        valc = ((val & 4) ? 0xff : 0);
-                        vald = ((val & 8) ? 0xff : 0);
-                        switch (svga->gdcreg[3] & 0x18) {
-                        case 0: /*Set*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) | (svga->la & ~svga->gdcreg[8]);
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | (svga->lb & ~svga->gdcreg[8]);
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | (svga->lc & ~svga->gdcreg[8]);
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | (svga->ld & ~svga->gdcreg[8]);
-                                break;
-                        case 8: /*AND*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala | ~svga->gdcreg[8]) & svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb | ~svga->gdcreg[8]) & svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc | ~svga->gdcreg[8]) & svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald | ~svga->gdcreg[8]) & svga->ld;
-                                break;
-                        case 0x10: /*OR*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) | svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | svga->ld;
-                                break;
-                        case 0x18: /*XOR*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) ^ svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) ^ svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) ^ svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) ^ svga->ld;
-                                break;
-                        }
-                }
-                break;
-        case 3:
-                if (svga->gdcreg[3] & 7)
-                        val = svga_rotate[svga->gdcreg[3] & 7][val];
-                wm = svga->gdcreg[8];
-                svga->gdcreg[8] &= val;
-
-                vala = (svga->gdcreg[0] & 1) ? 0xff : 0;
-                valb = (svga->gdcreg[0] & 2) ? 0xff : 0;
-                valc = (svga->gdcreg[0] & 4) ? 0xff : 0;
-                vald = (svga->gdcreg[0] & 8) ? 0xff : 0;
-                switch (svga->gdcreg[3] & 0x18) {
-                case 0: /*Set*/
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (vala & svga->gdcreg[8]) | (svga->la & ~svga->gdcreg[8]);
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | (svga->lb & ~svga->gdcreg[8]);
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | (svga->lc & ~svga->gdcreg[8]);
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | (svga->ld & ~svga->gdcreg[8]);
-                        break;
-                case 8: /*AND*/
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (vala | ~svga->gdcreg[8]) & svga->la;
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = (valb | ~svga->gdcreg[8]) & svga->lb;
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = (valc | ~svga->gdcreg[8]) & svga->lc;
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = (vald | ~svga->gdcreg[8]) & svga->ld;
-                        break;
-                case 0x10: /*OR*/
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (vala & svga->gdcreg[8]) | svga->la;
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | svga->lb;
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | svga->lc;
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | svga->ld;
-                        break;
-                case 0x18: /*XOR*/
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (vala & svga->gdcreg[8]) ^ svga->la;
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) ^ svga->lb;
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) ^ svga->lc;
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) ^ svga->ld;
-                        break;
-                }
-                svga->gdcreg[8] = wm;
-                break;
-        }
+        svga_write_planes(svga, addr, val * 0x01010101, writemask2);
 }
 
-uint8_t svga_read(uint32_t addr, void *p) {
+static uint8_t svga_read_common(uint32_t addr, void *p) {
         svga_t *svga = (svga_t *)p;
         uint8_t temp, temp2, temp3, temp4;
         uint32_t latch_addr;
@@ -1134,10 +1139,33 @@ uint8_t svga_read(uint32_t addr, void *p) {
         return svga->vram[addr | readplane];
 }
 
-void svga_write_linear(uint32_t addr, uint8_t val, void *p) {
+/*Called by LFB write handlers after a write that was a plain store to VRAM. addr is the physical
+  address written, vram_addr where it landed in VRAM*/
+void svga_lfb_map_direct(svga_t *svga, uint32_t addr, uint32_t vram_addr) {
+        mem_mapping_t *mapping = svga->lfb_direct_mapping;
+
+        if (!mapping->enable || (addr & ~0xfff) < mapping->base || (addr | 0xfff) - mapping->base >= mapping->size)
+                return;
+        vram_addr &= ~0xfff;
+        if (vram_addr + 0x1000 > svga->vram_max)
+                return;
+
+        addwritelookup_ptr(mem_logical_addr, &svga->vram[vram_addr]);
+        svga->lfb_direct_mapped = 1;
+}
+
+/*Take any directly mapped VRAM pages back out of the write TLB*/
+void svga_lfb_flush_direct(svga_t *svga) {
+        if (svga->lfb_direct_mapped) {
+                mem_flush_write_ptr_range(svga->vram, svga->vram_mask + 1);
+                svga->lfb_direct_mapped = 0;
+        }
+}
+
+static void svga_write_linear_common(uint32_t addr, uint8_t val, void *p) {
         svga_t *svga = (svga_t *)p;
-        uint8_t vala, valb, valc, vald, wm = svga->writemask;
         int writemask2 = svga->writemask;
+        uint32_t phys_addr = addr;
 
         cycles -= video_timing_write_b;
         cycles_lost += video_timing_write_b;
@@ -1146,8 +1174,6 @@ void svga_write_linear(uint32_t addr, uint8_t val, void *p) {
 
         if (svga_output)
                 pclog("Write LFB %08X %02X ", addr, val);
-        if (!(svga->gdcreg[6] & 1))
-                svga->fullchange = 2;
         if ((svga->chain4 && svga->packed_chain4) || svga->fb_only) {
                 writemask2 = 1 << (addr & 3);
                 addr &= ~3;
@@ -1171,213 +1197,13 @@ void svga_write_linear(uint32_t addr, uint8_t val, void *p) {
                 pclog("%08X\n", addr);
         svga->changedvram[addr >> 12] = changeframecount;
 
-        switch (svga->writemode) {
-        case 1:
-                if (writemask2 & 1)
-                        svga->vram[addr] = svga->la;
-                if (writemask2 & 2)
-                        svga->vram[addr | 0x1] = svga->lb;
-                if (writemask2 & 4)
-                        svga->vram[addr | 0x2] = svga->lc;
-                if (writemask2 & 8)
-                        svga->vram[addr | 0x3] = svga->ld;
-                break;
-        case 0:
-                if (svga->gdcreg[3] & 7)
-                        val = svga_rotate[svga->gdcreg[3] & 7][val];
-                if (svga->gdcreg[8] == 0xff && !(svga->gdcreg[3] & 0x18) && (!svga->gdcreg[1] || svga->set_reset_disabled)) {
-                        if (writemask2 & 1)
-                                svga->vram[addr] = val;
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = val;
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = val;
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = val;
-                } else {
-                        if (svga->gdcreg[1] & 1)
-                                vala = (svga->gdcreg[0] & 1) ? 0xff : 0;
-                        else
-                                vala = val;
-                        if (svga->gdcreg[1] & 2)
-                                valb = (svga->gdcreg[0] & 2) ? 0xff : 0;
-                        else
-                                valb = val;
-                        if (svga->gdcreg[1] & 4)
-                                valc = (svga->gdcreg[0] & 4) ? 0xff : 0;
-                        else
-                                valc = val;
-                        if (svga->gdcreg[1] & 8)
-                                vald = (svga->gdcreg[0] & 8) ? 0xff : 0;
-                        else
-                                vald = val;
-
-                        switch (svga->gdcreg[3] & 0x18) {
-                        case 0: /*Set*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) | (svga->la & ~svga->gdcreg[8]);
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | (svga->lb & ~svga->gdcreg[8]);
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | (svga->lc & ~svga->gdcreg[8]);
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | (svga->ld & ~svga->gdcreg[8]);
-                                break;
-                        case 8: /*AND*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala | ~svga->gdcreg[8]) & svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb | ~svga->gdcreg[8]) & svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc | ~svga->gdcreg[8]) & svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald | ~svga->gdcreg[8]) & svga->ld;
-                                break;
-                        case 0x10: /*OR*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) | svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | svga->ld;
-                                break;
-                        case 0x18: /*XOR*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) ^ svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) ^ svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) ^ svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) ^ svga->ld;
-                                break;
-                        }
-                        //                        pclog("- %02X %02X %02X %02X
-                        //                        %08X\n",vram[addr],vram[addr|0x1],vram[addr|0x2],vram[addr|0x3],addr);
-                }
-                break;
-        case 2:
-                if (!(svga->gdcreg[3] & 0x18) && (!svga->gdcreg[1] || svga->set_reset_disabled)) {
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (((val & 1) ? 0xff : 0) & svga->gdcreg[8]) | (svga->la & ~svga->gdcreg[8]);
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] =
-                                        (((val & 2) ? 0xff : 0) & svga->gdcreg[8]) | (svga->lb & ~svga->gdcreg[8]);
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] =
-                                        (((val & 4) ? 0xff : 0) & svga->gdcreg[8]) | (svga->lc & ~svga->gdcreg[8]);
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] =
-                                        (((val & 8) ? 0xff : 0) & svga->gdcreg[8]) | (svga->ld & ~svga->gdcreg[8]);
-                } else {
-                        vala = ((val & 1) ? 0xff : 0);
-                        valb = ((val & 2) ? 0xff : 0);
-                        valc = ((val & 4) ? 0xff : 0);
-                        vald = ((val & 8) ? 0xff : 0);
-                        switch (svga->gdcreg[3] & 0x18) {
-                        case 0: /*Set*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) | (svga->la & ~svga->gdcreg[8]);
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | (svga->lb & ~svga->gdcreg[8]);
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | (svga->lc & ~svga->gdcreg[8]);
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | (svga->ld & ~svga->gdcreg[8]);
-                                break;
-                        case 8: /*AND*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala | ~svga->gdcreg[8]) & svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb | ~svga->gdcreg[8]) & svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc | ~svga->gdcreg[8]) & svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald | ~svga->gdcreg[8]) & svga->ld;
-                                break;
-                        case 0x10: /*OR*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) | svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | svga->ld;
-                                break;
-                        case 0x18: /*XOR*/
-                                if (writemask2 & 1)
-                                        svga->vram[addr] = (vala & svga->gdcreg[8]) ^ svga->la;
-                                if (writemask2 & 2)
-                                        svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) ^ svga->lb;
-                                if (writemask2 & 4)
-                                        svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) ^ svga->lc;
-                                if (writemask2 & 8)
-                                        svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) ^ svga->ld;
-                                break;
-                        }
-                }
-                break;
-        case 3:
-                if (svga->gdcreg[3] & 7)
-                        val = svga_rotate[svga->gdcreg[3] & 7][val];
-                wm = svga->gdcreg[8];
-                svga->gdcreg[8] &= val;
-
-                vala = (svga->gdcreg[0] & 1) ? 0xff : 0;
-                valb = (svga->gdcreg[0] & 2) ? 0xff : 0;
-                valc = (svga->gdcreg[0] & 4) ? 0xff : 0;
-                vald = (svga->gdcreg[0] & 8) ? 0xff : 0;
-                switch (svga->gdcreg[3] & 0x18) {
-                case 0: /*Set*/
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (vala & svga->gdcreg[8]) | (svga->la & ~svga->gdcreg[8]);
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | (svga->lb & ~svga->gdcreg[8]);
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | (svga->lc & ~svga->gdcreg[8]);
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | (svga->ld & ~svga->gdcreg[8]);
-                        break;
-                case 8: /*AND*/
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (vala | ~svga->gdcreg[8]) & svga->la;
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = (valb | ~svga->gdcreg[8]) & svga->lb;
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = (valc | ~svga->gdcreg[8]) & svga->lc;
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = (vald | ~svga->gdcreg[8]) & svga->ld;
-                        break;
-                case 0x10: /*OR*/
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (vala & svga->gdcreg[8]) | svga->la;
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) | svga->lb;
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) | svga->lc;
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) | svga->ld;
-                        break;
-                case 0x18: /*XOR*/
-                        if (writemask2 & 1)
-                                svga->vram[addr] = (vala & svga->gdcreg[8]) ^ svga->la;
-                        if (writemask2 & 2)
-                                svga->vram[addr | 0x1] = (valb & svga->gdcreg[8]) ^ svga->lb;
-                        if (writemask2 & 4)
-                                svga->vram[addr | 0x2] = (valc & svga->gdcreg[8]) ^ svga->lc;
-                        if (writemask2 & 8)
-                                svga->vram[addr | 0x3] = (vald & svga->gdcreg[8]) ^ svga->ld;
-                        break;
-                }
-                svga->gdcreg[8] = wm;
-                break;
-        }
+        svga_write_planes(svga, addr, val * 0x01010101, writemask2);
+
+        if (svga->lfb_direct_mapping && svga->fast)
+                svga_lfb_map_direct(svga, phys_addr, addr);
 }
 
-uint8_t svga_read_linear(uint32_t addr, void *p) {
+static uint8_t svga_read_linear_common(uint32_t addr, void *p) {
         svga_t *svga = (svga_t *)p;
         uint8_t temp, temp2, temp3, temp4;
         int readplane = svga->readplane;
@@ -1471,11 +1297,59 @@ void svga_doblit(int y1, int y2, int wx, int wy, svga_t *svga) {
         //        pclog("svga_doblit end\n");
 }
 
-void svga_writew(uint32_t addr, uint16_t val, void *p) {
+/*Word and dword writes in modes that go through the GDC. Chain-4 writes within one
+  planar dword are done as a single write, and planar writes without decoding the
+  address for every byte. Anything else is split into byte writes.*/
+static void svga_write_gdc_multi(svga_t *svga, uint32_t addr, uint32_t val, int len, int linear) {
+        uint32_t bank_addr = linear ? addr : ((addr & svga->banked_mask) + svga->write_bank);
+        int chain4 = svga->chain4 || svga->fb_only;
+        int c;
+
+        if ((chain4 && ((bank_addr & 3) + len) > 4) || (!chain4 && svga->chain2_write) ||
+            (!chain4 && !linear && ((addr & svga->banked_mask) + len - 1) > svga->banked_mask)) {
+                for (c = 0; c < len; c++) {
+                        if (linear)
+                                svga_write_linear_common(addr + c, val >> (c * 8), svga);
+                        else
+                                svga_write_common(addr + c, val >> (c * 8), svga);
+                }
+                return;
+        }
+
+        egawrites += len;
+
+        cycles -= video_timing_write_b * len;
+        cycles_lost += video_timing_write_b * len;
+
+
+        if (chain4) {
+                int shift = bank_addr & 3;
+
+                addr = bank_addr & ~3;
+                if (!(svga->chain4 && svga->packed_chain4) && !svga->fb_only)
+                        addr = ((addr & 0xfffc) << 2) | ((addr & 0x30000) >> 14) | (addr & ~0x3ffff);
+                addr &= svga->decode_mask;
+                if (addr >= svga->vram_max)
+                        return;
+                addr &= svga->vram_mask;
+                svga->changedvram[addr >> 12] = changeframecount;
+                svga_write_planes(svga, addr, val << (shift * 8), ((1 << len) - 1) << shift);
+        } else {
+                for (c = 0; c < len; c++) {
+                        addr = ((bank_addr + c) << 2) & svga->decode_mask;
+                        if (addr >= svga->vram_max)
+                                continue;
+                        addr &= svga->vram_mask;
+                        svga->changedvram[addr >> 12] = changeframecount;
+                        svga_write_planes(svga, addr, ((val >> (c * 8)) & 0xff) * 0x01010101, svga->writemask);
+                }
+        }
+}
+
+static void svga_writew_common(uint32_t addr, uint16_t val, void *p) {
         svga_t *svga = (svga_t *)p;
         if (!svga->fast) {
-                svga_write(addr, val, p);
-                svga_write(addr + 1, val >> 8, p);
+                svga_write_gdc_multi(svga, addr, val, 2, 0);
                 return;
         }
 
@@ -1497,14 +1371,11 @@ void svga_writew(uint32_t addr, uint16_t val, void *p) {
         *(uint16_t *)&svga->vram[addr] = val;
 }
 
-void svga_writel(uint32_t addr, uint32_t val, void *p) {
+static void svga_writel_common(uint32_t addr, uint32_t val, void *p) {
         svga_t *svga = (svga_t *)p;
 
         if (!svga->fast) {
-                svga_write(addr, val, p);
-                svga_write(addr + 1, val >> 8, p);
-                svga_write(addr + 2, val >> 16, p);
-                svga_write(addr + 3, val >> 24, p);
+                svga_write_gdc_multi(svga, addr, val, 4, 0);
                 return;
         }
 
@@ -1527,11 +1398,11 @@ void svga_writel(uint32_t addr, uint32_t val, void *p) {
         *(uint32_t *)&svga->vram[addr] = val;
 }
 
-uint16_t svga_readw(uint32_t addr, void *p) {
+static uint16_t svga_readw_common(uint32_t addr, void *p) {
         svga_t *svga = (svga_t *)p;
 
         if (!svga->fast)
-                return svga_read(addr, p) | (svga_read(addr + 1, p) << 8);
+                return svga_read_common(addr, p) | (svga_read_common(addr + 1, p) << 8);
 
         egareads += 2;
 
@@ -1548,12 +1419,12 @@ uint16_t svga_readw(uint32_t addr, void *p) {
         return *(uint16_t *)&svga->vram[addr & svga->vram_mask];
 }
 
-uint32_t svga_readl(uint32_t addr, void *p) {
+static uint32_t svga_readl_common(uint32_t addr, void *p) {
         svga_t *svga = (svga_t *)p;
 
         if (!svga->fast)
-                return svga_read(addr, p) | (svga_read(addr + 1, p) << 8) | (svga_read(addr + 2, p) << 16) |
-                       (svga_read(addr + 3, p) << 24);
+                return svga_read_common(addr, p) | (svga_read_common(addr + 1, p) << 8) | (svga_read_common(addr + 2, p) << 16) |
+                       (svga_read_common(addr + 3, p) << 24);
 
         egareads += 4;
 
@@ -1570,12 +1441,12 @@ uint32_t svga_readl(uint32_t addr, void *p) {
         return *(uint32_t *)&svga->vram[addr & svga->vram_mask];
 }
 
-void svga_writew_linear(uint32_t addr, uint16_t val, void *p) {
+static void svga_writew_linear_common(uint32_t addr, uint16_t val, void *p) {
         svga_t *svga = (svga_t *)p;
+        uint32_t phys_addr = addr;
 
         if (!svga->fast) {
-                svga_write_linear(addr, val, p);
-                svga_write_linear(addr + 1, val >> 8, p);
+                svga_write_gdc_multi(svga, addr, val, 2, 1);
                 return;
         }
 
@@ -1592,16 +1463,17 @@ void svga_writew_linear(uint32_t addr, uint16_t val, void *p) {
         addr &= svga->vram_mask;
         svga->changedvram[addr >> 12] = changeframecount;
         *(uint16_t *)&svga->vram[addr] = val;
+
+        if (svga->lfb_direct_mapping)
+                svga_lfb_map_direct(svga, phys_addr, addr);
 }
 
-void svga_writel_linear(uint32_t addr, uint32_t val, void *p) {
+static void svga_writel_linear_common(uint32_t addr, uint32_t val, void *p) {
         svga_t *svga = (svga_t *)p;
+        uint32_t phys_addr = addr;
 
         if (!svga->fast) {
-                svga_write_linear(addr, val, p);
-                svga_write_linear(addr + 1, val >> 8, p);
-                svga_write_linear(addr + 2, val >> 16, p);
-                svga_write_linear(addr + 3, val >> 24, p);
+                svga_write_gdc_multi(svga, addr, val, 4, 1);
                 return;
         }
 
@@ -1618,13 +1490,16 @@ void svga_writel_linear(uint32_t addr, uint32_t val, void *p) {
         addr &= svga->vram_mask;
         svga->changedvram[addr >> 12] = changeframecount;
         *(uint32_t *)&svga->vram[addr] = val;
+
+        if (svga->lfb_direct_mapping)
+                svga_lfb_map_direct(svga, phys_addr, addr);
 }
 
-uint16_t svga_readw_linear(uint32_t addr, void *p) {
+static uint16_t svga_readw_linear_common(uint32_t addr, void *p) {
         svga_t *svga = (svga_t *)p;
 
         if (!svga->fast)
-                return svga_read_linear(addr, p) | (svga_read_linear(addr + 1, p) << 8);
+                return svga_read_linear_common(addr, p) | (svga_read_linear_common(addr + 1, p) << 8);
 
         egareads += 2;
 
@@ -1638,12 +1513,12 @@ uint16_t svga_readw_linear(uint32_t addr, void *p) {
         return *(uint16_t *)&svga->vram[addr & svga->vram_mask];
 }
 
-uint32_t svga_readl_linear(uint32_t addr, void *p) {
+static uint32_t svga_readl_linear_common(uint32_t addr, void *p) {
         svga_t *svga = (svga_t *)p;
 
         if (!svga->fast)
-                return svga_read_linear(addr, p) | (svga_read_linear(addr + 1, p) << 8) | (svga_read_linear(addr + 2, p) << 16) |
-                       (svga_read_linear(addr + 3, p) << 24);
+                return svga_read_linear_common(addr, p) | (svga_read_linear_common(addr + 1, p) << 8) |
+                       (svga_read_linear_common(addr + 2, p) << 16) | (svga_read_linear_common(addr + 3, p) << 24);
 
         egareads += 4;
 
@@ -1657,6 +1532,44 @@ uint32_t svga_readl_linear(uint32_t addr, void *p) {
         return *(uint32_t *)&svga->vram[addr & svga->vram_mask];
 }
 
+/*Every access is counted, but only one in VIDEO_STATS_SAMPLE is timed - reading the
+  host timer costs more than most of the accesses themselves*/
+#define SVGA_WRITE_ACCESSOR(name, type)                                                                                          \
+        void name(uint32_t addr, type val, void *p) {                                                                            \
+                if (!(video_stats.vram_writes++ & (VIDEO_STATS_SAMPLE - 1))) {                                                   \
+                        uint64_t start_time = timer_read();                                                                      \
+                        name##_common(addr, val, p);                                                                             \
+                        video_stats.vram_write_time += (timer_read() - start_time) * VIDEO_STATS_SAMPLE;                         \
+                } else                                                                                                           \
+                        name##_common(addr, val, p);                                                                             \
+        }
+
+#define SVGA_READ_ACCESSOR(name, type)                                                                                           \
+        type name(uint32_t addr, void *p) {                                                                                      \
+                type ret;                                                                                                        \
+                                                                                                                                 \
+                if (!(video_stats.vram_reads++ & (VIDEO_STATS_SAMPLE - 1))) {                                                    \
+                        uint64_t start_time = timer_read();                                                                      \
+                        ret = name##_common(addr, p);                                                                            \
+                        video_stats.vram_read_time += (timer_read() - start_time) * VIDEO_STATS_SAMPLE;                          \
+                } else                                                                                                           \
+                        ret = name##_common(addr, p);                                                                            \
+                return ret;                                                                                                      \
+        }
+
+SVGA_WRITE_ACCESSOR(svga_write, uint8_t)
+SVGA_WRITE_ACCESSOR(svga_writew, uint16_t)
+SVGA_WRITE_ACCESSOR(svga_writel, uint32_t)
+SVGA_WRITE_ACCESSOR(svga_write_linear, uint8_t)
+SVGA_WRITE_ACCESSOR(svga_writew_linear, uint16_t)
+SVGA_WRITE_ACCESSOR(svga_writel_linear, uint32_t)
+SVGA_READ_ACCESSOR(svga_read, uint8_t)
+SVGA_READ_ACCESSOR(svga_readw, uint16_t)
+SVGA_READ_ACCESSOR(svga_readl, uint32_t)
+SVGA_READ_ACCESSOR(svga_read_linear, uint8_t)
+SVGA_READ_ACCESSOR(svga_readw_linear, uint16_t)
+SVGA_READ_ACCESSOR(svga_readl_linear, uint32_t)
+
 void svga_add_status_info(char *s, int max_len, void *p) {
         svga_t *svga = (svga_t *)p;
         char temps[128];
@@ -40,12 +40,60 @@ void svga_render_blank(svga_t *svga) {
         }
 }
 
+/*Returns 1 if the current text line is unchanged since it was last drawn, in which case svga->ma
+  is advanced past the line and the caller can skip it*/
+static int svga_text_line_unchanged(svga_t *svga, int xinc) {
+        text_cache_key_t key;
+        uint32_t ma = svga->ma;
+        int nr_cells = 0;
+        int x;
+
+        /*Overlays that are not deferred are drawn over the line after the renderer, so the contents
+          of buffer32 can not be trusted on these lines*/
+        if (svga->overlay_on && !svga->overlay_deferred) {
+                text_cache_invalidate_line(&svga->text_cache, svga->displine);
+                return 0;
+        }
+
+        for (x = 0; x < svga->hdisp; x += xinc) {
+                uint32_t addr = svga->remap_func(svga, ma) & svga->vram_display_mask;
+
+                if (nr_cells == TEXT_CACHE_MAX_CELLS) {
+                        text_cache_invalidate_line(&svga->text_cache, svga->displine);
+                        return 0;
+                }
+                key.cells[nr_cells * 2] = svga->vram[addr];
+                key.cells[nr_cells * 2 + 1] = svga->vram[addr + 1];
+                ma += 4;
+                nr_cells++;
+        }
+
+        key.params[0] = svga->ma;
+        key.params[1] = svga->sc;
+        key.params[2] = svga->hdisp;
+        key.params[3] = svga->scrollcache | (xinc << 8);
+        key.params[4] = (svga->con && svga->cursoron) ? svga->ca : -1;
+        key.params[5] = (svga->blink & 16) | (svga->attrregs[0x10] << 8);
+        key.params[6] = svga->charseta;
+        key.params[7] = svga->charsetb;
+
+        if (svga->fullchange) {
+                text_cache_store(&svga->text_cache, svga->displine, &key, TEXT_CACHE_KEY_LEN(nr_cells));
+                return 0;
+        }
+        if (!text_cache_check(&svga->text_cache, svga->displine, &key, TEXT_CACHE_KEY_LEN(nr_cells)))
+                return 0;
+
+        svga->ma = ma & svga->vram_display_mask;
+        return 1;
+}
+
 void svga_render_text_40(svga_t *svga) {
         if (svga->firstline_draw == 2000)
                 svga->firstline_draw = svga->displine;
         svga->lastline_draw = svga->displine;
 
-        if (svga->fullchange) {
+        if (svga->fullchange || svga->text_changed) {
                 int offset = ((8 - svga->scrollcache) << 1) + 16;
                 uint32_t *p = &((uint32_t *)buffer32->line[svga->displine])[offset];
                 int x, xx;
@@ -54,6 +102,8 @@ void svga_render_text_40(svga_t *svga) {
                 uint32_t charaddr;
                 int fg, bg;
                 int xinc = (svga->seqregs[1] & 1) ? 16 : 18;
+                if (svga_text_line_unchanged(svga, xinc))
+                        return;
 
                 for (x = 0; x < svga->hdisp; x += xinc) {
                         uint32_t addr = svga->remap_func(svga, svga->ma) & svga->vram_display_mask;
@@ -104,7 +154,7 @@ void svga_render_text_80(svga_t *svga) {
                 svga->firstline_draw = svga->displine;
         svga->lastline_draw = svga->displine;
 
-        if (svga->fullchange) {
+        if (svga->fullchange || svga->text_changed) {
                 int offset = (8 - svga->scrollcache) + 24;
                 uint32_t *p = &((uint32_t *)buffer32->line[svga->displine])[offset];
                 int x, xx;
@@ -113,6 +163,8 @@ void svga_render_text_80(svga_t *svga) {
                 uint32_t charaddr;
                 int fg, bg;
                 int xinc = (svga->seqregs[1] & 1) ? 8 : 9;
+                if (svga_text_line_unchanged(svga, xinc))
+                        return;
 
                 for (x = 0; x < svga->hdisp; x += xinc) {
                         uint32_t addr = svga->remap_func(svga, svga->ma) & svga->vram_display_mask;
@@ -163,7 +215,7 @@ void svga_render_text_80_ksc5601(svga_t *svga) {
                 svga->firstline_draw = svga->displine;
         svga->lastline_draw = svga->displine;
 
-        if (svga->fullchange) {
+        if (svga->fullchange || svga->text_changed) {
                 int offset = (8 - svga->scrollcache) + 24;
                 uint32_t *p = &((uint32_t *)buffer32->line[svga->displine])[offset];
                 int x, xx;
@@ -0,0 +1,45 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ibm.h"
+#include "vid_text_cache.h"
+
+void text_cache_init(text_cache_t *cache, int lines) {
+        cache->lines = lines;
+        cache->key_len = malloc(lines * sizeof(int));
+        cache->keys = malloc(lines * sizeof(text_cache_key_t));
+        text_cache_invalidate(cache);
+}
+
+void text_cache_close(text_cache_t *cache) {
+        free(cache->key_len);
+        free(cache->keys);
+        cache->key_len = NULL;
+        cache->keys = NULL;
+        cache->lines = 0;
+}
+
+void text_cache_invalidate(text_cache_t *cache) {
+        if (cache->lines)
+                memset(cache->key_len, 0, cache->lines * sizeof(int));
+}
+
+int text_cache_check(text_cache_t *cache, int line, text_cache_key_t *key, int len) {
+        if (line >= cache->lines)
+                return 0;
+
+        if (cache->key_len[line] == len && !memcmp(&cache->keys[line], key, len))
+                return 1;
+
+        memcpy(&cache->keys[line], key, len);
+        cache->key_len[line] = len;
+        return 0;
+}
+
+void text_cache_store(text_cache_t *cache, int line, text_cache_key_t *key, int len) {
+        if (line >= cache->lines)
+                return;
+
+        memcpy(&cache->keys[line], key, len);
+        cache->key_len[line] = len;
+}
@@ -16,94 +16,15 @@
 #include "vid_voodoo_dither.h"
 #include "vid_voodoo_fb.h"
 #include "vid_voodoo_fifo.h"
+#include "vid_voodoo_record.h"
 #include "vid_voodoo_reg.h"
 #include "vid_voodoo_regs.h"
 #include "vid_voodoo_render.h"
 #include "vid_voodoo_texture.h"
 #include "viewer.h"
 
-rgba8_t rgb332[0x100], ai44[0x100], rgb565[0x10000], argb1555[0x10000], argb4444[0x10000], ai88[0x10000];
-
-int tris = 0;
-
 static uint64_t status_time = 0;
 
-void voodoo_recalc(voodoo_t *voodoo) {
-        uint32_t buffer_offset = ((voodoo->fbiInit2 >> 11) & 511) * 4096;
-
-        if (voodoo->type >= VOODOO_BANSHEE)
-                return;
-
-        voodoo->params.front_offset = voodoo->disp_buffer * buffer_offset;
-        voodoo->back_offset = voodoo->draw_buffer * buffer_offset;
-
-        voodoo->buffer_cutoff = TRIPLE_BUFFER ? (buffer_offset * 4) : (buffer_offset * 3);
-        if (TRIPLE_BUFFER)
-                voodoo->params.aux_offset = buffer_offset * 3;
-        else
-                voodoo->params.aux_offset = buffer_offset * 2;
-
-        switch (voodoo->lfbMode & LFB_WRITE_MASK) {
-        case LFB_WRITE_FRONT:
-                voodoo->fb_write_offset = voodoo->params.front_offset;
-                voodoo->fb_write_buffer = voodoo->disp_buffer;
-                break;
-        case LFB_WRITE_BACK:
-                voodoo->fb_write_offset = voodoo->back_offset;
-                voodoo->fb_write_buffer = voodoo->draw_buffer;
-                break;
-
-        default:
-                /*BreakNeck sets invalid LFB write buffer select*/
-                voodoo->fb_write_offset = voodoo->params.front_offset;
-                break;
-        }
-
-        switch (voodoo->lfbMode & LFB_READ_MASK) {
-        case LFB_READ_FRONT:
-                voodoo->fb_read_offset = voodoo->params.front_offset;
-                break;
-        case LFB_READ_BACK:
-                voodoo->fb_read_offset = voodoo->back_offset;
-                break;
-        case LFB_READ_AUX:
-                voodoo->fb_read_offset = voodoo->params.aux_offset;
-                break;
-
-        default:
-                fatal("voodoo_recalc : unknown lfb source\n");
-        }
-
-        switch (voodoo->params.fbzMode & FBZ_DRAW_MASK) {
-        case FBZ_DRAW_FRONT:
-                voodoo->params.draw_offset = voodoo->params.front_offset;
-                voodoo->fb_draw_buffer = voodoo->disp_buffer;
-                break;
-        case FBZ_DRAW_BACK:
-                voodoo->params.draw_offset = voodoo->back_offset;
-                voodoo->fb_draw_buffer = voodoo->draw_buffer;
-                break;
-
-        default:
-                fatal("voodoo_recalc : unknown draw buffer\n");
-        }
-
-        voodoo->block_width = ((voodoo->fbiInit1 >> 4) & 15) * 2;
-        if (voodoo->fbiInit6 & (1 << 30))
-                voodoo->block_width += 1;
-        if (voodoo->fbiInit1 & (1 << 24))
-                voodoo->block_width += 32;
-        voodoo->row_width = voodoo->block_width * 32 * 2;
-        voodoo->params.row_width = voodoo->row_width;
-        voodoo->aux_row_width = voodoo->row_width;
-        voodoo->params.aux_row_width = voodoo->aux_row_width;
-
-        /*        pclog("voodoo_recalc : front_offset %08X  back_offset %08X  aux_offset %08X draw_offset %08x\n",
-           voodoo->params.front_offset, voodoo->back_offset, voodoo->params.aux_offset, voodoo->params.draw_offset); pclog("
-           fb_read_offset %08X  fb_write_offset %08X  row_width %i  %08x %08x\n", voodoo->fb_read_offset, voodoo->fb_write_offset,
-           voodoo->row_width, voodoo->lfbMode, voodoo->params.fbzMode);*/
-}
-
 static uint16_t voodoo_readw(uint32_t addr, void *p) {
         voodoo_t *voodoo = (voodoo_t *)p;
 
@@ -467,6 +388,7 @@ static void voodoo_writel(uint32_t addr, uint32_t val, void *p) {
                                         voodoo->disp_buffer = 0;
                                         voodoo->draw_buffer = 1;
                                         voodoo_recalc(voodoo);
+                                        voodoo_display_flush_front(voodoo);
                                         voodoo->front_offset = voodoo->params.front_offset;
                                 }
                         }
@@ -785,12 +707,12 @@ static void voodoo_add_status_info(char *s, int max_len, void *p) {
         voodoo_set_t *voodoo_set = (voodoo_set_t *)p;
         voodoo_t *voodoo = voodoo_set->voodoos[0];
         voodoo_t *voodoo_slave = voodoo_set->voodoos[1];
-        char temps[512], temps2[256];
-        int pixel_count_current[4];
-        int pixel_count_total;
-        int texel_count_current[4];
-        int texel_count_total;
-        int render_time[4];
+        char temps[2048], temps2[256];
+        int pixel_count_current[VOODOO_MAX_RENDER_THREADS];
+        int pixel_count_total = 0;
+        int texel_count_current[VOODOO_MAX_RENDER_THREADS];
+        int texel_count_total = 0;
+        int render_time[VOODOO_MAX_RENDER_THREADS];
         uint64_t new_time = timer_read();
         uint64_t status_diff = new_time - status_time;
         status_time = new_time;
@@ -799,69 +721,47 @@ static void voodoo_add_status_info(char *s, int max_len, void *p) {
         if (!status_diff)
                 status_diff = 1;
 
-        for (c = 0; c < 4; c++) {
+        for (c = 0; c < VOODOO_MAX_RENDER_THREADS; c++) {
                 pixel_count_current[c] = voodoo->pixel_count[c];
                 texel_count_current[c] = voodoo->texel_count[c];
                 render_time[c] = voodoo->render_time[c];
         }
         if (voodoo_set->nr_cards == 2) {
-                for (c = 0; c < 4; c++) {
+                for (c = 0; c < VOODOO_MAX_RENDER_THREADS; c++) {
                         pixel_count_current[c] += voodoo_slave->pixel_count[c];
                         texel_count_current[c] += voodoo_slave->texel_count[c];
                         render_time[c] = (render_time[c] + voodoo_slave->render_time[c]) / 2;
                 }
         }
-        pixel_count_total = (pixel_count_current[0] + pixel_count_current[1] + pixel_count_current[2] + pixel_count_current[3]) -
-                            (voodoo->pixel_count_old[0] + voodoo->pixel_count_old[1] + voodoo->pixel_count_old[2] +
-                             voodoo->pixel_count_old[3]);
-        texel_count_total = (texel_count_current[0] + texel_count_current[1] + texel_count_current[2] + texel_count_current[3]) -
-                            (voodoo->texel_count_old[0] + voodoo->texel_count_old[1] + voodoo->texel_count_old[2] +
-                             voodoo->texel_count_old[3]);
+        for (c = 0; c < VOODOO_MAX_RENDER_THREADS; c++) {
+                pixel_count_total += pixel_count_current[c] - voodoo->pixel_count_old[c];
+                texel_count_total += texel_count_current[c] - voodoo->texel_count_old[c];
+        }
         sprintf(temps,
-                "%f Mpixels/sec (%f)\n%f Mtexels/sec (%f)\n%f ktris/sec\n%f%% CPU (%f%% real)\n%d frames/sec (%i)\n%f%% CPU "
+                "%f Mpixels/sec (%f)\n%f Mtexels/sec (%f)\n%f ktris/sec\n%f%% CPU (%f%% real)\n%d frames/sec (%i compiles, %i hits)\n%f%% CPU "
                 "(%f%% real)\n" /*%d reads/sec\n%d write/sec\n%d tex/sec\n*/,
                 (double)pixel_count_total / 1000000.0,
                 ((double)pixel_count_total / 1000000.0) / ((double)render_time[0] / status_diff),
                 (double)texel_count_total / 1000000.0,
                 ((double)texel_count_total / 1000000.0) / ((double)render_time[0] / status_diff),
                 (double)voodoo->tri_count / 1000.0, ((double)voodoo->time * 100.0) / timer_freq,
-                ((double)voodoo->time * 100.0) / status_diff, voodoo->frame_count, voodoo_recomp,
+                ((double)voodoo->time * 100.0) / status_diff, voodoo->frame_count, voodoo_recomp, voodoo_recomp_hits,
                 ((double)voodoo->render_time[0] * 100.0) / timer_freq, ((double)voodoo->render_time[0] * 100.0) / status_diff);
-        if (voodoo->render_threads >= 2) {
-                sprintf(temps2, "%f%% CPU (%f%% real)\n", ((double)voodoo->render_time[1] * 100.0) / timer_freq,
-                        ((double)voodoo->render_time[1] * 100.0) / status_diff);
-                strncat(temps, temps2, sizeof(temps) - 1);
-        }
-        if (voodoo->render_threads == 4) {
-                sprintf(temps2, "%f%% CPU (%f%% real)\n%f%% CPU (%f%% real)\n",
-                        ((double)voodoo->render_time[2] * 100.0) / timer_freq,
-                        ((double)voodoo->render_time[2] * 100.0) / status_diff,
-                        ((double)voodoo->render_time[3] * 100.0) / timer_freq,
-                        ((double)voodoo->render_time[3] * 100.0) / status_diff);
-                strncat(temps, temps2, sizeof(temps) - 1);
+        for (c = 1; c < voodoo->render_threads; c++) {
+                sprintf(temps2, "%f%% CPU (%f%% real)\n", ((double)voodoo->render_time[c] * 100.0) / timer_freq,
+                        ((double)voodoo->render_time[c] * 100.0) / status_diff);
+                strncat(temps, temps2, sizeof(temps) - strlen(temps) - 1);
         }
         if (voodoo_set->nr_cards == 2) {
-                sprintf(temps2, "%f%% CPU (%f%% real)\n", ((double)voodoo_slave->render_time[0] * 100.0) / timer_freq,
-                        ((double)voodoo_slave->render_time[0] * 100.0) / status_diff);
-                strncat(temps, temps2, sizeof(temps) - 1);
-
-                if (voodoo_slave->render_threads >= 2) {
-                        sprintf(temps2, "%f%% CPU (%f%% real)\n", ((double)voodoo_slave->render_time[1] * 100.0) / timer_freq,
-                                ((double)voodoo_slave->render_time[1] * 100.0) / status_diff);
-                        strncat(temps, temps2, sizeof(temps) - 1);
-                }
-                if (voodoo_slave->render_threads == 4) {
-                        sprintf(temps2, "%f%% CPU (%f%% real)\n%f%% CPU (%f%% real)\n",
-                                ((double)voodoo_slave->render_time[2] * 100.0) / timer_freq,
-                                ((double)voodoo_slave->render_time[2] * 100.0) / status_diff,
-                                ((double)voodoo_slave->render_time[3] * 100.0) / timer_freq,
-                                ((double)voodoo_slave->render_time[3] * 100.0) / status_diff);
-                        strncat(temps, temps2, sizeof(temps) - 1);
+                for (c = 0; c < voodoo_slave->render_threads; c++) {
+                        sprintf(temps2, "%f%% CPU (%f%% real)\n", ((double)voodoo_slave->render_time[c] * 100.0) / timer_freq,
+                                ((double)voodoo_slave->render_time[c] * 100.0) / status_diff);
+                        strncat(temps, temps2, sizeof(temps) - strlen(temps) - 1);
                 }
         }
         strncat(s, temps, max_len);
 
-        for (c = 0; c < 4; c++) {
+        for (c = 0; c < VOODOO_MAX_RENDER_THREADS; c++) {
                 voodoo->pixel_count_old[c] = pixel_count_current[c];
                 voodoo->texel_count_old[c] = texel_count_current[c];
                 voodoo->render_time[c] = 0;
@@ -870,7 +770,7 @@ static void voodoo_add_status_info(char *s, int max_len, void *p) {
         voodoo->rd_count = voodoo->wr_count = voodoo->tex_count = 0;
         voodoo->time = 0;
         if (voodoo_set->nr_cards == 2) {
-                for (c = 0; c < 4; c++) {
+                for (c = 0; c < VOODOO_MAX_RENDER_THREADS; c++) {
                         voodoo_slave->pixel_count_old[c] = pixel_count_current[c];
                         voodoo_slave->texel_count_old[c] = texel_count_current[c];
                         voodoo_slave->render_time[c] = 0;
@@ -880,6 +780,7 @@ static void voodoo_add_status_info(char *s, int max_len, void *p) {
                 voodoo_slave->time = 0;
         }
         voodoo_recomp = 0;
+        voodoo_recomp_hits = 0;
 }
 
 static void voodoo_speed_changed(void *p) {
@@ -915,7 +816,6 @@ void *voodoo_card_init() {
         voodoo->fb_size = device_get_config_int("framebuffer_memory");
         voodoo->fb_mask = (voodoo->fb_size << 20) - 1;
         voodoo->render_threads = device_get_config_int("render_threads");
-        voodoo->odd_even_mask = voodoo->render_threads - 1;
 #ifndef NO_CODEGEN
         voodoo->use_recompiler = device_get_config_int("recompiler");
 #endif
@@ -968,73 +868,15 @@ void *voodoo_card_init() {
         voodoo->fbiInit0 = 0;
 
         voodoo->wake_fifo_thread = thread_create_event();
-        voodoo->wake_render_thread[0] = thread_create_event();
-        voodoo->wake_render_thread[1] = thread_create_event();
-        voodoo->wake_render_thread[2] = thread_create_event();
-        voodoo->wake_render_thread[3] = thread_create_event();
         voodoo->wake_main_thread = thread_create_event();
         voodoo->fifo_not_full_event = thread_create_event();
-        voodoo->render_not_full_event[0] = thread_create_event();
-        voodoo->render_not_full_event[1] = thread_create_event();
-        voodoo->render_not_full_event[2] = thread_create_event();
-        voodoo->render_not_full_event[3] = thread_create_event();
         voodoo->fifo_thread = thread_create(voodoo_fifo_thread, voodoo);
-        voodoo->render_thread[0] = thread_create(voodoo_render_thread_1, voodoo);
-        if (voodoo->render_threads >= 2)
-                voodoo->render_thread[1] = thread_create(voodoo_render_thread_2, voodoo);
-        if (voodoo->render_threads == 4) {
-                voodoo->render_thread[2] = thread_create(voodoo_render_thread_3, voodoo);
-                voodoo->render_thread[3] = thread_create(voodoo_render_thread_4, voodoo);
-        }
+        voodoo_render_init(voodoo);
+        voodoo_display_init(voodoo);
         voodoo->swap_mutex = thread_create_mutex();
         timer_add(&voodoo->wake_timer, voodoo_wake_timer, (void *)voodoo, 0);
 
-        for (c = 0; c < 0x100; c++) {
-                rgb332[c].r = c & 0xe0;
-                rgb332[c].g = (c << 3) & 0xe0;
-                rgb332[c].b = (c << 6) & 0xc0;
-                rgb332[c].r = rgb332[c].r | (rgb332[c].r >> 3) | (rgb332[c].r >> 6);
-                rgb332[c].g = rgb332[c].g | (rgb332[c].g >> 3) | (rgb332[c].g >> 6);
-                rgb332[c].b = rgb332[c].b | (rgb332[c].b >> 2);
-                rgb332[c].b = rgb332[c].b | (rgb332[c].b >> 4);
-                rgb332[c].a = 0xff;
-
-                ai44[c].a = (c & 0xf0) | ((c & 0xf0) >> 4);
-                ai44[c].r = (c & 0x0f) | ((c & 0x0f) << 4);
-                ai44[c].g = ai44[c].b = ai44[c].r;
-        }
-
-        for (c = 0; c < 0x10000; c++) {
-                rgb565[c].r = (c >> 8) & 0xf8;
-                rgb565[c].g = (c >> 3) & 0xfc;
-                rgb565[c].b = (c << 3) & 0xf8;
-                rgb565[c].r |= (rgb565[c].r >> 5);
-                rgb565[c].g |= (rgb565[c].g >> 6);
-                rgb565[c].b |= (rgb565[c].b >> 5);
-                rgb565[c].a = 0xff;
-
-                argb1555[c].r = (c >> 7) & 0xf8;
-                argb1555[c].g = (c >> 2) & 0xf8;
-                argb1555[c].b = (c << 3) & 0xf8;
-                argb1555[c].r |= (argb1555[c].r >> 5);
-                argb1555[c].g |= (argb1555[c].g >> 5);
-                argb1555[c].b |= (argb1555[c].b >> 5);
-                argb1555[c].a = (c & 0x8000) ? 0xff : 0;
-
-                argb4444[c].a = (c >> 8) & 0xf0;
-                argb4444[c].r = (c >> 4) & 0xf0;
-                argb4444[c].g = c & 0xf0;
-                argb4444[c].b = (c << 4) & 0xf0;
-                argb4444[c].a |= (argb4444[c].a >> 4);
-                argb4444[c].r |= (argb4444[c].r >> 4);
-                argb4444[c].g |= (argb4444[c].g >> 4);
-                argb4444[c].b |= (argb4444[c].b >> 4);
-
-                ai88[c].a = (c >> 8);
-                ai88[c].r = c & 0xff;
-                ai88[c].g = c & 0xff;
-                ai88[c].b = c & 0xff;
-        }
+        voodoo_generate_colour_tables();
 #ifndef NO_CODEGEN
         voodoo_codegen_init(voodoo);
 #endif
@@ -1054,8 +896,6 @@ void *voodoo_2d3d_card_init(int type) {
         voodoo->dithersub_enabled = device_get_config_int("dithersub");
         voodoo->scrfilter = device_get_config_int("dacfilter");
         voodoo->render_threads = device_get_config_int("render_threads");
-
-        voodoo->odd_even_mask = voodoo->render_threads - 1;
 #ifndef NO_CODEGEN
         voodoo->use_recompiler = device_get_config_int("recompiler");
 #endif
@@ -1083,73 +923,15 @@ void *voodoo_2d3d_card_init(int type) {
         voodoo->fbiInit0 = 0;
 
         voodoo->wake_fifo_thread = thread_create_event();
-        voodoo->wake_render_thread[0] = thread_create_event();
-        voodoo->wake_render_thread[1] = thread_create_event();
-        voodoo->wake_render_thread[2] = thread_create_event();
-        voodoo->wake_render_thread[3] = thread_create_event();
         voodoo->wake_main_thread = thread_create_event();
         voodoo->fifo_not_full_event = thread_create_event();
-        voodoo->render_not_full_event[0] = thread_create_event();
-        voodoo->render_not_full_event[1] = thread_create_event();
-        voodoo->render_not_full_event[2] = thread_create_event();
-        voodoo->render_not_full_event[3] = thread_create_event();
         voodoo->fifo_thread = thread_create(voodoo_fifo_thread, voodoo);
-        voodoo->render_thread[0] = thread_create(voodoo_render_thread_1, voodoo);
-        if (voodoo->render_threads >= 2)
-                voodoo->render_thread[1] = thread_create(voodoo_render_thread_2, voodoo);
-        if (voodoo->render_threads == 4) {
-                voodoo->render_thread[2] = thread_create(voodoo_render_thread_3, voodoo);
-                voodoo->render_thread[3] = thread_create(voodoo_render_thread_4, voodoo);
-        }
+        voodoo_render_init(voodoo);
+        voodoo_display_init(voodoo);
         voodoo->swap_mutex = thread_create_mutex();
         timer_add(&voodoo->wake_timer, voodoo_wake_timer, (void *)voodoo, 0);
 
-        for (c = 0; c < 0x100; c++) {
-                rgb332[c].r = c & 0xe0;
-                rgb332[c].g = (c << 3) & 0xe0;
-                rgb332[c].b = (c << 6) & 0xc0;
-                rgb332[c].r = rgb332[c].r | (rgb332[c].r >> 3) | (rgb332[c].r >> 6);
-                rgb332[c].g = rgb332[c].g | (rgb332[c].g >> 3) | (rgb332[c].g >> 6);
-                rgb332[c].b = rgb332[c].b | (rgb332[c].b >> 2);
-                rgb332[c].b = rgb332[c].b | (rgb332[c].b >> 4);
-                rgb332[c].a = 0xff;
-
-                ai44[c].a = (c & 0xf0) | ((c & 0xf0) >> 4);
-                ai44[c].r = (c & 0x0f) | ((c & 0x0f) << 4);
-                ai44[c].g = ai44[c].b = ai44[c].r;
-        }
-
-        for (c = 0; c < 0x10000; c++) {
-                rgb565[c].r = (c >> 8) & 0xf8;
-                rgb565[c].g = (c >> 3) & 0xfc;
-                rgb565[c].b = (c << 3) & 0xf8;
-                rgb565[c].r |= (rgb565[c].r >> 5);
-                rgb565[c].g |= (rgb565[c].g >> 6);
-                rgb565[c].b |= (rgb565[c].b >> 5);
-                rgb565[c].a = 0xff;
-
-                argb1555[c].r = (c >> 7) & 0xf8;
-                argb1555[c].g = (c >> 2) & 0xf8;
-                argb1555[c].b = (c << 3) & 0xf8;
-                argb1555[c].r |= (argb1555[c].r >> 5);
-                argb1555[c].g |= (argb1555[c].g >> 5);
-                argb1555[c].b |= (argb1555[c].b >> 5);
-                argb1555[c].a = (c & 0x8000) ? 0xff : 0;
-
-                argb4444[c].a = (c >> 8) & 0xf0;
-                argb4444[c].r = (c >> 4) & 0xf0;
-                argb4444[c].g = c & 0xf0;
-                argb4444[c].b = (c << 4) & 0xf0;
-                argb4444[c].a |= (argb4444[c].a >> 4);
-                argb4444[c].r |= (argb4444[c].r >> 4);
-                argb4444[c].g |= (argb4444[c].g >> 4);
-                argb4444[c].b |= (argb4444[c].b >> 4);
-
-                ai88[c].a = (c >> 8);
-                ai88[c].r = c & 0xff;
-                ai88[c].g = c & 0xff;
-                ai88[c].b = c & 0xff;
-        }
+        voodoo_generate_colour_tables();
 #ifndef NO_CODEGEN
         voodoo_codegen_init(voodoo);
 #endif
@@ -1212,6 +994,12 @@ void *voodoo_init() {
         mem_mapping_add(&voodoo_set->snoop_mapping, 0, 0, NULL, voodoo_snoop_readw, voodoo_snoop_readl, NULL, voodoo_snoop_writew,
                         voodoo_snoop_writel, NULL, MEM_MAPPING_EXTERNAL, voodoo_set);
 
+        switch (device_get_config_int("command_stream")) {
+        case 1:
+                voodoo_record_init(voodoo_set->voodoos[0]);
+                break;
+        }
+
         viewer_add("3DFX Voodoo render", &viewer_voodoo, voodoo_set->voodoos[0]);
 
         return voodoo_set;
@@ -1237,20 +1025,12 @@ void voodoo_card_close(voodoo_t *voodoo) {
 #endif
 
         thread_kill(voodoo->fifo_thread);
-        thread_kill(voodoo->render_thread[0]);
-        if (voodoo->render_threads >= 2)
-                thread_kill(voodoo->render_thread[1]);
-        if (voodoo->render_threads == 4) {
-                thread_kill(voodoo->render_thread[2]);
-                thread_kill(voodoo->render_thread[3]);
-        }
+        voodoo_render_close(voodoo);
+        voodoo_display_close(voodoo);
+        voodoo_record_close(voodoo);
         thread_destroy_event(voodoo->fifo_not_full_event);
         thread_destroy_event(voodoo->wake_main_thread);
         thread_destroy_event(voodoo->wake_fifo_thread);
-        thread_destroy_event(voodoo->wake_render_thread[0]);
-        thread_destroy_event(voodoo->wake_render_thread[1]);
-        thread_destroy_event(voodoo->render_not_full_event[0]);
-        thread_destroy_event(voodoo->render_not_full_event[1]);
 
         for (c = 0; c < TEX_CACHE_MAX; c++) {
                 if (voodoo->dual_tmus)
@@ -1307,12 +1087,21 @@ static device_config_t voodoo_config[] = {
          .selection = {{.description = "1", .value = 1},
                        {.description = "2", .value = 2},
                        {.description = "4", .value = 4},
+                       {.description = "8", .value = 8},
+                       {.description = "16", .value = 16},
                        {.description = ""}},
          .default_int = 2},
         {.name = "sli", .description = "SLI", .type = CONFIG_BINARY, .default_int = 0},
 #ifndef NO_CODEGEN
-        {.name = "recompiler", .description = "Recompiler", .type = CONFIG_BINARY, .default_int = 1},
+        {.name = "recompiler", .description = "Recompiler", .type = CONFIG_BINARY, .default_int = VOODOO_RECOMPILER_DEFAULT},
 #endif
+        {.name = "command_stream",
+         .description = "Command stream",
+         .type = CONFIG_SELECTION,
+         .selection = {{.description = "Normal", .value = 0},
+                       {.description = "Record to voodoo_record.bin", .value = 1},
+                       {.description = ""}},
+         .default_int = 0},
         {.type = -1}};
 
 device_t voodoo_device = {"3DFX Voodoo Graphics", DEVICE_PCI,   voodoo_init, voodoo_close, NULL, voodoo_speed_changed, NULL,
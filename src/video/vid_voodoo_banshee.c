@@ -322,7 +322,7 @@ static void banshee_render_16bpp_tiled(svga_t *svga) {
                        ((banshee->desktop_y >> 5) * banshee->desktop_stride_tiled);
 
         for (x = 0; x <= svga->hdisp; x += 64) {
-                if (svga->hwcursor_on || svga->overlay_on)
+                if (svga->overlay_on)
                         svga->changedvram[addr >> 12] = 2;
                 if (svga->changedvram[addr >> 12] || svga->fullchange) {
                         uint16_t *vram_p = (uint16_t *)&svga->vram[addr & svga->vram_display_mask];
@@ -807,8 +807,7 @@ static uint32_t banshee_status(banshee_t *banshee) {
         int swap_count = voodoo->swap_count;
         int written = voodoo->cmd_written + voodoo->cmd_written_fifo;
         int busy = (written - voodoo->cmd_read) || (voodoo->cmdfifo_depth_rd != voodoo->cmdfifo_depth_wr) ||
-                   voodoo->render_voodoo_busy[0] || voodoo->render_voodoo_busy[1] || voodoo->render_voodoo_busy[2] ||
-                   voodoo->render_voodoo_busy[3] || voodoo->voodoo_busy;
+                   voodoo_render_busy(voodoo) || voodoo->voodoo_busy;
         uint32_t ret;
 
         ret = 0;
@@ -2512,10 +2511,12 @@ static device_config_t banshee_sgram_config[] = {
          .selection = {{.description = "1", .value = 1},
                        {.description = "2", .value = 2},
                        {.description = "4", .value = 4},
+                       {.description = "8", .value = 8},
+                       {.description = "16", .value = 16},
                        {.description = ""}},
          .default_int = 2},
 #ifndef NO_CODEGEN
-        {.name = "recompiler", .description = "Recompiler", .type = CONFIG_BINARY, .default_int = 1},
+        {.name = "recompiler", .description = "Recompiler", .type = CONFIG_BINARY, .default_int = VOODOO_RECOMPILER_DEFAULT},
 #endif
         {.type = -1}};
 
@@ -2529,10 +2530,12 @@ static device_config_t banshee_sdram_config[] = {
          .selection = {{.description = "1", .value = 1},
                        {.description = "2", .value = 2},
                        {.description = "4", .value = 4},
+                       {.description = "8", .value = 8},
+                       {.description = "16", .value = 16},
                        {.description = ""}},
          .default_int = 2},
 #ifndef NO_CODEGEN
-        {.name = "recompiler", .description = "Recompiler", .type = CONFIG_BINARY, .default_int = 1},
+        {.name = "recompiler", .description = "Recompiler", .type = CONFIG_BINARY, .default_int = VOODOO_RECOMPILER_DEFAULT},
 #endif
         {.type = -1}};
 
@@ -2663,12 +2666,12 @@ static uint64_t status_time = 0;
 static void banshee_add_status_info(char *s, int max_len, void *p) {
         banshee_t *banshee = (banshee_t *)p;
         voodoo_t *voodoo = banshee->voodoo;
-        char temps[512];
-        int pixel_count_current[4];
-        int pixel_count_total;
-        int texel_count_current[4];
-        int texel_count_total;
-        int render_time[4];
+        char temps[2048];
+        int pixel_count_current[VOODOO_MAX_RENDER_THREADS];
+        int pixel_count_total = 0;
+        int texel_count_current[VOODOO_MAX_RENDER_THREADS];
+        int texel_count_total = 0;
+        int render_time[VOODOO_MAX_RENDER_THREADS];
         uint64_t new_time = timer_read();
         uint64_t status_diff = new_time - status_time;
         int c;
@@ -2676,46 +2679,44 @@ static void banshee_add_status_info(char *s, int max_len, void *p) {
 
         svga_add_status_info(s, max_len, &banshee->svga);
 
-        for (c = 0; c < 4; c++) {
+        for (c = 0; c < VOODOO_MAX_RENDER_THREADS; c++) {
                 pixel_count_current[c] = voodoo->pixel_count[c];
                 texel_count_current[c] = voodoo->texel_count[c];
                 render_time[c] = voodoo->render_time[c];
-        }
 
-        pixel_count_total = (pixel_count_current[0] + pixel_count_current[1] + pixel_count_current[2] + pixel_count_current[3]) -
-                            (voodoo->pixel_count_old[0] + voodoo->pixel_count_old[1] + voodoo->pixel_count_old[2] +
-                             voodoo->pixel_count_old[3]);
-        texel_count_total = (texel_count_current[0] + texel_count_current[1] + texel_count_current[2] + texel_count_current[3]) -
-                            (voodoo->texel_count_old[0] + voodoo->texel_count_old[1] + voodoo->texel_count_old[2] +
-                             voodoo->texel_count_old[3]);
+                pixel_count_total += pixel_count_current[c] - voodoo->pixel_count_old[c];
+                texel_count_total += texel_count_current[c] - voodoo->texel_count_old[c];
+        }
         sprintf(temps,
-                "%f Mpixels/sec (%f)\n%f Mtexels/sec (%f)\n%f ktris/sec\n%f%% CPU (%f%% real)\n%d frames/sec (%i)\n%f%% CPU "
+                "%f Mpixels/sec (%f)\n%f Mtexels/sec (%f)\n%f ktris/sec\n%f%% CPU (%f%% real)\n%d frames/sec (%i compiles, %i hits)\n%f%% CPU "
                 "(%f%% real)\n" /*%d reads/sec\n%d write/sec\n%d tex/sec\n*/,
                 (double)pixel_count_total / 1000000.0,
                 ((double)pixel_count_total / 1000000.0) / ((double)render_time[0] / status_diff),
                 (double)texel_count_total / 1000000.0,
                 ((double)texel_count_total / 1000000.0) / ((double)render_time[0] / status_diff),
                 (double)voodoo->tri_count / 1000.0, ((double)voodoo->time * 100.0) / timer_freq,
-                ((double)voodoo->time * 100.0) / status_diff, voodoo->frame_count, voodoo_recomp,
+                ((double)voodoo->time * 100.0) / status_diff, voodoo->frame_count, voodoo_recomp, voodoo_recomp_hits,
                 ((double)voodoo->render_time[0] * 100.0) / timer_freq, ((double)voodoo->render_time[0] * 100.0) / status_diff);
-        if (voodoo->render_threads >= 2) {
-                char temps2[512];
-                sprintf(temps2, "%f%% CPU (%f%% real)\n", ((double)voodoo->render_time[1] * 100.0) / timer_freq,
-                        ((double)voodoo->render_time[1] * 100.0) / status_diff);
-                strncat(temps, temps2, sizeof(temps) - 1);
-        }
-        if (voodoo->render_threads == 4) {
+        for (c = 1; c < voodoo->render_threads; c++) {
                 char temps2[512];
-                sprintf(temps2, "%f%% CPU (%f%% real)\n%f%% CPU (%f%% real)\n",
-                        ((double)voodoo->render_time[2] * 100.0) / timer_freq,
-                        ((double)voodoo->render_time[2] * 100.0) / status_diff,
-                        ((double)voodoo->render_time[3] * 100.0) / timer_freq,
-                        ((double)voodoo->render_time[3] * 100.0) / status_diff);
-                strncat(temps, temps2, sizeof(temps) - 1);
+                sprintf(temps2, "%f%% CPU (%f%% real)\n", ((double)voodoo->render_time[c] * 100.0) / timer_freq,
+                        ((double)voodoo->render_time[c] * 100.0) / status_diff);
+                strncat(temps, temps2, sizeof(temps) - strlen(temps) - 1);
         }
 
         strncat(s, temps, max_len);
 
+#ifdef BANSHEE_BLT_STATS
+        sprintf(temps, "%f Mpixels/sec 2D (%f%% span)\n",
+                (double)(voodoo->banshee_blt.span_pixel_count + voodoo->banshee_blt.plot_pixel_count) / 1000000.0,
+                (voodoo->banshee_blt.span_pixel_count + voodoo->banshee_blt.plot_pixel_count)
+                        ? ((double)voodoo->banshee_blt.span_pixel_count * 100.0) /
+                                  (double)(voodoo->banshee_blt.span_pixel_count + voodoo->banshee_blt.plot_pixel_count)
+                        : 0.0);
+        strncat(s, temps, max_len);
+        voodoo->banshee_blt.span_pixel_count = voodoo->banshee_blt.plot_pixel_count = 0;
+#endif
+
         strncat(s, "Overlay mode: ", max_len); /* leilei debug additions */
         if ((banshee->vidProcCfg & VIDPROCCFG_FILTER_MODE_MASK) == VIDPROCCFG_FILTER_MODE_DITHER_2X2)
                 strncat(s, "2x2 box filter\n", max_len);
@@ -2734,7 +2735,7 @@ static void banshee_add_status_info(char *s, int max_len, void *p) {
 
         strncat(s, "\n", max_len);
 
-        for (c = 0; c < 4; c++) {
+        for (c = 0; c < VOODOO_MAX_RENDER_THREADS; c++) {
                 voodoo->pixel_count_old[c] = pixel_count_current[c];
                 voodoo->texel_count_old[c] = texel_count_current[c];
                 voodoo->render_time[c] = 0;
@@ -2747,6 +2748,7 @@ static void banshee_add_status_info(char *s, int max_len, void *p) {
         voodoo->read_time = pci_nonburst_time + pci_burst_time;
 
         voodoo_recomp = 0;
+        voodoo_recomp_hits = 0;
 }
 
 device_t voodoo_banshee_device = {"Voodoo Banshee PCI (reference)",
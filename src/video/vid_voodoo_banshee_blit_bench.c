@@ -0,0 +1,255 @@
+/*Banshee 2D blitter benchmark. Runs a set of typical desktop operations (solid and pattern fills,
+  window drags and scrolls) through the blitter with the span fast paths and through the per-pixel
+  reference build (vid_voodoo_banshee_blit_ref.c), at 8, 16 and 32 bpp, and reports pixel throughput
+  for each.
+
+  banshee-blit-bench [operations]
+
+  operations is the number of blits issued per test (default 500). Both builds start from the same
+  random VRAM contents, and the VRAM is compared after each test; the program exits with status 1 on
+  the first difference. The colour keyed copy always takes the per-pixel path and is there as a
+  control.*/
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "ibm.h"
+#include "device.h"
+#include "mem.h"
+#include "thread.h"
+#include "video.h"
+#include "vid_svga.h"
+#include "vid_voodoo.h"
+#include "vid_voodoo_common.h"
+#include "vid_voodoo_banshee_blitter.h"
+
+/*logging.h sends printf() to pclog()*/
+#undef printf
+
+void ref_voodoo_2d_reg_writel(voodoo_t *voodoo, uint32_t addr, uint32_t val);
+
+#define BENCH_VRAM_SIZE (16 << 20)
+#define BENCH_WIDTH 1024
+#define BENCH_HEIGHT 768
+
+#define BLT_CLIP0_MIN 0x08
+#define BLT_CLIP0_MAX 0x0c
+#define BLT_DST_BASE_ADDR 0x10
+#define BLT_DST_FORMAT 0x14
+#define BLT_SRC_BASE_ADDR 0x34
+#define BLT_COMMAND_EXTRA 0x38
+#define BLT_COLOR_PATTERN0 0x44
+#define BLT_COLOR_PATTERN1 0x48
+#define BLT_SRC_FORMAT 0x54
+#define BLT_COLOR_BACK 0x60
+#define BLT_COLOR_FORE 0x64
+#define BLT_DST_SIZE 0x68
+#define BLT_DST_XY 0x6c
+#define BLT_COMMAND 0x70
+#define BLT_LAUNCH 0x80
+
+#define CMD_SCREEN_TO_SCREEN_BLT 1
+#define CMD_RECTFILL 5
+#define CMD_PATTERN_MONO (1 << 13)
+#define CMDEXTRA_SRC_COLORKEY (1 << 0)
+
+enum {
+        TEST_SOLID_FILL,
+        TEST_PATTERN_XOR,
+        TEST_WINDOW_DRAG,
+        TEST_SCROLL,
+        TEST_KEYED_COPY,
+
+        TEST_MAX
+};
+
+static const char *test_names[TEST_MAX] = {"solid fill", "pattern xor", "window drag", "scroll", "keyed copy"};
+
+/*Emulator state the blitter refers to*/
+int changeframecount;
+
+void fatal(const char *format, ...) {
+        va_list ap;
+
+        va_start(ap, format);
+        vfprintf(stderr, format, ap);
+        va_end(ap);
+        exit(-1);
+}
+
+void pclog(const char *format, ...) {}
+
+void thread_set_event(event_t *event) {}
+int thread_wait_event(event_t *event, int timeout) { return 0; }
+
+static uint32_t bench_seed;
+
+static uint32_t bench_rand() {
+        bench_seed ^= bench_seed << 13;
+        bench_seed ^= bench_seed >> 17;
+        bench_seed ^= bench_seed << 5;
+        return bench_seed;
+}
+
+static double bench_time(void) {
+#ifdef _WIN32
+        LARGE_INTEGER freq, count;
+
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&count);
+        return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+#endif
+}
+
+static voodoo_t *bench_init(void) {
+        voodoo_t *voodoo = malloc(sizeof(voodoo_t));
+
+        memset(voodoo, 0, sizeof(voodoo_t));
+        voodoo->vram = malloc(BENCH_VRAM_SIZE);
+        voodoo->changedvram = malloc(BENCH_VRAM_SIZE >> 12);
+        voodoo->fb_mask = BENCH_VRAM_SIZE - 1;
+
+        return voodoo;
+}
+
+static void bench_fill_vram(voodoo_t *voodoo) {
+        uint32_t *p = (uint32_t *)voodoo->vram;
+        int c;
+
+        bench_seed = 0x2545f491;
+        for (c = 0; c < BENCH_VRAM_SIZE / 4; c++)
+                p[c] = bench_rand();
+}
+
+/*Issue ops blits of the given test, returns the number of pixels written*/
+static uint64_t bench_run(voodoo_t *voodoo, void (*reg_writel)(voodoo_t *voodoo, uint32_t addr, uint32_t val), int test,
+                          int bpp, int ops) {
+        uint32_t format = (BENCH_WIDTH * (bpp / 8)) | (((bpp == 8) ? 1 : (bpp == 16) ? 3 : 5) << 16);
+        uint64_t pixels = 0;
+        int c;
+
+        bench_seed = 0x9e3779b9 + test;
+
+        reg_writel(voodoo, BLT_CLIP0_MIN, 0);
+        reg_writel(voodoo, BLT_CLIP0_MAX, (BENCH_HEIGHT << 16) | BENCH_WIDTH);
+        reg_writel(voodoo, BLT_DST_FORMAT, format);
+        reg_writel(voodoo, BLT_DST_BASE_ADDR, 0);
+        reg_writel(voodoo, BLT_SRC_FORMAT, format);
+        reg_writel(voodoo, BLT_SRC_BASE_ADDR, 0);
+        reg_writel(voodoo, BLT_COMMAND_EXTRA, (test == TEST_KEYED_COPY) ? CMDEXTRA_SRC_COLORKEY : 0);
+        reg_writel(voodoo, BLT_COLOR_FORE, bench_rand());
+        reg_writel(voodoo, BLT_COLOR_BACK, bench_rand());
+        reg_writel(voodoo, BLT_COLOR_PATTERN0, (test == TEST_SOLID_FILL) ? 0xffffffff : 0xaa55aa55);
+        reg_writel(voodoo, BLT_COLOR_PATTERN1, (test == TEST_SOLID_FILL) ? 0xffffffff : 0xaa55aa55);
+
+        for (c = 0; c < ops; c++) {
+                int w, h, x, y;
+
+                switch (test) {
+                case TEST_SOLID_FILL:
+                case TEST_PATTERN_XOR:
+                        w = 16 + bench_rand() % 384;
+                        h = 16 + bench_rand() % 288;
+                        x = bench_rand() % (BENCH_WIDTH - w);
+                        y = bench_rand() % (BENCH_HEIGHT - h);
+                        reg_writel(voodoo, BLT_DST_SIZE, (h << 16) | w);
+                        reg_writel(voodoo, BLT_COMMAND,
+                                   CMD_RECTFILL | CMD_PATTERN_MONO | ((test == TEST_SOLID_FILL) ? 0xf0000000 : 0x5a000000));
+                        reg_writel(voodoo, BLT_LAUNCH, (y << 16) | x);
+                        break;
+
+                case TEST_WINDOW_DRAG:
+                case TEST_KEYED_COPY:
+                        /*A 400x300 window moved a few pixels up and left*/
+                        w = 400;
+                        h = 300;
+                        x = bench_rand() % (BENCH_WIDTH - w - 8);
+                        y = bench_rand() % (BENCH_HEIGHT - h - 8);
+                        reg_writel(voodoo, BLT_DST_SIZE, (h << 16) | w);
+                        reg_writel(voodoo, BLT_DST_XY, (y << 16) | x);
+                        reg_writel(voodoo, BLT_COMMAND, CMD_SCREEN_TO_SCREEN_BLT | 0xcc000000);
+                        reg_writel(voodoo, BLT_LAUNCH, ((y + 1 + (c & 7)) << 16) | (x + 1 + (c & 7)));
+                        break;
+
+                case TEST_SCROLL:
+                        /*Full width, scrolled up by a text line*/
+                        w = BENCH_WIDTH;
+                        h = BENCH_HEIGHT - 16;
+                        x = y = 0;
+                        reg_writel(voodoo, BLT_DST_SIZE, (h << 16) | w);
+                        reg_writel(voodoo, BLT_DST_XY, 0);
+                        reg_writel(voodoo, BLT_COMMAND, CMD_SCREEN_TO_SCREEN_BLT | 0xcc000000);
+                        reg_writel(voodoo, BLT_LAUNCH, 16 << 16);
+                        break;
+
+                default:
+                        abort();
+                }
+                pixels += (uint64_t)w * h;
+        }
+
+        return pixels;
+}
+
+int main(int argc, char **argv) {
+        int ops = (argc > 1) ? atoi(argv[1]) : 500;
+        voodoo_t *voodoo = bench_init();
+        uint8_t *ref_vram = malloc(BENCH_VRAM_SIZE);
+        int test, bpp;
+
+        if (ops < 1) {
+                fprintf(stderr, "usage: %s [operations]\n", argv[0]);
+                return 1;
+        }
+
+        printf("%d operations per test\n", ops);
+
+        for (bpp = 8; bpp <= 32; bpp *= 2) {
+                for (test = 0; test < TEST_MAX; test++) {
+                        double ref_time, span_time, start;
+                        uint64_t pixels;
+                        char name[64];
+                        int c;
+
+                        /*Scrolls are full screen, so fewer of them*/
+                        int test_ops = (test == TEST_SCROLL) ? (ops + 9) / 10 : ops;
+
+                        bench_fill_vram(voodoo);
+                        start = bench_time();
+                        pixels = bench_run(voodoo, ref_voodoo_2d_reg_writel, test, bpp, test_ops);
+                        ref_time = bench_time() - start;
+                        memcpy(ref_vram, voodoo->vram, BENCH_VRAM_SIZE);
+
+                        bench_fill_vram(voodoo);
+                        start = bench_time();
+                        bench_run(voodoo, voodoo_2d_reg_writel, test, bpp, test_ops);
+                        span_time = bench_time() - start;
+
+                        snprintf(name, sizeof(name), "%s %d bpp", test_names[test], bpp);
+                        for (c = 0; c < BENCH_VRAM_SIZE; c++) {
+                                if (voodoo->vram[c] != ref_vram[c]) {
+                                        printf("%s: VRAM differs at %06x, per-pixel %02x, span %02x\n", name, c, ref_vram[c],
+                                               voodoo->vram[c]);
+                                        return 1;
+                                }
+                        }
+
+                        printf("%-24s per-pixel %8.1f Mpixels/s, span %8.1f Mpixels/s, %.2fx\n", name,
+                               (double)pixels / ref_time / 1000000.0, (double)pixels / span_time / 1000000.0,
+                               ref_time / span_time);
+                }
+        }
+
+        free(ref_vram);
+        return 0;
+}
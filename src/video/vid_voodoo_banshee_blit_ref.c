@@ -0,0 +1,5 @@
+/*Banshee 2D blitter with the span fast paths turned off, for banshee-blit-bench. Every pixel goes
+  through PLOT()/MIX(), as it did before the fast paths were added*/
+#define BANSHEE_BLT_NO_SPAN
+#define voodoo_2d_reg_writel ref_voodoo_2d_reg_writel
+#include "vid_voodoo_banshee_blitter.c"
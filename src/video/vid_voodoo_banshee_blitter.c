@@ -11,6 +11,7 @@
 */
 #include <math.h>
 #include <stddef.h>
+#include <string.h>
 #include "ibm.h"
 #include "device.h"
 #include "mem.h"
@@ -156,6 +157,10 @@ static uint32_t get_addr(voodoo_t *voodoo, int x, int y, int src_notdst, uint32_
 
 static void PLOT(voodoo_t *voodoo, int x, int y, int pat_x, int pat_y, uint8_t pattern_mask, uint8_t rop, uint32_t src,
                  int src_colorkey) {
+#ifdef BANSHEE_BLT_STATS
+        voodoo->banshee_blt.plot_pixel_count++;
+#endif
+
         switch (voodoo->banshee_blt.dstFormat & DST_FORMAT_COL_MASK) {
         case DST_FORMAT_COL_8_BPP: {
                 uint32_t addr =
@@ -345,6 +350,311 @@ static void end_command(voodoo_t *voodoo) {
         }
 }
 
+/*Span fast paths. With colour keying and mono pattern transparency off, ROPs that
+  only combine the destination with one of source, pattern or a constant can be
+  applied to whole runs of pixels rather than going through PLOT()/MIX() for each
+  pixel. Runs are split wherever either surface crosses a tile or wraps round the
+  end of memory.
+
+  BANSHEE_BLT_NO_SPAN turns the fast paths off, for the reference build used by
+  banshee-blit-bench. BANSHEE_BLT_STATS counts pixels written by each path for the
+  status window.*/
+enum {
+        SPAN_NONE = 0,
+        SPAN_FILL,    /*dst = value*/
+        SPAN_XOR,     /*dst ^= value*/
+        SPAN_PATCOPY, /*dst = pattern*/
+        SPAN_PATXOR,  /*dst ^= pattern*/
+        SPAN_SRCCOPY, /*dst = src*/
+        SPAN_SRCXOR   /*dst ^= src*/
+};
+
+typedef struct span_t {
+        int op;
+        int bpp;
+        uint32_t mask;
+        uint32_t value;
+        uint32_t pattern[8]; /*Indexed by (dst_x + patoff_x) & 7*/
+} span_t;
+
+static int span_setup(voodoo_t *voodoo, span_t *span, int has_src) {
+        uint32_t colorFore;
+
+#ifdef BANSHEE_BLT_NO_SPAN
+        return SPAN_NONE;
+#endif
+        if (voodoo->banshee_blt.commandExtra & (CMDEXTRA_SRC_COLORKEY | CMDEXTRA_DST_COLORKEY))
+                return SPAN_NONE;
+        if ((voodoo->banshee_blt.command & (COMMAND_PATTERN_MONO | COMMAND_TRANS_MONO)) ==
+            (COMMAND_PATTERN_MONO | COMMAND_TRANS_MONO))
+                return SPAN_NONE;
+
+        switch (voodoo->banshee_blt.dstFormat & DST_FORMAT_COL_MASK) {
+        case DST_FORMAT_COL_8_BPP:
+                span->bpp = 1;
+                span->mask = 0xff;
+                break;
+        case DST_FORMAT_COL_16_BPP:
+                span->bpp = 2;
+                span->mask = 0xffff;
+                break;
+        case DST_FORMAT_COL_32_BPP:
+                span->bpp = 4;
+                span->mask = 0xffffffff;
+                break;
+        default:
+                return SPAN_NONE;
+        }
+        if ((voodoo->banshee_blt.dstBaseAddr | voodoo->banshee_blt.dst_stride) & (span->bpp - 1))
+                return SPAN_NONE;
+
+        colorFore = voodoo->banshee_blt.colorFore & span->mask;
+        span->value = 0;
+
+        switch (voodoo->banshee_blt.rops[0]) {
+        case 0x00: /*BLACKNESS*/
+                span->op = SPAN_FILL;
+                break;
+        case 0xff: /*WHITENESS*/
+                span->op = SPAN_FILL;
+                span->value = span->mask;
+                break;
+        case 0x55: /*DSTINVERT*/
+                span->op = SPAN_XOR;
+                span->value = span->mask;
+                break;
+        case 0xf0: /*PATCOPY*/
+                span->op = SPAN_PATCOPY;
+                break;
+        case 0x5a: /*PATINVERT*/
+                span->op = SPAN_PATXOR;
+                break;
+        case 0xcc: /*SRCCOPY*/
+                span->op = has_src ? SPAN_SRCCOPY : SPAN_FILL;
+                span->value = colorFore;
+                break;
+        case 0x66: /*SRCINVERT*/
+                span->op = has_src ? SPAN_SRCXOR : SPAN_XOR;
+                span->value = colorFore;
+                break;
+        default:
+                return SPAN_NONE;
+        }
+
+        return span->op;
+}
+
+static void span_setup_pattern(voodoo_t *voodoo, span_t *span, int pat_y) {
+        uint8_t pattern_mask = ((uint8_t *)voodoo->banshee_blt.colorPattern)[pat_y & 7];
+        int c;
+
+        if (span->op != SPAN_PATCOPY && span->op != SPAN_PATXOR)
+                return;
+
+        for (c = 0; c < 8; c++) {
+                uint32_t pattern;
+
+                if (voodoo->banshee_blt.command & COMMAND_PATTERN_MONO)
+                        pattern = (pattern_mask & (1 << (7 - c))) ? voodoo->banshee_blt.colorFore : voodoo->banshee_blt.colorBack;
+                else if (span->bpp == 1)
+                        pattern = voodoo->banshee_blt.colorPattern8[c + (pat_y & 7) * 8];
+                else if (span->bpp == 2)
+                        pattern = voodoo->banshee_blt.colorPattern16[c + (pat_y & 7) * 8];
+                else
+                        pattern = voodoo->banshee_blt.colorPattern[c + (pat_y & 7) * 8];
+
+                span->pattern[c] = pattern & span->mask;
+        }
+}
+
+#define SPAN_LOOP(expr)                                                                                                          \
+        do {                                                                                                                     \
+                switch (span->bpp) {                                                                                             \
+                case 1: {                                                                                                        \
+                        uint8_t *d = dst;                                                                                        \
+                        const uint8_t *s = src;                                                                                  \
+                        (void)s;                                                                                                 \
+                        for (c = 0; c < n; c++)                                                                                  \
+                                d[c] = expr;                                                                                     \
+                        break;                                                                                                   \
+                }                                                                                                                \
+                case 2: {                                                                                                        \
+                        uint16_t *d = (uint16_t *)dst;                                                                           \
+                        const uint16_t *s = (const uint16_t *)src;                                                               \
+                        (void)s;                                                                                                 \
+                        for (c = 0; c < n; c++)                                                                                  \
+                                d[c] = expr;                                                                                     \
+                        break;                                                                                                   \
+                }                                                                                                                \
+                case 4: {                                                                                                        \
+                        uint32_t *d = (uint32_t *)dst;                                                                           \
+                        const uint32_t *s = (const uint32_t *)src;                                                               \
+                        (void)s;                                                                                                 \
+                        for (c = 0; c < n; c++)                                                                                  \
+                                d[c] = expr;                                                                                     \
+                        break;                                                                                                   \
+                }                                                                                                                \
+                }                                                                                                                \
+        } while (0)
+
+static void span_run(voodoo_t *voodoo, span_t *span, uint32_t dst_addr, uint8_t *src, int pat_x, int n) {
+        uint8_t *dst = &voodoo->vram[dst_addr];
+        uint32_t value = span->value;
+        uint32_t *pattern = span->pattern;
+        int c;
+
+        switch (span->op) {
+        case SPAN_FILL:
+                if (span->bpp == 1 || !value || value == span->mask)
+                        memset(dst, value & 0xff, n * span->bpp);
+                else
+                        SPAN_LOOP(value);
+                break;
+        case SPAN_XOR:
+                SPAN_LOOP(d[c] ^ value);
+                break;
+        case SPAN_PATCOPY:
+                SPAN_LOOP(pattern[(pat_x + c) & 7]);
+                break;
+        case SPAN_PATXOR:
+                SPAN_LOOP(d[c] ^ pattern[(pat_x + c) & 7]);
+                break;
+        case SPAN_SRCCOPY:
+                memmove(dst, src, n * span->bpp);
+                break;
+        case SPAN_SRCXOR:
+                SPAN_LOOP(d[c] ^ s[c]);
+                break;
+        }
+
+        for (c = dst_addr >> 12; c <= (dst_addr + n * span->bpp - 1) >> 12; c++)
+                voodoo->changedvram[c] = changeframecount;
+}
+
+static uint32_t span_tiled_offset(uint32_t offset) { return (offset & 127) + ((offset >> 7) * 128 * 32); }
+
+/*Apply span to destination pixels [x0, x1) on row dst_y. src_p, src_x and src_tiled
+  describe the source row as for do_screen_to_screen_line(), with src_x being the source
+  pixel that corresponds to x0. Runs are done right to left when backwards is set, so
+  overlapping copies behave as they do on the per-pixel path.*/
+static void span_row(voodoo_t *voodoo, span_t *span, int x0, int x1, int dst_y, uint8_t *src_p, int src_x, int src_tiled,
+                     int backwards) {
+        int bpp = span->bpp;
+        int src_delta = src_x - x0;
+
+#ifdef BANSHEE_BLT_STATS
+        voodoo->banshee_blt.span_pixel_count += x1 - x0;
+#endif
+
+        while (x0 < x1) {
+                int x = backwards ? (x1 - 1) : x0;
+                uint32_t dst_addr = get_addr(voodoo, x * bpp, dst_y, 0, 0);
+                uint8_t *src = NULL;
+                int n = x1 - x0;
+                int limit;
+
+                if (backwards) {
+                        if (voodoo->banshee_blt.dstBaseAddr_tiled) {
+                                limit = ((x * bpp) & 127) / bpp + 1;
+                                n = MIN(n, limit);
+                        }
+                        if (src_p && src_tiled) {
+                                limit = (((x + src_delta) * bpp) & 127) / bpp + 1;
+                                n = MIN(n, limit);
+                        }
+                        limit = dst_addr / bpp + 1;
+                        n = MIN(n, limit);
+                        x -= n - 1;
+                        dst_addr -= (n - 1) * bpp;
+                        x1 -= n;
+                } else {
+                        if (voodoo->banshee_blt.dstBaseAddr_tiled) {
+                                limit = (128 - ((x * bpp) & 127)) / bpp;
+                                n = MIN(n, limit);
+                        }
+                        if (src_p && src_tiled) {
+                                limit = (128 - (((x + src_delta) * bpp) & 127)) / bpp;
+                                n = MIN(n, limit);
+                        }
+                        limit = (voodoo->fb_mask + 1 - dst_addr) / bpp;
+                        n = MIN(n, limit);
+                        x0 += n;
+                }
+
+                if (src_p) {
+                        uint32_t src_offset = (x + src_delta) * bpp;
+
+                        src = &src_p[src_tiled ? span_tiled_offset(src_offset) : src_offset];
+                }
+
+                span_run(voodoo, span, dst_addr, src, x + voodoo->banshee_blt.patoff_x, n);
+        }
+}
+
+static int span_screen_to_screen_line(voodoo_t *voodoo, uint8_t *src_p, int use_x_dir, int src_x, int src_tiled) {
+        clip_t *clip = &voodoo->banshee_blt.clip[(voodoo->banshee_blt.command & COMMAND_CLIP_SEL) ? 1 : 0];
+        int dst_y = voodoo->banshee_blt.dstY;
+        int backwards = use_x_dir && (voodoo->banshee_blt.command & COMMAND_DX);
+        int x0, x1;
+        span_t span;
+
+        if ((voodoo->banshee_blt.srcFormat & SRC_FORMAT_COL_MASK) != (voodoo->banshee_blt.dstFormat & DST_FORMAT_COL_MASK))
+                return 0;
+        if (!span_setup(voodoo, &span, 1))
+                return 0;
+
+        if (dst_y < clip->y_min || dst_y >= clip->y_max)
+                return 1;
+
+        if (backwards) {
+                x0 = voodoo->banshee_blt.dstX - voodoo->banshee_blt.dstSizeX + 1;
+                x1 = voodoo->banshee_blt.dstX + 1;
+                src_x -= voodoo->banshee_blt.dstSizeX - 1;
+        } else {
+                x0 = voodoo->banshee_blt.dstX;
+                x1 = voodoo->banshee_blt.dstX + voodoo->banshee_blt.dstSizeX;
+        }
+        if (x0 < clip->x_min) {
+                src_x += clip->x_min - x0;
+                x0 = clip->x_min;
+        }
+        if (x1 > clip->x_max)
+                x1 = clip->x_max;
+        if (src_x < 0)
+                return 0;
+
+        if (x0 >= x1) {
+                voodoo->banshee_blt.cur_x = voodoo->banshee_blt.dstSizeX;
+                return 1;
+        }
+
+        if (span.op == SPAN_SRCCOPY || span.op == SPAN_SRCXOR) {
+                /*Where source and destination overlap, only a straight copy along a row in the
+                  direction the blit asks for gives the same result as the per-pixel path*/
+                uint32_t src_first = (uint32_t)src_x * span.bpp, src_last = (uint32_t)(src_x + x1 - x0 - 1) * span.bpp;
+                uint8_t *src_start = src_p + (src_tiled ? span_tiled_offset(src_first) : src_first);
+                uint8_t *src_end = src_p + (src_tiled ? span_tiled_offset(src_last) : src_last) + span.bpp;
+                uint8_t *dst_start = &voodoo->vram[get_addr(voodoo, x0 * span.bpp, dst_y, 0, 0)];
+                uint8_t *dst_end = &voodoo->vram[get_addr(voodoo, (x1 - 1) * span.bpp, dst_y, 0, 0)] + span.bpp;
+
+                if (src_start < dst_end && dst_start < src_end) {
+                        int same_row = (src_tiled == !!voodoo->banshee_blt.dstBaseAddr_tiled) &&
+                                       (src_p == &voodoo->vram[get_addr(voodoo, 0, dst_y, 0, 0)]);
+
+                        if (!same_row || span.op == SPAN_SRCXOR || (backwards ? (src_x > x0) : (src_x < x0)))
+                                return 0;
+                }
+        }
+
+        span_setup_pattern(voodoo, &span,
+                           (voodoo->banshee_blt.commandExtra & CMDEXTRA_FORCE_PAT_ROW0) ? 0
+                                                                                        : (voodoo->banshee_blt.patoff_y + dst_y));
+        span_row(voodoo, &span, x0, x1, dst_y, src_p, src_x, src_tiled, backwards);
+        voodoo->banshee_blt.cur_x = voodoo->banshee_blt.dstSizeX;
+
+        return 1;
+}
+
 static void banshee_do_rectfill(voodoo_t *voodoo) {
         clip_t *clip = &voodoo->banshee_blt.clip[(voodoo->banshee_blt.command & COMMAND_CLIP_SEL) ? 1 : 0];
         int dst_y = voodoo->banshee_blt.dstY;
@@ -355,6 +665,8 @@ static void banshee_do_rectfill(voodoo_t *voodoo) {
         int use_pattern_trans = (voodoo->banshee_blt.command & (COMMAND_PATTERN_MONO | COMMAND_TRANS_MONO)) ==
                                 (COMMAND_PATTERN_MONO | COMMAND_TRANS_MONO);
         uint8_t rop = voodoo->banshee_blt.command >> 24;
+        span_t span;
+        int use_span = span_setup(voodoo, &span, 0);
 
         //        pclog("banshee_do_rectfill: size=%i,%i  dst=%i,%i\n", voodoo->banshee_blt.dstSizeX,
         //        voodoo->banshee_blt.dstSizeY, voodoo->banshee_blt.dstX, voodoo->banshee_blt.dstY); pclog("clipping: %i,%i ->
@@ -364,7 +676,18 @@ static void banshee_do_rectfill(voodoo_t *voodoo) {
              voodoo->banshee_blt.cur_y++) {
                 int dst_x = voodoo->banshee_blt.dstX;
 
-                if (dst_y >= clip->y_min && dst_y < clip->y_max) {
+                if (dst_y >= clip->y_min && dst_y < clip->y_max && use_span) {
+                        int x0 = (voodoo->banshee_blt.command & COMMAND_DX) ? (dst_x - voodoo->banshee_blt.dstSizeX + 1) : dst_x;
+                        int x1 = x0 + voodoo->banshee_blt.dstSizeX;
+
+                        x0 = MAX(x0, clip->x_min);
+                        x1 = MIN(x1, clip->x_max);
+                        if (x0 < x1) {
+                                span_setup_pattern(voodoo, &span, pat_y);
+                                span_row(voodoo, &span, x0, x1, dst_y, NULL, 0, 0, 0);
+                        }
+                        voodoo->banshee_blt.cur_x = voodoo->banshee_blt.dstSizeX;
+                } else if (dst_y >= clip->y_min && dst_y < clip->y_max) {
                         int pat_x = voodoo->banshee_blt.patoff_x + voodoo->banshee_blt.dstX;
                         uint8_t pattern_mask = pattern_mono[pat_y & 7];
 
@@ -400,6 +723,12 @@ static void do_screen_to_screen_line(voodoo_t *voodoo, uint8_t *src_p, int use_x
         uint8_t rop = voodoo->banshee_blt.command >> 24;
         int src_colorkey;
 
+        if (span_screen_to_screen_line(voodoo, src_p, use_x_dir, src_x, src_tiled)) {
+                voodoo->banshee_blt.srcY += (voodoo->banshee_blt.command & COMMAND_DY) ? -1 : 1;
+                voodoo->banshee_blt.dstY += (voodoo->banshee_blt.command & COMMAND_DY) ? -1 : 1;
+                return;
+        }
+
         switch (voodoo->banshee_blt.srcFormat & SRC_FORMAT_COL_MASK) {
         case SRC_FORMAT_COL_8_BPP:
                 src_colorkey = COLORKEY_8;
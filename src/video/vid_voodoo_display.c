@@ -1,4 +1,9 @@
 #include <assert.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "ibm.h"
 #include "device.h"
 #include "mem.h"
@@ -108,6 +113,10 @@ void voodoo_generate_filter_v1(voodoo_t *voodoo) {
         float thiscol, thiscolg, thiscolb, lined;
         float fcr, fcg, fcb;
 
+        voodoo->filter_cap[0] = FILTCAPB;
+        voodoo->filter_cap[1] = FILTCAPG;
+        voodoo->filter_cap[2] = FILTCAP;
+
         fcr = FILTCAP * 5;
         fcg = FILTCAPG * 6;
         fcb = FILTCAPB * 5;
@@ -189,6 +198,10 @@ void voodoo_generate_filter_v2(voodoo_t *voodoo) {
         float clr, clg, clb = 0;
         float fcr, fcg, fcb = 0;
 
+        voodoo->filter_cap[0] = FILTCAPB;
+        voodoo->filter_cap[1] = FILTCAPG;
+        voodoo->filter_cap[2] = FILTCAP;
+
         // pre-clamping
 
         fcr = FILTCAP;
@@ -314,124 +327,390 @@ void voodoo_threshold_check(voodoo_t *voodoo) {
         }
 }
 
-static void voodoo_filterline_v1(voodoo_t *voodoo, uint8_t *fil, int column, uint16_t *src, int line) {
+/*The screen filter is applied to each colour channel separately, on planar 8-bit lines. The
+  filter tables are indexed [pixel][neighbour] and reduce to simple arithmetic on the channel
+  threshold, so whole spans of 16 pixels can be filtered with SIMD; any remainder uses the
+  tables.
+
+  v1 : result = (2*pixel + clamp(neighbour - pixel, -cap, cap)) / 2
+  v2 : if the neighbour is brighter by no more than cap, result = pixel + min(avgdiff, cap, 32),
+       where avgdiff = (pixel + 4*neighbour)/5 - (4*pixel + neighbour)/5, otherwise pixel*/
+#define FILTER_LINE_SIZE (4096 + 16)
+
+#if defined(__SSE2__)
+static int voodoo_filter_span_v1_simd(uint8_t *dst, const uint8_t *pix, const uint8_t *nb, int count, int cap) {
+        const __m128i cap_v = _mm_set1_epi8(cap);
+        const __m128i one = _mm_set1_epi8(1);
         int x;
 
-        // Scratchpad for avoiding feedback streaks
-        uint8_t fil3[4096 * 3];
+        for (x = 0; x + 16 <= count; x += 16) {
+                __m128i g = _mm_loadu_si128((const __m128i *)&pix[x]);
+                __m128i h = _mm_loadu_si128((const __m128i *)&nb[x]);
+                __m128i lo = _mm_subs_epu8(g, cap_v);
+                __m128i hi = _mm_adds_epu8(g, cap_v);
+
+                h = _mm_min_epu8(_mm_max_epu8(h, lo), hi);
+                /*avg_epu8 rounds up, correct back to a truncating average*/
+                _mm_storeu_si128((__m128i *)&dst[x],
+                                 _mm_sub_epi8(_mm_avg_epu8(g, h), _mm_and_si128(_mm_xor_si128(g, h), one)));
+        }
+
+        return x;
+}
+
+static inline __m128i voodoo_filter_v2_16(__m128i g, __m128i h, __m128i cap_v, __m128i lim_v) {
+        const __m128i div5 = _mm_set1_epi16(13108); /*(x * 13108) >> 16 == x / 5 for x <= 1275*/
+        __m128i hi_avg = _mm_mulhi_epu16(_mm_add_epi16(g, _mm_slli_epi16(h, 2)), div5);
+        __m128i lo_avg = _mm_mulhi_epu16(_mm_add_epi16(_mm_slli_epi16(g, 2), h), div5);
+        __m128i res = _mm_add_epi16(g, _mm_min_epi16(_mm_sub_epi16(hi_avg, lo_avg), lim_v));
+        __m128i diff = _mm_sub_epi16(h, g);
+        __m128i mask = _mm_andnot_si128(_mm_cmpgt_epi16(diff, cap_v), _mm_cmpgt_epi16(diff, _mm_setzero_si128()));
 
-        assert(voodoo->h_disp <= 4096);
+        return _mm_or_si128(_mm_and_si128(mask, res), _mm_andnot_si128(mask, g));
+}
+
+static int voodoo_filter_span_v2_simd(uint8_t *dst, const uint8_t *pix, const uint8_t *nb, int count, int cap) {
+        const __m128i cap_v = _mm_set1_epi16(cap);
+        const __m128i lim_v = _mm_set1_epi16((cap > 32) ? 32 : cap);
+        const __m128i zero = _mm_setzero_si128();
+        int x;
 
-        /* 16 to 32-bit */
-        for (x = 0; x < column; x++) {
-                fil[x * 3] = ((src[x] & 31) << 3);
-                fil[x * 3 + 1] = (((src[x] >> 5) & 63) << 2);
-                fil[x * 3 + 2] = (((src[x] >> 11) & 31) << 3);
+        for (x = 0; x + 16 <= count; x += 16) {
+                __m128i g = _mm_loadu_si128((const __m128i *)&pix[x]);
+                __m128i h = _mm_loadu_si128((const __m128i *)&nb[x]);
+                __m128i res_l = voodoo_filter_v2_16(_mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(h, zero), cap_v, lim_v);
+                __m128i res_h = voodoo_filter_v2_16(_mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(h, zero), cap_v, lim_v);
 
-                // Copy to our scratchpads
-                fil3[x * 3 + 0] = fil[x * 3 + 0];
-                fil3[x * 3 + 1] = fil[x * 3 + 1];
-                fil3[x * 3 + 2] = fil[x * 3 + 2];
+                _mm_storeu_si128((__m128i *)&dst[x], _mm_packus_epi16(res_l, res_h));
         }
 
-        /* lines */
+        return x;
+}
+#elif defined(__ARM_NEON)
+static int voodoo_filter_span_v1_simd(uint8_t *dst, const uint8_t *pix, const uint8_t *nb, int count, int cap) {
+        const uint8x16_t cap_v = vdupq_n_u8(cap);
+        int x;
 
-        if (line & 1) {
-                for (x = 0; x < column; x++) {
-                        fil[x * 3] = voodoo->purpleline[fil[x * 3]][0];
-                        fil[x * 3 + 1] = voodoo->purpleline[fil[x * 3 + 1]][1];
-                        fil[x * 3 + 2] = voodoo->purpleline[fil[x * 3 + 2]][2];
-                }
+        for (x = 0; x + 16 <= count; x += 16) {
+                uint8x16_t g = vld1q_u8(&pix[x]);
+                uint8x16_t h = vld1q_u8(&nb[x]);
+
+                h = vminq_u8(vmaxq_u8(h, vqsubq_u8(g, cap_v)), vqaddq_u8(g, cap_v));
+                vst1q_u8(&dst[x], vhaddq_u8(g, h));
         }
 
-        /* filtering time */
+        return x;
+}
+
+static inline int16x8_t voodoo_filter_v2_8(int16x8_t g, int16x8_t h, int16x8_t cap_v, int16x8_t lim_v) {
+        const int16x8_t div5 = vdupq_n_s16(6554); /*(2 * x * 6554) >> 16 == x / 5 for x <= 1275*/
+        int16x8_t hi_avg = vqdmulhq_s16(vaddq_s16(g, vshlq_n_s16(h, 2)), div5);
+        int16x8_t lo_avg = vqdmulhq_s16(vaddq_s16(vshlq_n_s16(g, 2), h), div5);
+        int16x8_t res = vaddq_s16(g, vminq_s16(vsubq_s16(hi_avg, lo_avg), lim_v));
+        int16x8_t diff = vsubq_s16(h, g);
+        uint16x8_t mask = vandq_u16(vcgtq_s16(diff, vdupq_n_s16(0)), vcleq_s16(diff, cap_v));
+
+        return vbslq_s16(mask, res, g);
+}
+
+static int voodoo_filter_span_v2_simd(uint8_t *dst, const uint8_t *pix, const uint8_t *nb, int count, int cap) {
+        const int16x8_t cap_v = vdupq_n_s16(cap);
+        const int16x8_t lim_v = vdupq_n_s16((cap > 32) ? 32 : cap);
+        int x;
+
+        for (x = 0; x + 16 <= count; x += 16) {
+                uint8x16_t g = vld1q_u8(&pix[x]);
+                uint8x16_t h = vld1q_u8(&nb[x]);
+                int16x8_t res_l = voodoo_filter_v2_8(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(g))),
+                                                     vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(h))), cap_v, lim_v);
+                int16x8_t res_h = voodoo_filter_v2_8(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(g))),
+                                                     vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(h))), cap_v, lim_v);
 
-        for (x = 1; x < column; x++) {
-                fil3[(x)*3] = voodoo->thefilterb[fil[x * 3]][fil[(x - 1) * 3]];
-                fil3[(x)*3 + 1] = voodoo->thefilterg[fil[x * 3 + 1]][fil[(x - 1) * 3 + 1]];
-                fil3[(x)*3 + 2] = voodoo->thefilter[fil[x * 3 + 2]][fil[(x - 1) * 3 + 2]];
+                vst1q_u8(&dst[x], vcombine_u8(vqmovun_s16(res_l), vqmovun_s16(res_h)));
         }
 
-        for (x = 1; x < column; x++) {
-                fil[(x)*3] = voodoo->thefilterb[fil3[x * 3]][fil3[(x - 1) * 3]];
-                fil[(x)*3 + 1] = voodoo->thefilterg[fil3[x * 3 + 1]][fil3[(x - 1) * 3 + 1]];
-                fil[(x)*3 + 2] = voodoo->thefilter[fil3[x * 3 + 2]][fil3[(x - 1) * 3 + 2]];
+        return x;
+}
+#endif
+
+static inline uint8_t voodoo_filter_pixel(voodoo_t *voodoo, int ch, uint8_t pix, uint8_t nb) {
+        if (ch == 0)
+                return voodoo->thefilterb[pix][nb];
+        if (ch == 1)
+                return voodoo->thefilterg[pix][nb];
+        return voodoo->thefilter[pix][nb];
+}
+
+/*dst[x] = filter(pix[x], nb[x]) for one channel. dst must not overlap either source*/
+static void voodoo_filter_span(voodoo_t *voodoo, int ch, uint8_t *dst, const uint8_t *pix, const uint8_t *nb, int count) {
+        uint8_t(*table)[256] = (ch == 0) ? voodoo->thefilterb : ((ch == 1) ? voodoo->thefilterg : voodoo->thefilter);
+        int x = 0;
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+        if (voodoo->type == VOODOO_2)
+                x = voodoo_filter_span_v2_simd(dst, pix, nb, count, voodoo->filter_cap[ch]);
+        else
+                x = voodoo_filter_span_v1_simd(dst, pix, nb, count, voodoo->filter_cap[ch]);
+#endif
+        for (; x < count; x++)
+                dst[x] = table[pix[x]][nb[x]];
+}
+
+/*Expand RGB565 into planar 8-bit blue/green/red*/
+static void voodoo_filter_expand(uint8_t *b, uint8_t *g, uint8_t *r, const uint16_t *src, int count) {
+        int x = 0;
+
+#if defined(__SSE2__)
+        const __m128i mask_b = _mm_set1_epi16(0xf8);
+        const __m128i mask_g = _mm_set1_epi16(0xfc);
+
+        for (; x + 16 <= count; x += 16) {
+                __m128i s0 = _mm_loadu_si128((const __m128i *)&src[x]);
+                __m128i s1 = _mm_loadu_si128((const __m128i *)&src[x + 8]);
+
+                _mm_storeu_si128((__m128i *)&b[x], _mm_packus_epi16(_mm_and_si128(_mm_slli_epi16(s0, 3), mask_b),
+                                                                    _mm_and_si128(_mm_slli_epi16(s1, 3), mask_b)));
+                _mm_storeu_si128((__m128i *)&g[x], _mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(s0, 3), mask_g),
+                                                                    _mm_and_si128(_mm_srli_epi16(s1, 3), mask_g)));
+                _mm_storeu_si128((__m128i *)&r[x], _mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(s0, 8), mask_b),
+                                                                    _mm_and_si128(_mm_srli_epi16(s1, 8), mask_b)));
         }
+#elif defined(__ARM_NEON)
+        for (; x + 8 <= count; x += 8) {
+                uint16x8_t s = vld1q_u16(&src[x]);
 
-        for (x = 1; x < column; x++) {
-                fil3[(x)*3] = voodoo->thefilterb[fil[x * 3]][fil[(x - 1) * 3]];
-                fil3[(x)*3 + 1] = voodoo->thefilterg[fil[x * 3 + 1]][fil[(x - 1) * 3 + 1]];
-                fil3[(x)*3 + 2] = voodoo->thefilter[fil[x * 3 + 2]][fil[(x - 1) * 3 + 2]];
+                vst1_u8(&b[x], vmovn_u16(vandq_u16(vshlq_n_u16(s, 3), vdupq_n_u16(0xf8))));
+                vst1_u8(&g[x], vmovn_u16(vandq_u16(vshrq_n_u16(s, 3), vdupq_n_u16(0xfc))));
+                vst1_u8(&r[x], vand_u8(vshrn_n_u16(s, 8), vdup_n_u8(0xf8)));
+        }
+#endif
+        for (; x < count; x++) {
+                b[x] = (src[x] & 31) << 3;
+                g[x] = ((src[x] >> 5) & 63) << 2;
+                r[x] = ((src[x] >> 11) & 31) << 3;
         }
+}
 
-        for (x = 0; x < column - 1; x++) {
-                fil[(x)*3] = voodoo->thefilterb[fil3[x * 3]][fil3[(x + 1) * 3]];
-                fil[(x)*3 + 1] = voodoo->thefilterg[fil3[x * 3 + 1]][fil3[(x + 1) * 3 + 1]];
-                fil[(x)*3 + 2] = voodoo->thefilter[fil3[x * 3 + 2]][fil3[(x + 1) * 3 + 2]];
+static void voodoo_filterline_v1(voodoo_t *voodoo, uint8_t *fil[3], int column, uint16_t *src, int line) {
+        /* Scratchpad for avoiding feedback streaks */
+        uint8_t fil3[FILTER_LINE_SIZE];
+        int ch, x;
+
+        voodoo_filter_expand(fil[0], fil[1], fil[2], src, column);
+
+        for (ch = 0; ch < 3; ch++) {
+                uint8_t *f = fil[ch];
+
+                fil3[0] = f[0];
+
+                /* lines */
+                if ((line & 1) && ch != 1) {
+                        for (x = 0; x < column; x++)
+                                f[x] = voodoo->purpleline[f[x]][ch];
+                }
+
+                /* filtering time */
+                if (column > 1) {
+                        voodoo_filter_span(voodoo, ch, &fil3[1], &f[1], &f[0], column - 1);
+                        voodoo_filter_span(voodoo, ch, &f[1], &fil3[1], &fil3[0], column - 1);
+                        voodoo_filter_span(voodoo, ch, &fil3[1], &f[1], &f[0], column - 1);
+                        voodoo_filter_span(voodoo, ch, &f[0], &fil3[0], &fil3[1], column - 1);
+                }
         }
 }
 
-static void voodoo_filterline_v2(voodoo_t *voodoo, uint8_t *fil, int column, uint16_t *src, int line) {
+/*Reference version of the v2 filter, interleaved as the tables were originally used. Only used
+  for degenerate display widths*/
+static void voodoo_filterline_v2_small(voodoo_t *voodoo, uint8_t *fil[3], int column, uint16_t *src) {
+        uint8_t s[3][8 + 1], f[8], f3[8];
+        int ch, x;
+
+        voodoo_filter_expand(s[0], s[1], s[2], src, column + 1);
+
+        for (ch = 0; ch < 3; ch++) {
+                uint8_t *sc = s[ch];
+
+                for (x = 0; x < column; x++)
+                        f[x] = f3[x] = sc[x];
+
+                for (x = 1; x < column - 3; x++) {
+                        f3[x + 3] = voodoo_filter_pixel(voodoo, ch, sc[x + 3], sc[x]);
+                        f[x + 2] = voodoo_filter_pixel(voodoo, ch, f3[x + 2], sc[x]);
+                        f3[x + 1] = voodoo_filter_pixel(voodoo, ch, f[x + 1], sc[x]);
+                        f[x - 1] = voodoo_filter_pixel(voodoo, ch, f3[x - 1], sc[x]);
+                }
+
+                for (x = 0; x < column; x++) {
+                        if (x >= column - 2) {
+                                uint8_t t = voodoo_filter_pixel(voodoo, ch, sc[x], sc[column]);
+
+                                fil[ch][x] = voodoo_filter_pixel(voodoo, ch, t, sc[column]);
+                        } else
+                                fil[ch][x] = f[x];
+                }
+        }
+}
+
+static void voodoo_filterline_v2(voodoo_t *voodoo, uint8_t *fil[3], int column, uint16_t *src) {
+        /* Scratchpads for blending filter. a, b and c hold the successive filter stages, offset so
+           that each stage reads the previous one at the same index*/
+        uint8_t s[3][FILTER_LINE_SIZE];
+        uint8_t a[FILTER_LINE_SIZE], b[FILTER_LINE_SIZE], c[FILTER_LINE_SIZE];
+        int ch, n = column;
+
+        if (column < 8) {
+                voodoo_filterline_v2_small(voodoo, fil, column, src);
+                return;
+        }
+
+        /* 16 to 32-bit, including the pixel past the end of the line used by the edge cases */
+        voodoo_filter_expand(s[0], s[1], s[2], src, column + 1);
+
+        for (ch = 0; ch < 3; ch++) {
+                uint8_t *sc = s[ch];
+                uint8_t t1, t2;
+
+                a[1] = sc[3];
+                voodoo_filter_span(voodoo, ch, &a[2], &sc[4], &sc[1], n - 4);
+                b[1] = sc[2];
+                voodoo_filter_span(voodoo, ch, &b[2], &a[1], &sc[1], n - 4);
+                c[1] = sc[0];
+                c[2] = sc[1];
+                voodoo_filter_span(voodoo, ch, &c[3], &b[1], &sc[1], n - 4);
+                voodoo_filter_span(voodoo, ch, fil[ch], &c[1], &sc[1], n - 4);
+
+                fil[ch][n - 4] = b[n - 5];
+                fil[ch][n - 3] = b[n - 4];
+
+                /* unroll for edge cases */
+                t2 = voodoo_filter_pixel(voodoo, ch, sc[n - 2], sc[n]);
+                t1 = voodoo_filter_pixel(voodoo, ch, sc[n - 1], sc[n]);
+                fil[ch][n - 2] = voodoo_filter_pixel(voodoo, ch, t2, sc[n]);
+                fil[ch][n - 1] = voodoo_filter_pixel(voodoo, ch, t1, sc[n]);
+        }
+}
+
+static void voodoo_display_convert_line(voodoo_t *voodoo, voodoo_display_line_t *display_line) {
+        uint32_t *p = &((uint32_t *)buffer32->line[display_line->line])[32];
+        uint16_t *src = display_line->src;
         int x;
 
-        // Scratchpad for blending filter
-        uint8_t fil3[4096 * 3];
+        if (voodoo->scrfilter && voodoo->scrfilterEnabled) {
+                uint8_t fil_b[FILTER_LINE_SIZE], fil_g[FILTER_LINE_SIZE], fil_r[FILTER_LINE_SIZE];
+                uint8_t *fil[3] = {fil_b, fil_g, fil_r};
 
-        assert(voodoo->h_disp <= 4096);
+                assert(voodoo->h_disp <= 4096);
+
+                if (voodoo->type == VOODOO_2)
+                        voodoo_filterline_v2(voodoo, fil, voodoo->h_disp, src);
+                else
+                        voodoo_filterline_v1(voodoo, fil, voodoo->h_disp, src, display_line->line);
 
-        /* 16 to 32-bit */
-        for (x = 0; x < column; x++) {
-                // Blank scratchpads
-                fil3[x * 3 + 0] = fil[x * 3 + 0] = ((src[x] & 31) << 3);
-                fil3[x * 3 + 1] = fil[x * 3 + 1] = (((src[x] >> 5) & 63) << 2);
-                fil3[x * 3 + 2] = fil[x * 3 + 2] = (((src[x] >> 11) & 31) << 3);
+                for (x = 0; x < voodoo->h_disp; x++) {
+                        p[x] = (voodoo->clutData256[fil_b[x]].b << 0 | voodoo->clutData256[fil_g[x]].g << 8 |
+                                voodoo->clutData256[fil_r[x]].r << 16);
+                }
+        } else {
+                uint32_t *video_16to32 = display_line->draw_voodoo->video_16to32;
+
+                for (x = 0; x < voodoo->h_disp; x++)
+                        p[x] = video_16to32[src[x]];
         }
+}
+
+/*Displayed lines are queued by voodoo_callback() as the raster passes them, and converted into
+  buffer32 in one go before the frame is blitted. With more than one render thread the queue is
+  shared between the emulation thread and the display threads, one line in every
+  display_threads each*/
+static void voodoo_display_convert_lines(voodoo_t *voodoo, int thread) {
+        int c;
 
-        /* filtering time */
+        for (c = thread; c < voodoo->nr_display_lines; c += voodoo->display_threads)
+                voodoo_display_convert_line(voodoo, &voodoo->display_line[c]);
+}
 
-        for (x = 1; x < column - 3; x++) {
-                fil3[(x + 3) * 3] = voodoo->thefilterb[((src[x + 3] & 31) << 3)][((src[x] & 31) << 3)];
-                fil3[(x + 3) * 3 + 1] = voodoo->thefilterg[(((src[x + 3] >> 5) & 63) << 2)][(((src[x] >> 5) & 63) << 2)];
-                fil3[(x + 3) * 3 + 2] = voodoo->thefilter[(((src[x + 3] >> 11) & 31) << 3)][(((src[x] >> 11) & 31) << 3)];
+static void voodoo_display_thread(void *param) {
+        voodoo_render_worker_t *worker = (voodoo_render_worker_t *)param;
+        voodoo_t *voodoo = worker->voodoo;
+        int thread = worker->index;
 
-                fil[(x + 2) * 3] = voodoo->thefilterb[fil3[(x + 2) * 3]][((src[x] & 31) << 3)];
-                fil[(x + 2) * 3 + 1] = voodoo->thefilterg[fil3[(x + 2) * 3 + 1]][(((src[x] >> 5) & 63) << 2)];
-                fil[(x + 2) * 3 + 2] = voodoo->thefilter[fil3[(x + 2) * 3 + 2]][(((src[x] >> 11) & 31) << 3)];
+        while (1) {
+                thread_wait_event(voodoo->wake_display_thread[thread], -1);
+                thread_reset_event(voodoo->wake_display_thread[thread]);
 
-                fil3[(x + 1) * 3] = voodoo->thefilterb[fil[(x + 1) * 3]][((src[x] & 31) << 3)];
-                fil3[(x + 1) * 3 + 1] = voodoo->thefilterg[fil[(x + 1) * 3 + 1]][(((src[x] >> 5) & 63) << 2)];
-                fil3[(x + 1) * 3 + 2] = voodoo->thefilter[fil[(x + 1) * 3 + 2]][(((src[x] >> 11) & 31) << 3)];
+                voodoo_display_convert_lines(voodoo, thread);
 
-                fil[(x - 1) * 3] = voodoo->thefilterb[fil3[(x - 1) * 3]][((src[x] & 31) << 3)];
-                fil[(x - 1) * 3 + 1] = voodoo->thefilterg[fil3[(x - 1) * 3 + 1]][(((src[x] >> 5) & 63) << 2)];
-                fil[(x - 1) * 3 + 2] = voodoo->thefilter[fil3[(x - 1) * 3 + 2]][(((src[x] >> 11) & 31) << 3)];
+                thread_set_event(voodoo->display_done_event[thread]);
         }
+}
+
+static void voodoo_display_flush(voodoo_t *voodoo) {
+        int c;
 
-        // unroll for edge cases
+        if (!voodoo->nr_display_lines)
+                return;
 
-        fil3[(column - 3) * 3] = voodoo->thefilterb[((src[column - 3] & 31) << 3)][((src[column] & 31) << 3)];
-        fil3[(column - 3) * 3 + 1] = voodoo->thefilterg[(((src[column - 3] >> 5) & 63) << 2)][(((src[column] >> 5) & 63) << 2)];
-        fil3[(column - 3) * 3 + 2] = voodoo->thefilter[(((src[column - 3] >> 11) & 31) << 3)][(((src[column] >> 11) & 31) << 3)];
+        video_wait_for_buffer();
 
-        fil3[(column - 2) * 3] = voodoo->thefilterb[((src[column - 2] & 31) << 3)][((src[column] & 31) << 3)];
-        fil3[(column - 2) * 3 + 1] = voodoo->thefilterg[(((src[column - 2] >> 5) & 63) << 2)][(((src[column] >> 5) & 63) << 2)];
-        fil3[(column - 2) * 3 + 2] = voodoo->thefilter[(((src[column - 2] >> 11) & 31) << 3)][(((src[column] >> 11) & 31) << 3)];
+        if (voodoo->display_threads > 1 && voodoo->nr_display_lines > 1) {
+                for (c = 1; c < voodoo->display_threads; c++) {
+                        thread_reset_event(voodoo->display_done_event[c]);
+                        thread_set_event(voodoo->wake_display_thread[c]);
+                }
+                voodoo_display_convert_lines(voodoo, 0);
+                for (c = 1; c < voodoo->display_threads; c++)
+                        thread_wait_event(voodoo->display_done_event[c], -1);
+        } else {
+                for (c = 0; c < voodoo->nr_display_lines; c++)
+                        voodoo_display_convert_line(voodoo, &voodoo->display_line[c]);
+        }
 
-        fil3[(column - 1) * 3] = voodoo->thefilterb[((src[column - 1] & 31) << 3)][((src[column] & 31) << 3)];
-        fil3[(column - 1) * 3 + 1] = voodoo->thefilterg[(((src[column - 1] >> 5) & 63) << 2)][(((src[column] >> 5) & 63) << 2)];
-        fil3[(column - 1) * 3 + 2] = voodoo->thefilter[(((src[column - 1] >> 11) & 31) << 3)][(((src[column] >> 11) & 31) << 3)];
+        voodoo->nr_display_lines = 0;
+}
 
-        fil[(column - 2) * 3] = voodoo->thefilterb[fil3[(column - 2) * 3]][((src[column] & 31) << 3)];
-        fil[(column - 2) * 3 + 1] = voodoo->thefilterg[fil3[(column - 2) * 3 + 1]][(((src[column] >> 5) & 63) << 2)];
-        fil[(column - 2) * 3 + 2] = voodoo->thefilter[fil3[(column - 2) * 3 + 2]][(((src[column] >> 11) & 31) << 3)];
+/*Queued lines point into the front buffer, so they must be converted before front_offset is changed. May be
+  called from the FIFO thread*/
+void voodoo_display_flush_front(voodoo_t *voodoo) {
+        voodoo_t *owner = SLI_ENABLED ? voodoo->set->voodoos[0] : voodoo;
 
-        fil[(column - 1) * 3] = voodoo->thefilterb[fil3[(column - 1) * 3]][((src[column] & 31) << 3)];
-        fil[(column - 1) * 3 + 1] = voodoo->thefilterg[fil3[(column - 1) * 3 + 1]][(((src[column] >> 5) & 63) << 2)];
-        fil[(column - 1) * 3 + 2] = voodoo->thefilter[fil3[(column - 1) * 3 + 2]][(((src[column] >> 11) & 31) << 3)];
+        /*Banshee and later do not queue display lines*/
+        if (!owner->display_mutex)
+                return;
 
-        fil3[(column - 1) * 3] = voodoo->thefilterb[fil[(column - 1) * 3]][((src[column] & 31) << 3)];
-        fil3[(column - 1) * 3 + 1] = voodoo->thefilterg[fil[(column - 1) * 3 + 1]][(((src[column] >> 5) & 63) << 2)];
-        fil3[(column - 1) * 3 + 2] = voodoo->thefilter[fil[(column - 1) * 3 + 2]][(((src[column] >> 11) & 31) << 3)];
+        thread_lock_mutex(owner->display_mutex);
+        voodoo_display_flush(owner);
+        thread_unlock_mutex(owner->display_mutex);
+}
+
+void voodoo_display_init(voodoo_t *voodoo) {
+        int c;
+
+        voodoo->display_mutex = thread_create_mutex();
+
+        voodoo->display_threads = voodoo->render_threads;
+        if (voodoo->display_threads < 1)
+                voodoo->display_threads = 1;
+        if (voodoo->display_threads > VOODOO_MAX_DISPLAY_THREADS)
+                voodoo->display_threads = VOODOO_MAX_DISPLAY_THREADS;
+
+        for (c = 1; c < voodoo->display_threads; c++) {
+                voodoo->display_worker[c].voodoo = voodoo;
+                voodoo->display_worker[c].index = c;
+                voodoo->wake_display_thread[c] = thread_create_event();
+                voodoo->display_done_event[c] = thread_create_event();
+                voodoo->display_thread[c] = thread_create(voodoo_display_thread, &voodoo->display_worker[c]);
+        }
+}
+
+void voodoo_display_close(voodoo_t *voodoo) {
+        int c;
+
+        for (c = 1; c < voodoo->display_threads; c++) {
+                thread_kill(voodoo->display_thread[c]);
+                thread_destroy_event(voodoo->wake_display_thread[c]);
+                thread_destroy_event(voodoo->display_done_event[c]);
+        }
+        thread_destroy_mutex(voodoo->display_mutex);
 }
 
 void voodoo_callback(void *p) {
@@ -459,40 +738,25 @@ void voodoo_callback(void *p) {
                         }
 
                         if (draw_voodoo->dirty_line[draw_line]) {
-                                uint32_t *p = &((uint32_t *)buffer32->line[voodoo->line])[32];
-                                uint16_t *src = (uint16_t *)&draw_voodoo
-                                                        ->fb_mem[draw_voodoo->front_offset + draw_line * draw_voodoo->row_width];
-                                int x;
+                                voodoo_display_line_t *display_line;
+
+                                thread_lock_mutex(voodoo->display_mutex);
+                                if (voodoo->nr_display_lines == VOODOO_MAX_DISPLAY_LINES)
+                                        voodoo_display_flush(voodoo);
+                                display_line = &voodoo->display_line[voodoo->nr_display_lines++];
 
                                 draw_voodoo->dirty_line[draw_line] = 0;
 
-                                if (voodoo->line < voodoo->dirty_line_low) {
+                                if (voodoo->line < voodoo->dirty_line_low)
                                         voodoo->dirty_line_low = voodoo->line;
-                                        video_wait_for_buffer();
-                                }
                                 if (voodoo->line > voodoo->dirty_line_high)
                                         voodoo->dirty_line_high = voodoo->line;
 
-                                if (voodoo->scrfilter && voodoo->scrfilterEnabled) {
-                                        uint8_t fil[4096 * 3]; /* interleaved 24-bit RGB */
-
-                                        assert(voodoo->h_disp <= 4096);
-
-                                        if (voodoo->type == VOODOO_2)
-                                                voodoo_filterline_v2(voodoo, fil, voodoo->h_disp, src, voodoo->line);
-                                        else
-                                                voodoo_filterline_v1(voodoo, fil, voodoo->h_disp, src, voodoo->line);
-
-                                        for (x = 0; x < voodoo->h_disp; x++) {
-                                                p[x] = (voodoo->clutData256[fil[x * 3]].b << 0 |
-                                                        voodoo->clutData256[fil[x * 3 + 1]].g << 8 |
-                                                        voodoo->clutData256[fil[x * 3 + 2]].r << 16);
-                                        }
-                                } else {
-                                        for (x = 0; x < voodoo->h_disp; x++) {
-                                                p[x] = draw_voodoo->video_16to32[src[x]];
-                                        }
-                                }
+                                display_line->draw_voodoo = draw_voodoo;
+                                display_line->src = (uint16_t *)&draw_voodoo->fb_mem[draw_voodoo->front_offset +
+                                                                                     draw_line * draw_voodoo->row_width];
+                                display_line->line = voodoo->line;
+                                thread_unlock_mutex(voodoo->display_mutex);
                         }
                 }
         }
@@ -505,6 +769,9 @@ skip_draw:
                         if (voodoo == voodoo->set->voodoos[0]) {
                                 voodoo_t *voodoo_1 = voodoo->set->voodoos[1];
 
+                                if (voodoo->swap_pending && voodoo_1->swap_pending)
+                                        voodoo_display_flush_front(voodoo);
+
                                 thread_lock_mutex(voodoo->swap_mutex);
                                 /*Only swap if both Voodoos are waiting for buffer swap*/
                                 if (voodoo->swap_pending && (voodoo->retrace_count > voodoo->swap_interval) &&
@@ -533,6 +800,9 @@ skip_draw:
                                         thread_unlock_mutex(voodoo->swap_mutex);
                         }
                 } else {
+                        if (voodoo->swap_pending)
+                                voodoo_display_flush_front(voodoo);
+
                         thread_lock_mutex(voodoo->swap_mutex);
                         if (voodoo->swap_pending && (voodoo->retrace_count > voodoo->swap_interval)) {
                                 voodoo->front_offset = voodoo->swap_offset;
@@ -554,6 +824,9 @@ skip_draw:
 
         if (voodoo->fbiInit0 & FBIINIT0_VGA_PASS) {
                 if (voodoo->line == voodoo->v_disp) {
+                        thread_lock_mutex(voodoo->display_mutex);
+                        voodoo_display_flush(voodoo);
+                        thread_unlock_mutex(voodoo->display_mutex);
                         if (voodoo->dirty_line_high > voodoo->dirty_line_low)
                                 svga_doblit(0, voodoo->v_disp, voodoo->h_disp, voodoo->v_disp - 1, voodoo->svga);
                         if (voodoo->clutData_dirty) {
@@ -563,7 +836,8 @@ skip_draw:
                         voodoo->dirty_line_high = -1;
                         voodoo->dirty_line_low = 2000;
                 }
-        }
+        } else
+                voodoo->nr_display_lines = 0;
 
         if (voodoo->line >= voodoo->v_total) {
                 voodoo->line = 0;
@@ -9,8 +9,10 @@
 #include "vid_voodoo.h"
 #include "vid_voodoo_common.h"
 #include "vid_voodoo_banshee_blitter.h"
+#include "vid_voodoo_display.h"
 #include "vid_voodoo_fb.h"
 #include "vid_voodoo_fifo.h"
+#include "vid_voodoo_record.h"
 #include "vid_voodoo_reg.h"
 #include "vid_voodoo_regs.h"
 #include "vid_voodoo_render.h"
@@ -82,6 +84,7 @@ void voodoo_wait_for_swap_complete(voodoo_t *voodoo) {
                 thread_lock_mutex(voodoo->swap_mutex);
                 if ((voodoo->swap_pending && voodoo->flush) || FIFO_FULL) {
                         /*Main thread is waiting for FIFO to empty, so skip vsync wait and just swap*/
+                        voodoo_display_flush_front(voodoo);
                         memset(voodoo->dirty_line, 1, sizeof(voodoo->dirty_line));
                         voodoo->front_offset = voodoo->params.front_offset;
                         if (voodoo->swap_count > 0)
@@ -153,6 +156,7 @@ void voodoo_fifo_thread(void *param) {
                         switch (fifo->addr_type & FIFO_TYPE) {
                         case FIFO_WRITEL_REG:
                                 while ((fifo->addr_type & FIFO_TYPE) == FIFO_WRITEL_REG) {
+                                        voodoo_record(voodoo, fifo->addr_type, fifo->val);
                                         voodoo_reg_writel(fifo->addr_type & FIFO_ADDR, fifo->val, voodoo);
                                         fifo->addr_type = FIFO_INVALID;
                                         voodoo->fifo_read_idx++;
@@ -164,6 +168,7 @@ void voodoo_fifo_thread(void *param) {
                         case FIFO_WRITEW_FB:
                                 voodoo_wait_for_render_thread_idle(voodoo);
                                 while ((fifo->addr_type & FIFO_TYPE) == FIFO_WRITEW_FB) {
+                                        voodoo_record(voodoo, fifo->addr_type, fifo->val);
                                         voodoo_fb_writew(fifo->addr_type & FIFO_ADDR, fifo->val, voodoo);
                                         fifo->addr_type = FIFO_INVALID;
                                         voodoo->fifo_read_idx++;
@@ -175,6 +180,7 @@ void voodoo_fifo_thread(void *param) {
                         case FIFO_WRITEL_FB:
                                 voodoo_wait_for_render_thread_idle(voodoo);
                                 while ((fifo->addr_type & FIFO_TYPE) == FIFO_WRITEL_FB) {
+                                        voodoo_record(voodoo, fifo->addr_type, fifo->val);
                                         voodoo_fb_writel(fifo->addr_type & FIFO_ADDR, fifo->val, voodoo);
                                         fifo->addr_type = FIFO_INVALID;
                                         voodoo->fifo_read_idx++;
@@ -185,6 +191,7 @@ void voodoo_fifo_thread(void *param) {
                                 break;
                         case FIFO_WRITEL_TEX:
                                 while ((fifo->addr_type & FIFO_TYPE) == FIFO_WRITEL_TEX) {
+                                        voodoo_record(voodoo, fifo->addr_type, fifo->val);
                                         if (!(fifo->addr_type & 0x400000))
                                                 voodoo_tex_writel(fifo->addr_type & FIFO_ADDR, fifo->val, voodoo);
                                         fifo->addr_type = FIFO_INVALID;
@@ -196,6 +203,7 @@ void voodoo_fifo_thread(void *param) {
                                 break;
                         case FIFO_WRITEL_2DREG:
                                 while ((fifo->addr_type & FIFO_TYPE) == FIFO_WRITEL_2DREG) {
+                                        voodoo_record(voodoo, fifo->addr_type, fifo->val);
                                         voodoo_2d_reg_writel(voodoo, fifo->addr_type & FIFO_ADDR, fifo->val);
                                         fifo->addr_type = FIFO_INVALID;
                                         voodoo->fifo_read_idx++;
@@ -281,6 +289,7 @@ void voodoo_fifo_thread(void *param) {
 
                                                 if (voodoo->type >= VOODOO_BANSHEE && (addr & 0x3ff) == SST_swapbufferCMD)
                                                         voodoo->cmd_written_fifo++;
+                                                voodoo_record(voodoo, addr | FIFO_WRITEL_REG, val);
                                                 voodoo_reg_writel(addr, val, voodoo);
                                         }
 
@@ -310,6 +319,7 @@ void voodoo_fifo_thread(void *param) {
                                 num = (header >> 29) & 7;
                                 mask = header; //(header >> 10) & 0xff;
                                 smode = (header >> 22) & 0xf;
+                                voodoo_record(voodoo, SST_sSetupMode | FIFO_WRITEL_REG, ((header >> 10) & 0xff) | (smode << 16));
                                 voodoo_reg_writel(SST_sSetupMode, ((header >> 10) & 0xff) | (smode << 16), voodoo);
                                 num_verticies = (header >> 6) & 0xf;
                                 v_num = 0;
@@ -353,6 +363,11 @@ void voodoo_fifo_thread(void *param) {
                                                 voodoo->verts[3].sS1 = cmdfifo_get_f(voodoo);
                                                 voodoo->verts[3].sT1 = cmdfifo_get_f(voodoo);
                                         }
+                                        if (voodoo->record_data) {
+                                                voodoo_record_vertex(voodoo);
+                                                voodoo_record_write(
+                                                        voodoo, (v_num ? SST_sDrawTriCMD : SST_sBeginTriCMD) | FIFO_WRITEL_REG, 0);
+                                        }
                                         if (v_num)
                                                 voodoo_reg_writel(SST_sDrawTriCMD, 0, voodoo);
                                         else
@@ -387,6 +402,7 @@ void voodoo_fifo_thread(void *param) {
 
                                                         if (voodoo->type >= VOODOO_BANSHEE && (addr & 0x3ff) == SST_swapbufferCMD)
                                                                 voodoo->cmd_written_fifo++;
+                                                        voodoo_record(voodoo, addr | FIFO_WRITEL_REG, val);
                                                         voodoo_reg_writel(addr, val, voodoo);
                                                 }
                                         }
@@ -433,6 +449,7 @@ void voodoo_fifo_thread(void *param) {
                                 case 2: /*Framebuffer*/
                                         while (num--) {
                                                 uint32_t val = cmdfifo_get(voodoo);
+                                                voodoo_record(voodoo, addr | FIFO_WRITEL_FB, val);
                                                 voodoo_fb_writel(addr, val, voodoo);
                                                 addr += 4;
                                         }
@@ -440,6 +457,7 @@ void voodoo_fifo_thread(void *param) {
                                 case 3: /*Texture*/
                                         while (num--) {
                                                 uint32_t val = cmdfifo_get(voodoo);
+                                                voodoo_record(voodoo, addr | FIFO_WRITEL_TEX, val);
                                                 voodoo_tex_writel(addr, val, voodoo);
                                                 addr += 4;
                                         }
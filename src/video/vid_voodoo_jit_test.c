@@ -0,0 +1,391 @@
+/*Voodoo pixel pipeline recompiler test. Draws triangles with random pipeline states through both the
+  recompiler and the C pixel loop in voodoo_half_triangle(), starting from the same random framebuffer,
+  and compares the resulting colour and depth buffers and the pixel statistics counters.
+
+  voodoo-jit-test [states] [seed]
+
+  states is the number of random pipeline states to try (default 10000), seed the initial random seed.
+  Returns non-zero if any state produced a different result.
+
+  The render code is built into this file, so that the static pipeline functions can be called
+  directly. Only one render thread is used, and the texture cache is filled with random texels rather
+  than decoded from texture memory.
+
+  Both the AArch64 and the x86-64 recompilers should match the C loop exactly. The AArch64 recompiler
+  samples textures through the C code; the x86-64 one does its own texture sampling and combine.*/
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vid_voodoo_render.c"
+
+/*logging.h sends printf() to pclog()*/
+#undef printf
+
+#define TEST_FB_SIZE (1 << 20)
+#define TEST_ROW_WIDTH 1024
+#define TEST_AUX_OFFSET (512 * 1024)
+#define TEST_TEX_SIZE (256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2)
+
+/*The x86 recompilers do not update the depth and alpha test failure counters*/
+#if defined __aarch64__ || defined _M_ARM64
+#define TEST_FAIL_COUNTERS 1
+#else
+#define TEST_FAIL_COUNTERS 0
+#endif
+
+rgba8_t rgb565[0x10000];
+viewer_t viewer_voodoo;
+
+void fatal(const char *format, ...) {
+        va_list ap;
+
+        va_start(ap, format);
+        vfprintf(stderr, format, ap);
+        va_end(ap);
+        exit(-1);
+}
+
+void pclog(const char *format, ...) {}
+
+/*Everything runs on one thread, so the synchronisation primitives are no-ops*/
+static int test_dummy;
+
+thread_t *thread_create(void (*thread_rout)(void *param), void *param) { return &test_dummy; }
+void thread_kill(thread_t *handle) {}
+event_t *thread_create_event() { return &test_dummy; }
+void thread_set_event(event_t *event) {}
+void thread_reset_event(event_t *_event) {}
+int thread_wait_event(event_t *event, int timeout) { return 0; }
+void thread_destroy_event(event_t *_event) {}
+mutex_t *thread_create_mutex(void) { return &test_dummy; }
+void thread_lock_mutex(mutex_t *mutex) {}
+void thread_unlock_mutex(mutex_t *mutex) {}
+void thread_destroy_mutex(mutex_t *mutex) {}
+
+uint64_t timer_read() { return 0; }
+void viewer_call(viewer_t *viewer, void *p, void (*func)(void *v, void *param), void *param) {}
+void voodoo_viewer_queue_triangle(void *v, void *param) {}
+void voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu) {}
+
+static uint32_t test_seed;
+
+static uint32_t test_rand(void) {
+        test_seed ^= test_seed << 13;
+        test_seed ^= test_seed >> 17;
+        test_seed ^= test_seed << 5;
+        return test_seed;
+}
+
+static int test_rand_range(int min, int max) { return min + (int)(test_rand() % (uint32_t)(max - min + 1)); }
+
+static int64_t test_rand_signed(int bits) { return (int64_t)(test_rand() & ((1u << bits) - 1)) - (1 << (bits - 1)); }
+
+/*As voodoo_recalc_tex(), without the texture memory addresses*/
+static void test_recalc_tex(voodoo_params_t *params, int tmu) {
+        int aspect = (params->tLOD[tmu] >> 21) & 3;
+        int width = 256, height = 256;
+        int shift = 8;
+        int lod;
+        int tex_lod = 0;
+
+        if (params->tLOD[tmu] & LOD_S_IS_WIDER)
+                height >>= aspect;
+        else {
+                width >>= aspect;
+                shift -= aspect;
+        }
+
+        if ((params->textureMode[tmu] & TEXTUREMODE_TRILINEAR) && (params->tLOD[tmu] & LOD_ODD))
+                tex_lod++;
+
+        for (lod = 0; lod <= LOD_MAX + 1; lod++) {
+                int w = width >> tex_lod, h = height >> tex_lod, s = shift - tex_lod;
+
+                params->tex_w_mask[tmu][lod] = (w ? w : 1) - 1;
+                params->tex_w_nmask[tmu][lod] = ~((w ? w : 1) - 1);
+                params->tex_h_mask[tmu][lod] = (h ? h : 1) - 1;
+                params->tex_shift[tmu][lod] = (s < 0) ? 0 : s;
+                params->tex_lod[tmu][lod] = tex_lod;
+
+                if (!(params->textureMode[tmu] & TEXTUREMODE_TRILINEAR) || ((lod & 1) && (params->tLOD[tmu] & LOD_ODD)) ||
+                    (!(lod & 1) && !(params->tLOD[tmu] & LOD_ODD))) {
+                        if (!(params->tLOD[tmu] & LOD_ODD) || lod != 0) {
+                                if (params->textureMode[tmu] & TEXTUREMODE_TRILINEAR)
+                                        tex_lod += 2;
+                                else
+                                        tex_lod++;
+                        }
+                }
+                if (tex_lod > LOD_MAX)
+                        tex_lod = LOD_MAX;
+        }
+}
+
+/*Random colour/alpha combine fields, restricted to the values the C pipeline accepts. With texturing off the
+  texel colour is left over from whatever ran before, so it is not selected as an input*/
+static uint32_t test_rand_fbzcolorpath(void) {
+        uint32_t val = test_rand() & ((1 << 4) | (1 << 8) | (1 << 9) | (1 << 13) | (1 << 16) | (1 << 17) | (1 << 18) | (1 << 22) |
+                                      (1 << 25) | FBZ_PARAM_ADJUST);
+
+        val |= test_rand_range(0, 2) << 5; /*cca_localselect*/
+        val |= test_rand_range(0, 2) << 14; /*cc_add*/
+        val |= test_rand_range(0, 3) << 23; /*cca_add*/
+        if (test_rand() & 3) {
+                val |= FBZCP_TEXTURE_ENABLED;
+                val |= test_rand() & (1 << 7); /*cc_localselect_override*/
+                val |= test_rand_range(0, 2); /*rgb_sel*/
+                val |= test_rand_range(0, 2) << 2; /*a_sel*/
+                val |= test_rand_range(0, CC_MSELECT_TEXRGB) << 10;
+                val |= test_rand_range(0, CCA_MSELECT_TEX) << 19;
+        } else {
+                val |= (test_rand() & 1) ? C_SEL_COLOR1 : C_SEL_ITER_RGB;
+                val |= ((test_rand() & 1) ? A_SEL_COLOR1 : A_SEL_ITER_A) << 2;
+                val |= test_rand_range(0, CC_MSELECT_ALOCAL) << 10;
+                val |= test_rand_range(0, CCA_MSELECT_ALOCAL2) << 19;
+        }
+        return val;
+}
+
+static uint32_t test_rand_texturemode(void) {
+        uint32_t val = test_rand() & ~((7 << 14) | (7 << 23) | (0xf << 8) | (3u << 30));
+
+        val |= test_rand_range(0, TC_MSELECT_LOD_FRAC) << 14;
+        val |= test_rand_range(0, TCA_MSELECT_LOD_FRAC) << 23;
+        if (!(test_rand() & 3))
+                val |= TEXTUREMODE_TRILINEAR;
+        /*Bias towards the common cases of a plain decal texture and a TMU in pass-through*/
+        switch (test_rand() & 7) {
+        case 0:
+                val &= ~TEXTUREMODE_MASK;
+                break;
+        case 1:
+                val = (val & ~TEXTUREMODE_LOCAL_MASK) | TEXTUREMODE_LOCAL;
+                break;
+        }
+        return val;
+}
+
+static uint32_t test_rand_alphamode(void) {
+        static const int afuncs[] = {AFUNC_AZERO,  AFUNC_ASRC_ALPHA,   AFUNC_A_COLOR,   AFUNC_ADST_ALPHA,   AFUNC_AONE,
+                                     AFUNC_AOMSRC_ALPHA, AFUNC_AOM_COLOR, AFUNC_AOMDST_ALPHA, AFUNC_ASATURATE};
+        uint32_t val = test_rand() & ((1 << 0) | (7 << 1) | (1 << 4) | 0xff000000);
+
+        /*0xf is AFUNC_ACOLORBEFOREFOG for the source, which the C pipeline does not implement*/
+        val |= afuncs[test_rand() % 8] << 8;
+        val |= afuncs[test_rand() % 9] << 12;
+        return val;
+}
+
+static uint32_t test_rand_fbzmode(void) {
+        return test_rand() & (1 | FBZ_CHROMAKEY | FBZ_W_BUFFER | FBZ_DEPTH_ENABLE | (7 << 5) | FBZ_DITHER | FBZ_RGB_WMASK |
+                              FBZ_DEPTH_WMASK | FBZ_DITHER_2x2 | FBZ_DEPTH_BIAS | (1 << 17) | FBZ_DITHER_SUB |
+                              FBZ_DEPTH_SOURCE);
+}
+
+static void test_rand_params(voodoo_t *voodoo, voodoo_params_t *params) {
+        int y[3], tmp;
+        int c;
+
+        memset(params, 0, sizeof(voodoo_params_t));
+
+        /*Vertices are 12.4 fixed point and sorted by Y, as triangle setup leaves them*/
+        for (c = 0; c < 3; c++)
+                y[c] = test_rand_range(0, 255 << 4);
+        if (y[0] > y[1])
+                tmp = y[0], y[0] = y[1], y[1] = tmp;
+        if (y[1] > y[2])
+                tmp = y[1], y[1] = y[2], y[2] = tmp;
+        if (y[0] > y[1])
+                tmp = y[0], y[0] = y[1], y[1] = tmp;
+        params->vertexAx = test_rand_range(0, 255 << 4);
+        params->vertexAy = y[0];
+        params->vertexBx = test_rand_range(0, 255 << 4);
+        params->vertexBy = y[1];
+        params->vertexCx = test_rand_range(0, 255 << 4);
+        params->vertexCy = y[2];
+        params->sign = test_rand() & 1;
+
+        params->startR = test_rand_range(0, 0x1ff) << 11;
+        params->startG = test_rand_range(0, 0x1ff) << 11;
+        params->startB = test_rand_range(0, 0x1ff) << 11;
+        params->startA = test_rand_range(0, 0x1ff) << 11;
+        params->startZ = test_rand_range(0, 0x1ffff) << 11;
+        params->dRdX = test_rand_signed(14);
+        params->dGdX = test_rand_signed(14);
+        params->dBdX = test_rand_signed(14);
+        params->dAdX = test_rand_signed(14);
+        params->dZdX = test_rand_signed(22);
+        params->dRdY = test_rand_signed(14);
+        params->dGdY = test_rand_signed(14);
+        params->dBdY = test_rand_signed(14);
+        params->dAdY = test_rand_signed(14);
+        params->dZdY = test_rand_signed(22);
+        params->startW = (int64_t)test_rand() << test_rand_range(0, 8);
+        params->dWdX = test_rand_signed(24);
+        params->dWdY = test_rand_signed(24);
+
+        for (c = 0; c < 2; c++) {
+                params->tmu[c].startS = (int64_t)test_rand_range(0, 0xffff) << 24;
+                params->tmu[c].startT = (int64_t)test_rand_range(0, 0xffff) << 24;
+                params->tmu[c].startW = (int64_t)test_rand_range(0x8000, 0x1ffff) << 16;
+                params->tmu[c].dSdX = test_rand_signed(20) << 14;
+                params->tmu[c].dTdX = test_rand_signed(20) << 14;
+                params->tmu[c].dWdX = test_rand_signed(16) << 8;
+                params->tmu[c].dSdY = test_rand_signed(20) << 14;
+                params->tmu[c].dTdY = test_rand_signed(20) << 14;
+                params->tmu[c].dWdY = test_rand_signed(16) << 8;
+
+                params->textureMode[c] = test_rand_texturemode();
+                /*LOD limits are 4.2 fixed point, and the render code expects them to be no more than 8*/
+                params->tLOD[c] = test_rand() & (0x3f000 | LOD_ODD | LOD_S_IS_WIDER | (3 << 21) | LOD_TMIRROR_S | LOD_TMIRROR_T);
+                params->tLOD[c] |= test_rand_range(0, 0x20) | (test_rand_range(0, 0x20) << 6);
+                params->tex_entry[c] = 0;
+                test_recalc_tex(params, c);
+        }
+
+        params->color0 = test_rand();
+        params->color1 = test_rand();
+        params->fbzMode = test_rand_fbzmode();
+        params->fbzColorPath = test_rand_fbzcolorpath();
+        params->alphaMode = test_rand_alphamode();
+        params->zaColor = test_rand();
+        params->chromaKey = test_rand() & 0xffffff;
+        /*Make sure some texels hit the chroma key*/
+        if (test_rand() & 1)
+                params->chromaKey = voodoo->texture_cache[0][0].data[test_rand() % TEST_TEX_SIZE] & 0xffffff;
+        params->chromaKey_r = (params->chromaKey >> 16) & 0xff;
+        params->chromaKey_g = (params->chromaKey >> 8) & 0xff;
+        params->chromaKey_b = params->chromaKey & 0xff;
+
+        params->fogMode = test_rand() & 0x3f;
+        if (test_rand() & 1)
+                params->fogMode &= ~FOG_ENABLE;
+        params->fogColor.r = test_rand();
+        params->fogColor.g = test_rand();
+        params->fogColor.b = test_rand();
+        for (c = 0; c < 64; c++) {
+                params->fogTable[c].fog = test_rand();
+                params->fogTable[c].dfog = test_rand();
+        }
+
+        params->clipLeft = test_rand_range(0, 128);
+        params->clipRight = test_rand_range(128, 256);
+        params->clipLowY = test_rand_range(0, 128);
+        params->clipHighY = test_rand_range(128, 256);
+
+        params->draw_offset = 0;
+        params->aux_offset = TEST_AUX_OFFSET;
+        params->row_width = TEST_ROW_WIDTH;
+        params->aux_row_width = TEST_ROW_WIDTH;
+        params->front_offset = TEST_FB_SIZE;
+
+        voodoo->dual_tmus = test_rand() & 1;
+        voodoo->bilinear_enabled = test_rand() & 1;
+        voodoo->dithersub_enabled = test_rand() & 1;
+        voodoo->trexInit1[0] = (test_rand() & 15) ? 0 : (1 << 18);
+        voodoo->tmuConfig = test_rand();
+}
+
+static void test_reset_counters(voodoo_t *voodoo) {
+        voodoo->fbiPixelsIn = 0;
+        voodoo->fbiChromaFail = 0;
+        voodoo->fbiZFuncFail = 0;
+        voodoo->fbiAFuncFail = 0;
+        voodoo->pixel_count[0] = 0;
+}
+
+int main(int argc, char **argv) {
+        int states = (argc > 1) ? atoi(argv[1]) : 10000;
+        voodoo_t *voodoo = calloc(1, sizeof(voodoo_t));
+        uint8_t *fb_init = malloc(TEST_FB_SIZE);
+        uint8_t *fb_c = malloc(TEST_FB_SIZE);
+        int fail = 0, native = 0;
+        int c, tmu;
+
+        test_seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+        if (!test_seed)
+                test_seed = 1;
+
+        for (c = 0; c < 0x10000; c++) {
+                rgb565[c].r = (c >> 8) & 0xf8;
+                rgb565[c].g = (c >> 3) & 0xfc;
+                rgb565[c].b = (c << 3) & 0xf8;
+                rgb565[c].r |= (rgb565[c].r >> 5);
+                rgb565[c].g |= (rgb565[c].g >> 6);
+                rgb565[c].b |= (rgb565[c].b >> 5);
+        }
+
+        voodoo->type = VOODOO_2;
+        voodoo->render_threads = 1;
+        voodoo->render_tiles = 1;
+        voodoo->v_disp = 256;
+        voodoo->fb_mem = malloc(TEST_FB_SIZE);
+        voodoo->fb_mask = TEST_FB_SIZE - 1;
+        for (tmu = 0; tmu < 2; tmu++) {
+                voodoo->texture_cache[tmu][0].data = malloc(TEST_TEX_SIZE * 4);
+                for (c = 0; c < TEST_TEX_SIZE; c++)
+                        voodoo->texture_cache[tmu][0].data[c] = test_rand();
+        }
+        voodoo_codegen_init(voodoo);
+
+        for (c = 0; c < states; c++) {
+                int pixels_in, chroma_fail, z_fail, a_fail, pixel_count;
+                int d;
+
+                test_rand_params(voodoo, &voodoo->params);
+                for (d = 0; d < TEST_FB_SIZE; d += 4)
+                        *(uint32_t *)&fb_init[d] = test_rand();
+
+                memcpy(voodoo->fb_mem, fb_init, TEST_FB_SIZE);
+                test_reset_counters(voodoo);
+                voodoo->use_recompiler = 0;
+                voodoo_triangle(voodoo, &voodoo->params, 0, 0);
+                memcpy(fb_c, voodoo->fb_mem, TEST_FB_SIZE);
+                pixels_in = voodoo->fbiPixelsIn;
+                chroma_fail = voodoo->fbiChromaFail;
+                z_fail = voodoo->fbiZFuncFail;
+                a_fail = voodoo->fbiAFuncFail;
+                pixel_count = voodoo->pixel_count[0];
+
+                memcpy(voodoo->fb_mem, fb_init, TEST_FB_SIZE);
+                test_reset_counters(voodoo);
+                voodoo->use_recompiler = 1;
+                voodoo_triangle(voodoo, &voodoo->params, 0, 0);
+#if defined __aarch64__ || defined _M_ARM64
+                if (voodoo_codegen_supported(voodoo, &voodoo->params))
+                        native++;
+#else
+                native++;
+#endif
+
+                if (memcmp(fb_c, voodoo->fb_mem, TEST_FB_SIZE) || pixels_in != voodoo->fbiPixelsIn ||
+                    chroma_fail != voodoo->fbiChromaFail || pixel_count != voodoo->pixel_count[0] ||
+                    (TEST_FAIL_COUNTERS && (z_fail != voodoo->fbiZFuncFail || a_fail != voodoo->fbiAFuncFail))) {
+                        voodoo_params_t *params = &voodoo->params;
+
+                        for (d = 0; d < TEST_FB_SIZE; d += 2) {
+                                if (*(uint16_t *)&fb_c[d] != *(uint16_t *)&voodoo->fb_mem[d])
+                                        break;
+                        }
+                        printf("state %i differs: fbzMode=%08x fbzColorPath=%08x alphaMode=%08x fogMode=%08x\n", c,
+                               params->fbzMode, params->fbzColorPath, params->alphaMode, params->fogMode);
+                        printf("  textureMode=%08x,%08x tLOD=%08x,%08x dual_tmus=%i bilinear=%i trexInit1=%08x\n",
+                               params->textureMode[0], params->textureMode[1], params->tLOD[0], params->tLOD[1],
+                               voodoo->dual_tmus, voodoo->bilinear_enabled, voodoo->trexInit1[0]);
+                        if (d < TEST_FB_SIZE)
+                                printf("  first difference at %s offset %06x : C %04x, recompiler %04x\n",
+                                       (d >= TEST_AUX_OFFSET) ? "aux" : "colour", d, *(uint16_t *)&fb_c[d],
+                                       *(uint16_t *)&voodoo->fb_mem[d]);
+                        printf("  pixels in %i/%i, chroma fail %i/%i, Z fail %i/%i, alpha fail %i/%i, pixel count %i/%i\n",
+                               pixels_in, voodoo->fbiPixelsIn, chroma_fail, voodoo->fbiChromaFail, z_fail, voodoo->fbiZFuncFail,
+                               a_fail, voodoo->fbiAFuncFail, pixel_count, voodoo->pixel_count[0]);
+                        fail++;
+                }
+        }
+
+        printf("%i states, %i compiled natively, %i differ\n", states, native, fail);
+
+        voodoo_codegen_close(voodoo);
+        return fail ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+/*Voodoo command stream recorder.
+
+  The recorder is fed by the FIFO thread as it dispatches work, so it sees PCI
+  FIFO entries and decoded CMDFIFO packets in the order they are executed. CMDFIFO
+  packets are stored as the equivalent register/framebuffer/texture writes, which
+  means a stream recorded with CMDFIFO enabled replays through the plain FIFO.
+
+  Registers that the CPU writes directly rather than through the FIFO (fbiInit*,
+  video timing) are snapshotted into the file header when the first command is
+  recorded; by that point the driver has finished initialising the card.
+
+  Only Voodoo Graphics and Voodoo 2 can be recorded. Banshee and Voodoo 3 run 2D
+  and CMDFIFO work that the stream format does not carry, so recording is refused
+  on those cards.
+
+  Recordings are replayed outside the emulator by voodoo-replay
+  (vid_voodoo_replay.c).*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ibm.h"
+#include "device.h"
+#include "mem.h"
+#include "thread.h"
+#include "video.h"
+#include "vid_svga.h"
+#include "vid_voodoo.h"
+#include "vid_voodoo_common.h"
+#include "vid_voodoo_record.h"
+#include "vid_voodoo_regs.h"
+#include "config.h"
+#include "paths.h"
+
+#define RECORD_BUF_ENTRIES 4096
+
+typedef struct voodoo_record_t {
+        FILE *f;
+        int header_written;
+        int nr_entries;
+        uint64_t total_entries;
+        uint32_t buf[RECORD_BUF_ENTRIES * 2];
+} voodoo_record_t;
+
+static FILE *voodoo_record_fopen(char *fn, char *mode) {
+        char path[512];
+
+        append_filename(path, logs_path, fn, sizeof(path));
+        return fopen(path, mode);
+}
+
+void voodoo_record_init(voodoo_t *voodoo) {
+        voodoo_record_t *record;
+
+        if (voodoo->type >= VOODOO_BANSHEE) {
+                pclog("Voodoo record : recording is not supported on Banshee/Voodoo 3\n");
+                return;
+        }
+
+        record = malloc(sizeof(voodoo_record_t));
+        memset(record, 0, sizeof(voodoo_record_t));
+
+        record->f = voodoo_record_fopen("voodoo_record.bin", "wb");
+        if (!record->f) {
+                pclog("Voodoo record : can't open voodoo_record.bin\n");
+                free(record);
+                return;
+        }
+
+        voodoo->record_data = record;
+}
+
+static void voodoo_record_flush(voodoo_record_t *record) {
+        if (record->nr_entries) {
+                fwrite(record->buf, record->nr_entries * 8, 1, record->f);
+                record->nr_entries = 0;
+        }
+}
+
+static void voodoo_record_write_header(voodoo_t *voodoo, voodoo_record_t *record) {
+        voodoo_record_header_t header;
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, VOODOO_RECORD_MAGIC, 8);
+        header.version = VOODOO_RECORD_VERSION;
+        header.type = voodoo->type;
+        header.dual_tmus = voodoo->dual_tmus;
+        header.fb_size = voodoo->fb_size;
+        header.texture_size = voodoo->texture_size;
+        header.fbiInit[0] = voodoo->fbiInit0;
+        header.fbiInit[1] = voodoo->fbiInit1;
+        header.fbiInit[2] = voodoo->fbiInit2;
+        header.fbiInit[3] = voodoo->fbiInit3;
+        header.fbiInit[4] = voodoo->fbiInit4;
+        header.fbiInit[5] = voodoo->fbiInit5;
+        header.fbiInit[6] = voodoo->fbiInit6;
+        header.fbiInit[7] = voodoo->fbiInit7;
+        header.backPorch = voodoo->backPorch;
+        header.videoDimensions = voodoo->videoDimensions;
+        header.hSync = voodoo->hSync;
+        header.vSync = voodoo->vSync;
+
+        fwrite(&header, sizeof(header), 1, record->f);
+        record->header_written = 1;
+}
+
+void voodoo_record_write(voodoo_t *voodoo, uint32_t addr_type, uint32_t val) {
+        voodoo_record_t *record = voodoo->record_data;
+
+        if (!record->header_written)
+                voodoo_record_write_header(voodoo, record);
+
+        record->buf[record->nr_entries * 2] = addr_type;
+        record->buf[record->nr_entries * 2 + 1] = val;
+        record->nr_entries++;
+        record->total_entries++;
+
+        if (record->nr_entries == RECORD_BUF_ENTRIES)
+                voodoo_record_flush(record);
+}
+
+/*Store a CMDFIFO packet 3 vertex as writes to the triangle setup registers*/
+void voodoo_record_vertex(voodoo_t *voodoo) {
+        vert_t *vert = &voodoo->verts[3];
+        union {
+                uint32_t i;
+                float f;
+        } tempif;
+
+#define RECORD_VERT(reg, field)                                                                                                  \
+        do {                                                                                                                     \
+                tempif.f = vert->field;                                                                                          \
+                voodoo_record_write(voodoo, reg | FIFO_WRITEL_REG, tempif.i);                                                    \
+        } while (0)
+
+        RECORD_VERT(SST_sVx, sVx);
+        RECORD_VERT(SST_sVy, sVy);
+        RECORD_VERT(SST_sRed, sRed);
+        RECORD_VERT(SST_sGreen, sGreen);
+        RECORD_VERT(SST_sBlue, sBlue);
+        RECORD_VERT(SST_sAlpha, sAlpha);
+        RECORD_VERT(SST_sVz, sVz);
+        RECORD_VERT(SST_sWb, sWb);
+        RECORD_VERT(SST_sW0, sW0);
+        RECORD_VERT(SST_sS0, sS0);
+        RECORD_VERT(SST_sT0, sT0);
+        RECORD_VERT(SST_sW1, sW1);
+        RECORD_VERT(SST_sS1, sS1);
+        RECORD_VERT(SST_sT1, sT1);
+
+#undef RECORD_VERT
+}
+
+void voodoo_record_close(voodoo_t *voodoo) {
+        voodoo_record_t *record = voodoo->record_data;
+
+        if (!record)
+                return;
+
+        voodoo_record_flush(record);
+        fclose(record->f);
+        pclog("Voodoo record : %.0f entries written\n", (double)record->total_entries);
+
+        free(record);
+        voodoo->record_data = NULL;
+}
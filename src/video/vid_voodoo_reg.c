@@ -10,6 +10,7 @@
 #include "vid_voodoo_common.h"
 #include "vid_voodoo_banshee.h"
 #include "vid_voodoo_blitter.h"
+#include "vid_voodoo_display.h"
 #include "vid_voodoo_dither.h"
 #include "vid_voodoo_fifo.h"
 #include "vid_voodoo_reg.h"
@@ -22,6 +23,82 @@
 
 enum { CHIP_FBI = 0x1, CHIP_TREX0 = 0x2, CHIP_TREX1 = 0x4, CHIP_TREX2 = 0x8 };
 
+void voodoo_recalc(voodoo_t *voodoo) {
+        uint32_t buffer_offset = ((voodoo->fbiInit2 >> 11) & 511) * 4096;
+
+        if (voodoo->type >= VOODOO_BANSHEE)
+                return;
+
+        voodoo->params.front_offset = voodoo->disp_buffer * buffer_offset;
+        voodoo->back_offset = voodoo->draw_buffer * buffer_offset;
+
+        voodoo->buffer_cutoff = TRIPLE_BUFFER ? (buffer_offset * 4) : (buffer_offset * 3);
+        if (TRIPLE_BUFFER)
+                voodoo->params.aux_offset = buffer_offset * 3;
+        else
+                voodoo->params.aux_offset = buffer_offset * 2;
+
+        switch (voodoo->lfbMode & LFB_WRITE_MASK) {
+        case LFB_WRITE_FRONT:
+                voodoo->fb_write_offset = voodoo->params.front_offset;
+                voodoo->fb_write_buffer = voodoo->disp_buffer;
+                break;
+        case LFB_WRITE_BACK:
+                voodoo->fb_write_offset = voodoo->back_offset;
+                voodoo->fb_write_buffer = voodoo->draw_buffer;
+                break;
+
+        default:
+                /*BreakNeck sets invalid LFB write buffer select*/
+                voodoo->fb_write_offset = voodoo->params.front_offset;
+                break;
+        }
+
+        switch (voodoo->lfbMode & LFB_READ_MASK) {
+        case LFB_READ_FRONT:
+                voodoo->fb_read_offset = voodoo->params.front_offset;
+                break;
+        case LFB_READ_BACK:
+                voodoo->fb_read_offset = voodoo->back_offset;
+                break;
+        case LFB_READ_AUX:
+                voodoo->fb_read_offset = voodoo->params.aux_offset;
+                break;
+
+        default:
+                fatal("voodoo_recalc : unknown lfb source\n");
+        }
+
+        switch (voodoo->params.fbzMode & FBZ_DRAW_MASK) {
+        case FBZ_DRAW_FRONT:
+                voodoo->params.draw_offset = voodoo->params.front_offset;
+                voodoo->fb_draw_buffer = voodoo->disp_buffer;
+                break;
+        case FBZ_DRAW_BACK:
+                voodoo->params.draw_offset = voodoo->back_offset;
+                voodoo->fb_draw_buffer = voodoo->draw_buffer;
+                break;
+
+        default:
+                fatal("voodoo_recalc : unknown draw buffer\n");
+        }
+
+        voodoo->block_width = ((voodoo->fbiInit1 >> 4) & 15) * 2;
+        if (voodoo->fbiInit6 & (1 << 30))
+                voodoo->block_width += 1;
+        if (voodoo->fbiInit1 & (1 << 24))
+                voodoo->block_width += 32;
+        voodoo->row_width = voodoo->block_width * 32 * 2;
+        voodoo->params.row_width = voodoo->row_width;
+        voodoo->aux_row_width = voodoo->row_width;
+        voodoo->params.aux_row_width = voodoo->aux_row_width;
+
+        /*        pclog("voodoo_recalc : front_offset %08X  back_offset %08X  aux_offset %08X draw_offset %08x\n",
+           voodoo->params.front_offset, voodoo->back_offset, voodoo->params.aux_offset, voodoo->params.draw_offset); pclog("
+           fb_read_offset %08X  fb_write_offset %08X  row_width %i  %08x %08x\n", voodoo->fb_read_offset, voodoo->fb_write_offset,
+           voodoo->row_width, voodoo->lfbMode, voodoo->params.fbzMode);*/
+}
+
 void voodoo_reg_writel(uint32_t addr, uint32_t val, void *p) {
         voodoo_t *voodoo = (voodoo_t *)p;
         union {
@@ -89,6 +166,7 @@ void voodoo_reg_writel(uint32_t addr, uint32_t val, void *p) {
                 if (voodoo->viewer_active)
                         viewer_call(&viewer_voodoo, voodoo, voodoo_viewer_swap_buffer, NULL);
                 if (!(val & 1)) {
+                        voodoo_display_flush_front(voodoo);
                         memset(voodoo->dirty_line, 1, sizeof(voodoo->dirty_line));
                         voodoo->front_offset = voodoo->params.front_offset;
                         thread_lock_mutex(voodoo->swap_mutex);
@@ -359,11 +359,11 @@ static inline void voodoo_tmu_fetch_and_blend(voodoo_t *voodoo, voodoo_params_t
         voodoo_tmu_fetch(voodoo, params, state, 1, x);
 
         if ((params->textureMode[1] & TEXTUREMODE_TRILINEAR) && (state->lod & 1)) {
-                c_reverse = tc_reverse_blend;
-                a_reverse = tca_reverse_blend;
+                c_reverse = tc_reverse_blend_1;
+                a_reverse = tca_reverse_blend_1;
         } else {
-                c_reverse = !tc_reverse_blend;
-                a_reverse = !tca_reverse_blend;
+                c_reverse = !tc_reverse_blend_1;
+                a_reverse = !tca_reverse_blend_1;
         }
         /*        c_reverse1 = c_reverse;
                 a_reverse1 = a_reverse;*/
@@ -439,9 +439,9 @@ static inline void voodoo_tmu_fetch_and_blend(voodoo_t *voodoo, voodoo_params_t
                         break;
                 }
                 if (!a_reverse)
-                        a = (-state->tex_a[1] * ((factor_a ^ 0xff) + 1)) >> 8;
-                else
                         a = (-state->tex_a[1] * (factor_a + 1)) >> 8;
+                else
+                        a = (-state->tex_a[1] * ((factor_a ^ 0xff) + 1)) >> 8;
                 if (tca_add_clocal_1 || tca_add_alocal_1)
                         a += state->tex_a[1];
                 state->tex_a[1] = CLAMP(a);
@@ -561,16 +561,21 @@ static inline void voodoo_tmu_fetch_and_blend(voodoo_t *voodoo, voodoo_params_t
                 state->tex_a[0] ^= 0xff;
 }
 
+int tris = 0;
+
 #if (defined i386 || defined __i386 || defined __i386__ || defined _X86_) && !(defined __amd64__)
 #include "vid_voodoo_codegen_x86.h"
 #elif (defined __amd64__)
 #include "vid_voodoo_codegen_x86-64.h"
+#elif (defined __aarch64__ || defined _M_ARM64)
+#include "vid_voodoo_codegen_arm64.h"
 #else
 int voodoo_recomp = 0;
+int voodoo_recomp_hits = 0;
 #endif
 
 static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int ystart, int yend,
-                                 int odd_even) {
+                                 int tile, int thread) {
         /*        int rgb_sel                 = params->fbzColorPath & 3;
                 int a_sel                   = (params->fbzColorPath >> 2) & 3;
                 int cc_localselect          = params->fbzColorPath & (1 << 4);
@@ -690,7 +695,7 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
         }
 #ifndef NO_CODEGEN
         if (voodoo->use_recompiler)
-                voodoo_draw = voodoo_get_block(voodoo, params, state, odd_even);
+                voodoo_draw = voodoo_get_block(voodoo, params, state, thread);
         else
                 voodoo_draw = NULL;
 #endif
@@ -732,10 +737,10 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
                         real_y >>= 4;
 
                 if (SLI_ENABLED) {
-                        if (((real_y >> 1) & voodoo->odd_even_mask) != odd_even)
+                        if ((((real_y >> 1) >> VOODOO_TILE_SHIFT) & (voodoo->render_tiles - 1)) != tile)
                                 goto next_line;
                 } else {
-                        if ((real_y & voodoo->odd_even_mask) != odd_even)
+                        if (((real_y >> VOODOO_TILE_SHIFT) & (voodoo->render_tiles - 1)) != tile)
                                 goto next_line;
                 }
 
@@ -856,7 +861,7 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
                 state->x = x;
                 state->x2 = x2;
 #ifndef NO_CODEGEN
-                if (voodoo->use_recompiler) {
+                if (voodoo_draw) {
                         voodoo_draw(state, params, x, real_y);
                 } else
 #endif
@@ -864,8 +869,8 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
                                 int x_tiled = (x & 63) | ((x >> 6) * 128 * 32 / 2);
                                 start_x = x;
                                 state->x = x;
-                                voodoo->pixel_count[odd_even]++;
-                                voodoo->texel_count[odd_even] += texels;
+                                voodoo->pixel_count[thread]++;
+                                voodoo->texel_count[thread] += texels;
                                 voodoo->fbiPixelsIn++;
 
                                 if (voodoo_output)
@@ -948,7 +953,7 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
 
                                         if (voodoo->trexInit1[0] & (1 << 18)) {
                                                 state->tex_r[0] = state->tex_g[0] = 0;
-                                                state->tex_b[0] = voodoo->tmuConfig;
+                                                state->tex_b[0] = voodoo->tmuConfig & 0xff;
                                         }
 
                                         if (cc_localselect_override)
@@ -1251,8 +1256,8 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
                                 x += state->xdir;
                         } while (start_x != x2);
 
-                voodoo->pixel_count[odd_even] += state->pixel_count;
-                voodoo->texel_count[odd_even] += state->texel_count;
+                voodoo->pixel_count[thread] += state->pixel_count;
+                voodoo->texel_count[thread] += state->texel_count;
                 voodoo->fbiPixelsIn += state->pixel_count;
 
                 if (voodoo->params.draw_offset == voodoo->params.front_offset && (real_y >> 1) < 2048)
@@ -1290,12 +1295,50 @@ static void voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, vood
                 state->xstart += state->dx1;
                 state->xend += state->dx2;
         }
+}
+
+/*Returns non-zero if any line in [ystart, yend) falls within the given tile*/
+static int voodoo_tile_in_range(voodoo_t *voodoo, voodoo_params_t *params, int ystart, int yend, int tile) {
+        int y_origin = (voodoo->type >= VOODOO_BANSHEE) ? voodoo->y_origin_swap : (voodoo->v_disp - 1);
+        int start, end;
+        int band;
+
+        if (voodoo->render_tiles == 1)
+                return 1;
+
+        if (params->fbzMode & 1) {
+                if (ystart < params->clipLowY)
+                        ystart = params->clipLowY;
+                if (yend >= params->clipHighY)
+                        yend = params->clipHighY;
+        }
+        if (ystart >= yend)
+                return 0;
 
-        voodoo->texture_cache[0][params->tex_entry[0]].refcount_r[odd_even]++;
-        voodoo->texture_cache[1][params->tex_entry[1]].refcount_r[odd_even]++;
+        if (params->fbzMode & (1 << 17)) {
+                start = y_origin - (yend - 1);
+                end = y_origin - ystart;
+        } else {
+                start = ystart;
+                end = yend - 1;
+        }
+        if (SLI_ENABLED) {
+                start >>= 1;
+                end >>= 1;
+        }
+        start >>= VOODOO_TILE_SHIFT;
+        end >>= VOODOO_TILE_SHIFT;
+
+        if ((end - start) >= (voodoo->render_tiles - 1))
+                return 1;
+        for (band = start; band <= end; band++) {
+                if ((band & (voodoo->render_tiles - 1)) == tile)
+                        return 1;
+        }
+        return 0;
 }
 
-void voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_even) {
+static void voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int tile, int thread) {
         voodoo_state_t state;
         int vertexAy_adjusted;
         int vertexCy_adjusted;
@@ -1306,7 +1349,8 @@ void voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_even) {
         int LOD;
         int lodbias;
 
-        voodoo->tri_count++;
+        if (!tile)
+                voodoo->tri_count++;
 
         dx = 8 - (params->vertexAx & 0xf);
         if ((params->vertexAx & 0xf) > 8)
@@ -1316,7 +1360,7 @@ void voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_even) {
                 dy += 16;
 
         /*        pclog("voodoo_triangle %i %i %i : vA %f, %f  vB %f, %f  vC %f, %f f %i,%i %08x %08x %08x,%08x tex=%i,%i
-           fogMode=%08x\n", odd_even, voodoo->params_read_idx[odd_even], voodoo->params_read_idx[odd_even] & PARAM_MASK,
+           fogMode=%08x\n", tile, voodoo->params_read_idx[tile], voodoo->params_read_idx[tile] & PARAM_MASK,
            (float)params->vertexAx / 16.0, (float)params->vertexAy / 16.0, (float)params->vertexBx / 16.0, (float)params->vertexBy
            / 16.0, (float)params->vertexCx / 16.0, (float)params->vertexCy / 16.0, (params->fbzColorPath & FBZCP_TEXTURE_ENABLED)
            ? params->tformat[0] : 0, (params->fbzColorPath & FBZCP_TEXTURE_ENABLED) ? params->tformat[1] : 0,
@@ -1376,6 +1420,9 @@ void voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_even) {
         vertexAy_adjusted = (state.vertexAy + 7) >> 4;
         vertexCy_adjusted = (state.vertexCy + 7) >> 4;
 
+        if (!voodoo_tile_in_range(voodoo, params, vertexAy_adjusted, vertexCy_adjusted, tile))
+                return;
+
         if (state.vertexBy - state.vertexAy)
                 state.dxAB = (int)((((int64_t)state.vertexBx << 12) - ((int64_t)state.vertexAx << 12)) << 4) /
                              (int)(state.vertexBy - state.vertexAy);
@@ -1443,63 +1490,139 @@ void voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_even) {
                 lodbias |= ~0x3f;
         state.tmu[1].lod = LOD + (lodbias << 6);
 
-        voodoo_half_triangle(voodoo, params, &state, vertexAy_adjusted, vertexCy_adjusted, odd_even);
+        voodoo_half_triangle(voodoo, params, &state, vertexAy_adjusted, vertexCy_adjusted, tile, thread);
 }
 
-static void render_thread(void *param, int odd_even) {
-        voodoo_t *voodoo = (voodoo_t *)param;
+/*Claim a tile with queued triangles for this thread. Threads prefer their own
+  group of tiles, then steal from the groups of other threads.*/
+static int voodoo_render_claim_tile(voodoo_t *voodoo, int thread) {
+        int tiles_per_thread = voodoo->render_tiles / voodoo->render_threads;
+        int c;
+
+        thread_lock_mutex(voodoo->render_tile_lock);
+        for (c = 0; c < voodoo->render_tiles; c++) {
+                int tile = (thread * tiles_per_thread + c) & (voodoo->render_tiles - 1);
+
+                if (!voodoo->render_tile_claimed[tile] && !PARAM_EMPTY(tile)) {
+                        voodoo->render_tile_claimed[tile] = 1;
+                        thread_unlock_mutex(voodoo->render_tile_lock);
+                        return tile;
+                }
+        }
+        thread_unlock_mutex(voodoo->render_tile_lock);
+
+        return -1;
+}
+
+static void voodoo_render_release_tile(voodoo_t *voodoo, int tile) {
+        thread_lock_mutex(voodoo->render_tile_lock);
+        voodoo->render_tile_claimed[tile] = 0;
+        thread_unlock_mutex(voodoo->render_tile_lock);
+}
+
+/*Maximum number of triangles rendered into a tile before it is released, to give
+  other threads a chance to steal it*/
+#define RENDER_TILE_BATCH 64
+
+static void render_thread(void *param) {
+        voodoo_render_worker_t *worker = (voodoo_render_worker_t *)param;
+        voodoo_t *voodoo = worker->voodoo;
+        int thread = worker->index;
 
         while (1) {
-                thread_set_event(voodoo->render_not_full_event[odd_even]);
-                thread_wait_event(voodoo->wake_render_thread[odd_even], -1);
-                thread_reset_event(voodoo->wake_render_thread[odd_even]);
-                voodoo->render_voodoo_busy[odd_even] = 1;
+                int tile;
+
+                thread_set_event(voodoo->render_not_full_event);
+                thread_wait_event(voodoo->wake_render_thread[thread], -1);
+                thread_reset_event(voodoo->wake_render_thread[thread]);
+                voodoo->render_voodoo_busy[thread] = 1;
 
-                while (!PARAM_EMPTY(odd_even)) {
+                while ((tile = voodoo_render_claim_tile(voodoo, thread)) != -1) {
                         uint64_t start_time = timer_read();
                         uint64_t end_time;
-                        voodoo_params_t *params = &voodoo->params_buffer[voodoo->params_read_idx[odd_even] & PARAM_MASK];
+                        int c;
+
+                        for (c = 0; c < RENDER_TILE_BATCH && !PARAM_EMPTY(tile); c++) {
+                                voodoo_params_t *params = &voodoo->params_buffer[voodoo->params_read_idx[tile] & PARAM_MASK];
+
+                                voodoo_triangle(voodoo, params, tile, thread);
+
+                                voodoo->texture_cache[0][params->tex_entry[0]].refcount_r[tile]++;
+                                voodoo->texture_cache[1][params->tex_entry[1]].refcount_r[tile]++;
 
-                        voodoo_triangle(voodoo, params, odd_even);
+                                voodoo->params_read_idx[tile]++;
 
-                        voodoo->params_read_idx[odd_even]++;
+                                if (PARAM_ENTRIES(tile) > (PARAM_SIZE - 10))
+                                        thread_set_event(voodoo->render_not_full_event);
+                        }
 
-                        if (PARAM_ENTRIES(odd_even) > (PARAM_SIZE - 10))
-                                thread_set_event(voodoo->render_not_full_event[odd_even]);
+                        voodoo_render_release_tile(voodoo, tile);
 
                         end_time = timer_read();
-                        voodoo->render_time[odd_even] += end_time - start_time;
+                        voodoo->render_time[thread] += end_time - start_time;
                 }
 
-                voodoo->render_voodoo_busy[odd_even] = 0;
+                voodoo->render_voodoo_busy[thread] = 0;
+        }
+}
+
+void voodoo_render_init(voodoo_t *voodoo) {
+        int c;
+
+        if (voodoo->render_threads < 1)
+                voodoo->render_threads = 1;
+        if (voodoo->render_threads > VOODOO_MAX_RENDER_THREADS)
+                voodoo->render_threads = VOODOO_MAX_RENDER_THREADS;
+        voodoo->render_tiles = (voodoo->render_threads == 1) ? 1 : voodoo->render_threads * 2;
+
+        voodoo->render_tile_lock = thread_create_mutex();
+        voodoo->render_not_full_event = thread_create_event();
+        for (c = 0; c < voodoo->render_threads; c++) {
+                voodoo->render_worker[c].voodoo = voodoo;
+                voodoo->render_worker[c].index = c;
+                voodoo->wake_render_thread[c] = thread_create_event();
+                voodoo->render_thread[c] = thread_create(render_thread, &voodoo->render_worker[c]);
+        }
+}
+
+void voodoo_render_close(voodoo_t *voodoo) {
+        int c;
+
+        for (c = 0; c < voodoo->render_threads; c++) {
+                thread_kill(voodoo->render_thread[c]);
+                thread_destroy_event(voodoo->wake_render_thread[c]);
+        }
+        thread_destroy_event(voodoo->render_not_full_event);
+        thread_destroy_mutex(voodoo->render_tile_lock);
+}
+
+static int voodoo_params_full(voodoo_t *voodoo) {
+        int c;
+
+        for (c = 0; c < voodoo->render_tiles; c++) {
+                if (PARAM_FULL(c))
+                        return 1;
         }
+        return 0;
 }
 
-void voodoo_render_thread_1(void *param) { render_thread(param, 0); }
-void voodoo_render_thread_2(void *param) { render_thread(param, 1); }
-void voodoo_render_thread_3(void *param) { render_thread(param, 2); }
-void voodoo_render_thread_4(void *param) { render_thread(param, 3); }
+static int voodoo_params_low(voodoo_t *voodoo) {
+        int c;
+
+        for (c = 0; c < voodoo->render_tiles; c++) {
+                if (PARAM_ENTRIES(c) < 4)
+                        return 1;
+        }
+        return 0;
+}
 
 void voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params) {
         voodoo_params_t *params_new = &voodoo->params_buffer[voodoo->params_write_idx & PARAM_MASK];
 
-        while (PARAM_FULL(0) || (voodoo->render_threads >= 2 && PARAM_FULL(1)) ||
-               (voodoo->render_threads == 4 && (PARAM_FULL(2) || PARAM_FULL(3)))) {
-                thread_reset_event(voodoo->render_not_full_event[0]);
-                if (voodoo->render_threads >= 2)
-                        thread_reset_event(voodoo->render_not_full_event[1]);
-                if (voodoo->render_threads == 4) {
-                        thread_reset_event(voodoo->render_not_full_event[2]);
-                        thread_reset_event(voodoo->render_not_full_event[3]);
-                }
-                if (PARAM_FULL(0))
-                        thread_wait_event(voodoo->render_not_full_event[0], -1); /*Wait for room in ringbuffer*/
-                if (voodoo->render_threads >= 2 && PARAM_FULL(1))
-                        thread_wait_event(voodoo->render_not_full_event[1], -1); /*Wait for room in ringbuffer*/
-                if (voodoo->render_threads == 4 && PARAM_FULL(2))
-                        thread_wait_event(voodoo->render_not_full_event[2], -1); /*Wait for room in ringbuffer*/
-                if (voodoo->render_threads == 4 && PARAM_FULL(3))
-                        thread_wait_event(voodoo->render_not_full_event[3], -1); /*Wait for room in ringbuffer*/
+        while (voodoo_params_full(voodoo)) {
+                thread_reset_event(voodoo->render_not_full_event);
+                if (voodoo_params_full(voodoo))
+                        thread_wait_event(voodoo->render_not_full_event, 1); /*Wait for room in ringbuffer*/
         }
 
         voodoo_use_texture(voodoo, params, 0);
@@ -1513,7 +1636,6 @@ void voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params) {
 
         voodoo->params_write_idx++;
 
-        if (PARAM_ENTRIES(0) < 4 || (voodoo->render_threads >= 2 && PARAM_ENTRIES(1) < 4) ||
-            (voodoo->render_threads == 4 && (PARAM_ENTRIES(2) < 4 || PARAM_ENTRIES(3) < 4)))
+        if (voodoo_params_low(voodoo))
                 voodoo_wake_render_thread(voodoo);
 }
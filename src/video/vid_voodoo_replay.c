@@ -0,0 +1,327 @@
+/*Voodoo command stream replay. Plays a stream recorded with the Voodoo "Command stream" option through
+  the register, setup, texture and render code, outside the emulator, and reports triangle and pixel
+  throughput and frame times.
+
+  voodoo-replay <stream> [render threads] [recompiler]
+
+  render threads is 1 to VOODOO_MAX_RENDER_THREADS (default 1), recompiler 0 or 1 (default 1 where the
+  recompiler is built). Only Voodoo Graphics and Voodoo 2 streams exist, as the recorder does not run on
+  Banshee or Voodoo 3.
+
+  The tool owns its voodoo_t. The stream is executed on the main thread the way voodoo_fifo_thread()
+  executes the FIFO, with the render threads doing the drawing, so nothing else touches the card state.
+  Buffer swaps are made immediate so replay is not paced by retrace. Pixel counts are taken from the
+  per-thread render counters once the render threads are idle.
+
+  A checksum of the framebuffer is printed at the end, so that runs with different render thread and
+  recompiler settings can be compared.*/
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "ibm.h"
+#include "device.h"
+#include "mem.h"
+#include "thread.h"
+#include "timer.h"
+#include "video.h"
+#include "vid_svga.h"
+#include "vid_voodoo.h"
+#include "vid_voodoo_banshee.h"
+#include "vid_voodoo_common.h"
+#include "vid_voodoo_display.h"
+#include "vid_voodoo_fb.h"
+#include "vid_voodoo_record.h"
+#include "vid_voodoo_reg.h"
+#include "vid_voodoo_regs.h"
+#include "vid_voodoo_render.h"
+#include "vid_voodoo_texture.h"
+#include "viewer.h"
+#include "viewer_voodoo.h"
+
+/*logging.h sends printf() to pclog()*/
+#undef printf
+
+#define REPLAY_BUF_ENTRIES 4096
+#define REPLAY_TEX_CACHE_SIZE ((256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2) * 4)
+
+/*Emulator state and services the Voodoo core refers to. The viewer is never active, there is no SVGA
+  or Banshee display to update, and the stream is never re-recorded*/
+uint64_t TIMER_USEC;
+uint64_t tsc;
+float cpuclock;
+int changeframecount;
+VIDEO_BITMAP *buffer32;
+viewer_t viewer_voodoo;
+
+void fatal(const char *format, ...) {
+        va_list ap;
+
+        va_start(ap, format);
+        vfprintf(stderr, format, ap);
+        va_end(ap);
+        exit(-1);
+}
+
+void pclog(const char *format, ...) {}
+
+uint64_t timer_read() { return 0; }
+void timer_enable(pc_timer_t *timer) {}
+void svga_doblit(int y1, int y2, int wx, int wy, svga_t *svga) {}
+void video_wait_for_buffer() {}
+void viewer_call(viewer_t *viewer, void *p, void (*func)(void *v, void *param), void *param) {}
+void voodoo_viewer_begin_strip(void *v, void *param) {}
+void voodoo_viewer_end_strip(void *v, void *param) {}
+void voodoo_viewer_queue_triangle(void *v, void *param) {}
+void voodoo_viewer_swap_buffer(void *v, void *param) {}
+void voodoo_viewer_use_texture(void *v, void *param) {}
+void banshee_set_overlay_addr(void *p, uint32_t addr) {}
+void voodoo_generate_vb_filters(voodoo_t *voodoo, int fcr, int fcg) {}
+void voodoo_record_write(voodoo_t *voodoo, uint32_t addr_type, uint32_t val) {}
+void voodoo_record_vertex(voodoo_t *voodoo) {}
+
+static double replay_time(void) {
+#ifdef _WIN32
+        LARGE_INTEGER freq, count;
+
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&count);
+        return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+#endif
+}
+
+/*As voodoo_card_init(), without the PCI, memory mapping, timers, FIFO thread and display*/
+static voodoo_t *replay_card_init(voodoo_record_header_t *header, int render_threads, int use_recompiler) {
+        voodoo_t *voodoo = malloc(sizeof(voodoo_t));
+        voodoo_set_t *set = malloc(sizeof(voodoo_set_t));
+        int c;
+
+        memset(voodoo, 0, sizeof(voodoo_t));
+        memset(set, 0, sizeof(voodoo_set_t));
+
+        voodoo->type = header->type;
+        voodoo->dual_tmus = header->dual_tmus;
+        voodoo->bilinear_enabled = 1;
+        voodoo->dithersub_enabled = 1;
+        voodoo->texture_size = header->texture_size;
+        voodoo->texture_mask = (voodoo->texture_size << 20) - 1;
+        voodoo->fb_size = header->fb_size;
+        voodoo->fb_mask = (voodoo->fb_size << 20) - 1;
+        voodoo->render_threads = render_threads;
+        voodoo->use_recompiler = use_recompiler;
+
+        set->nr_cards = 1;
+        set->voodoos[0] = voodoo;
+        voodoo->set = set;
+
+        voodoo->fb_mem = malloc(4 * 1024 * 1024);
+        memset(voodoo->fb_mem, 0, 4 * 1024 * 1024);
+        voodoo->tex_mem[0] = malloc(voodoo->texture_size * 1024 * 1024);
+        memset(voodoo->tex_mem[0], 0, voodoo->texture_size * 1024 * 1024);
+        if (voodoo->dual_tmus) {
+                voodoo->tex_mem[1] = malloc(voodoo->texture_size * 1024 * 1024);
+                memset(voodoo->tex_mem[1], 0, voodoo->texture_size * 1024 * 1024);
+        }
+        voodoo->tex_mem_w[0] = (uint16_t *)voodoo->tex_mem[0];
+        voodoo->tex_mem_w[1] = (uint16_t *)voodoo->tex_mem[1];
+
+        for (c = 0; c < TEX_CACHE_MAX; c++) {
+                voodoo->texture_cache[0][c].data = malloc(REPLAY_TEX_CACHE_SIZE);
+                voodoo->texture_cache[0][c].base = -1; /*invalid*/
+                if (voodoo->dual_tmus) {
+                        voodoo->texture_cache[1][c].data = malloc(REPLAY_TEX_CACHE_SIZE);
+                        voodoo->texture_cache[1][c].base = -1; /*invalid*/
+                }
+        }
+
+        voodoo->wake_fifo_thread = thread_create_event();
+        voodoo->wake_main_thread = thread_create_event();
+        voodoo->fifo_not_full_event = thread_create_event();
+        voodoo->swap_mutex = thread_create_mutex();
+        voodoo_render_init(voodoo);
+
+        voodoo_generate_colour_tables();
+#ifndef NO_CODEGEN
+        voodoo_codegen_init(voodoo);
+#endif
+
+        voodoo->fbiInit0 = header->fbiInit[0];
+        /*The recording was made on one card, or on the first card of an SLI pair*/
+        voodoo->fbiInit1 = header->fbiInit[1] & ~(FBIINIT1_SLI_ENABLE | FBIINIT1_MULTI_SST);
+        voodoo->fbiInit2 = header->fbiInit[2];
+        voodoo->fbiInit3 = header->fbiInit[3];
+        voodoo->fbiInit4 = header->fbiInit[4];
+        voodoo->fbiInit5 = header->fbiInit[5] & ~FBIINIT5_MULTI_CVG;
+        voodoo->fbiInit6 = header->fbiInit[6];
+        /*CMDFIFO packets were recorded in decoded form*/
+        voodoo->fbiInit7 = header->fbiInit[7] & ~FBIINIT7_CMDFIFO_ENABLE;
+
+        voodoo->backPorch = header->backPorch;
+        voodoo->videoDimensions = header->videoDimensions;
+        voodoo->h_disp = (header->videoDimensions & 0xfff) + 1;
+        voodoo->v_disp = (header->videoDimensions >> 16) & 0xfff;
+        voodoo->hSync = header->hSync;
+        voodoo->h_total = (header->hSync & 0xffff) + (header->hSync >> 16);
+        voodoo->vSync = header->vSync;
+        voodoo->v_total = (header->vSync & 0xffff) + (header->vSync >> 16);
+
+        voodoo->disp_buffer = 0;
+        voodoo->draw_buffer = 1;
+        voodoo_recalc(voodoo);
+        voodoo->front_offset = voodoo->params.front_offset;
+
+        return voodoo;
+}
+
+/*Execute one stream entry, as voodoo_fifo_thread() does for a FIFO entry*/
+static void replay_execute(voodoo_t *voodoo, uint32_t addr_type, uint32_t val) {
+        switch (addr_type & FIFO_TYPE) {
+        case FIFO_WRITEL_REG:
+                voodoo_reg_writel(addr_type & FIFO_ADDR, val, voodoo);
+                break;
+        case FIFO_WRITEW_FB:
+                voodoo_wait_for_render_thread_idle(voodoo);
+                voodoo_fb_writew(addr_type & FIFO_ADDR, val, voodoo);
+                break;
+        case FIFO_WRITEL_FB:
+                voodoo_wait_for_render_thread_idle(voodoo);
+                voodoo_fb_writel(addr_type & FIFO_ADDR, val, voodoo);
+                break;
+        case FIFO_WRITEL_TEX:
+                if (!(addr_type & 0x400000))
+                        voodoo_tex_writel(addr_type & FIFO_ADDR, val, voodoo);
+                break;
+        }
+}
+
+static uint64_t replay_pixels(voodoo_t *voodoo) {
+        uint64_t pixels = 0;
+        int c;
+
+        voodoo_wait_for_render_thread_idle(voodoo);
+        for (c = 0; c < voodoo->render_threads; c++)
+                pixels += voodoo->pixel_count[c];
+
+        return pixels;
+}
+
+int main(int argc, char **argv) {
+        voodoo_record_header_t header;
+        voodoo_t *voodoo;
+        uint32_t *buf;
+        FILE *f;
+        size_t nr;
+        int render_threads = (argc > 2) ? atoi(argv[2]) : 1;
+#ifndef NO_CODEGEN
+        int use_recompiler = (argc > 3) ? atoi(argv[3]) : 1;
+#else
+        int use_recompiler = 0;
+#endif
+        uint64_t tris = 0, pixels;
+        double start_time, frame_start, end_time, elapsed;
+        double frame_min = 0.0, frame_max = 0.0;
+        int frames = 0;
+        uint32_t checksum = 2166136261u;
+        uint32_t c;
+
+        if (argc < 2 || render_threads < 1 || render_threads > VOODOO_MAX_RENDER_THREADS) {
+                fprintf(stderr, "usage: %s <stream> [render threads] [recompiler]\n", argv[0]);
+                return 1;
+        }
+
+        f = fopen(argv[1], "rb");
+        if (!f) {
+                fprintf(stderr, "can't open %s\n", argv[1]);
+                return 1;
+        }
+        if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, VOODOO_RECORD_MAGIC, 8) ||
+            header.version != VOODOO_RECORD_VERSION) {
+                fprintf(stderr, "%s is not a valid command stream\n", argv[1]);
+                fclose(f);
+                return 1;
+        }
+        if (header.type >= VOODOO_BANSHEE || (header.fb_size != 2 && header.fb_size != 4) ||
+            (header.texture_size != 2 && header.texture_size != 4)) {
+                fprintf(stderr, "%s was recorded on an unsupported card configuration\n", argv[1]);
+                fclose(f);
+                return 1;
+        }
+
+        voodoo = replay_card_init(&header, render_threads, use_recompiler);
+        buf = malloc(REPLAY_BUF_ENTRIES * 8);
+
+        start_time = frame_start = replay_time();
+
+        while ((nr = fread(buf, 8, REPLAY_BUF_ENTRIES, f)) > 0) {
+                size_t i;
+
+                for (i = 0; i < nr; i++) {
+                        uint32_t addr_type = buf[i * 2];
+                        uint32_t val = buf[i * 2 + 1];
+                        int swap = 0;
+
+                        if ((addr_type & FIFO_TYPE) == FIFO_WRITEL_REG) {
+                                switch (addr_type & 0x3fc) {
+                                case SST_triangleCMD:
+                                case SST_ftriangleCMD:
+                                case SST_sDrawTriCMD:
+                                        tris++;
+                                        break;
+
+                                case SST_swapbufferCMD:
+                                        val &= ~1; /*Swap immediately rather than waiting for retrace*/
+                                        swap = 1;
+                                        break;
+                                }
+                        }
+
+                        replay_execute(voodoo, addr_type, val);
+
+                        if (swap) {
+                                double frame_time;
+
+                                /*The swap has already waited for the render threads to go idle*/
+                                end_time = replay_time();
+                                frame_time = end_time - frame_start;
+                                if (!frames || frame_time < frame_min)
+                                        frame_min = frame_time;
+                                if (frame_time > frame_max)
+                                        frame_max = frame_time;
+                                frame_start = end_time;
+                                frames++;
+                        }
+                }
+        }
+
+        pixels = replay_pixels(voodoo);
+        end_time = replay_time();
+        fclose(f);
+
+        elapsed = end_time - start_time;
+        if (elapsed <= 0.0)
+                elapsed = 1e-9;
+
+        for (c = 0; c < (uint32_t)voodoo->fb_size << 20; c++)
+                checksum = (checksum ^ voodoo->fb_mem[c]) * 16777619u;
+
+        printf("%i render threads, %s\n", voodoo->render_threads, voodoo->use_recompiler ? "recompiler" : "interpreter");
+        printf("%.0f triangles, %.0f pixels, %i frames in %f s\n", (double)tris, (double)pixels, frames, elapsed);
+        printf("%f Mtris/sec, %f Mpixels/sec\n", ((double)tris / 1000000.0) / elapsed, ((double)pixels / 1000000.0) / elapsed);
+        if (frames)
+                printf("frame time min %f ms, avg %f ms, max %f ms\n", frame_min * 1000.0, (elapsed * 1000.0) / frames,
+                       frame_max * 1000.0);
+        printf("framebuffer checksum %08x\n", checksum);
+
+        free(buf);
+        return 0;
+}
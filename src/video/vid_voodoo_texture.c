@@ -15,6 +15,59 @@
 #include "viewer.h"
 #include "viewer_voodoo.h"
 
+rgba8_t rgb332[0x100], ai44[0x100], rgb565[0x10000], argb1555[0x10000], argb4444[0x10000], ai88[0x10000];
+
+void voodoo_generate_colour_tables(void) {
+        int c;
+
+        for (c = 0; c < 0x100; c++) {
+                rgb332[c].r = c & 0xe0;
+                rgb332[c].g = (c << 3) & 0xe0;
+                rgb332[c].b = (c << 6) & 0xc0;
+                rgb332[c].r = rgb332[c].r | (rgb332[c].r >> 3) | (rgb332[c].r >> 6);
+                rgb332[c].g = rgb332[c].g | (rgb332[c].g >> 3) | (rgb332[c].g >> 6);
+                rgb332[c].b = rgb332[c].b | (rgb332[c].b >> 2);
+                rgb332[c].b = rgb332[c].b | (rgb332[c].b >> 4);
+                rgb332[c].a = 0xff;
+
+                ai44[c].a = (c & 0xf0) | ((c & 0xf0) >> 4);
+                ai44[c].r = (c & 0x0f) | ((c & 0x0f) << 4);
+                ai44[c].g = ai44[c].b = ai44[c].r;
+        }
+
+        for (c = 0; c < 0x10000; c++) {
+                rgb565[c].r = (c >> 8) & 0xf8;
+                rgb565[c].g = (c >> 3) & 0xfc;
+                rgb565[c].b = (c << 3) & 0xf8;
+                rgb565[c].r |= (rgb565[c].r >> 5);
+                rgb565[c].g |= (rgb565[c].g >> 6);
+                rgb565[c].b |= (rgb565[c].b >> 5);
+                rgb565[c].a = 0xff;
+
+                argb1555[c].r = (c >> 7) & 0xf8;
+                argb1555[c].g = (c >> 2) & 0xf8;
+                argb1555[c].b = (c << 3) & 0xf8;
+                argb1555[c].r |= (argb1555[c].r >> 5);
+                argb1555[c].g |= (argb1555[c].g >> 5);
+                argb1555[c].b |= (argb1555[c].b >> 5);
+                argb1555[c].a = (c & 0x8000) ? 0xff : 0;
+
+                argb4444[c].a = (c >> 8) & 0xf0;
+                argb4444[c].r = (c >> 4) & 0xf0;
+                argb4444[c].g = c & 0xf0;
+                argb4444[c].b = (c << 4) & 0xf0;
+                argb4444[c].a |= (argb4444[c].a >> 4);
+                argb4444[c].r |= (argb4444[c].r >> 4);
+                argb4444[c].g |= (argb4444[c].g >> 4);
+                argb4444[c].b |= (argb4444[c].b >> 4);
+
+                ai88[c].a = (c >> 8);
+                ai88[c].r = c & 0xff;
+                ai88[c].g = c & 0xff;
+                ai88[c].b = c & 0xff;
+        }
+}
+
 void voodoo_recalc_tex(voodoo_t *voodoo, int tmu) {
         int aspect = (voodoo->params.tLOD[tmu] >> 21) & 3;
         int width = 256, height = 256;
@@ -105,6 +158,18 @@ void voodoo_recalc_tex(voodoo_t *voodoo, int tmu) {
 
 #define makergba(r, g, b, a) ((b) | ((g) << 8) | ((r) << 16) | ((a) << 24))
 
+/*A texture is in use while any render tile has not yet processed every queued
+  triangle that references it*/
+static int voodoo_texture_in_use(voodoo_t *voodoo, texture_t *texture) {
+        int c;
+
+        for (c = 0; c < voodoo->render_tiles; c++) {
+                if (texture->refcount != texture->refcount_r[c])
+                        return 1;
+        }
+        return 0;
+}
+
 void voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu) {
         int c, d;
         int lod;
@@ -154,11 +219,7 @@ void voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu) {
                 for (c = 0; c < TEX_CACHE_MAX; c++) {
                         voodoo->texture_last_removed++;
                         voodoo->texture_last_removed &= (TEX_CACHE_MAX - 1);
-                        if (voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount ==
-                                    voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[0] &&
-                            (voodoo->render_threads == 1 ||
-                             voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount ==
-                                     voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[1]))
+                        if (!voodoo_texture_in_use(voodoo, &voodoo->texture_cache[tmu][voodoo->texture_last_removed]))
                                 break;
                 }
                 if (c == TEX_CACHE_MAX)
@@ -462,11 +523,7 @@ void flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu) {
                                                 //                                pclog("  Evict texture %i %08x\n", c,
                                                 //                                voodoo->texture_cache[tmu][c].base);
 
-                                                if (voodoo->texture_cache[tmu][c].refcount !=
-                                                            voodoo->texture_cache[tmu][c].refcount_r[0] ||
-                                                    (voodoo->render_threads == 2 &&
-                                                     voodoo->texture_cache[tmu][c].refcount !=
-                                                             voodoo->texture_cache[tmu][c].refcount_r[1]))
+                                                if (voodoo_texture_in_use(voodoo, &voodoo->texture_cache[tmu][c]))
                                                         wait_for_idle = 1;
 
                                                 voodoo->texture_cache[tmu][c].base = -1;
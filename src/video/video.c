@@ -553,6 +553,10 @@ int frames = 0;
 int video_frames = 0;
 int video_refresh_rate = 0;
 
+video_stats_t video_stats;
+static video_stats_t video_stats_latched, video_stats_host;
+static mutex_t *video_stats_mutex;
+
 int fullchange;
 
 uint8_t edatlookup[4][4];
@@ -1101,6 +1105,10 @@ void initvideo() {
         blit_data.blit_complete = thread_create_event();
         blit_data.buffer_not_in_use = thread_create_event();
         blit_data.blit_thread = thread_create(blit_thread, NULL);
+
+        /*Kept for the life of the process, as the host renderer may still present after closevideo()*/
+        if (!video_stats_mutex)
+                video_stats_mutex = thread_create_mutex();
 }
 
 void closevideo() {
@@ -1132,14 +1140,53 @@ void video_blit_complete() {
 }
 
 void video_wait_for_blit() {
+        uint64_t start_time = timer_read();
+
         while (blit_data.busy)
                 thread_wait_event(blit_data.blit_complete, 1);
         thread_reset_event(blit_data.blit_complete);
+
+        video_stats.blit_wait_time += timer_read() - start_time;
 }
 void video_wait_for_buffer() {
+        uint64_t start_time = timer_read();
+
         while (blit_data.buffer_in_use)
                 thread_wait_event(blit_data.buffer_not_in_use, 1);
         thread_reset_event(blit_data.buffer_not_in_use);
+
+        video_stats.buffer_wait_time += timer_read() - start_time;
+}
+
+void video_stats_latch() {
+        thread_lock_mutex(video_stats_mutex);
+        video_stats_latched = video_stats;
+        video_stats_latched.update_time = video_stats_host.update_time;
+        video_stats_latched.present_time = video_stats_host.present_time;
+        video_stats_latched.presents = video_stats_host.presents;
+        memset(&video_stats_host, 0, sizeof(video_stats_host));
+        thread_unlock_mutex(video_stats_mutex);
+
+        memset(&video_stats, 0, sizeof(video_stats));
+}
+
+void video_stats_get(video_stats_t *stats) {
+        thread_lock_mutex(video_stats_mutex);
+        *stats = video_stats_latched;
+        thread_unlock_mutex(video_stats_mutex);
+}
+
+void video_stats_add_update(uint64_t time) {
+        thread_lock_mutex(video_stats_mutex);
+        video_stats_host.update_time += time;
+        thread_unlock_mutex(video_stats_mutex);
+}
+
+void video_stats_add_present(uint64_t time) {
+        thread_lock_mutex(video_stats_mutex);
+        video_stats_host.present_time += time;
+        video_stats_host.presents++;
+        thread_unlock_mutex(video_stats_mutex);
 }
 
 void video_blit_memtoscreen(int x, int y, int y1, int y2, int w, int h) {
@@ -1147,6 +1194,7 @@ void video_blit_memtoscreen(int x, int y, int y1, int y2, int w, int h) {
         if (h <= 0)
                 return;
         video_wait_for_blit();
+        video_stats.blits++;
         blit_data.busy = 1;
         blit_data.buffer_in_use = 1;
         blit_data.x = x;
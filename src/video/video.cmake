@@ -34,6 +34,7 @@ set(PCEM_PRIVATE_API ${PCEM_PRIVATE_API}
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_t3100e.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_tandy.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_tandysl.h
+        ${CMAKE_SOURCE_DIR}/includes/private/video/vid_text_cache.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_tgui9440.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_tkd8001_ramdac.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_tvga.h
@@ -43,6 +44,7 @@ set(PCEM_PRIVATE_API ${PCEM_PRIVATE_API}
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_banshee_blitter.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_banshee.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_blitter.h
+        ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_codegen_arm64.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_codegen_x86-64.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_codegen_x86.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_common.h
@@ -52,6 +54,7 @@ set(PCEM_PRIVATE_API ${PCEM_PRIVATE_API}
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_fifo.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_reg.h
+        ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_record.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_regs.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_render.h
         ${CMAKE_SOURCE_DIR}/includes/private/video/vid_voodoo_setup.h
@@ -120,6 +123,7 @@ set(PCEM_SRC ${PCEM_SRC}
         video/vid_t3100e.c
         video/vid_tandy.c
         video/vid_tandysl.c
+        video/vid_text_cache.c
         video/vid_tgui9440.c
         video/vid_tkd8001_ramdac.c
         video/vid_tvga.c
@@ -135,9 +139,37 @@ set(PCEM_SRC ${PCEM_SRC}
         video/vid_voodoo_fb.c
         video/vid_voodoo_fifo.c
         video/vid_voodoo_reg.c
+        video/vid_voodoo_record.c
         video/vid_voodoo_render.c
         video/vid_voodoo_setup.c
         video/vid_voodoo_texture.c
         video/vid_wy700.c
         video/video.c
         )
+
+if(BUILD_VOODOO_JIT_TEST)
+        add_executable(voodoo-jit-test video/vid_voodoo_jit_test.c)
+        target_compile_definitions(voodoo-jit-test PUBLIC ${PCEM_DEFINES})
+        if(UNIX)
+                target_link_libraries(voodoo-jit-test m)
+        endif()
+endif()
+
+if(BUILD_VOODOO_REPLAY)
+        add_executable(voodoo-replay video/vid_voodoo_replay.c video/vid_voodoo_reg.c video/vid_voodoo_render.c
+                video/vid_voodoo_setup.c video/vid_voodoo_texture.c video/vid_voodoo_fb.c video/vid_voodoo_fifo.c
+                video/vid_voodoo_display.c video/vid_voodoo_blitter.c video/vid_voodoo_banshee_blitter.c wx-ui/wx-thread.c)
+        target_compile_definitions(voodoo-replay PUBLIC ${PCEM_DEFINES})
+        if(UNIX)
+                target_link_libraries(voodoo-replay m pthread)
+        endif()
+endif()
+
+if(BUILD_BANSHEE_BLIT_BENCH)
+        add_executable(banshee-blit-bench video/vid_voodoo_banshee_blit_bench.c video/vid_voodoo_banshee_blit_ref.c
+                video/vid_voodoo_banshee_blitter.c)
+        target_compile_definitions(banshee-blit-bench PUBLIC ${PCEM_DEFINES})
+        if(UNIX)
+                target_link_libraries(banshee-blit-bench m)
+        endif()
+endif()
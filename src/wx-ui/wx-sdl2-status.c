@@ -14,6 +14,9 @@
 #include "ide.h"
 #include "cdrom-image.h"
 #include "scsi_zip.h"
+#include "sound.h"
+#include "sound_capture.h"
+#include "sound_out.h"
 #include "codegen_allocator.h"
 #include "wx-common.h"
 
@@ -105,7 +108,10 @@ int get_status(char *machine, char *device) {
         //        char device_s[4096];
         uint64_t new_time = timer_read();
         uint64_t status_diff = new_time - status_time;
+        video_stats_t stats;
+
         status_time = new_time;
+        video_stats_get(&stats);
         sprintf(machine,
                 "CPU speed : %f MIPS\n"
                 "FPU speed : %f MFLOPS\n\n"
@@ -123,6 +129,14 @@ int get_status(char *machine, char *device) {
                 "Render FPS: %d\n"
                 "\n"
 
+                "Emulated frames : %i/sec (%i blitted)\n"
+                "Line rendering : %f%% (%i lines/sec)\n"
+                "VRAM reads : %f%% (%i calls/sec)\n"
+                "VRAM writes : %f%% (%i calls/sec)\n"
+                "Blit wait : %f%%\nBuffer wait : %f%%\n"
+                "Presenter : %f%% update, %f%% present (%i frames/sec)\n"
+                "\n"
+
                 "New blocks : %i\nOld blocks : %i\nRecompiled speed : %f MIPS\nAverage size : %f\n"
                 "Flushes : %i\nEvicted : %i\nReused : %i\nRemoved : %i\nReal speed : %f MIPS\nMem blocks used : %i (%g MB)"
                 //                        "\nFully recompiled ins %% : %f%%"
@@ -135,7 +149,16 @@ int get_status(char *machine, char *device) {
                 segareads, segawrites, cpu_get_speed() - scycles_lost, pit_timer0_freq(),
                 ((double)main_time * 100.0) / status_diff, ((double)main_time * 100.0) / timer_freq,
                 ((double)render_time * 100.0) / status_diff, ((double)render_time * 100.0) / timer_freq,
-                current_render_driver_name, render_fps, cpu_new_blocks_latched, cpu_recomp_blocks_latched,
+                current_render_driver_name, render_fps,
+
+                emu_fps, stats.blits, ((double)stats.render_time * 100.0) / timer_freq, stats.render_lines,
+                ((double)stats.vram_read_time * 100.0) / timer_freq, stats.vram_reads,
+                ((double)stats.vram_write_time * 100.0) / timer_freq, stats.vram_writes,
+                ((double)stats.blit_wait_time * 100.0) / timer_freq, ((double)stats.buffer_wait_time * 100.0) / timer_freq,
+                ((double)stats.update_time * 100.0) / timer_freq, ((double)stats.present_time * 100.0) / timer_freq,
+                stats.presents,
+
+                cpu_new_blocks_latched, cpu_recomp_blocks_latched,
                 (double)cpu_recomp_ins_latched / 1000000.0, (double)cpu_recomp_ins_latched / cpu_recomp_blocks_latched,
                 cpu_recomp_flushes_latched, cpu_recomp_evicted_latched, cpu_recomp_reuse_latched, cpu_recomp_removed_latched,
 
@@ -153,6 +176,9 @@ int get_status(char *machine, char *device) {
         //        device_s[0] = 0;
         device[0] = 0;
         device_add_status_info(device, 4096);
+        sound_add_status_info(device, 4096);
+        sound_out_add_status_info(device, 4096);
+        sound_capture_add_status_info(device, 4096);
 
         return 1;
 }
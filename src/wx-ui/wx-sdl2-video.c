@@ -4,6 +4,7 @@
 #include <string.h>
 #include <stdio.h>
 #include "wx-sdl2.h"
+#include "ibm.h"
 #include "video.h"
 #include "wx-sdl2-video.h"
 
@@ -243,6 +244,7 @@ int sdl_renderer_update(SDL_Window *window) {
         if ((window == NULL) || (renderer == NULL))
                 return 0;
         int render = 0;
+        uint64_t start_time = timer_read();
         SDL_LockMutex(blitMutex);
         if (updated) {
                 updated = 0;
@@ -259,6 +261,7 @@ int sdl_renderer_update(SDL_Window *window) {
         SDL_UnlockMutex(blitMutex);
         if (screen_copy && render)
                 renderer->update(window, updated_rect_copy, screen_copy);
+        video_stats_add_update(timer_read() - start_time);
         return render || renderer->always_update;
 }
 
@@ -274,7 +277,10 @@ void sdl_renderer_present(SDL_Window *window) {
         SDL_Rect wr;
         SDL_GetWindowSize(window, &wr.w, &wr.h);
         sdl_scale(video_fullscreen_scale, wr, &wr, texture_rect.w, texture_rect.h);
+
+        uint64_t start_time = timer_read();
         renderer->present(window, texture_rect, wr, screen_rect);
+        video_stats_add_present(timer_read() - start_time);
 }
 
 void color_flash(FLASH_FUNC func, int time_ms, char r, char g, char b, char a) {
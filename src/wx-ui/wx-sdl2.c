@@ -34,6 +34,7 @@
 #include "plat-midi.h"
 #include "scsi_zip.h"
 #include "sound.h"
+#include "sound_capture.h"
 #include "thread.h"
 #include "disc.h"
 #include "disc_img.h"
@@ -169,6 +170,10 @@ int mainthread(void *param) {
                 drawits += new_time - old_time;
                 old_time = new_time;
 
+                /*An unthrottled capture runs emulation flat out, so it takes only as long as the host needs*/
+                if (sound_capture && sound_capture_unthrottled)
+                        drawits = 10;
+
                 if (drawits > 0 && !pause) {
                         uint64_t start_time = timer_read();
                         uint64_t end_time;
@@ -621,6 +626,8 @@ int stop_emulation() {
         endblit();
         SDL_DestroyMutex(ghMutex);
 
+        sound_synth_stop();
+        sound_capture_close();
         device_close_all();
         midi_close();
 